@@ -1,263 +1,115 @@
 #include <glib.h>
-#include <glib/gprintf.h>
-#include <linux/videodev2.h>
-#include <math.h>
+#include <string.h>
 #include <pulse/glib-mainloop.h>
 #include <pulse/pulseaudio.h>
-#include <sys/ioctl.h>
 
 #include "audio.h"
 #include "fmtx-object.h"
+#include "meter.h"
+#include "profile.h"
 
-static void
-pa_connect(FmtxObject *obj);
+/* PulseAudio side of the engine: whether sink.hw0 is running decides if
+ * the pilot tone is needed. */
 
-#define WRITE_FMTX_SYSFS_PILOT(file, val) \
-  WRITE_FMTX_SYSFS(file, val, "fmtxd fmtx chirping error")
+/* One meter block, also how long audio takes to ungate the carrier */
+#define METER_BLOCK_MS 20
 
-gboolean
-idle_timeout_cb(FmtxObject *obj)
-{
-  obj->active = 0;
-  obj->idle_timeout = 0;
-  obj->exit_timeout = g_timeout_add(60000, (GSourceFunc)exit_timeout_cb, obj);
-  return FALSE;
-}
+static void
+pa_connect(FmtxObject *obj);
 
-static gboolean
-pilot_timeout_cb(FmtxObject *obj)
+static void
+context_sink_info_cb(pa_context *c, const pa_sink_info *i, int eol,
+                     void *userdata)
 {
-  if (!obj->active &&
-      (!obj->mixer_inited || !obj->pa_running) &&
-      g_str_equal(obj->state, "enabled"))
-  {
-    fmtx_enable(obj, FALSE);
-    g_idle_add(emit_changed, obj);
-    g_idle_add(emit_info, obj);
-    obj->active = TRUE;
-
-    if (!obj->idle_timeout)
-      obj->idle_timeout = g_timeout_add_seconds(300,
-                                                (GSourceFunc)idle_timeout_cb,
-                                                obj);
-  }
-
-  obj->pilot_timeout = 0;
-
-  return FALSE;
+  if (!eol)
+    fmtx_engine_set_sink_running(((FmtxObject *)userdata)->engine,
+                                 i->state == PA_SINK_RUNNING);
 }
 
 static void
-fmtx_set_mute(FmtxObject *obj, int value)
+context_subscribe_cb(pa_context *c, pa_subscription_event_type_t t,
+                     uint32_t idx, void *userdata)
 {
-  struct v4l2_control ctl;
-
-  ctl.id = V4L2_CID_AUDIO_MUTE;
-  ctl.value = value;
+  pa_operation *op;
 
-  if (ioctl(obj->dev_radio, VIDIOC_S_CTRL, &ctl) < 0)
-    g_fprintf(stderr, "Could not toggle mute on the device\n");
+  op = pa_context_get_sink_info_by_name(c, "sink.hw0", context_sink_info_cb,
+                                        userdata);
+  pa_operation_unref(op);
 }
 
-int
-fmtx_set_frequency(FmtxObject *fmtx, unsigned int frequency)
+static void
+meter_read_cb(pa_stream *s, size_t nbytes, void *userdata)
 {
-  unsigned int f;
-  struct v4l2_tuner tun;
-  GError *err = NULL;
-
-  if (fmtx->dev_radio < 0)
-    return 1;
-
-  if (fmtx->freq_max < fmtx->freq_min)
-    return 0;
-
-  f = fmtx->freq_min;
-
-  while (f <= fmtx->freq_max)
-  {
-    if (frequency == f)
-      break;
-
-    f += fmtx->freq_step;
-  }
-
-  if (f > fmtx->freq_max)
-    return 0;
-
-  fmtx->frequency = f;
-
-  gconf_client_set_int(fmtx->gcclient, "/system/fmtx/frequency", f, &err);
-
-  if (err)
-    g_fprintf(stderr, "Could not set fmtx settings: %s\n", err->message);
+  FmtxObject *obj = userdata;
+  FmtxMeterLevel level;
+  const void *data;
 
-  if (!g_str_equal(fmtx->state, "enabled"))
-    return 2;
-
-  tun.index = 0;
-
-  if ((ioctl(fmtx->dev_radio, VIDIOC_S_TUNER, &tun) >= 0) &&
-      (ioctl(fmtx->dev_radio, VIDIOC_G_TUNER, &tun) >= 0))
+  while (pa_stream_readable_size(s) > 0)
   {
-    struct v4l2_frequency freq;
+    if (pa_stream_peek(s, &data, &nbytes) < 0)
+      return;
 
-    f = rint((tun.capability & V4L2_TUNER_CAP_LOW ? 16000.0 : 16.0) *
-             (long double)fmtx->frequency / 1000.0);
+    /* a hole means nothing was played, which is silence too */
+    if (!data)
+      fmtx_meter_block(NULL, 0, &level);
+    else
+      fmtx_meter_block(data, nbytes / sizeof(int16_t), &level);
 
-    freq.tuner = tun.index;
-    freq.type = tun.type;
-    freq.frequency = f;
+    if (nbytes)
+      pa_stream_drop(s);
 
-    if (ioctl(fmtx->dev_radio, VIDIOC_S_FREQUENCY, &freq) >= 0)
-      return 2;
+    fmtx_engine_set_audio_level(obj->engine, &level);
   }
-
-  perror("fmtxd Could not set frequency");
-
-  return 1;
 }
 
-int
-fmtx_enable(FmtxObject *fmtx, gboolean enable)
+static void
+meter_connect(FmtxObject *obj)
 {
-  int rv;
-  GError *err = NULL;
+  static const pa_sample_spec ss = {PA_SAMPLE_S16NE, 48000, 2};
+  pa_buffer_attr attr;
 
-  if (!g_str_equal(fmtx->state, "n/a"))
-  {
-    if (enable)
-    {
-      if (!g_str_equal(fmtx->state, "enabled"))
-      {
-        if (fmtx->offline || fmtx->hp_connected)
-        {
-          fmtx_set_mute(fmtx, TRUE);
-          g_free(fmtx->state);
-          fmtx->state = g_strdup("disabled");
-          return 0;
-        }
-
-        fmtx_set_mute(fmtx, FALSE);
-        rv = fmtx_set_frequency(fmtx, fmtx->frequency);
-
-        if (rv != 2)
-        {
-          fmtx_set_mute(fmtx, TRUE);
-          return rv;
-        }
-
-        g_free(fmtx->state);
-        fmtx->state = g_strdup("enabled");
-out:
-        gconf_client_set_bool(fmtx->gcclient, "/system/fmtx/enabled", enable,
-                              &err);
-
-        if (err)
-          g_fprintf(stderr, "Could not save fmtx settings: %s\n", err->message);
-
-        fmtx_toggle_pilot(fmtx);
-        fmtx_set_frequency(fmtx, fmtx->frequency);
-        return 2;
-      }
-    }
-    else
-    {
-      if (!g_str_equal(fmtx->state, "disabled"))
-      {
-        fmtx->active = FALSE;
-
-        if (fmtx->idle_timeout)
-        {
-          g_source_remove(fmtx->idle_timeout);
-          fmtx->idle_timeout = 0;
-        }
-
-        fmtx_set_mute(fmtx, TRUE);
-        g_free(fmtx->state);
-        fmtx->state = g_strdup("disabled");
-        goto out;
-      }
-
-      fmtx->active = 0;
-
-      if (fmtx->idle_timeout)
-      {
-        g_source_remove(fmtx->idle_timeout);
-        fmtx->idle_timeout = 0;
-        return 2;
-      }
-    }
+  memset(&attr, 0xff, sizeof(attr));
+  attr.fragsize = pa_usec_to_bytes(METER_BLOCK_MS * PA_USEC_PER_MSEC, &ss);
 
-    return 2;
-  }
+  obj->meter = pa_stream_new(obj->context, "fmtx-meter", &ss, NULL);
 
-  return 0;
-}
+  if (!obj->meter)
+    return;
 
-void
-fmtx_toggle_pilot(FmtxObject *fmtx)
-{
-  if (!g_str_equal(fmtx->state, "enabled") ||
-      (fmtx->mixer_inited && fmtx->pa_running))
-  {
-    if (fmtx->active &&
-        fmtx->pa_running &&
-        !fmtx->offline &&
-        !fmtx->hp_connected &&
-        !fmtx->call_active)
-    {
-      if (fmtx->idle_timeout)
-      {
-        g_source_remove(fmtx->idle_timeout);
-        fmtx->idle_timeout = 0;
-      }
-
-      fmtx->active = 0;
-      fmtx_enable(fmtx, TRUE);
-      g_idle_add(emit_changed, fmtx);
-      g_idle_add(emit_info, fmtx);
-    }
+  pa_stream_set_read_callback(obj->meter, meter_read_cb, obj);
 
-    WRITE_FMTX_SYSFS_PILOT("tone_frequency", "0");
-    WRITE_FMTX_SYSFS_PILOT("tone_deviation", "0");
-    WRITE_FMTX_SYSFS_PILOT("tone_off_time", "0");
-    WRITE_FMTX_SYSFS_PILOT("tone_on_time", "0");
-  }
-  else
+  if (pa_stream_connect_record(obj->meter, "sink.hw0.monitor", &attr,
+                               PA_STREAM_ADJUST_LATENCY) < 0)
   {
-    WRITE_FMTX_SYSFS_PILOT("tone_frequency", "1760");
-    WRITE_FMTX_SYSFS_PILOT("tone_deviation", "6750");
-    WRITE_FMTX_SYSFS_PILOT("tone_off_time", "2000");
-    WRITE_FMTX_SYSFS_PILOT("tone_on_time", "50");
-
-    if (!fmtx->pilot_timeout)
-      fmtx->pilot_timeout = g_timeout_add(50000,
-                                          (GSourceFunc)pilot_timeout_cb,
-                                          fmtx);
+    g_log(NULL, G_LOG_LEVEL_WARNING, "Failed to connect audio meter: %s",
+          pa_strerror(pa_context_errno(obj->context)));
+    pa_stream_unref(obj->meter);
+    obj->meter = NULL;
   }
 }
 
 static void
-context_sink_info_cb(pa_context *c, const pa_sink_info *i, int eol,
-                     void *userdata)
+meter_disconnect(FmtxObject *obj)
 {
-  if (!eol)
+  if (obj->meter)
   {
-    ((FmtxObject *)userdata)->pa_running = (i->state == PA_SINK_RUNNING);
-    fmtx_toggle_pilot(userdata);
+    pa_stream_set_read_callback(obj->meter, NULL, NULL);
+    pa_stream_disconnect(obj->meter);
+    pa_stream_unref(obj->meter);
+    obj->meter = NULL;
   }
 }
 
-static void
-context_subscribe_cb(pa_context *c, pa_subscription_event_type_t t,
-                     uint32_t idx, void *userdata)
+void
+fmtx_audio_meter(FmtxObject *obj, gboolean on)
 {
-  pa_operation *op;
+  obj->meter_wanted = on;
 
-  op = pa_context_get_sink_info_by_name(c, "sink.hw0", context_sink_info_cb,
-                                        userdata);
-  pa_operation_unref(op);
+  if (!on)
+    meter_disconnect(obj);
+  else if (!obj->meter && obj->context &&
+           pa_context_get_state(obj->context) == PA_CONTEXT_READY)
+    meter_connect(obj);
 }
 
 static void
@@ -280,6 +132,9 @@ context_state_cb(pa_context *c, void *userdata)
       op = pa_context_get_sink_info_by_name(c, "sink.hw0", context_sink_info_cb,
                                             userdata);
       pa_operation_unref(op);
+
+      if (((FmtxObject *)userdata)->meter_wanted)
+        meter_connect(userdata);
     }
     else
       pa_connect((FmtxObject *)userdata);
@@ -289,6 +144,8 @@ context_state_cb(pa_context *c, void *userdata)
 static void
 pa_connect(FmtxObject *obj)
 {
+  meter_disconnect(obj);
+
   if (obj->context)
     pa_context_unref(obj->context);
 
@@ -303,7 +160,7 @@ pa_connect(FmtxObject *obj)
           pa_strerror(pa_context_errno(obj->context)));
 }
 
-void
+static void
 register_pa(FmtxObject *obj)
 {
   pa_glib_mainloop *m;
@@ -318,3 +175,13 @@ register_pa(FmtxObject *obj)
 
   pa_connect(obj);
 }
+
+void
+fmtx_audio_start(FmtxObject *obj)
+{
+  FmtxProfileMark mark;
+
+  fmtx_profile_begin(&mark);
+  register_pa(obj);
+  fmtx_profile_end(&mark, "pulseaudio");
+}
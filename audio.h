@@ -3,11 +3,12 @@
 
 #include "fmtx-object.h"
 
+/* FmtxEngineOps.audio_start */
 void
-register_pa(FmtxObject *obj);
-gboolean
-idle_timeout_cb(FmtxObject *obj);
+fmtx_audio_start(FmtxObject *obj);
+
+/* FmtxEngineOps.meter */
 void
-fmtx_toggle_pilot(FmtxObject *fmtx);
+fmtx_audio_meter(FmtxObject *obj, gboolean on);
 
 #endif /* __FMTXD_AUDIO_H_INCLUDED__ */
@@ -1,6 +0,0 @@
-#ifndef __FMTXD_DBUS_H_INCLUDED__
-#define __FMTXD_DBUS_H_INCLUDED__
-void
-connect_dbus_signals(DBusGConnection *dbus, FmtxObject *obj);
-
-#endif /* __FMTXD_DBUS_H_INCLUDED__ */
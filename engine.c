@@ -0,0 +1,2602 @@
+#include <ctype.h>
+#include <errno.h>
+#include <linux/videodev2.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "rds.h"
+
+#define PENDING_CHANGED (1 << 0)
+#define PENDING_INFO (1 << 1)
+
+/* epoll data for the worker, timers use their FmtxEngineTimer */
+#define SOURCE_WORKER FMTX_ENGINE_TIMER_LAST
+/* any of the governor's sysfs files */
+#define SOURCE_SENSORS (FMTX_ENGINE_TIMER_LAST + 1)
+#define MAX_EVENTS (FMTX_ENGINE_TIMER_LAST + 2)
+
+#define WRITE_FMTX_SYSFS(engine, attr, val, err_msg) \
+  fmtx_hw_worker_write((engine)->worker, attr, val, sizeof(val), \
+                       write_done, (void *)(err_msg))
+
+#define WRITE_FMTX_SYSFS_PILOT(engine, attr, val) \
+  WRITE_FMTX_SYSFS(engine, attr, val, "fmtxd fmtx chirping error")
+
+static int
+enable(FmtxEngine *engine, int on);
+static void
+monitor_update(FmtxEngine *engine);
+static void
+monitor_sample(FmtxEngine *engine);
+static void
+governor_poll(FmtxEngine *engine);
+static void
+governor_update(FmtxEngine *engine);
+static void
+schedule_update(FmtxEngine *engine);
+static void
+ct_update(FmtxEngine *engine);
+static int
+set_rds_ps(FmtxEngine *engine, const char *rds_ps);
+static int
+set_rds_text(FmtxEngine *engine, const char *rds_text,
+             const FmtxRdsTag *tags, unsigned int n_tags);
+static void
+call_end(FmtxEngine *engine);
+
+static void
+emit(FmtxEngine *engine, unsigned int what)
+{
+  engine->pending |= what;
+}
+
+/* Runs the coalesced outputs. Callbacks may feed the engine again. */
+static void
+flush_outputs(FmtxEngine *engine)
+{
+  unsigned int pending;
+
+  while ((pending = engine->pending))
+  {
+    engine->pending = 0;
+
+    if ((pending & PENDING_CHANGED) && engine->ops->changed)
+      engine->ops->changed(engine->data);
+
+    if ((pending & PENDING_INFO) && engine->ops->info)
+      engine->ops->info(engine->data);
+  }
+}
+
+static void
+fatal(FmtxEngine *engine, const char *msg, const char *reason)
+{
+  if (engine->ops->fatal)
+    engine->ops->fatal(engine->data, msg, reason);
+  else
+    fprintf(stderr, "fmtxd: ERROR: %s (%s)\n", msg, reason);
+}
+
+static void
+store(FmtxEngine *engine, FmtxEngineKey key, unsigned int value)
+{
+  if (engine->ops->store)
+    engine->ops->store(engine->data, key, value);
+}
+
+static void
+timer_arm(FmtxEngine *engine, FmtxEngineTimer timer, unsigned int ms,
+          int repeat)
+{
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = ms / 1000;
+  its.it_value.tv_nsec = (ms % 1000) * 1000000;
+
+  if (repeat)
+    its.it_interval = its.it_value;
+
+  if (timerfd_settime(engine->timer_fd[timer], 0, &its, NULL) == -1)
+    perror("fmtxd Could not arm timer");
+  else
+    engine->armed |= 1u << timer;
+}
+
+static void
+timer_disarm(FmtxEngine *engine, FmtxEngineTimer timer)
+{
+  struct itimerspec its;
+
+  if (!(engine->armed & (1u << timer)))
+    return;
+
+  memset(&its, 0, sizeof(its));
+  timerfd_settime(engine->timer_fd[timer], 0, &its, NULL);
+  engine->armed &= ~(1u << timer);
+}
+
+static int
+timer_armed(FmtxEngine *engine, FmtxEngineTimer timer)
+{
+  return (engine->armed & (1u << timer)) != 0;
+}
+
+/* ns is CLOCK_MONOTONIC, see now_ns() */
+static void
+timer_arm_at(FmtxEngine *engine, FmtxEngineTimer timer, long long ns)
+{
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = ns / 1000000000;
+  its.it_value.tv_nsec = ns % 1000000000;
+
+  if (timerfd_settime(engine->timer_fd[timer], TFD_TIMER_ABSTIME, &its,
+                      NULL) == -1)
+    perror("fmtxd Could not arm timer");
+  else
+    engine->armed |= 1u << timer;
+}
+
+/* t is CLOCK_REALTIME seconds. Setting the clock cancels the timer, which
+ * then expires with ECANCELED. */
+static void
+timer_arm_wall(FmtxEngine *engine, FmtxEngineTimer timer, time_t t)
+{
+  struct itimerspec its;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = t;
+
+  if (timerfd_settime(engine->timer_fd[timer],
+                      TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its,
+                      NULL) == -1)
+    perror("fmtxd Could not arm timer");
+  else
+    engine->armed |= 1u << timer;
+}
+
+static long long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+write_done(void *err_msg, int result, int err)
+{
+  if (result < 0)
+    fprintf(stderr, "%s: %s\n", (const char *)err_msg, strerror(err));
+}
+
+/* Fails to compile if a transaction can't hold one op per key */
+typedef char txn_ops_check[FMTX_ENGINE_TXN_OPS >= FMTX_HW_WORKER_KEY_LAST ?
+                           1 : -1];
+
+/* Like the worker, only the last op for a key counts, so a transaction
+ * never fills up */
+static FmtxEngineTxnOp *
+txn_op(FmtxEngineTxn *txn, int key)
+{
+  unsigned int i;
+
+  for (i = 0; i < txn->n; i++)
+  {
+    if (txn->op[i].key == key)
+      return &txn->op[i];
+  }
+
+  txn->op[i].key = key;
+  txn->n++;
+
+  return &txn->op[i];
+}
+
+/* Collected into the open transaction, if any, else queued right away */
+static void
+hw_write(FmtxEngine *engine, FmtxHwAttr attr, const void *val, size_t len,
+         const char *err_msg)
+{
+  FmtxEngineTxn *txn = engine->txn_open;
+  FmtxEngineTxnOp *op;
+
+  /* the driver doesn't have it, so there is nothing to send it to */
+  if (!fmtx_hw_has_attr(engine->hw, attr))
+    return;
+
+  if (!txn)
+  {
+    fmtx_hw_worker_write(engine->worker, attr, val, len, write_done,
+                         (void *)err_msg);
+    return;
+  }
+
+  op = txn_op(txn, attr);
+  op->len = len > sizeof(op->val) ? sizeof(op->val) : len;
+  memcpy(op->val, val, op->len);
+}
+
+static void
+rds_write_uint(FmtxEngine *engine, FmtxHwAttr attr, unsigned int value,
+               const char *err_msg)
+{
+  char buf[12];
+
+  snprintf(buf, sizeof(buf), "%u", value);
+  hw_write(engine, attr, buf, strlen(buf) + 1, err_msg);
+}
+
+static void
+rds_write_tags(FmtxEngine *engine, const FmtxRdsTag *tags, unsigned int n)
+{
+  char buf[32] = "0";
+  unsigned int off = 0;
+  unsigned int i;
+
+  if (!fmtx_hw_has_attr(engine->hw, FMTX_HW_ATTR_RDS_RT_PLUS))
+    return;
+
+  for (i = 0; i < n; i++)
+    off += snprintf(buf + off, sizeof(buf) - off, "%s%u %u %u", i ? " " : "",
+                    tags[i].type, tags[i].start, tags[i].len);
+
+  hw_write(engine, FMTX_HW_ATTR_RDS_RT_PLUS, buf, strlen(buf) + 1,
+           "fmtxd Could not set RT+ tags");
+}
+
+/* Writes whatever the RDS scheduler says has changed and rearms its timer.
+ * Unchanged text and fields are never written again. */
+static void
+rds_update(FmtxEngine *engine)
+{
+  const FmtxRdsFields *f = &engine->rds.fields_out;
+  const char *ps;
+  const char *rt;
+  unsigned int changed;
+  long long deadline;
+  char buf[32];
+
+  if (!engine->worker)
+    return;
+
+  changed = fmtx_rds_sched_run(&engine->rds, now_ns(), &ps, &rt);
+
+  /* no terminator, like it always was */
+  if (changed & FMTX_RDS_SCHED_PI)
+  {
+    snprintf(buf, sizeof(buf), "%04x", f->pi);
+    hw_write(engine, FMTX_HW_ATTR_RDS_PI, buf, 4,
+             "fmtxd Could not set RDS PI");
+  }
+
+  if (changed & FMTX_RDS_SCHED_PTY)
+    rds_write_uint(engine, FMTX_HW_ATTR_RDS_PTY, f->pty,
+                   "fmtxd Could not set RDS PTY");
+
+  if (changed & FMTX_RDS_SCHED_TP)
+    rds_write_uint(engine, FMTX_HW_ATTR_RDS_TP, f->tp,
+                   "fmtxd Could not set RDS TP");
+
+  if (changed & FMTX_RDS_SCHED_TA)
+    rds_write_uint(engine, FMTX_HW_ATTR_RDS_TA, f->ta,
+                   "fmtxd Could not set RDS TA");
+
+  if (changed & FMTX_RDS_SCHED_CT)
+  {
+    if (f->ct)
+      snprintf(buf, sizeof(buf), "%lld %d", (long long)f->ct, f->ct_offset);
+    else
+      strcpy(buf, "0");
+
+    hw_write(engine, FMTX_HW_ATTR_RDS_CT, buf, strlen(buf) + 1,
+             "fmtxd Could not set RDS clock time");
+  }
+
+  if (changed & FMTX_RDS_SCHED_PS)
+    hw_write(engine, FMTX_HW_ATTR_RDS_PS_NAME, ps, FMTX_RDS_PS_LEN + 1,
+             "fmtxd Could not set rds station name");
+
+  if (changed & FMTX_RDS_SCHED_RT)
+    hw_write(engine, FMTX_HW_ATTR_RDS_RADIO_TEXT, rt, strlen(rt) + 1,
+             "fmtxd Could not set rds info text");
+
+  /* after the text the tags point into */
+  if (changed & FMTX_RDS_SCHED_RTPLUS)
+    rds_write_tags(engine, engine->rds.tags_out, engine->rds.n_tags_out);
+
+  deadline = fmtx_rds_sched_deadline(&engine->rds);
+
+  if (deadline < 0)
+    timer_disarm(engine, FMTX_ENGINE_TIMER_RDS);
+  else
+    timer_arm_at(engine, FMTX_ENGINE_TIMER_RDS, deadline);
+}
+
+static int
+mute_job(FmtxHw *hw, void *data)
+{
+  struct v4l2_control ctl;
+
+  ctl.id = V4L2_CID_AUDIO_MUTE;
+  ctl.value = (intptr_t)data;
+
+  return fmtx_hw_ioctl(hw, VIDIOC_S_CTRL, &ctl);
+}
+
+static void
+mute_done(void *data, int result, int err)
+{
+  if (result < 0)
+    fprintf(stderr, "Could not toggle mute on the device\n");
+}
+
+/* Mute toggles are never collapsed, every one of them reaches the device */
+static void
+set_mute(FmtxEngine *engine, int value)
+{
+  fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, mute_job,
+                     mute_done, (void *)(intptr_t)value);
+}
+
+static int
+tune_job(FmtxHw *hw, void *data)
+{
+  struct v4l2_tuner tun;
+  struct v4l2_frequency freq;
+
+  tun.index = 0;
+
+  if ((fmtx_hw_ioctl(hw, VIDIOC_S_TUNER, &tun) < 0) ||
+      (fmtx_hw_ioctl(hw, VIDIOC_G_TUNER, &tun) < 0))
+    return -1;
+
+  freq.tuner = tun.index;
+  freq.type = tun.type;
+  freq.frequency = rint((tun.capability & V4L2_TUNER_CAP_LOW ?
+                         16000.0 : 16.0) *
+                        (long double)(uintptr_t)data / 1000.0);
+
+  return fmtx_hw_ioctl(hw, VIDIOC_S_FREQUENCY, &freq);
+}
+
+static void
+tune_done(void *data, int result, int err)
+{
+  if (result < 0)
+    fprintf(stderr, "fmtxd Could not set frequency: %s\n", strerror(err));
+}
+
+static void
+apply_power_level(FmtxEngine *engine);
+
+static int
+on_plan(FmtxEngine *engine, unsigned int f)
+{
+  return engine->freq_min <= engine->freq_max && f >= engine->freq_min &&
+         f <= engine->freq_max && !((f - engine->freq_min) % engine->freq_step);
+}
+
+static int
+set_frequency(FmtxEngine *engine, unsigned int f)
+{
+  FmtxEngineTxn *txn = engine->txn_open;
+  FmtxEngineTxnOp *op;
+  unsigned int old = engine->frequency;
+
+  if (engine->hw->dev_radio < 0)
+    return 1;
+
+  if (!on_plan(engine, f))
+    return 0;
+
+  engine->frequency = f;
+
+  /* retunes to the same channel, e.g. after every monitor sample, don't
+   * touch the settings */
+  if (f != old)
+    store(engine, FMTX_ENGINE_KEY_FREQUENCY, f);
+
+  apply_power_level(engine);
+
+  /* a running scan retunes once it is done */
+  if (engine->state != FMTX_STATE_ENABLED || engine->scan.active)
+    return 2;
+
+  /* a transaction only retunes if it has to */
+  if (txn)
+  {
+    if (f == old)
+      return 2;
+
+    op = txn_op(txn, FMTX_HW_WORKER_KEY_FREQUENCY);
+    op->len = f;
+  }
+  else
+  {
+    /* Only the last of several queued retunes is applied */
+    fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_FREQUENCY,
+                       tune_job, tune_done, (void *)(uintptr_t)f);
+  }
+
+  return 2;
+}
+
+static void
+set_preemphasis_level(FmtxEngine *engine, int level)
+{
+  char buf[12];
+
+  if (level == engine->preemphasis_written)
+    return;
+
+  snprintf(buf, sizeof(buf), "%u", level);
+
+  hw_write(engine, FMTX_HW_ATTR_REGION_PREEMPHASIS, buf, strlen(buf) + 1,
+           "fmtxd Could not set FM tx pre-emphasis level");
+
+  engine->preemphasis_written = level;
+}
+
+/* The channel's calibrated level, limited by power_level, the governor
+ * and the silence gate. Only written when that changes. */
+static void
+apply_power_level(FmtxEngine *engine)
+{
+  int level = engine->power_level;
+  int channel = fmtx_power_table_lookup(&engine->power_table,
+                                        engine->frequency);
+  char buf[12];
+
+  if (channel && channel < level)
+    level = channel;
+
+  if (engine->governor.level && engine->governor.level < level)
+    level = engine->governor.level;
+
+  if (engine->gated && engine->silence_action == FMTX_SILENCE_POWER)
+    level = FMTX_MIN_POWER_LEVEL;
+
+  if (level == engine->power_written)
+    return;
+
+  snprintf(buf, sizeof(buf), "%u", level);
+
+  hw_write(engine, FMTX_HW_ATTR_POWER_LEVEL, buf, strlen(buf) + 1,
+           "fmtxd Could not set FM tx power level");
+
+  engine->power_written = level;
+}
+
+static int
+set_power_level(FmtxEngine *engine, int level)
+{
+  if (engine->max_power_level < level)
+    return 0;
+
+  if (level < FMTX_MIN_POWER_LEVEL)
+    level = FMTX_MIN_POWER_LEVEL;
+
+  engine->power_level = level;
+  apply_power_level(engine);
+
+  return 2;
+}
+
+/* Unmutes unless a scan or the silence gate keeps the carrier off */
+static void
+unmute(FmtxEngine *engine)
+{
+  if (!engine->scan.active &&
+      (!engine->gated || engine->silence_action != FMTX_SILENCE_MUTE))
+    set_mute(engine, 0);
+}
+
+static void
+gate(FmtxEngine *engine, int on)
+{
+  engine->gated = on;
+
+  if (engine->silence_action == FMTX_SILENCE_POWER)
+    apply_power_level(engine);
+  else if (on)
+    set_mute(engine, 1);
+  else if (engine->state == FMTX_STATE_ENABLED)
+    unmute(engine);
+
+  emit(engine, PENDING_CHANGED);
+}
+
+/* The meter only runs while it can gate something */
+static void
+silence_update(FmtxEngine *engine)
+{
+  int meter = engine->silence_timeout && engine->state == FMTX_STATE_ENABLED;
+
+  engine->silence_start_ns = now_ns();
+
+  if (engine->gated)
+    gate(engine, 0);
+
+  if (meter != engine->meter_on)
+  {
+    engine->meter_on = meter;
+
+    if (engine->ops->meter)
+      engine->ops->meter(engine->data, meter);
+  }
+}
+
+static void
+resume(FmtxEngine *engine)
+{
+  timer_disarm(engine, FMTX_ENGINE_TIMER_IDLE);
+  engine->active = 0;
+  enable(engine, 1);
+  emit(engine, PENDING_CHANGED | PENDING_INFO);
+}
+
+/* Transmitting was interrupted, come back within five minutes or give up */
+static void
+suspend(FmtxEngine *engine)
+{
+  enable(engine, 0);
+  emit(engine, PENDING_CHANGED | PENDING_INFO);
+  engine->active = 1;
+
+  if (!timer_armed(engine, FMTX_ENGINE_TIMER_IDLE))
+    timer_arm(engine, FMTX_ENGINE_TIMER_IDLE, 300000, 0);
+}
+
+static void
+toggle_pilot(FmtxEngine *engine)
+{
+  if (engine->state != FMTX_STATE_ENABLED ||
+      (engine->mixer_inited && engine->pa_running))
+  {
+    if (engine->active &&
+        engine->pa_running &&
+        !engine->offline &&
+        !engine->hp_connected &&
+        !engine->call_active)
+      resume(engine);
+
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_FREQUENCY, "0");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_DEVIATION, "0");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_OFF_TIME, "0");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_ON_TIME, "0");
+  }
+  else
+  {
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_FREQUENCY, "1760");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_DEVIATION, "6750");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_OFF_TIME, "2000");
+    WRITE_FMTX_SYSFS_PILOT(engine, FMTX_HW_ATTR_TONE_ON_TIME, "50");
+
+    if (!timer_armed(engine, FMTX_ENGINE_TIMER_PILOT))
+      timer_arm(engine, FMTX_ENGINE_TIMER_PILOT, 50000, 0);
+  }
+}
+
+static int
+mixer_function_job(FmtxHw *hw, void *data)
+{
+  unsigned int idx;
+
+  if (fmtx_hw_mixer_get_function(hw, &idx) < 0)
+    return -1;
+
+  return idx;
+}
+
+static void
+mixer_function_done(void *data, int result, int err)
+{
+  FmtxEngine *engine = data;
+  int old;
+
+  engine->mixer_pending = 0;
+
+  if (result < 0)
+    return;
+
+  old = engine->mixer_inited;
+  engine->mixer_inited = (result != 0);
+
+  if (engine->mixer_inited != old)
+  {
+    fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_MIXER, result);
+    toggle_pilot(engine);
+  }
+}
+
+void
+fmtx_engine_check_mixer(FmtxEngine *engine)
+{
+  /* a slow mixer must not pile up polls behind it */
+  if (!engine->mixer_pending)
+  {
+    engine->mixer_pending = 1;
+    fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE,
+                       mixer_function_job, mixer_function_done, engine);
+  }
+}
+
+static int
+mixer_open_job(FmtxHw *hw, void *data)
+{
+  return fmtx_hw_mixer_open(hw);
+}
+
+static void
+mixer_open_done(void *data, int result, int err)
+{
+  FmtxEngine *engine = data;
+
+  if (result < 0)
+    fatal(engine, "Couldn't open the mixer", engine->hw->ops->name);
+}
+
+/* The mixer and PulseAudio only matter while transmitting, so launches that
+ * just answer a Get never pay for them. */
+static void
+audio_start(FmtxEngine *engine)
+{
+  if (engine->audio_started)
+    return;
+
+  engine->audio_started = 1;
+
+  fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, mixer_open_job,
+                     mixer_open_done, engine);
+  fmtx_engine_check_mixer(engine);
+  timer_arm(engine, FMTX_ENGINE_TIMER_MIXER, 1000, 1);
+
+  if (engine->ops->audio_start)
+    engine->ops->audio_start(engine->data);
+}
+
+static int
+enable(FmtxEngine *engine, int on)
+{
+  int rv;
+
+  if (engine->state == FMTX_STATE_NA)
+    return 0;
+
+  if (on)
+  {
+    if (engine->state == FMTX_STATE_ENABLED)
+      return 2;
+
+    audio_start(engine);
+
+    if (engine->offline || engine->hp_connected)
+    {
+      set_mute(engine, 1);
+      engine->state = FMTX_STATE_DISABLED;
+      return 0;
+    }
+
+    unmute(engine);
+    rv = set_frequency(engine, engine->frequency);
+
+    if (rv != 2)
+    {
+      set_mute(engine, 1);
+      return rv;
+    }
+
+    engine->state = FMTX_STATE_ENABLED;
+  }
+  else
+  {
+    engine->active = 0;
+    timer_disarm(engine, FMTX_ENGINE_TIMER_IDLE);
+
+    if (engine->state == FMTX_STATE_DISABLED)
+      return 2;
+
+    set_mute(engine, 1);
+    engine->state = FMTX_STATE_DISABLED;
+  }
+
+  store(engine, FMTX_ENGINE_KEY_ENABLED, on);
+  monitor_update(engine);
+  silence_update(engine);
+  governor_update(engine);
+  ct_update(engine);
+  toggle_pilot(engine);
+  set_frequency(engine, engine->frequency);
+
+  return 2;
+}
+
+static void
+pilot_timeout(FmtxEngine *engine)
+{
+  if (!engine->active &&
+      (!engine->mixer_inited || !engine->pa_running) &&
+      engine->state == FMTX_STATE_ENABLED)
+    suspend(engine);
+}
+
+static void
+idle_timeout(FmtxEngine *engine)
+{
+  engine->active = 0;
+  timer_arm(engine, FMTX_ENGINE_TIMER_EXIT, 60000, 0);
+}
+
+static void
+timer_expired(FmtxEngine *engine, FmtxEngineTimer timer)
+{
+  uint64_t expirations;
+
+  /* ECANCELED: the clock was set under the schedule, which looks again */
+  if (read(engine->timer_fd[timer], &expirations, sizeof(expirations)) == -1 &&
+      errno != ECANCELED)
+    return;
+
+  /* the mixer poll, the monitor and the governor repeat */
+  if (timer != FMTX_ENGINE_TIMER_MIXER &&
+      timer != FMTX_ENGINE_TIMER_MONITOR &&
+      timer != FMTX_ENGINE_TIMER_GOVERNOR)
+    engine->armed &= ~(1u << timer);
+
+  switch (timer)
+  {
+    case FMTX_ENGINE_TIMER_PILOT:
+      pilot_timeout(engine);
+      break;
+    case FMTX_ENGINE_TIMER_IDLE:
+      idle_timeout(engine);
+      break;
+    case FMTX_ENGINE_TIMER_EXIT:
+      if (engine->ops->idle && !engine->schedule.n)
+        engine->ops->idle(engine->data);
+      break;
+    case FMTX_ENGINE_TIMER_MIXER:
+      fmtx_engine_check_mixer(engine);
+      break;
+    case FMTX_ENGINE_TIMER_RDS:
+      rds_update(engine);
+      break;
+    case FMTX_ENGINE_TIMER_MONITOR:
+      monitor_sample(engine);
+      break;
+    case FMTX_ENGINE_TIMER_GOVERNOR:
+      governor_poll(engine);
+      break;
+    case FMTX_ENGINE_TIMER_SCHEDULE:
+      schedule_update(engine);
+      break;
+    case FMTX_ENGINE_TIMER_CT:
+      ct_update(engine);
+      break;
+    default:
+      break;
+  }
+}
+
+static void
+handle_events(FmtxEngine *engine, int timeout)
+{
+  struct epoll_event events[MAX_EVENTS];
+  int n;
+  int i;
+
+  n = epoll_wait(engine->epoll_fd, events, MAX_EVENTS, timeout);
+
+  for (i = 0; i < n; i++)
+  {
+    if (events[i].data.u32 == SOURCE_WORKER)
+      fmtx_hw_worker_dispatch(engine->worker);
+    else if (events[i].data.u32 == SOURCE_SENSORS)
+      governor_poll(engine);
+    else
+      timer_expired(engine, events[i].data.u32);
+  }
+
+  flush_outputs(engine);
+}
+
+static int
+watch(FmtxEngine *engine, int fd, uint32_t source)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = source;
+
+  return epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+FmtxEngine *
+fmtx_engine_new(FmtxHw *hw, const FmtxEngineOps *ops, void *data)
+{
+  FmtxEngine *engine = calloc(1, sizeof(*engine));
+  int i;
+
+  if (!engine)
+    return NULL;
+
+  engine->hw = hw;
+  engine->ops = ops;
+  engine->data = data;
+  engine->state = FMTX_STATE_INITIALIZING;
+  engine->freq_step = 100;
+  fmtx_rds_sched_init(&engine->rds);
+  snprintf(engine->rds_pi, sizeof(engine->rds_pi), "%04X",
+           engine->rds.fields.pi);
+  engine->rds.rt_dwell_ms = 10000;
+  engine->rds.ps_dwell_ms = 3000;
+  engine->monitor_threshold = FMTX_DEFAULT_MONITOR_THRESHOLD;
+  engine->monitor_alternates = FMTX_DEFAULT_MONITOR_ALTERNATES;
+  engine->silence_threshold = FMTX_DEFAULT_SILENCE_THRESHOLD;
+  engine->audio_level.rms_db = FMTX_METER_FLOOR_DB;
+  engine->audio_level.peak_db = FMTX_METER_FLOOR_DB;
+  fmtx_governor_init(&engine->governor);
+  fmtx_governor_curve_format(&engine->governor.battery,
+                             engine->governor_battery,
+                             sizeof(engine->governor_battery));
+  fmtx_governor_curve_format(&engine->governor.thermal,
+                             engine->governor_thermal,
+                             sizeof(engine->governor_thermal));
+  strcpy(engine->sysfs_class, "/sys/class");
+  engine->schedule_slot = -1;
+  fmtx_input_log_init(&engine->input_log);
+  engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+  for (i = 0; i < FMTX_ENGINE_TIMER_LAST; i++)
+    engine->timer_fd[i] = -1;
+
+  if (engine->epoll_fd == -1)
+    goto err;
+
+  for (i = 0; i < FMTX_ENGINE_TIMER_LAST; i++)
+  {
+    engine->timer_fd[i] = timerfd_create(i == FMTX_ENGINE_TIMER_SCHEDULE ||
+                                         i == FMTX_ENGINE_TIMER_CT ?
+                                         CLOCK_REALTIME : CLOCK_MONOTONIC,
+                                         TFD_CLOEXEC | TFD_NONBLOCK);
+
+    if (engine->timer_fd[i] == -1 || watch(engine, engine->timer_fd[i], i))
+      goto err;
+  }
+
+  return engine;
+
+err:
+  fmtx_engine_free(engine);
+
+  return NULL;
+}
+
+void
+fmtx_engine_free(FmtxEngine *engine)
+{
+  int i;
+
+  if (!engine)
+    return;
+
+  fmtx_hw_worker_free(engine->worker);
+
+  if (engine->noise_dirty && engine->noise_path[0] &&
+      fmtx_noise_map_save(&engine->noise, engine->noise_path) < 0)
+    fprintf(stderr, "fmtxd Could not save the noise map: %s\n",
+            strerror(errno));
+
+  fmtx_governor_close(&engine->governor);
+  fmtx_input_log_close(&engine->input_log);
+
+  for (i = 0; i < FMTX_ENGINE_TIMER_LAST; i++)
+  {
+    if (engine->timer_fd[i] != -1)
+      close(engine->timer_fd[i]);
+  }
+
+  if (engine->epoll_fd != -1)
+    close(engine->epoll_fd);
+
+  free(engine);
+}
+
+int
+fmtx_engine_get_fd(FmtxEngine *engine)
+{
+  return engine->epoll_fd;
+}
+
+void
+fmtx_engine_dispatch(FmtxEngine *engine)
+{
+  handle_events(engine, 0);
+}
+
+void
+fmtx_engine_run(FmtxEngine *engine)
+{
+  engine->quit = 0;
+
+  while (!engine->quit)
+    handle_events(engine, -1);
+}
+
+void
+fmtx_engine_quit(FmtxEngine *engine)
+{
+  engine->quit = 1;
+}
+
+void
+fmtx_engine_flush(FmtxEngine *engine)
+{
+  if (engine->worker)
+    fmtx_hw_worker_flush(engine->worker);
+
+  flush_outputs(engine);
+  fmtx_input_log_flush(&engine->input_log);
+}
+
+int
+fmtx_engine_log_inputs(FmtxEngine *engine, const char *path)
+{
+  return fmtx_input_log_open(&engine->input_log, path);
+}
+
+const char *
+fmtx_state_name(FmtxState state)
+{
+  switch (state)
+  {
+    case FMTX_STATE_INITIALIZING:
+      return "initializing";
+    case FMTX_STATE_DISABLED:
+      return "disabled";
+    case FMTX_STATE_ENABLED:
+      return "enabled";
+    case FMTX_STATE_NA:
+      return "n/a";
+    default:
+      return "error";
+  }
+}
+
+const char *
+fmtx_engine_startable(FmtxEngine *engine)
+{
+  if (engine->hp_connected)
+    return "Headphones are connected";
+
+  if (engine->offline)
+    return "Device is in offline mode";
+
+  return "true";
+}
+
+int
+fmtx_engine_open(FmtxEngine *engine)
+{
+  if (fmtx_hw_write_attr(engine->hw, FMTX_HW_ATTR_PILOT_FREQUENCY, "19000",
+                         6) == -1)
+  {
+    perror("fmtxd Could not set pilot tone frequency");
+    return 1;
+  }
+
+  /* FIXME Why 1, but not 2??? */
+  if (fmtx_hw_write_attr(engine->hw, FMTX_HW_ATTR_PILOT_ENABLED, "1", 1) == -1)
+  {
+    perror("fmtxd Could not set pilot tone");
+    return 1;
+  }
+
+  if (fmtx_hw_open_modulator(engine->hw) < 0)
+  {
+    perror("fmtxd Could not open fmtx device");
+    engine->state = FMTX_STATE_ERROR;
+    return 1;
+  }
+
+  /* From here on only the worker thread touches the hardware */
+  engine->worker = fmtx_hw_worker_new(engine->hw);
+
+  if (!engine->worker ||
+      watch(engine, fmtx_hw_worker_get_fd(engine->worker), SOURCE_WORKER))
+  {
+    perror("fmtxd Could not start the hardware worker");
+    engine->state = FMTX_STATE_ERROR;
+    return 1;
+  }
+
+  return 2;
+}
+
+static int
+cal_etsi_job(FmtxHw *hw, void *data)
+{
+  return fmtx_hw_cal_power_level(hw, "etsi");
+}
+
+static int
+cal_fcc_job(FmtxHw *hw, void *data)
+{
+  return fmtx_hw_cal_power_level(hw, "fcc");
+}
+
+static void
+init_power(void *data, int max_power_level, int err)
+{
+  FmtxEngine *engine = data;
+  int rv;
+
+  engine->max_power_level = max_power_level;
+  fmtx_power_table_build(&engine->power_table, engine->freq_min,
+                         engine->freq_max, engine->freq_step,
+                         max_power_level);
+  set_power_level(engine, engine->max_power_level);
+
+  set_rds_ps(engine, "Nokia   ");
+
+  set_rds_text(engine, " ", NULL, 0);
+
+  rv = set_frequency(engine, engine->init_frequency);
+
+  if (rv == 1)
+    fatal(engine, "Could not set the initial frequency", "set_frequency");
+
+  if (!rv)
+    set_frequency(engine, engine->freq_min);
+
+  if (enable(engine, 0) == 1)
+    fatal(engine, "Could not disable the transmitter", "enable");
+
+  if (engine->state != FMTX_STATE_ENABLED)
+    timer_arm(engine, FMTX_ENGINE_TIMER_EXIT, 60000, 0);
+
+  if (engine->ops->started)
+    engine->ops->started(engine->data);
+}
+
+/* Reading CAL can take a while, so the power limit is fetched on the
+ * hardware worker and the setup continues in init_power(). */
+void
+fmtx_engine_set_region(FmtxEngine *engine, int region,
+                       unsigned int frequency)
+{
+  unsigned int args[2] = { region, frequency };
+  FmtxHwJobFunc cal;
+
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_REGION, args, 2,
+                       NULL, 0);
+  engine->init_frequency = frequency;
+
+  if (region == 2 || region == 3)
+  {
+    cal = cal_etsi_job;
+    engine->freq_step = 100;
+  }
+  else if (region == 4 || region == 5)
+  {
+    cal = cal_fcc_job;
+    engine->freq_step = 200;
+  }
+  else
+  {
+    engine->state = FMTX_STATE_NA;
+    init_power(engine, engine->max_power_level, 0);
+    return;
+  }
+
+  engine->region_preemphasis = region == 2 || region == 4 ? 50 : 75;
+  set_preemphasis_level(engine, engine->region_preemphasis);
+  engine->freq_min = 88100;
+  engine->freq_max = 107900;
+
+  fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, cal,
+                     init_power, engine);
+}
+
+int
+fmtx_engine_set_enabled(FmtxEngine *engine, int enabled)
+{
+  int rv;
+
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_ENABLED, enabled);
+  rv = enable(engine, enabled);
+
+  if (!enabled)
+    timer_disarm(engine, FMTX_ENGINE_TIMER_PILOT);
+
+  if (rv == 2)
+    emit(engine, PENDING_CHANGED | PENDING_INFO);
+
+  flush_outputs(engine);
+
+  return rv;
+}
+
+int
+fmtx_engine_set_frequency(FmtxEngine *engine, unsigned int frequency)
+{
+  int rv;
+
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_FREQUENCY, frequency);
+  rv = set_frequency(engine, frequency);
+
+  if (rv == 2)
+    emit(engine, PENDING_CHANGED);
+
+  flush_outputs(engine);
+
+  return rv;
+}
+
+/* Copies as much of utf8 as fits max characters on air. Combining accents
+ * take no room there, so the bytes are limited as well. */
+static void
+copy_fitting(char *buf, size_t size, const char *utf8, size_t max)
+{
+  size_t len = strlen(utf8);
+  size_t used;
+
+  if (len >= size)
+  {
+    len = size - 1;
+
+    while (len && ((unsigned char)utf8[len] & 0xc0) == 0x80)
+      len--;
+  }
+
+  fmtx_rds_charset_encode(utf8, len, NULL, max, &used);
+  memcpy(buf, utf8, used);
+  buf[used] = 0;
+}
+
+static int
+text_fits(const char *utf8, size_t max)
+{
+  size_t len = strlen(utf8);
+  size_t used;
+
+  fmtx_rds_charset_encode(utf8, len, NULL, max, &used);
+
+  return used == len;
+}
+
+/* The writes below complete on the hardware worker, failures are only
+ * logged. The engine keeps the requested value either way. Text is
+ * encoded once when it is set, the same text again costs nothing. */
+static int
+set_rds_ps(FmtxEngine *engine, const char *rds_ps)
+{
+  char buf[sizeof(engine->rds_ps)];
+
+  if (!rds_ps)
+    return 0;
+
+  /* longer names are still cut, on a character boundary */
+  copy_fitting(buf, sizeof(buf), rds_ps, FMTX_MAX_RDS_PS);
+
+  if (!strcmp(buf, engine->rds_ps))
+    return 2;
+
+  fmtx_rds_sched_set_static_ps(&engine->rds, buf);
+  strcpy(engine->rds_ps, buf);
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+static int
+set_rds_text(FmtxEngine *engine, const char *rds_text,
+             const FmtxRdsTag *tags, unsigned int n_tags)
+{
+  if (!rds_text || strlen(rds_text) >= sizeof(engine->rds_text) ||
+      n_tags > FMTX_RDS_RTPLUS_MAX_TAGS)
+    return 0;
+
+  if (!strcmp(rds_text, engine->rds_text) &&
+      n_tags == engine->n_rds_text_tags &&
+      fmtx_rds_tags_equal(tags, engine->rds_text_tags, n_tags))
+    return 2;
+
+  if (!fmtx_rds_sched_set_static_rt(&engine->rds, rds_text, tags, n_tags))
+    return 0;
+
+  strcpy(engine->rds_text, rds_text);
+
+  if (n_tags)
+    memcpy(engine->rds_text_tags, tags, n_tags * sizeof(*tags));
+
+  engine->n_rds_text_tags = n_tags;
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_rds_ps(FmtxEngine *engine, const char *rds_ps)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_RDS_PS, rds_ps);
+
+  return set_rds_ps(engine, rds_ps);
+}
+
+int
+fmtx_engine_set_rds_text(FmtxEngine *engine, const char *rds_text)
+{
+  return fmtx_engine_set_rds_text_tagged(engine, rds_text, NULL, 0);
+}
+
+int
+fmtx_engine_set_rds_text_tagged(FmtxEngine *engine, const char *rds_text,
+                                const FmtxRdsTag *tags, unsigned int n_tags)
+{
+  unsigned int args[3 * FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int i;
+
+  for (i = 0; i < n_tags && i < FMTX_RDS_RTPLUS_MAX_TAGS; i++)
+  {
+    args[3 * i] = tags[i].type;
+    args[3 * i + 1] = tags[i].start;
+    args[3 * i + 2] = tags[i].len;
+  }
+
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_RDS_TEXT, args, 3 * i,
+                       &rds_text, 1);
+
+  return set_rds_text(engine, rds_text, tags, n_tags);
+}
+
+int
+fmtx_engine_set_rds_rotation(FmtxEngine *engine, const char *messages)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_RDS_ROTATION, messages);
+
+  if (!messages || strlen(messages) >= sizeof(engine->rds_rotation) ||
+      !fmtx_rds_sched_set_rotation(&engine->rds, messages,
+                                   engine->rds.rt_dwell_ms, now_ns()))
+    return 0;
+
+  strcpy(engine->rds_rotation, messages);
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+/* Takes effect with the next message */
+int
+fmtx_engine_set_rds_rotation_dwell(FmtxEngine *engine, unsigned int ms)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_ROTATION_DWELL, ms);
+
+  if (ms < FMTX_MIN_RDS_ROTATION_DWELL)
+    return 0;
+
+  engine->rds.rt_dwell_ms = ms;
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+static int
+set_rds_ps_text(FmtxEngine *engine, const char *text, FmtxRdsPsMode mode,
+                unsigned int dwell_ms)
+{
+  if (strlen(text) >= sizeof(engine->rds_ps_text) ||
+      !fmtx_rds_sched_set_ps_text(&engine->rds, text, mode, dwell_ms,
+                                  now_ns()))
+    return 0;
+
+  /* text is rds_ps_text itself when only the mode changes */
+  memmove(engine->rds_ps_text, text, strlen(text) + 1);
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_rds_ps_text(FmtxEngine *engine, const char *text)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_RDS_PS_TEXT, text);
+
+  if (!text)
+    return 0;
+
+  return set_rds_ps_text(engine, text, engine->rds.ps_mode,
+                         engine->rds.ps_dwell_ms);
+}
+
+int
+fmtx_engine_set_rds_ps_mode(FmtxEngine *engine, const char *mode)
+{
+  int m;
+
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_RDS_PS_MODE, mode);
+  m = mode ? fmtx_rds_ps_mode_from_name(mode) : -1;
+
+  if (m < 0)
+    return 0;
+
+  return set_rds_ps_text(engine, engine->rds_ps_text, m,
+                         engine->rds.ps_dwell_ms);
+}
+
+int
+fmtx_engine_set_rds_ps_dwell(FmtxEngine *engine, unsigned int ms)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_PS_DWELL, ms);
+
+  if (ms < FMTX_MIN_RDS_PS_DWELL)
+    return 0;
+
+  engine->rds.ps_dwell_ms = ms;
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_rds_pi(FmtxEngine *engine, const char *pi)
+{
+  unsigned long v;
+  unsigned int i;
+
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_RDS_PI, pi);
+
+  if (!pi)
+    return 0;
+
+  /* strtoul() alone would take a sign or leading blanks */
+  for (i = 0; i < 4; i++)
+  {
+    if (!isxdigit((unsigned char)pi[i]))
+      return 0;
+  }
+
+  if (pi[4] || !(v = strtoul(pi, NULL, 16)))
+    return 0;
+
+  engine->rds.fields.pi = v;
+  snprintf(engine->rds_pi, sizeof(engine->rds_pi), "%04X", (unsigned int)v);
+  store(engine, FMTX_ENGINE_KEY_RDS_PI, v);
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+/* PTY, TP and TA go out in every group and only change on these calls */
+static int
+set_rds_flag(FmtxEngine *engine, FmtxEngineKey key, uint8_t *field,
+             unsigned int value, unsigned int max)
+{
+  if (value > max)
+    return 0;
+
+  *field = value;
+  store(engine, key, value);
+  rds_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_rds_pty(FmtxEngine *engine, unsigned int pty)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_PTY, pty);
+
+  return set_rds_flag(engine, FMTX_ENGINE_KEY_RDS_PTY,
+                      &engine->rds.fields.pty, pty, 31);
+}
+
+int
+fmtx_engine_set_rds_tp(FmtxEngine *engine, unsigned int tp)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_TP, tp);
+
+  return set_rds_flag(engine, FMTX_ENGINE_KEY_RDS_TP, &engine->rds.fields.tp,
+                      tp, 1);
+}
+
+int
+fmtx_engine_set_rds_ta(FmtxEngine *engine, unsigned int ta)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_TA, ta);
+
+  return set_rds_flag(engine, FMTX_ENGINE_KEY_RDS_TA, &engine->rds.fields.ta,
+                      ta, 1);
+}
+
+/* One 4A group right as each minute starts, from a timer on the wall clock
+ * that is armed for the next minute only. Setting the clock sends the
+ * corrected time at once. */
+static void
+ct_update(FmtxEngine *engine)
+{
+  FmtxRdsFields *f = &engine->rds.fields;
+  time_t now;
+  struct tm tm;
+
+  if (!engine->rds_ct || engine->state != FMTX_STATE_ENABLED ||
+      !fmtx_hw_has_attr(engine->hw, FMTX_HW_ATTR_RDS_CT))
+  {
+    timer_disarm(engine, FMTX_ENGINE_TIMER_CT);
+    f->ct = 0;
+  }
+  else
+  {
+    now = time(NULL);
+    localtime_r(&now, &tm);
+    f->ct = now - now % 60;
+    f->ct_offset = tm.tm_gmtoff / 1800;
+    timer_arm_wall(engine, FMTX_ENGINE_TIMER_CT, f->ct + 60);
+  }
+
+  rds_update(engine);
+}
+
+int
+fmtx_engine_set_rds_ct(FmtxEngine *engine, unsigned int ct)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_RDS_CT, ct);
+
+  if (ct > 1)
+    return 0;
+
+  engine->rds_ct = ct;
+  store(engine, FMTX_ENGINE_KEY_RDS_CT, ct);
+  ct_update(engine);
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+static uint32_t
+wall_s(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return ts.tv_sec;
+}
+
+static int
+scan_result_cmp(const void *a, const void *b)
+{
+  const FmtxScanResult *ra = a;
+  const FmtxScanResult *rb = b;
+
+  if (ra->noise != rb->noise)
+    return ra->noise < rb->noise ? -1 : 1;
+
+  return ra->frequency < rb->frequency ? -1 : ra->frequency > rb->frequency;
+}
+
+/* Fills scan.results with the measured channels, or only the ones younger
+ * than max_age, quietest first */
+static unsigned int
+scan_collect(FmtxEngine *engine, uint32_t now, unsigned int max_age)
+{
+  FmtxNoiseMap *map = &engine->noise;
+  unsigned int n = 0;
+  unsigned int i;
+
+  for (i = 0; i < map->n; i++)
+  {
+    if (max_age ? !fmtx_noise_map_is_fresh(map, i, now, max_age) :
+        !map->entry[i].measured)
+      continue;
+
+    engine->scan.results[n].frequency = fmtx_noise_map_frequency(map, i);
+    engine->scan.results[n].noise = map->entry[i].rnl;
+    n++;
+  }
+
+  qsort(engine->scan.results, n, sizeof(engine->scan.results[0]),
+        scan_result_cmp);
+
+  return n;
+}
+
+static void
+scan_report(FmtxEngine *engine, unsigned int count, FmtxScanFunc cb,
+            void *data)
+{
+  unsigned int n = scan_collect(engine, 0, 0);
+
+  if (count && n > count)
+    n = count;
+
+  cb(data, engine->scan.results, n);
+}
+
+static int
+scan_begin_job(FmtxHw *hw, void *data)
+{
+  FmtxEngineScan *scan = data;
+  struct v4l2_tuner tun;
+
+  tun.index = 0;
+
+  if (fmtx_hw_ioctl(hw, VIDIOC_G_TUNER, &tun) < 0)
+    return -1;
+
+  scan->units = tun.capability & V4L2_TUNER_CAP_LOW ? 16000 : 16;
+
+  return 0;
+}
+
+/* The driver tunes, waits for the receiver to settle and measures in one
+ * call, so there is a single job per channel */
+static int
+measure_job(FmtxHw *hw, void *data)
+{
+  FmtxScanSlot *slot = data;
+  FmtxEngine *engine = slot->engine;
+  struct si4713_rnl rnl;
+
+  memset(&rnl, 0, sizeof(rnl));
+  rnl.frequency = (uint64_t)engine->scan.units *
+                  fmtx_noise_map_frequency(&engine->noise, slot->index) /
+                  1000;
+
+  if (fmtx_hw_ioctl(hw, SI4713_IOC_MEASURE_RNL, &rnl) < 0)
+    return -1;
+
+  slot->rnl = rnl.rnl;
+
+  return 0;
+}
+
+static void
+measure_done(void *data, int result, int err);
+
+static void
+scan_submit(FmtxEngine *engine, FmtxScanSlot *slot)
+{
+  FmtxEngineScan *scan = &engine->scan;
+
+  if (scan->next >= scan->n_todo)
+    return;
+
+  slot->index = scan->todo[scan->next++];
+  scan->in_flight++;
+  fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, measure_job,
+                     measure_done, slot);
+}
+
+static int
+monitor_evaluate(FmtxEngine *engine);
+
+static void
+scan_finish(FmtxEngine *engine)
+{
+  FmtxEngineScan *scan = &engine->scan;
+  int retuned = 0;
+
+  /* monitor samples only touch a few channels, they are saved with the
+   * next full scan or when the engine goes away */
+  if (scan->monitor)
+    engine->noise_dirty = 1;
+  else if (engine->noise_path[0] &&
+           fmtx_noise_map_save(&engine->noise, engine->noise_path) < 0)
+    fprintf(stderr, "fmtxd Could not save the noise map: %s\n",
+            strerror(errno));
+  else
+    engine->noise_dirty = 0;
+
+  /* cb may start the next scan */
+  scan->active = 0;
+
+  /* a migration happens while still muted, so it is one mute, retune and
+   * unmute on air */
+  if (scan->monitor)
+    retuned = monitor_evaluate(engine);
+
+  if (engine->state == FMTX_STATE_ENABLED)
+  {
+    if (!retuned)
+      set_frequency(engine, engine->frequency);
+
+    unmute(engine);
+  }
+
+  if (!scan->monitor)
+    scan_report(engine, scan->count, scan->cb, scan->data);
+
+  call_end(engine);
+}
+
+static void
+measure_done(void *data, int result, int err)
+{
+  FmtxScanSlot *slot = data;
+  FmtxEngine *engine = slot->engine;
+  FmtxEngineScan *scan = &engine->scan;
+
+  if (result < 0)
+    fprintf(stderr, "fmtxd Could not measure noise on %u kHz: %s\n",
+            fmtx_noise_map_frequency(&engine->noise, slot->index),
+            strerror(err));
+  else
+    fmtx_noise_map_set(&engine->noise, slot->index, slot->rnl, wall_s());
+
+  scan->in_flight--;
+  scan_submit(engine, slot);
+
+  /* submitting can dispatch completions while the ring is full, so the
+   * scan may already have finished underneath */
+  if (scan->active && !scan->in_flight && scan->next >= scan->n_todo)
+    scan_finish(engine);
+}
+
+/* Sets up the noise map for the current plan, returns 0 without one */
+static int
+scan_prepare(FmtxEngine *engine)
+{
+  FmtxNoiseMap *map = &engine->noise;
+
+  if (engine->state == FMTX_STATE_NA || engine->state == FMTX_STATE_ERROR ||
+      !fmtx_noise_map_reset(map, engine->freq_min, engine->freq_max,
+                            engine->freq_step))
+    return 0;
+
+  if (!engine->noise_loaded && engine->noise_path[0])
+  {
+    fmtx_noise_map_load(map, engine->noise_path);
+    engine->noise_loaded = 1;
+  }
+
+  return 1;
+}
+
+/* Measures scan.todo, the transmitter stays muted until scan_finish() */
+static void
+scan_start(FmtxEngine *engine, int monitor)
+{
+  FmtxEngineScan *scan = &engine->scan;
+  unsigned int i;
+
+  scan->active = 1;
+  scan->monitor = monitor;
+  scan->started = wall_s();
+  scan->next = 0;
+  scan->in_flight = 0;
+  scan->units = 16000;
+
+  timer_disarm(engine, FMTX_ENGINE_TIMER_EXIT);
+
+  if (engine->state == FMTX_STATE_ENABLED)
+    set_mute(engine, 1);
+
+  fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, scan_begin_job,
+                     NULL, scan);
+
+  for (i = 0; i < FMTX_SCAN_WINDOW; i++)
+  {
+    scan->slot[i].engine = engine;
+    scan_submit(engine, &scan->slot[i]);
+  }
+}
+
+void
+fmtx_engine_set_noise_map_path(FmtxEngine *engine, const char *path)
+{
+  snprintf(engine->noise_path, sizeof(engine->noise_path), "%s", path);
+  engine->noise_loaded = 0;
+}
+
+static int
+scan_todo_has(const FmtxEngineScan *scan, unsigned int index)
+{
+  unsigned int i;
+
+  for (i = 0; i < scan->n_todo; i++)
+  {
+    if (scan->todo[i] == index)
+      return 1;
+  }
+
+  return 0;
+}
+
+int
+fmtx_engine_scan(FmtxEngine *engine, unsigned int max_age,
+                 unsigned int count, FmtxScanFunc cb, void *data)
+{
+  FmtxEngineScan *scan = &engine->scan;
+  FmtxNoiseMap *map = &engine->noise;
+  unsigned int args[2] = { max_age, count };
+  uint32_t now = wall_s();
+  unsigned int index;
+  unsigned int top;
+  unsigned int n;
+  unsigned int i;
+
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_SCAN, args, 2, NULL,
+                       0);
+
+  if (!scan_prepare(engine))
+    return 0;
+
+  if (!engine->worker || scan->active)
+    return 1;
+
+  scan->n_todo = 0;
+
+  for (i = 0; i < map->n; i++)
+  {
+    if (!fmtx_noise_map_is_fresh(map, i, now, max_age))
+      scan->todo[scan->n_todo++] = i;
+  }
+
+  if (!scan->n_todo)
+  {
+    scan_report(engine, count, cb, data);
+    return 2;
+  }
+
+  /* whatever is picked gets a fresh look too, a window's worth when all
+   * channels are asked for, but no channel is measured twice */
+  top = count ? count : FMTX_SCAN_WINDOW;
+  n = scan_collect(engine, now, max_age);
+
+  for (i = 0; i < n && i < top; i++)
+  {
+    index = (scan->results[i].frequency - map->freq_min) / map->freq_step;
+
+    if (!scan_todo_has(scan, index))
+      scan->todo[scan->n_todo++] = index;
+  }
+
+  scan->cb = cb;
+  scan->data = data;
+  scan->count = count;
+  scan_start(engine, 0);
+
+  return 2;
+}
+
+/* One sample of the current channel and monitor_alternates others: the
+ * best known ones, plus the one measured longest ago so the rest of the
+ * band is eventually looked at too */
+static void
+monitor_sample(FmtxEngine *engine)
+{
+  FmtxEngineScan *scan = &engine->scan;
+  FmtxNoiseMap *map = &engine->noise;
+  unsigned int want = 1 + engine->monitor_alternates;
+  unsigned int known;
+  unsigned int index;
+  unsigned int n;
+  unsigned int i;
+
+  if (engine->state != FMTX_STATE_ENABLED || !engine->worker ||
+      scan->active || !scan_prepare(engine))
+    return;
+
+  scan->todo[0] = (engine->frequency - map->freq_min) / map->freq_step;
+  scan->n_todo = 1;
+
+  known = engine->monitor_alternates > 1 ? engine->monitor_alternates - 1 : 1;
+  n = scan_collect(engine, 0, 0);
+
+  for (i = 0; i < n && scan->n_todo < 1 + known; i++)
+  {
+    index = (scan->results[i].frequency - map->freq_min) / map->freq_step;
+
+    if (!scan_todo_has(scan, index))
+      scan->todo[scan->n_todo++] = index;
+  }
+
+  while (scan->n_todo < want)
+  {
+    unsigned int stalest = map->n;
+
+    for (i = 0; i < map->n; i++)
+    {
+      if (!scan_todo_has(scan, i) &&
+          (stalest == map->n ||
+           map->entry[i].measured < map->entry[stalest].measured))
+        stalest = i;
+    }
+
+    if (stalest == map->n)
+      break;
+
+    scan->todo[scan->n_todo++] = stalest;
+  }
+
+  scan_start(engine, 1);
+}
+
+/* Moves to the quietest sampled alternate once the current channel is
+ * over the threshold and the alternate is clearly better. Returns 1 if it
+ * did. */
+static int
+monitor_evaluate(FmtxEngine *engine)
+{
+  FmtxEngineScan *scan = &engine->scan;
+  FmtxNoiseMap *map = &engine->noise;
+  const FmtxNoiseEntry *cur = &map->entry[scan->todo[0]];
+  unsigned int best = map->n;
+  unsigned int from = engine->frequency;
+  unsigned int i;
+
+  if (engine->state != FMTX_STATE_ENABLED || cur->measured < scan->started ||
+      cur->rnl < (int)engine->monitor_threshold)
+    return 0;
+
+  for (i = 1; i < scan->n_todo; i++)
+  {
+    const FmtxNoiseEntry *e = &map->entry[scan->todo[i]];
+
+    if (e->measured >= scan->started &&
+        (best == map->n || e->rnl < map->entry[best].rnl))
+      best = scan->todo[i];
+  }
+
+  if (best == map->n ||
+      map->entry[best].rnl + FMTX_MONITOR_MARGIN > cur->rnl ||
+      set_frequency(engine, fmtx_noise_map_frequency(map, best)) != 2)
+    return 0;
+
+  emit(engine, PENDING_CHANGED);
+
+  if (engine->ops->migrated)
+    engine->ops->migrated(engine->data, from, engine->frequency);
+
+  return 1;
+}
+
+/* Only runs while transmitting */
+static void
+monitor_update(FmtxEngine *engine)
+{
+  if (engine->monitor_interval && engine->state == FMTX_STATE_ENABLED)
+  {
+    if (!timer_armed(engine, FMTX_ENGINE_TIMER_MONITOR))
+      timer_arm(engine, FMTX_ENGINE_TIMER_MONITOR,
+                engine->monitor_interval * 1000, 1);
+  }
+  else
+    timer_disarm(engine, FMTX_ENGINE_TIMER_MONITOR);
+}
+
+int
+fmtx_engine_set_monitor_interval(FmtxEngine *engine, unsigned int s)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_MONITOR_INTERVAL, s);
+
+  if (s && (s < FMTX_MIN_MONITOR_INTERVAL || s > FMTX_MAX_MONITOR_INTERVAL))
+    return 0;
+
+  if (s != engine->monitor_interval)
+  {
+    engine->monitor_interval = s;
+    store(engine, FMTX_ENGINE_KEY_MONITOR_INTERVAL, s);
+    /* rearm with the new period */
+    timer_disarm(engine, FMTX_ENGINE_TIMER_MONITOR);
+    monitor_update(engine);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_monitor_threshold(FmtxEngine *engine, unsigned int dbuv)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_MONITOR_THRESHOLD, dbuv);
+
+  if (dbuv > INT8_MAX)
+    return 0;
+
+  if (dbuv != engine->monitor_threshold)
+  {
+    engine->monitor_threshold = dbuv;
+    store(engine, FMTX_ENGINE_KEY_MONITOR_THRESHOLD, dbuv);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_monitor_alternates(FmtxEngine *engine, unsigned int n)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_MONITOR_ALTERNATES, n);
+
+  if (n < 1 || n > FMTX_MAX_MONITOR_ALTERNATES)
+    return 0;
+
+  if (n != engine->monitor_alternates)
+  {
+    engine->monitor_alternates = n;
+    store(engine, FMTX_ENGINE_KEY_MONITOR_ALTERNATES, n);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_silence_timeout(FmtxEngine *engine, unsigned int s)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_SILENCE_TIMEOUT, s);
+
+  if (s > FMTX_MAX_SILENCE_TIMEOUT)
+    return 0;
+
+  if (s != engine->silence_timeout)
+  {
+    engine->silence_timeout = s;
+    store(engine, FMTX_ENGINE_KEY_SILENCE_TIMEOUT, s);
+    silence_update(engine);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_silence_threshold(FmtxEngine *engine, unsigned int db)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_SILENCE_THRESHOLD, db);
+
+  if (!db || db > FMTX_METER_FLOOR_DB)
+    return 0;
+
+  if (db != engine->silence_threshold)
+  {
+    engine->silence_threshold = db;
+    store(engine, FMTX_ENGINE_KEY_SILENCE_THRESHOLD, db);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+const char *
+fmtx_silence_action_name(FmtxSilenceAction action)
+{
+  return action == FMTX_SILENCE_POWER ? "power" : "mute";
+}
+
+int
+fmtx_engine_set_silence_action(FmtxEngine *engine, const char *action)
+{
+  FmtxSilenceAction a;
+
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_SILENCE_ACTION,
+                        action);
+
+  if (!action)
+    return 0;
+
+  if (!strcmp(action, "mute"))
+    a = FMTX_SILENCE_MUTE;
+  else if (!strcmp(action, "power"))
+    a = FMTX_SILENCE_POWER;
+  else
+    return 0;
+
+  if (a != engine->silence_action)
+  {
+    /* undo the old action before the new one can take over */
+    if (engine->gated)
+      gate(engine, 0);
+
+    engine->silence_action = a;
+    engine->silence_start_ns = now_ns();
+    store(engine, FMTX_ENGINE_KEY_SILENCE_ACTION, a);
+    emit(engine, PENDING_CHANGED);
+  }
+
+  flush_outputs(engine);
+
+  return 2;
+}
+
+/* Runs for every meter block, so there is no timer: silence is measured
+ * from the block times and audio ungates on the first loud block */
+void
+fmtx_engine_set_audio_level(FmtxEngine *engine, const FmtxMeterLevel *level)
+{
+  unsigned int args[2] = { level->rms_db, level->peak_db };
+  long long now;
+
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_AUDIO_LEVEL, args, 2,
+                       NULL, 0);
+  engine->audio_level = *level;
+
+  if (!engine->meter_on)
+    return;
+
+  now = now_ns();
+
+  if (level->peak_db < engine->silence_threshold)
+  {
+    engine->silence_start_ns = now;
+
+    if (engine->gated)
+      gate(engine, 0);
+  }
+  else if (!engine->gated &&
+           now - engine->silence_start_ns >=
+           engine->silence_timeout * 1000000000LL)
+    gate(engine, 1);
+
+  flush_outputs(engine);
+}
+
+int
+fmtx_engine_set_power_points(FmtxEngine *engine, const char *points)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_POWER_POINTS, points);
+
+  if (!points || !fmtx_power_table_set_points(&engine->power_table, points))
+    return 0;
+
+  fmtx_power_table_format_points(&engine->power_table, engine->power_points,
+                                 sizeof(engine->power_points));
+
+  /* before init_power() there is no plan to build for yet */
+  if (engine->max_power_level)
+  {
+    fmtx_power_table_build(&engine->power_table, engine->freq_min,
+                           engine->freq_max, engine->freq_step,
+                           engine->max_power_level);
+    apply_power_level(engine);
+  }
+
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_save_preset(FmtxEngine *engine, const FmtxPreset *preset)
+{
+  unsigned int args[3] =
+  {
+    preset->frequency, preset->power_level, preset->preemphasis
+  };
+  const char *text[3] = { preset->name, preset->rds_ps, preset->rds_text };
+
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_SAVE_PRESET, args, 3,
+                       text, 3);
+
+  if (engine->state == FMTX_STATE_INITIALIZING)
+    return 1;
+
+  if (!fmtx_preset_name_valid(preset->name) ||
+      !on_plan(engine, preset->frequency) ||
+      (int)preset->power_level > engine->max_power_level ||
+      (preset->power_level && preset->power_level < FMTX_MIN_POWER_LEVEL) ||
+      (preset->preemphasis && preset->preemphasis != 50 &&
+       preset->preemphasis != 75) ||
+      !text_fits(preset->rds_ps, FMTX_MAX_RDS_PS) ||
+      !text_fits(preset->rds_text, FMTX_MAX_RDS_TEXT))
+    return 0;
+
+  if (!fmtx_preset_store(&engine->presets, preset))
+    return 1;
+
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_delete_preset(FmtxEngine *engine, const char *name)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_DELETE_PRESET, name);
+
+  if (!name || !fmtx_preset_remove(&engine->presets, name))
+    return 0;
+
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+static int
+txn_job(FmtxHw *hw, void *data)
+{
+  FmtxEngineTxn *txn = data;
+  int rv = 0;
+  int err = 0;
+  unsigned int i;
+
+  /* one failed write does not keep the rest from being tried */
+  for (i = 0; i < txn->n; i++)
+  {
+    FmtxEngineTxnOp *op = &txn->op[i];
+    int res;
+
+    if (op->key == FMTX_HW_WORKER_KEY_FREQUENCY)
+      res = tune_job(hw, (void *)(uintptr_t)op->len);
+    else
+      res = fmtx_hw_write_attr(hw, op->key, op->val, op->len);
+
+    if (res < 0 && !rv)
+    {
+      rv = res;
+      err = errno;
+    }
+  }
+
+  errno = err;
+
+  return rv;
+}
+
+static void
+txn_done(void *data, int result, int err)
+{
+  FmtxEngineTxn *txn = data;
+
+  txn->busy = 0;
+
+  if (result < 0)
+    fprintf(stderr, "fmtxd Could not apply preset: %s\n", strerror(err));
+}
+
+/* Every setting goes through the usual paths, which skip what the
+ * hardware already has, with the writes collected into one job */
+static int
+apply_preset(FmtxEngine *engine, const FmtxPreset *preset)
+{
+  FmtxEngineTxn *txn = NULL;
+  unsigned int i;
+
+  for (i = 0; i < FMTX_ENGINE_TXNS && !txn; i++)
+  {
+    if (!engine->txn[i].busy)
+      txn = &engine->txn[i];
+  }
+
+  if (!txn || !engine->worker)
+    return 1;
+
+  txn->n = 0;
+  engine->txn_open = txn;
+
+  set_preemphasis_level(engine, preset->preemphasis ?
+                        (int)preset->preemphasis :
+                        engine->region_preemphasis);
+
+  fmtx_rds_sched_set_static_ps(&engine->rds, preset->rds_ps);
+  fmtx_rds_sched_set_static_rt(&engine->rds, preset->rds_text, NULL, 0);
+  strcpy(engine->rds_ps, preset->rds_ps);
+  strcpy(engine->rds_text, preset->rds_text);
+  engine->n_rds_text_tags = 0;
+  rds_update(engine);
+
+  engine->power_level = preset->power_level ? (int)preset->power_level :
+                        engine->max_power_level;
+
+  /* also applies the power level for the new channel */
+  set_frequency(engine, preset->frequency);
+
+  engine->txn_open = NULL;
+
+  if (txn->n)
+  {
+    txn->busy = 1;
+    fmtx_hw_worker_job(engine->worker, FMTX_HW_WORKER_KEY_NONE, txn_job,
+                       txn_done, txn);
+  }
+
+  emit(engine, PENDING_CHANGED);
+
+  return 2;
+}
+
+int
+fmtx_engine_apply_preset(FmtxEngine *engine, const char *name)
+{
+  FmtxPreset *preset;
+  int rv;
+
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_APPLY_PRESET, name);
+  preset = name ? fmtx_preset_find(&engine->presets, name) : NULL;
+
+  if (!preset)
+    return 0;
+
+  rv = apply_preset(engine, preset);
+  flush_outputs(engine);
+
+  return rv;
+}
+
+/* Slots are entered and left on their edges only, so the transmitter can
+ * still be switched by hand in between, as it could with cron */
+static void
+schedule_enter(FmtxEngine *engine, int index)
+{
+  const FmtxScheduleSlot *slot;
+  const FmtxPreset *preset;
+
+  engine->schedule_slot = index;
+  engine->schedule_active[0] = 0;
+
+  if (index < 0)
+  {
+    enable(engine, 0);
+    timer_disarm(engine, FMTX_ENGINE_TIMER_PILOT);
+    emit(engine, PENDING_CHANGED | PENDING_INFO);
+    return;
+  }
+
+  slot = &engine->schedule.slot[index];
+  fmtx_schedule_format_slot(slot, engine->schedule_active,
+                            sizeof(engine->schedule_active));
+
+  if (slot->preset[0])
+  {
+    preset = fmtx_preset_find(&engine->presets, slot->preset);
+
+    if (!preset)
+      fprintf(stderr, "fmtxd Scheduled preset %s is gone\n", slot->preset);
+    else if (apply_preset(engine, preset) != 2)
+      fprintf(stderr, "fmtxd Could not apply scheduled preset %s\n",
+              slot->preset);
+  }
+
+  enable(engine, 1);
+  emit(engine, PENDING_CHANGED | PENDING_INFO);
+}
+
+/* On every edge and clock change, one localtime() and one mktime() */
+static void
+schedule_update(FmtxEngine *engine)
+{
+  time_t now = time(NULL);
+  struct tm tm;
+  int index;
+
+  localtime_r(&now, &tm);
+  index = fmtx_schedule_active(&engine->schedule, &tm);
+
+  if (index != engine->schedule_slot)
+    schedule_enter(engine, index);
+
+  engine->schedule_next = fmtx_schedule_next(&engine->schedule, now);
+
+  if (engine->schedule_next)
+    timer_arm_wall(engine, FMTX_ENGINE_TIMER_SCHEDULE, engine->schedule_next);
+  else
+    timer_disarm(engine, FMTX_ENGINE_TIMER_SCHEDULE);
+
+  emit(engine, PENDING_CHANGED);
+}
+
+void
+fmtx_engine_set_schedule_path(FmtxEngine *engine, const char *path)
+{
+  snprintf(engine->schedule_path, sizeof(engine->schedule_path), "%s",
+           path);
+}
+
+int
+fmtx_engine_load_schedule(FmtxEngine *engine, unsigned int *line)
+{
+  FmtxSchedule schedule;
+  unsigned int i;
+  int rv;
+
+  *line = 0;
+
+  if (!engine->schedule_path[0])
+    schedule.n = 0;
+  else if ((rv = fmtx_schedule_load(&schedule, engine->schedule_path,
+                                    line)) < 0)
+    return 1;
+  else if (!rv)
+    return 0;
+
+  for (i = 0; i < schedule.n; i++)
+  {
+    if (schedule.slot[i].preset[0] &&
+        !fmtx_preset_find(&engine->presets, schedule.slot[i].preset))
+    {
+      *line = schedule.slot[i].line;
+      return 0;
+    }
+  }
+
+  engine->schedule = schedule;
+  fmtx_schedule_format(&schedule, engine->schedule_text,
+                       sizeof(engine->schedule_text));
+  /* the file may be gone by the time the log is replayed */
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_LOAD_SCHEDULE,
+                        engine->schedule_text);
+
+  /* the slot in effect is entered afresh, but loading outside of one does
+   * not take the transmitter off air */
+  engine->schedule_slot = -1;
+  engine->schedule_active[0] = 0;
+  schedule_update(engine);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+/* sysfs_notify() shows up as EPOLLPRI. Most power_supply attributes never
+ * get one, the poll timer covers those. */
+static void
+watch_sensor(FmtxEngine *engine, int fd, int op)
+{
+  struct epoll_event ev;
+
+  if (fd == -1)
+    return;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLPRI;
+  ev.data.u32 = SOURCE_SENSORS;
+
+  epoll_ctl(engine->epoll_fd, op, fd, &ev);
+}
+
+/* Off the air a sensor change has no power level to recompute */
+static void
+watch_sensors(FmtxEngine *engine, int watched)
+{
+  FmtxGovernor *gov = &engine->governor;
+  int op = watched ? EPOLL_CTL_ADD : EPOLL_CTL_DEL;
+  unsigned int i;
+
+  if (engine->sensors_watched == watched)
+    return;
+
+  watch_sensor(engine, gov->capacity_fd, op);
+  watch_sensor(engine, gov->status_fd, op);
+
+  for (i = 0; i < gov->n_zones; i++)
+    watch_sensor(engine, gov->zone_fd[i], op);
+
+  engine->sensors_watched = watched;
+}
+
+static void
+governor_poll(FmtxEngine *engine)
+{
+  fmtx_governor_read(&engine->governor);
+
+  if (fmtx_governor_update(&engine->governor, now_ns()))
+  {
+    apply_power_level(engine);
+    emit(engine, PENDING_CHANGED);
+  }
+}
+
+/* Nothing to save while the transmitter is off, the files stay open for
+ * the next time */
+static void
+governor_update(FmtxEngine *engine)
+{
+  if (engine->state == FMTX_STATE_ENABLED)
+  {
+    if (!engine->governor.opened)
+      fmtx_governor_open(&engine->governor, engine->sysfs_class);
+
+    watch_sensors(engine, 1);
+    governor_poll(engine);
+
+    if (!timer_armed(engine, FMTX_ENGINE_TIMER_GOVERNOR))
+      timer_arm(engine, FMTX_ENGINE_TIMER_GOVERNOR,
+                FMTX_GOVERNOR_POLL_INTERVAL * 1000, 1);
+  }
+  else
+  {
+    watch_sensors(engine, 0);
+    timer_disarm(engine, FMTX_ENGINE_TIMER_GOVERNOR);
+  }
+}
+
+void
+fmtx_engine_set_sysfs_class(FmtxEngine *engine, const char *path)
+{
+  snprintf(engine->sysfs_class, sizeof(engine->sysfs_class), "%s", path);
+
+  if (engine->governor.opened)
+  {
+    watch_sensors(engine, 0);
+    fmtx_governor_close(&engine->governor);
+
+    if (engine->state == FMTX_STATE_ENABLED)
+      governor_update(engine);
+  }
+}
+
+static int
+set_governor_curve(FmtxEngine *engine, FmtxGovernorCurve *curve, char *text,
+                   size_t len, const char *value, int min_x, int max_x)
+{
+  if (!value || !fmtx_governor_curve_parse(curve, value, min_x, max_x))
+    return 0;
+
+  fmtx_governor_curve_format(curve, text, len);
+
+  if (engine->state == FMTX_STATE_ENABLED)
+    governor_poll(engine);
+
+  emit(engine, PENDING_CHANGED);
+  flush_outputs(engine);
+
+  return 2;
+}
+
+int
+fmtx_engine_set_governor_battery(FmtxEngine *engine, const char *curve)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_GOVERNOR_BATTERY,
+                        curve);
+
+  return set_governor_curve(engine, &engine->governor.battery,
+                            engine->governor_battery,
+                            sizeof(engine->governor_battery), curve,
+                            FMTX_GOVERNOR_BATTERY_MIN,
+                            FMTX_GOVERNOR_BATTERY_MAX);
+}
+
+int
+fmtx_engine_set_governor_thermal(FmtxEngine *engine, const char *curve)
+{
+  fmtx_input_log_string(&engine->input_log, FMTX_INPUT_GOVERNOR_THERMAL,
+                        curve);
+
+  return set_governor_curve(engine, &engine->governor.thermal,
+                            engine->governor_thermal,
+                            sizeof(engine->governor_thermal), curve,
+                            FMTX_GOVERNOR_THERMAL_MIN,
+                            FMTX_GOVERNOR_THERMAL_MAX);
+}
+
+void
+fmtx_engine_set_offline(FmtxEngine *engine, int offline)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_OFFLINE, offline);
+
+  engine->offline = offline;
+
+  if (offline && engine->state == FMTX_STATE_ENABLED)
+  {
+    enable(engine, 0);
+    emit(engine, PENDING_CHANGED | PENDING_INFO);
+  }
+
+  flush_outputs(engine);
+}
+
+void
+fmtx_engine_set_call_active(FmtxEngine *engine, int call_active)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_CALL_ACTIVE, call_active);
+
+  engine->call_active = call_active;
+
+  if (call_active)
+  {
+    if (engine->state == FMTX_STATE_ENABLED)
+      suspend(engine);
+  }
+  else if (engine->active && !engine->hp_connected)
+    resume(engine);
+
+  flush_outputs(engine);
+}
+
+void
+fmtx_engine_set_jack(FmtxEngine *engine, int connected)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_JACK, connected);
+
+  engine->hp_connected = connected;
+
+  if (connected)
+  {
+    if (engine->state == FMTX_STATE_ENABLED)
+    {
+      if (engine->ops->error)
+        engine->ops->error(engine->data, "fmtx_ni_cable_error");
+
+      suspend(engine);
+    }
+  }
+  else if (engine->active && !engine->call_active)
+    resume(engine);
+
+  flush_outputs(engine);
+}
+
+void
+fmtx_engine_set_sink_running(FmtxEngine *engine, int running)
+{
+  fmtx_input_log_uint(&engine->input_log, FMTX_INPUT_SINK_RUNNING, running);
+
+  engine->pa_running = running;
+  toggle_pilot(engine);
+  flush_outputs(engine);
+}
+
+int
+fmtx_engine_is_idle(FmtxEngine *engine)
+{
+  return engine->state != FMTX_STATE_ENABLED && !engine->active &&
+         !engine->scan.active && !engine->schedule.n &&
+         !timer_armed(engine, FMTX_ENGINE_TIMER_EXIT);
+}
+
+void
+fmtx_engine_call_begin(FmtxEngine *engine)
+{
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_CALL_BEGIN, NULL, 0,
+                       NULL, 0);
+
+  timer_disarm(engine, FMTX_ENGINE_TIMER_EXIT);
+}
+
+static void
+call_end(FmtxEngine *engine)
+{
+  if (engine->state != FMTX_STATE_ENABLED && !engine->active &&
+      !engine->scan.active)
+    timer_arm(engine, FMTX_ENGINE_TIMER_EXIT, 60000, 0);
+}
+
+void
+fmtx_engine_call_end(FmtxEngine *engine)
+{
+  fmtx_input_log_write(&engine->input_log, FMTX_INPUT_CALL_END, NULL, 0,
+                       NULL, 0);
+  call_end(engine);
+}
@@ -0,0 +1,458 @@
+#ifndef __FMTXD_ENGINE_H_INCLUDED__
+#define __FMTXD_ENGINE_H_INCLUDED__
+
+#include "governor.h"
+#include "hw-worker.h"
+#include "hw.h"
+#include "input-log.h"
+#include "meter.h"
+#include "noise-map.h"
+#include "power-table.h"
+#include "preset.h"
+#include "rds-charset.h"
+#include "rds-sched.h"
+#include "schedule.h"
+
+/* Transmitter policy and hardware control, without GLib. All timers are
+ * timerfds in one epoll set, together with the hardware worker. Embedders
+ * either call fmtx_engine_run() or watch fmtx_engine_get_fd() from their own
+ * loop and call fmtx_engine_dispatch() when it is readable.
+ *
+ * Inputs are the fmtx_engine_set_*() calls, outputs are FmtxEngineOps. The
+ * engine only allocates in fmtx_engine_new(). */
+
+/* characters on air, the UTF-8 may be longer */
+#define FMTX_MAX_RDS_PS 8
+#define FMTX_MAX_RDS_TEXT 64
+#define FMTX_MAX_RDS_ROTATION \
+  (FMTX_RDS_SCHED_MAX_RT * (FMTX_RDS_CHARSET_MAX_BYTES(FMTX_RDS_RT_LEN) + 1))
+
+/* A full RT takes about three seconds to go out, PS one third of that */
+#define FMTX_MIN_RDS_ROTATION_DWELL 3000
+#define FMTX_MIN_RDS_PS_DWELL 1000
+
+/* Each interference sample keeps the transmitter muted for one measurement
+ * of the current channel and one per alternate, about 20 ms each on a
+ * si4713. The interval bounds the wakeups, the alternates the work done
+ * per wakeup. */
+#define FMTX_MIN_MONITOR_INTERVAL 10
+#define FMTX_MAX_MONITOR_INTERVAL 3600
+#define FMTX_MAX_MONITOR_ALTERNATES 4
+#define FMTX_DEFAULT_MONITOR_ALTERNATES 2
+#define FMTX_DEFAULT_MONITOR_THRESHOLD 45
+/* dB an alternate has to be quieter by, so noise near the threshold does
+ * not make the transmitter hop back and forth */
+#define FMTX_MONITOR_MARGIN 6
+
+/* Carrier gating, silence_timeout is in seconds and 0 turns it off */
+#define FMTX_MAX_SILENCE_TIMEOUT 3600
+#define FMTX_DEFAULT_SILENCE_THRESHOLD 60
+
+typedef enum
+{
+  FMTX_STATE_INITIALIZING,
+  FMTX_STATE_DISABLED,
+  FMTX_STATE_ENABLED,
+  FMTX_STATE_NA,
+  FMTX_STATE_ERROR
+} FmtxState;
+
+/* What happens to the carrier after silence_timeout */
+typedef enum
+{
+  FMTX_SILENCE_MUTE,
+  /* down to FMTX_MIN_POWER_LEVEL, receivers stay locked */
+  FMTX_SILENCE_POWER
+} FmtxSilenceAction;
+
+typedef enum
+{
+  FMTX_ENGINE_TIMER_PILOT,
+  FMTX_ENGINE_TIMER_IDLE,
+  FMTX_ENGINE_TIMER_EXIT,
+  FMTX_ENGINE_TIMER_MIXER,
+  /* absolute, the next fmtx_rds_sched_deadline() */
+  FMTX_ENGINE_TIMER_RDS,
+  /* repeating, every monitor_interval seconds while enabled */
+  FMTX_ENGINE_TIMER_MONITOR,
+  /* repeating, FMTX_GOVERNOR_POLL_INTERVAL while enabled */
+  FMTX_ENGINE_TIMER_GOVERNOR,
+  /* CLOCK_REALTIME, the next fmtx_schedule_next(), cancelled when the
+   * clock is set */
+  FMTX_ENGINE_TIMER_SCHEDULE,
+  /* CLOCK_REALTIME, the next minute while clock time is sent */
+  FMTX_ENGINE_TIMER_CT,
+  FMTX_ENGINE_TIMER_LAST
+} FmtxEngineTimer;
+
+/* At most this many fmtx_engine_apply_preset() in flight */
+#define FMTX_ENGINE_TXNS 4
+/* one write per attribute and the retune */
+#define FMTX_ENGINE_TXN_OPS FMTX_HW_WORKER_KEY_LAST
+
+typedef struct
+{
+  /* FmtxHwAttr, or FMTX_HW_WORKER_KEY_FREQUENCY with len in kHz */
+  int key;
+  unsigned int len;
+  char val[FMTX_HW_WORKER_MAX_VALUE];
+} FmtxEngineTxnOp;
+
+/* Writes run back to back as one worker job */
+typedef struct
+{
+  int busy;
+  unsigned int n;
+  FmtxEngineTxnOp op[FMTX_ENGINE_TXN_OPS];
+} FmtxEngineTxn;
+
+/* Settings the embedder should persist */
+typedef enum
+{
+  FMTX_ENGINE_KEY_FREQUENCY,
+  FMTX_ENGINE_KEY_ENABLED,
+  FMTX_ENGINE_KEY_MONITOR_INTERVAL,
+  FMTX_ENGINE_KEY_MONITOR_THRESHOLD,
+  FMTX_ENGINE_KEY_MONITOR_ALTERNATES,
+  FMTX_ENGINE_KEY_SILENCE_TIMEOUT,
+  FMTX_ENGINE_KEY_SILENCE_THRESHOLD,
+  FMTX_ENGINE_KEY_SILENCE_ACTION,
+  FMTX_ENGINE_KEY_RDS_PI,
+  FMTX_ENGINE_KEY_RDS_PTY,
+  FMTX_ENGINE_KEY_RDS_TP,
+  FMTX_ENGINE_KEY_RDS_TA,
+  FMTX_ENGINE_KEY_RDS_CT
+} FmtxEngineKey;
+
+/* Noise measurements queued on the hardware worker at a time */
+#define FMTX_SCAN_WINDOW 16
+
+typedef struct _FmtxEngine FmtxEngine;
+
+typedef struct
+{
+  unsigned int frequency;
+  /* dBuV */
+  int noise;
+} FmtxScanResult;
+
+/* results are sorted, quietest channel first */
+typedef void (*FmtxScanFunc)(void *data, const FmtxScanResult *results,
+                             unsigned int n);
+
+/* One measurement in flight on the hardware worker */
+typedef struct
+{
+  FmtxEngine *engine;
+  unsigned int index;
+  int rnl;
+} FmtxScanSlot;
+
+typedef struct
+{
+  int active;
+  /* a monitor sample rather than a ScanChannels call */
+  int monitor;
+  /* CLOCK_REALTIME seconds, older entries weren't part of this scan */
+  uint32_t started;
+  FmtxScanFunc cb;
+  void *data;
+  unsigned int count;
+  uint16_t todo[FMTX_NOISE_MAP_MAX];
+  unsigned int n_todo;
+  unsigned int next;
+  unsigned int in_flight;
+  int muted;
+  /* V4L2 frequency units per kHz, only used on the worker thread */
+  unsigned int units;
+  FmtxScanSlot slot[FMTX_SCAN_WINDOW];
+  FmtxScanResult results[FMTX_NOISE_MAP_MAX];
+} FmtxEngineScan;
+
+/* Every callback may be NULL. changed and info are coalesced and run once
+ * at the end of the input or dispatch that caused them. */
+typedef struct
+{
+  /* a property changed */
+  void (*changed)(void *data);
+  /* the connected state for the policy may have changed */
+  void (*info)(void *data);
+  /* error for the UI, e.g. "fmtx_ni_cable_error" */
+  void (*error)(void *data, const char *error);
+  void (*store)(void *data, FmtxEngineKey key, unsigned int value);
+  /* first enable, the mixer is already being opened */
+  void (*audio_start)(void *data);
+  /* fmtx_engine_set_region() has finished */
+  void (*started)(void *data);
+  /* nothing happened for a minute */
+  void (*idle)(void *data);
+  /* the engine can't continue */
+  void (*fatal)(void *data, const char *msg, const char *reason);
+  /* the interference monitor moved the transmitter, frequencies in kHz */
+  void (*migrated)(void *data, unsigned int from, unsigned int to);
+  /* start or stop feeding fmtx_engine_set_audio_level() */
+  void (*meter)(void *data, int on);
+} FmtxEngineOps;
+
+/* Readable by embedders, only written by engine.c */
+struct _FmtxEngine
+{
+  const FmtxEngineOps *ops;
+  void *data;
+  FmtxHw *hw;
+  FmtxHwWorker *worker;
+  int epoll_fd;
+  int timer_fd[FMTX_ENGINE_TIMER_LAST];
+  unsigned int armed;
+  unsigned int pending;
+  int quit;
+  FmtxState state;
+  unsigned int frequency;
+  unsigned int init_frequency;
+  unsigned int freq_max;
+  unsigned int freq_min;
+  unsigned int freq_step;
+  /* what the user and CAL allow, see governor for what is used */
+  int power_level;
+  int max_power_level;
+  /* last power level sent to the hardware, 0 before the first */
+  int power_written;
+  int region_preemphasis;
+  int preemphasis_written;
+  FmtxPresetList presets;
+  FmtxEngineTxn txn[FMTX_ENGINE_TXNS];
+  FmtxEngineTxn *txn_open;
+  FmtxPowerTable power_table;
+  char power_points[FMTX_POWER_TABLE_MAX_TEXT];
+  FmtxGovernor governor;
+  /* the governor's files are in the epoll set, only while enabled */
+  int sensors_watched;
+  char governor_battery[FMTX_GOVERNOR_MAX_CURVE];
+  char governor_thermal[FMTX_GOVERNOR_MAX_CURVE];
+  char sysfs_class[64];
+  FmtxSchedule schedule;
+  char schedule_path[128];
+  char schedule_text[FMTX_SCHEDULE_MAX_TEXT];
+  /* the slot last entered, -1 for none */
+  int schedule_slot;
+  char schedule_active[FMTX_SCHEDULE_SLOT_TEXT];
+  /* CLOCK_REALTIME seconds, 0 without a schedule */
+  time_t schedule_next;
+  /* as they were set, the scheduler keeps them encoded */
+  char rds_ps[FMTX_RDS_CHARSET_MAX_BYTES(FMTX_MAX_RDS_PS) + 1];
+  char rds_text[FMTX_RDS_CHARSET_MAX_BYTES(FMTX_MAX_RDS_TEXT) + 1];
+  /* RT+ tags of rds_text, byte ranges */
+  FmtxRdsTag rds_text_tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_rds_text_tags;
+  char rds_ps_text[FMTX_RDS_CHARSET_MAX_BYTES(FMTX_RDS_SCHED_MAX_PS_TEXT) +
+                   1];
+  /* rds_ps and rds_text are what the scheduler falls back to */
+  FmtxRdsSched rds;
+  /* rds.fields.pi in hex */
+  char rds_pi[5];
+  /* send clock time while enabled */
+  int rds_ct;
+  char rds_rotation[FMTX_MAX_RDS_ROTATION];
+  FmtxNoiseMap noise;
+  char noise_path[128];
+  int noise_loaded;
+  int noise_dirty;
+  FmtxEngineScan scan;
+  /* seconds, 0 is off */
+  unsigned int monitor_interval;
+  /* dBuV on the current channel that makes the monitor look elsewhere */
+  unsigned int monitor_threshold;
+  unsigned int monitor_alternates;
+  unsigned int silence_timeout;
+  /* dB below full scale a block's peak has to stay under */
+  unsigned int silence_threshold;
+  FmtxSilenceAction silence_action;
+  /* the last meter block, not signalled */
+  FmtxMeterLevel audio_level;
+  /* CLOCK_MONOTONIC of the last loud block, when the silence began */
+  long long silence_start_ns;
+  int meter_on;
+  int gated;
+  int offline;
+  int hp_connected;
+  int pa_running;
+  int call_active;
+  int audio_started;
+  int mixer_inited;
+  int mixer_pending;
+  int active;
+  FmtxInputLog input_log;
+};
+
+/* hw stays owned by the caller */
+FmtxEngine *
+fmtx_engine_new(FmtxHw *hw, const FmtxEngineOps *ops, void *data);
+void
+fmtx_engine_free(FmtxEngine *engine);
+
+int
+fmtx_engine_get_fd(FmtxEngine *engine);
+void
+fmtx_engine_dispatch(FmtxEngine *engine);
+void
+fmtx_engine_run(FmtxEngine *engine);
+void
+fmtx_engine_quit(FmtxEngine *engine);
+/* Waits for the hardware worker, see fmtx_hw_worker_flush(), and writes
+ * out the input log */
+void
+fmtx_engine_flush(FmtxEngine *engine);
+/* Records every input from here on to path for fmtx_replay. Returns -1
+ * with errno set if it can't be created. */
+int
+fmtx_engine_log_inputs(FmtxEngine *engine, const char *path);
+
+const char *
+fmtx_state_name(FmtxState state);
+const char *
+fmtx_engine_startable(FmtxEngine *engine);
+
+/* Initial writes and opening the modulator. Returns 1 on failure. */
+int
+fmtx_engine_open(FmtxEngine *engine);
+/* Region byte from fmtx-raw or -1, and the saved frequency. Calls
+ * ops->started once the limits are applied. */
+void
+fmtx_engine_set_region(FmtxEngine *engine, int region,
+                       unsigned int frequency);
+
+/* These return 0 for invalid values, 1 on failure and 2 on success */
+int
+fmtx_engine_set_enabled(FmtxEngine *engine, int enabled);
+int
+fmtx_engine_set_frequency(FmtxEngine *engine, unsigned int frequency);
+/* RDS text is UTF-8, see rds-charset.h for what goes on air. A PS that is
+ * too long is cut, other text is refused. */
+int
+fmtx_engine_set_rds_ps(FmtxEngine *engine, const char *rds_ps);
+int
+fmtx_engine_set_rds_text(FmtxEngine *engine, const char *rds_text);
+/* With RT+ tags, byte ranges of rds_text such as the artist and title */
+int
+fmtx_engine_set_rds_text_tagged(FmtxEngine *engine, const char *rds_text,
+                                const FmtxRdsTag *tags, unsigned int n_tags);
+/* Newline separated RT messages that replace rds_text while set */
+int
+fmtx_engine_set_rds_rotation(FmtxEngine *engine, const char *messages);
+int
+fmtx_engine_set_rds_rotation_dwell(FmtxEngine *engine, unsigned int ms);
+/* Paged or scrolled in place of rds_ps unless the mode is "static" */
+int
+fmtx_engine_set_rds_ps_text(FmtxEngine *engine, const char *text);
+int
+fmtx_engine_set_rds_ps_mode(FmtxEngine *engine, const char *mode);
+int
+fmtx_engine_set_rds_ps_dwell(FmtxEngine *engine, unsigned int ms);
+
+/* Programme identification, four hex digits */
+int
+fmtx_engine_set_rds_pi(FmtxEngine *engine, const char *pi);
+/* Programme type, 0 to 31 */
+int
+fmtx_engine_set_rds_pty(FmtxEngine *engine, unsigned int pty);
+/* Traffic programme and traffic announcement flags, 0 or 1 */
+int
+fmtx_engine_set_rds_tp(FmtxEngine *engine, unsigned int tp);
+int
+fmtx_engine_set_rds_ta(FmtxEngine *engine, unsigned int ta);
+/* Clock time in a 4A group at the start of every minute, 0 or 1 */
+int
+fmtx_engine_set_rds_ct(FmtxEngine *engine, unsigned int ct);
+
+/* Where the noise map is kept, before the first scan */
+void
+fmtx_engine_set_noise_map_path(FmtxEngine *engine, const char *path);
+/* Measures the noise on the channels of the plan and calls cb with up to
+ * count of them, all if 0, quietest first. Entries younger than max_age
+ * seconds are reused: if all are, cb runs before this returns, else the
+ * stale channels and the count best known ones are measured again. The
+ * transmitter is muted meanwhile. Returns 0 without a frequency plan, 1
+ * while another scan runs and 2 once cb is taken. */
+int
+fmtx_engine_scan(FmtxEngine *engine, unsigned int max_age,
+                 unsigned int count, FmtxScanFunc cb, void *data);
+
+/* Interference monitor, see FMTX_MIN_MONITOR_INTERVAL */
+int
+fmtx_engine_set_monitor_interval(FmtxEngine *engine, unsigned int s);
+int
+fmtx_engine_set_monitor_threshold(FmtxEngine *engine, unsigned int dbuv);
+int
+fmtx_engine_set_monitor_alternates(FmtxEngine *engine, unsigned int n);
+
+/* Gates the carrier once the monitor source has been quiet for a while */
+int
+fmtx_engine_set_silence_timeout(FmtxEngine *engine, unsigned int s);
+int
+fmtx_engine_set_silence_threshold(FmtxEngine *engine, unsigned int db);
+/* "mute" or "power" */
+int
+fmtx_engine_set_silence_action(FmtxEngine *engine, const char *action);
+const char *
+fmtx_silence_action_name(FmtxSilenceAction action);
+/* One block from the monitor source, see FmtxEngineOps.meter */
+void
+fmtx_engine_set_audio_level(FmtxEngine *engine, const FmtxMeterLevel *level);
+
+/* Measured kHz:dBuV points for the per-channel power table, "" for the
+ * CAL level everywhere */
+int
+fmtx_engine_set_power_points(FmtxEngine *engine, const char *points);
+
+/* Checks preset against the plan and the CAL limit and keeps it. Returns
+ * 1 before the limits are known or when there are too many. */
+int
+fmtx_engine_save_preset(FmtxEngine *engine, const FmtxPreset *preset);
+int
+fmtx_engine_delete_preset(FmtxEngine *engine, const char *name);
+/* Writes only what differs from the current settings, all in one worker
+ * job. Returns 0 for unknown names and 1 while too many are pending. */
+int
+fmtx_engine_apply_preset(FmtxEngine *engine, const char *name);
+
+/* Where the schedule is kept, see schedule.h */
+void
+fmtx_engine_set_schedule_path(FmtxEngine *engine, const char *path);
+/* Reads the schedule again and applies the slot in effect, if any. Every
+ * preset it names has to exist. Returns 0 and sets line for an invalid
+ * schedule, 1 with errno set if it can't be read. While there is one the
+ * engine never goes idle. */
+int
+fmtx_engine_load_schedule(FmtxEngine *engine, unsigned int *line);
+
+/* Where power_supply and thermal are, /sys/class unless testing */
+void
+fmtx_engine_set_sysfs_class(FmtxEngine *engine, const char *path);
+/* Governor curves, see fmtx_governor_curve_parse() */
+int
+fmtx_engine_set_governor_battery(FmtxEngine *engine, const char *curve);
+int
+fmtx_engine_set_governor_thermal(FmtxEngine *engine, const char *curve);
+
+void
+fmtx_engine_set_offline(FmtxEngine *engine, int offline);
+void
+fmtx_engine_set_call_active(FmtxEngine *engine, int call_active);
+void
+fmtx_engine_set_jack(FmtxEngine *engine, int connected);
+void
+fmtx_engine_set_sink_running(FmtxEngine *engine, int running);
+void
+fmtx_engine_check_mixer(FmtxEngine *engine);
+
+/* Not transmitting, not waiting to resume and not counting down to idle */
+int
+fmtx_engine_is_idle(FmtxEngine *engine);
+
+/* Around every client request, holds off the idle exit */
+void
+fmtx_engine_call_begin(FmtxEngine *engine);
+void
+fmtx_engine_call_end(FmtxEngine *engine);
+
+#endif /* __FMTXD_ENGINE_H_INCLUDED__ */
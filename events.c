@@ -0,0 +1,23 @@
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include "events.h"
+
+void
+fmtx_device_mode_changed(FmtxObject *obj, const char *mode)
+{
+  fmtx_engine_set_offline(obj->engine, !g_str_equal(MCE_NORMAL_MODE, mode));
+}
+
+void
+fmtx_jack_changed(FmtxObject *obj, gboolean connected)
+{
+  fmtx_engine_set_jack(obj->engine, connected);
+}
+
+void
+fmtx_call_state_changed(FmtxObject *obj, const char *call_state)
+{
+  fmtx_engine_set_call_active(obj->engine,
+                              g_str_equal(MCE_CALL_STATE_ACTIVE, call_state));
+}
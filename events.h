@@ -0,0 +1,15 @@
+#ifndef __FMTXD_EVENTS_H_INCLUDED__
+#define __FMTXD_EVENTS_H_INCLUDED__
+
+#include "fmtx-object.h"
+
+/* MCE and HAL notifications turned into engine inputs, shared by the D-Bus
+ * frontends */
+void
+fmtx_device_mode_changed(FmtxObject *obj, const char *mode);
+void
+fmtx_call_state_changed(FmtxObject *obj, const char *call_state);
+void
+fmtx_jack_changed(FmtxObject *obj, gboolean connected);
+
+#endif /* __FMTXD_EVENTS_H_INCLUDED__ */
@@ -1,11 +1,18 @@
 #include "fmtx-object.h"
+#include <errno.h>
 #include <glib.h>
+#include <string.h>
+
+#include "frontend.h"
+#include "mpris.h"
+#include "status.h"
 
 G_DEFINE_TYPE(FmtxObject, fmtx_object, G_TYPE_OBJECT);
 
 gboolean
 emit_changed(gpointer obj)
 {
+  status_page_update(obj);
   g_signal_emit(obj, FMTX_OBJECT_GET_CLASS(obj)->changed, 0);
   return FALSE;
 }
@@ -25,7 +32,8 @@ emit_info(gpointer obj)
                 FMTX_OBJECT_GET_CLASS(obj)->info,
                 0,
                 "connected",
-                g_str_equal(((FmtxObject *)obj)->state, "enabled") ? "1" : "0",
+                ((FmtxObject *)obj)->engine->state == FMTX_STATE_ENABLED ?
+                "1" : "0",
                 strv);
 
   g_free(s);
@@ -33,397 +41,924 @@ emit_info(gpointer obj)
   return 0;
 }
 
-void
-exit_timeout_cb(FmtxObject *obj)
+gboolean
+fmtx_object_is_primary(FmtxObject *obj)
 {
-  snd_mixer_close(obj->snd_mixer);
-  pa_context_disconnect(obj->context);
-  g_object_unref(obj->gcclient);
-  dbus_g_connection_unref(obj->dbus);
-  exit(0);
+  return g_str_equal(obj->path, FMTX_OBJECT_PATH);
 }
 
-int
-fmtx_set_rds_text(FmtxObject *obj, const char *rds_text)
+void
+fmtx_object_close(FmtxObject *obj)
 {
-  int rv = 0;
-  int fd;
+  FmtxHw *hw = obj->engine->hw;
 
-  if (rds_text && (strlen(rds_text) <= FMTX_MAX_RDS_TEXT))
-  {
-    fd = open(FMTX_SYSFS_NODE "rds_radio_text", O_WRONLY);
+  fmtx_mpris_close(obj);
+  status_page_close(obj);
+  fmtx_engine_free(obj->engine);
+  fmtx_hw_free(hw);
 
-    if (fd == -1)
-    {
-      perror("fmtxd Could not open rds text file");
-      rv = 1;
-    }
-    else
-    {
-      if (write(fd, rds_text, strlen(rds_text) + 1) == -1)
-      {
-        perror("fmtxd Could not set rds info text");
-        close(fd);
-        rv = 1;
-      }
-      else
-      {
-        close(fd);
-        g_free(obj->rds_text);
-        obj->rds_text = g_strdup(rds_text);
-        rv = 2;
-      }
-    }
-  }
+  if (obj->context)
+    pa_context_disconnect(obj->context);
 
-  return rv;
+  g_object_unref(obj->gcclient);
+  frontend_close(obj);
 }
 
-int
-fmtx_set_rds_station_name(FmtxObject *obj, const char *rds_ps)
+typedef struct
 {
-  int fd;
-  size_t i;
-  char buf[9];
+  const char *name;
+  int type;
+  void (*get)(FmtxObject *obj, FmtxValue *value);
+  gboolean (*set)(FmtxObject *obj, const FmtxValue *value, GError **error);
+} FmtxProperty;
 
-  if (!rds_ps)
-    return 0;
+static void
+fmtx_property_get_version(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = 1u;
+}
 
-  strncpy(buf, rds_ps, sizeof(buf) - 1);
+static void
+fmtx_property_get_frequency(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->frequency;
+}
 
-  if ((i = strlen(rds_ps)) < sizeof(buf) - 1)
-  {
-    char *p = &buf[i];
+static gboolean
+fmtx_property_set_frequency(FmtxObject *obj, const FmtxValue *value,
+                            GError **error)
+{
+  int tmp = fmtx_engine_set_frequency(obj->engine, value->u);
 
-    do
-    {
-      *p++ = ' ';
-    }
-    while (p != &buf[sizeof(buf) - 1]);
-  }
+  if (tmp == 2)
+    return TRUE;
 
-  buf[sizeof(buf) - 1] = 0;
+  if (tmp == 1)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Frequency could not be set");
+  else if (!tmp)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Frequency is not currently allowed");
+  else
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Unknown return code");
 
-  fd = open(FMTX_SYSFS_NODE "rds_ps_name", O_WRONLY);
+  return FALSE;
+}
 
-  if (fd == -1)
-  {
-    perror("fmtxd Could not open rds station name file");
-    return 1;
-  }
+static void
+fmtx_property_get_freq_max(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->freq_max;
+}
 
-  if (write(fd, buf, sizeof(buf)) == -1)
-  {
-    perror("fmtxd Could not set rds station name");
-    close(fd);
-    return 1;
-  }
+static void
+fmtx_property_get_freq_min(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->freq_min;
+}
 
-  close(fd);
-  g_free(obj->rds_ps);
-  obj->rds_ps = g_strdup(rds_ps);
+static void
+fmtx_property_get_freq_step(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->freq_step;
+}
 
-  return 2;
+static void
+fmtx_property_get_state(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_state_name(obj->engine->state);
 }
 
 static gboolean
-dbus_glib_marshal_fmtx_object_get(FmtxObject *obj,
-                                  gconstpointer iname,
-                                  gconstpointer pname,
-                                  GValue *value,
-                                  GError **error)
+fmtx_property_set_state(FmtxObject *obj, const FmtxValue *value,
+                        GError **error)
 {
-  gboolean rv = FALSE;
-  gboolean startable;
-  GValue v = { 0, };
+  FmtxEngine *engine = obj->engine;
+  const char *state = value->s;
+  int res = 0;
 
-  if (obj->exit_timeout)
+  if (engine->state == FMTX_STATE_ERROR)
   {
-    g_source_remove(obj->exit_timeout);
-    obj->exit_timeout = 0;
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Device initialization failed");
+    return FALSE;
   }
 
-  if (g_str_equal(pname, "version"))
+  if (g_str_equal(state, "enabled"))
   {
-    g_value_init(&v, G_TYPE_UINT);
-    g_value_set_uint(&v, 1u);
-    rv = TRUE;
-  }
+    if (engine->offline)
+    {
+      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                  "Device is in offline mode");
+      return FALSE;
+    }
 
-  if (g_str_equal(pname, "frequency"))
-  {
-    g_value_init(&v, G_TYPE_UINT);
-    g_value_set_uint(&v, obj->frequency);
-    rv = TRUE;
-  }
+    if (engine->hp_connected)
+    {
+      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                  "Headphones are connected");
+      return FALSE;
+    }
 
-  if (g_str_equal(pname, "freq_max"))
-  {
-    g_value_init(&v, G_TYPE_UINT);
-    g_value_set_uint(&v, obj->freq_max);
-    rv = TRUE;
+    res = fmtx_engine_set_enabled(engine, TRUE);
   }
-
-  if (g_str_equal(pname, "freq_min"))
+  else if (g_str_equal(state, "disabled"))
+    res = fmtx_engine_set_enabled(engine, FALSE);
+  else
   {
-    g_value_init(&v, G_TYPE_UINT);
-    g_value_set_uint(&v, obj->freq_min);
-    rv = TRUE;
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Unknown state");
+    return FALSE;
   }
 
-  if (g_str_equal(pname, "freq_step"))
+  if (res != 2)
   {
-    g_value_init(&v, G_TYPE_UINT);
-    g_value_set_uint(&v, obj->freq_step);
-    rv = TRUE;
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Failed to change fmtx state");
+    return FALSE;
   }
 
-  if (g_str_equal(pname, "startable"))
-  {
-    g_value_init(&v, G_TYPE_STRING);
+  return TRUE;
+}
 
-    if (obj->offline)
-    {
-      g_value_set_string(&v, "Device is in offline mode");
-      startable = FALSE;
-    }
-    else
-      startable = TRUE;
+static void
+fmtx_property_get_startable(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_engine_startable(obj->engine);
+}
 
-    if (obj->hp_connected)
-    {
-      g_value_set_string(&v, "Headphones are connected");
-      startable = 0;
-    }
+static void
+fmtx_property_get_rds_ps(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->rds_ps;
+}
 
-    if (startable)
-      g_value_set_string(&v, "true");
+static gboolean
+fmtx_property_set_rds_ps(FmtxObject *obj, const FmtxValue *value,
+                         GError **error)
+{
+  int res = fmtx_engine_set_rds_ps(obj->engine, value->s);
 
-    rv = TRUE;
-  }
+  if (res == 2)
+    return TRUE;
 
-  if (g_str_equal(pname, "state"))
-  {
-    g_value_init(&v, G_TYPE_STRING);
-    g_value_set_string(&v, obj->state);
-    rv = TRUE;
-  }
+  if (res == 1)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "RDS station name could not be set");
+  else if (!res)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Invalid RDS station name");
+  else
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Unknown return code");
 
-  if (g_str_equal(pname, "rds_ps"))
-  {
-    g_value_init(&v, G_TYPE_STRING);
-    g_value_set_string(&v, obj->rds_ps);
-    rv = TRUE;
-  }
+  return FALSE;
+}
 
-  if (g_str_equal(pname, "rds_text"))
-  {
-    g_value_init(&v, G_TYPE_STRING);
-    g_value_set_string(&v, obj->rds_text);
-    rv = TRUE;
-  }
+static void
+fmtx_property_get_rds_text(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->rds_text;
+}
 
-  if (!g_str_equal(obj->state, "enabled") && !obj->active)
-    obj->exit_timeout = g_timeout_add(60000, (GSourceFunc)exit_timeout_cb, obj);
+static gboolean
+fmtx_property_set_rds_text(FmtxObject *obj, const FmtxValue *value,
+                           GError **error)
+{
+  int res = fmtx_engine_set_rds_text(obj->engine, value->s);
 
-  if (rv)
-    memcpy(value, &v, sizeof(v));
-  else
+  if (res == 2)
+    return TRUE;
+
+  if (res == 1)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "RDS text could not be set");
+  else if (!res)
     g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                "Property does not exist");
+                "Invalid RDS text");
+  else
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Unknown return code");
+
+  return FALSE;
+}
+
+/* Maps the 0/2 results of the setters below, which can't fail otherwise */
+static gboolean
+check_set_result(int res, const char *invalid, GError **error)
+{
+  if (res == 2)
+    return TRUE;
 
-  return rv;
+  g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS, "%s", invalid);
+
+  return FALSE;
+}
+
+static void
+fmtx_property_get_rds_rotation(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->rds_rotation;
+}
+
+static gboolean
+fmtx_property_set_rds_rotation(FmtxObject *obj, const FmtxValue *value,
+                               GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_rotation(obj->engine, value->s),
+                          "Invalid RDS text rotation", error);
+}
+
+static void
+fmtx_property_get_rds_rotation_dwell(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.rt_dwell_ms;
 }
 
 static gboolean
-dbus_glib_marshal_fmtx_object_set(FmtxObject *obj,
-                                  gconstpointer iname,
-                                  gconstpointer pname,
-                                  GValue *value,
+fmtx_property_set_rds_rotation_dwell(FmtxObject *obj, const FmtxValue *value,
+                                     GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_rotation_dwell(obj->engine,
+                                                             value->u),
+                          "RDS text dwell time is too short", error);
+}
+
+static void
+fmtx_property_get_rds_ps_text(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->rds_ps_text;
+}
+
+static gboolean
+fmtx_property_set_rds_ps_text(FmtxObject *obj, const FmtxValue *value,
+                              GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_ps_text(obj->engine, value->s),
+                          "Invalid RDS station name text", error);
+}
+
+static void
+fmtx_property_get_rds_ps_mode(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_rds_ps_mode_name(obj->engine->rds.ps_mode);
+}
+
+static gboolean
+fmtx_property_set_rds_ps_mode(FmtxObject *obj, const FmtxValue *value,
+                              GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_ps_mode(obj->engine, value->s),
+                          "Unknown RDS station name mode", error);
+}
+
+static void
+fmtx_property_get_rds_ps_dwell(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.ps_dwell_ms;
+}
+
+static gboolean
+fmtx_property_set_rds_ps_dwell(FmtxObject *obj, const FmtxValue *value,
+                               GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_ps_dwell(obj->engine,
+                                                       value->u),
+                          "RDS station name dwell time is too short", error);
+}
+
+static void
+fmtx_property_get_rds_pi(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->rds_pi;
+}
+
+static gboolean
+fmtx_property_set_rds_pi(FmtxObject *obj, const FmtxValue *value,
+                         GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_pi(obj->engine, value->s),
+                          "RDS PI has to be four hex digits", error);
+}
+
+static void
+fmtx_property_get_rds_pty(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.fields.pty;
+}
+
+static gboolean
+fmtx_property_set_rds_pty(FmtxObject *obj, const FmtxValue *value,
+                          GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_pty(obj->engine, value->u),
+                          "RDS PTY out of range", error);
+}
+
+static void
+fmtx_property_get_rds_tp(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.fields.tp;
+}
+
+static gboolean
+fmtx_property_set_rds_tp(FmtxObject *obj, const FmtxValue *value,
+                         GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_tp(obj->engine, value->u),
+                          "RDS TP has to be 0 or 1", error);
+}
+
+static void
+fmtx_property_get_rds_ta(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.fields.ta;
+}
+
+static gboolean
+fmtx_property_set_rds_ta(FmtxObject *obj, const FmtxValue *value,
+                         GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_ta(obj->engine, value->u),
+                          "RDS TA has to be 0 or 1", error);
+}
+
+static void
+fmtx_property_get_rds_ct(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds_ct;
+}
+
+static gboolean
+fmtx_property_set_rds_ct(FmtxObject *obj, const FmtxValue *value,
+                         GError **error)
+{
+  return check_set_result(fmtx_engine_set_rds_ct(obj->engine, value->u),
+                          "RDS CT has to be 0 or 1", error);
+}
+
+static void
+fmtx_property_get_rds_jitter(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->rds.jitter_max_us;
+}
+
+static void
+fmtx_property_get_mpris_rt_template(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_mpris_get_template(obj, FMTX_MPRIS_RT);
+}
+
+static gboolean
+fmtx_property_set_mpris_rt_template(FmtxObject *obj, const FmtxValue *value,
+                                    GError **error)
+{
+  return fmtx_mpris_set_template(obj, FMTX_MPRIS_RT, value->s, error);
+}
+
+static void
+fmtx_property_get_mpris_ps_template(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_mpris_get_template(obj, FMTX_MPRIS_PS);
+}
+
+static gboolean
+fmtx_property_set_mpris_ps_template(FmtxObject *obj, const FmtxValue *value,
+                                    GError **error)
+{
+  return fmtx_mpris_set_template(obj, FMTX_MPRIS_PS, value->s, error);
+}
+
+static void
+fmtx_property_get_monitor_interval(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->monitor_interval;
+}
+
+static gboolean
+fmtx_property_set_monitor_interval(FmtxObject *obj, const FmtxValue *value,
+                                   GError **error)
+{
+  return check_set_result(fmtx_engine_set_monitor_interval(obj->engine,
+                                                           value->u),
+                          "Monitor interval is out of range", error);
+}
+
+static void
+fmtx_property_get_monitor_threshold(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->monitor_threshold;
+}
+
+static gboolean
+fmtx_property_set_monitor_threshold(FmtxObject *obj, const FmtxValue *value,
+                                    GError **error)
+{
+  return check_set_result(fmtx_engine_set_monitor_threshold(obj->engine,
+                                                            value->u),
+                          "Monitor threshold is out of range", error);
+}
+
+static void
+fmtx_property_get_monitor_alternates(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->monitor_alternates;
+}
+
+static gboolean
+fmtx_property_set_monitor_alternates(FmtxObject *obj, const FmtxValue *value,
+                                     GError **error)
+{
+  return check_set_result(fmtx_engine_set_monitor_alternates(obj->engine,
+                                                             value->u),
+                          "Number of alternates is out of range", error);
+}
+
+/* Levels are dB below full scale from the last meter block, they only
+ * update while the silence gate is armed */
+static void
+fmtx_property_get_audio_level(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->audio_level.rms_db;
+}
+
+static void
+fmtx_property_get_audio_peak(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->audio_level.peak_db;
+}
+
+static void
+fmtx_property_get_silence_timeout(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->silence_timeout;
+}
+
+static gboolean
+fmtx_property_set_silence_timeout(FmtxObject *obj, const FmtxValue *value,
                                   GError **error)
 {
-  gboolean property_found = FALSE;
-  gboolean rv = FALSE;
+  return check_set_result(fmtx_engine_set_silence_timeout(obj->engine,
+                                                          value->u),
+                          "Silence timeout is out of range", error);
+}
+
+static void
+fmtx_property_get_silence_threshold(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->silence_threshold;
+}
+
+static gboolean
+fmtx_property_set_silence_threshold(FmtxObject *obj, const FmtxValue *value,
+                                    GError **error)
+{
+  return check_set_result(fmtx_engine_set_silence_threshold(obj->engine,
+                                                            value->u),
+                          "Silence threshold is out of range", error);
+}
+
+static void
+fmtx_property_get_silence_action(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_silence_action_name(obj->engine->silence_action);
+}
+
+static gboolean
+fmtx_property_set_silence_action(FmtxObject *obj, const FmtxValue *value,
+                                 GError **error)
+{
+  return check_set_result(fmtx_engine_set_silence_action(obj->engine,
+                                                         value->s),
+                          "Unknown silence action", error);
+}
+
+static void
+fmtx_property_get_silence_gated(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->gated;
+}
+
+/* The power level the governor picked and what limited it */
+static void
+fmtx_property_get_governor_level(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->governor.level;
+}
+
+static void
+fmtx_property_get_governor_reason(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = fmtx_governor_reason_name(obj->engine->governor.reason);
+}
+
+/* Curves are strings, so they are saved here rather than by the engine */
+static void
+save_string(FmtxObject *obj, const char *name, const char *value)
+{
+  gchar *key = g_strconcat(obj->gconf_dir, "/", name, NULL);
+
+  gconf_client_set_string(obj->gcclient, key, value, NULL);
+  g_free(key);
+}
+
+static void
+fmtx_property_get_governor_battery(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->governor_battery;
+}
+
+static gboolean
+fmtx_property_set_governor_battery(FmtxObject *obj, const FmtxValue *value,
+                                   GError **error)
+{
+  if (!check_set_result(fmtx_engine_set_governor_battery(obj->engine,
+                                                         value->s),
+                        "Invalid battery power curve", error))
+    return FALSE;
+
+  save_string(obj, "governor_battery", obj->engine->governor_battery);
+
+  return TRUE;
+}
+
+static void
+fmtx_property_get_governor_thermal(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->governor_thermal;
+}
+
+static gboolean
+fmtx_property_set_governor_thermal(FmtxObject *obj, const FmtxValue *value,
+                                   GError **error)
+{
+  if (!check_set_result(fmtx_engine_set_governor_thermal(obj->engine,
+                                                         value->s),
+                        "Invalid thermal power curve", error))
+    return FALSE;
+
+  save_string(obj, "governor_thermal", obj->engine->governor_thermal);
+
+  return TRUE;
+}
+
+/* What the hardware was last told, after calibration and the governor */
+static void
+fmtx_property_get_power_level(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->power_written;
+}
+
+static void
+fmtx_property_get_power_points(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->power_points;
+}
+
+static gboolean
+fmtx_property_set_power_points(FmtxObject *obj, const FmtxValue *value,
+                               GError **error)
+{
+  if (!check_set_result(fmtx_engine_set_power_points(obj->engine, value->s),
+                        "Invalid power calibration points", error))
+    return FALSE;
+
+  save_string(obj, "power_points", obj->engine->power_points);
+
+  return TRUE;
+}
+
+static void
+fmtx_property_get_presets(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->presets.names;
+}
+
+static void
+fmtx_property_get_schedule(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->schedule_text;
+}
+
+static void
+fmtx_property_get_schedule_active(FmtxObject *obj, FmtxValue *value)
+{
+  value->s = obj->engine->schedule_active;
+}
+
+static void
+fmtx_property_get_schedule_next(FmtxObject *obj, FmtxValue *value)
+{
+  value->u = obj->engine->schedule_next;
+}
+
+#include "fmtx-object-properties.h"
+
+static const FmtxProperty *
+fmtx_property_lookup(const char *name)
+{
+  const unsigned char *p;
+  unsigned int h = 0;
+  int i;
+
+  for (p = (const unsigned char *)name; *p; p++)
+    h = (h * FMTX_PROPERTY_HASH_SEED + *p) % FMTX_PROPERTY_HASH_SIZE;
+
+  i = fmtx_property_slots[h];
+
+  if (i < 0 || strcmp(fmtx_object_properties[i].name, name))
+    return NULL;
+
+  return &fmtx_object_properties[i];
+}
+
+void
+fmtx_object_call_begin(FmtxObject *obj)
+{
+  fmtx_engine_call_begin(obj->engine);
+}
+
+void
+fmtx_object_call_end(FmtxObject *obj)
+{
+  fmtx_engine_call_end(obj->engine);
+}
+
+gboolean
+fmtx_object_get_property(FmtxObject *obj, const char *name, FmtxValue *value,
+                         GError **error)
+{
+  const FmtxProperty *prop = fmtx_property_lookup(name);
 
-  if (obj->exit_timeout)
+  if (!prop)
   {
-    g_source_remove(obj->exit_timeout);
-    obj->exit_timeout = 0;
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Property does not exist");
+    return FALSE;
   }
 
-  if (g_str_equal(pname, "version") ||
-      g_str_equal(pname, "frequency_min") ||
-      g_str_equal(pname, "frequency_max") ||
-      g_str_equal(pname, "frequency_step"))
-  {
+  memset(value, 0, sizeof(*value));
+  value->type = prop->type;
+  prop->get(obj, value);
+
+  return TRUE;
+}
+
+gboolean
+fmtx_object_set_property(FmtxObject *obj, const char *name,
+                         const FmtxValue *value, GError **error)
+{
+  const FmtxProperty *prop = fmtx_property_lookup(name);
+
+  if (!prop)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Property does not exist");
+  else if (!prop->set)
     g_set_error(error, DBUS_GERROR, DBUS_GERROR_ACCESS_DENIED,
                 "Property is read only");
-    property_found = TRUE;
-  }
+  else if (value->type != prop->type)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Property has a different type");
+  else
+    return prop->set(obj, value, error);
 
-  if (g_str_equal(pname, "frequency"))
-  {
-    unsigned int f = g_value_get_uint(value);
-    int tmp = fmtx_set_frequency(obj, f);
+  return FALSE;
+}
 
-    if (tmp == 2)
-    {
-      g_idle_add(emit_changed, obj);
-      rv = TRUE;
-    }
-    else if (tmp == 1)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Frequency could not be set");
-    else if (!tmp)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                  "Frequency is not currently allowed");
-    else
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Unknown return code");
+void
+fmtx_object_foreach_property(FmtxObject *obj, FmtxPropertyFunc func,
+                             gpointer user_data)
+{
+  FmtxValue value;
+  size_t i;
 
-    property_found = TRUE;
+  for (i = 0; i < G_N_ELEMENTS(fmtx_object_properties); i++)
+  {
+    memset(&value, 0, sizeof(value));
+    value.type = fmtx_object_properties[i].type;
+    fmtx_object_properties[i].get(obj, &value);
+    func(fmtx_object_properties[i].name, &value, user_data);
   }
+}
 
-  if (g_str_equal(pname, "state"))
-  {
-    int res = 0;
+gboolean
+fmtx_object_scan(FmtxObject *obj, guint max_age, guint count,
+                 FmtxScanFunc cb, gpointer data, GError **error)
+{
+  int res = fmtx_engine_scan(obj->engine, max_age, count, cb, data);
 
-    if (g_str_equal(obj->state, "error"))
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Device initialization failed");
+  if (res == 2)
+    return TRUE;
 
-    if (g_str_equal(g_value_get_string(value), "enabled"))
-    {
-      if (obj->offline)
-        g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                    "Device is in offline mode");
+  if (res == 1)
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Could not start the scan, another one may be running");
+  else
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "No channels to scan in this region");
 
-      if (obj->hp_connected)
-        g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                    "Headphones are connected");
+  return FALSE;
+}
 
-      res = fmtx_enable(obj, TRUE);
-    }
-    else
-    {
-      if (g_str_equal(g_value_get_string(value), "disabled"))
-      {
-        res = fmtx_enable(obj, FALSE);
-
-        if (obj->pilot_timeout)
-        {
-          g_source_remove(obj->pilot_timeout);
-          obj->pilot_timeout = 0;
-        }
-      }
-      else
-        g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                    "Unknown state");
-    }
+static gchar *
+preset_key(FmtxObject *obj, const char *name, const char *field)
+{
+  return g_strconcat(obj->gconf_dir, "/presets/", name, field ? "/" : NULL,
+                     field, NULL);
+}
 
-    if (res == 2)
-    {
-      g_idle_add(emit_changed, obj);
-      g_idle_add((GSourceFunc)emit_info, obj);
-      rv = TRUE;
-    }
-    else
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Failed to change fmtx state");
+static void
+preset_set_int(FmtxObject *obj, const char *name, const char *field,
+               guint value)
+{
+  gchar *k = preset_key(obj, name, field);
 
-    property_found = TRUE;
-  }
+  gconf_client_set_int(obj->gcclient, k, value, NULL);
+  g_free(k);
+}
 
-  if (g_str_equal(pname, "rds_ps"))
-  {
-    int res = fmtx_set_rds_station_name(obj, g_value_get_string(value));
+static void
+preset_set_string(FmtxObject *obj, const char *name, const char *field,
+                  const char *value)
+{
+  gchar *k = preset_key(obj, name, field);
 
-    if (res == 2)
-    {
-      g_idle_add(emit_changed, obj);
-      rv = TRUE;
-    }
-    else if (res == 1)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "RDS station name could not be set");
-    else if (!res)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                  "Invalid RDS station name");
-    else
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Unknown return code");
+  gconf_client_set_string(obj->gcclient, k, value, NULL);
+  g_free(k);
+}
 
-    property_found = TRUE;
-  }
+static int
+preset_save(FmtxObject *obj, const char *name, guint frequency,
+            guint power_level, guint preemphasis, const char *rds_ps,
+            const char *rds_text)
+{
+  FmtxPreset preset;
 
-  if (g_str_equal(pname, "rds_text"))
-  {
-    int res = fmtx_set_rds_text(obj, g_value_get_string(value));
+  memset(&preset, 0, sizeof(preset));
 
-    if (res == 2)
-    {
-      g_idle_add(emit_changed, obj);
-      rv = TRUE;
-    }
-    else if (res == 1)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "RDS text could not be set");
-    else if (!res)
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                  "Invalid RDS text");
-    else
-      g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                  "Unknown return code");
+  if (strlen(name) >= sizeof(preset.name) ||
+      strlen(rds_ps) >= sizeof(preset.rds_ps) ||
+      strlen(rds_text) >= sizeof(preset.rds_text))
+    return 0;
+
+  strcpy(preset.name, name);
+  preset.frequency = frequency;
+  preset.power_level = power_level;
+  preset.preemphasis = preemphasis;
+  strcpy(preset.rds_ps, rds_ps);
+  strcpy(preset.rds_text, rds_text);
+
+  return fmtx_engine_save_preset(obj->engine, &preset);
+}
+
+gboolean
+fmtx_object_preset_save(FmtxObject *obj, const char *name, guint frequency,
+                        guint power_level, guint preemphasis,
+                        const char *rds_ps, const char *rds_text,
+                        GError **error)
+{
+  int res = preset_save(obj, name, frequency, power_level, preemphasis,
+                        rds_ps, rds_text);
 
-    property_found = TRUE;
+  if (res == 1)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Could not save the preset, there may be too many");
+    return FALSE;
   }
 
-  if (!g_str_equal(obj->state, "enabled") && !obj->active)
-    obj->exit_timeout = g_timeout_add(60000, (GSourceFunc)exit_timeout_cb, obj);
+  if (!check_set_result(res, "Invalid preset", error))
+    return FALSE;
 
-  if (!property_found)
-    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
-                "Property does not exist");
+  preset_set_int(obj, name, "frequency", frequency);
+  preset_set_int(obj, name, "power_level", power_level);
+  preset_set_int(obj, name, "preemphasis", preemphasis);
+  preset_set_string(obj, name, "rds_ps", rds_ps);
+  preset_set_string(obj, name, "rds_text", rds_text);
 
-  return rv;
+  return TRUE;
 }
 
-static gboolean
-dbus_glib_marshal_fmtx_object_get_all(FmtxObject *obj,
-                                      gconstpointer iname,
-                                      GArray *array,
-                                      GError **error)
+gboolean
+fmtx_object_preset_delete(FmtxObject *obj, const char *name, GError **error)
 {
-  return FALSE;
+  gchar *k;
+
+  if (!check_set_result(fmtx_engine_delete_preset(obj->engine, name),
+                        "Unknown preset", error))
+    return FALSE;
+
+  k = preset_key(obj, name, NULL);
+  gconf_client_recursive_unset(obj->gcclient, k, 0, NULL);
+  g_free(k);
+
+  return TRUE;
+}
+
+gboolean
+fmtx_object_preset_apply(FmtxObject *obj, const char *name, GError **error)
+{
+  int res = fmtx_engine_apply_preset(obj->engine, name);
+
+  if (res == 1)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Could not apply the preset, the transmitter is busy");
+    return FALSE;
+  }
+
+  return check_set_result(res, "Unknown preset", error);
+}
+
+/* Presets that no longer fit the region or the CAL limit are skipped */
+void
+fmtx_object_load_presets(FmtxObject *obj)
+{
+  gchar *dir = preset_key(obj, "", NULL);
+  GSList *dirs = gconf_client_all_dirs(obj->gcclient, dir, NULL);
+  GSList *l;
+
+  g_free(dir);
+
+  for (l = dirs; l; l = l->next)
+  {
+    gchar *name = g_path_get_basename(l->data);
+    gchar *k;
+    guint frequency;
+    guint power_level;
+    guint preemphasis;
+    gchar *rds_ps;
+    gchar *rds_text;
+
+    k = g_strconcat(l->data, "/frequency", NULL);
+    frequency = gconf_client_get_int(obj->gcclient, k, NULL);
+    g_free(k);
+    k = g_strconcat(l->data, "/power_level", NULL);
+    power_level = gconf_client_get_int(obj->gcclient, k, NULL);
+    g_free(k);
+    k = g_strconcat(l->data, "/preemphasis", NULL);
+    preemphasis = gconf_client_get_int(obj->gcclient, k, NULL);
+    g_free(k);
+    k = g_strconcat(l->data, "/rds_ps", NULL);
+    rds_ps = gconf_client_get_string(obj->gcclient, k, NULL);
+    g_free(k);
+    k = g_strconcat(l->data, "/rds_text", NULL);
+    rds_text = gconf_client_get_string(obj->gcclient, k, NULL);
+    g_free(k);
+
+    if (preset_save(obj, name, frequency, power_level, preemphasis,
+                    rds_ps ? rds_ps : "", rds_text ? rds_text : "") != 2)
+      g_printerr("fmtxd: skipping preset %s\n", name);
+
+    g_free(rds_ps);
+    g_free(rds_text);
+    g_free(name);
+    g_free(l->data);
+  }
+
+  g_slist_free(dirs);
 }
 
-#include "fmtx-object-bindings.h"
+gboolean
+fmtx_object_schedule_reload(FmtxObject *obj, GError **error)
+{
+  unsigned int line;
+  int res = fmtx_engine_load_schedule(obj->engine, &line);
+
+  if (res == 1)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Could not read %s: %s", obj->engine->schedule_path,
+                g_strerror(errno));
+    return FALSE;
+  }
+
+  if (!res)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Invalid schedule in %s, line %u",
+                obj->engine->schedule_path, line);
+    return FALSE;
+  }
+
+  return TRUE;
+}
 
 static void
 fmtx_object_init(FmtxObject *obj)
 {
   g_assert(obj != NULL);
 
-  obj->gcclient = 0;
-  obj->power_level = 0;
-  obj->max_power_level = 0;
-  obj->frequency = 0;
-  obj->freq_max = 0;
-  obj->freq_min = 0;
-  obj->freq_step = 100;
-  obj->dev_radio = -1;
-  obj->offline = FALSE;
-  obj->call_active = FALSE;
-  obj->hp_connected = FALSE;
-  obj->state = g_strdup("initializing");
-  obj->rds_ps = g_strdup("");
-  obj->rds_text = g_strdup("");
-  obj->mixer_inited = FALSE;
-  obj->pa_running = FALSE;
-  obj->mixer_elem = 0;
-  obj->active = FALSE;
-  obj->idle_timeout = 0;
-  obj->pilot_timeout = 0;
+  obj->path = NULL;
+  obj->gconf_dir = NULL;
+  obj->gcclient = NULL;
+  obj->engine = NULL;
+  obj->status = NULL;
+  obj->mpris = NULL;
+  obj->status_fd = -1;
+  obj->context = NULL;
+  obj->api = NULL;
 }
 
 static void
@@ -454,10 +989,17 @@ fmtx_object_class_init(FmtxObjectClass *klass)
       G_SIGNAL_RUN_LAST,
       0,
       NULL, NULL,
-      dbus_glib_marshal_fmtx_object_BOOLEAN__STRING_STRING_BOXED_POINTER,
+      g_cclosure_marshal_generic,
       G_TYPE_NONE, 3,
       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRV);
 
-  dbus_g_object_type_install_info(FMTX_OBJECT_TYPE,
-                                  &dbus_glib_fmtx_object_object_info);
+  klass->channel_migrated = g_signal_new(
+      "channel-migrated",
+      G_OBJECT_CLASS_TYPE(klass),
+      G_SIGNAL_RUN_LAST,
+      0,
+      NULL, NULL,
+      g_cclosure_marshal_generic,
+      G_TYPE_NONE, 2,
+      G_TYPE_UINT, G_TYPE_UINT);
 }
@@ -1,27 +1,14 @@
 #ifndef __FMTX_H_INCLUDED__
 #define __FMTX_H_INCLUDED__
 
-#include <alsa/asoundlib.h>
 #include <dbus/dbus-glib.h>
+#include <dbus/dbus.h>
 #include <gconf/gconf-client.h>
 #include <glib.h>
 #include <pulse/pulseaudio.h>
 
-#define FMTX_MAX_RDS_TEXT 64
-#define FMTX_SYSFS_NODE "/sys/bus/i2c/devices/2-0063/"
-
-#define WRITE_FMTX_SYSFS(file, val, err_msg) \
-  { \
-    int fd = open(FMTX_SYSFS_NODE file, O_WRONLY); \
-    if (fd == -1) \
-      perror("fmtxd Error opening " file " file"); \
-    else \
-    { \
-      if (write(fd, val, sizeof(val)) == -1) \
-        perror(err_msg); \
-      close(fd); \
-    } \
-  }
+#include "engine.h"
+#include "fmtxd.h"
 
 #define FMTX_OBJECT_TYPE (fmtx_object_get_type())
 
@@ -33,35 +20,39 @@
 
 typedef struct _FmtxObject FmtxObject;
 typedef struct _FmtxObjectClass FmtxObjectClass;
+typedef struct _FmtxMpris FmtxMpris;
+
+/* A property value as the frontends see it. type is DBUS_TYPE_UINT32 or
+ * DBUS_TYPE_STRING; s is borrowed from the object or the caller. */
+typedef struct
+{
+  int type;
+  unsigned int u;
+  const char *s;
+} FmtxValue;
+
+typedef void (*FmtxPropertyFunc)(const char *name, const FmtxValue *value,
+                                 gpointer user_data);
 
+/* GLib and D-Bus adapter around the FmtxEngine */
 struct _FmtxObject
 {
   GObject parent;
-  DBusGConnection *dbus;
+  /* FMTX_OBJECT_PATH for the first transmitter */
+  gchar *path;
+  /* /system/fmtx, or /system/fmtx/radioN past the first transmitter */
+  gchar *gconf_dir;
+  DBusConnection *dbus;
   GConfClient *gcclient;
-  int power_level;
-  int max_power_level;
-  int frequency;
-  unsigned int freq_max;
-  unsigned int freq_min;
-  unsigned int freq_step;
-  char *state;
-  char *rds_ps;
-  char *rds_text;
-  gboolean offline;
-  gboolean hp_connected;
-  gboolean pa_running;
-  gboolean call_active;
-  int dev_radio;
-  gboolean mixer_inited;
-  snd_mixer_elem_t *mixer_elem;
-  int exit_timeout;
-  snd_mixer_t *snd_mixer;
+  FmtxEngine *engine;
+  FmtxStatusPage *status;
+  int status_fd;
   pa_context *context;
   pa_mainloop_api *api;
-  gboolean active;
-  int idle_timeout;
-  int pilot_timeout;
+  /* monitor source tap for the silence gate */
+  pa_stream *meter;
+  gboolean meter_wanted;
+  FmtxMpris *mpris;
 };
 
 struct _FmtxObjectClass
@@ -70,6 +61,7 @@ struct _FmtxObjectClass
   int changed;
   int error;
   int info;
+  int channel_migrated;
 };
 
 GType
@@ -78,16 +70,46 @@ gboolean
 emit_changed(gpointer obj);
 gboolean
 emit_info(gpointer obj);
+gboolean
+fmtx_object_is_primary(FmtxObject *obj);
+/* Releases the hardware and the bus, the object is unusable afterwards */
+void
+fmtx_object_close(FmtxObject *obj);
+void
+fmtx_object_call_begin(FmtxObject *obj);
+void
+fmtx_object_call_end(FmtxObject *obj);
+gboolean
+fmtx_object_get_property(FmtxObject *obj, const char *name, FmtxValue *value,
+                         GError **error);
+gboolean
+fmtx_object_set_property(FmtxObject *obj, const char *name,
+                         const FmtxValue *value, GError **error);
+void
+fmtx_object_foreach_property(FmtxObject *obj, FmtxPropertyFunc func,
+                             gpointer user_data);
+/* ScanChannels for the frontends, see fmtx_engine_scan(). cb may run
+ * before this returns, it is never run when this fails. */
+gboolean
+fmtx_object_scan(FmtxObject *obj, guint max_age, guint count,
+                 FmtxScanFunc cb, gpointer data, GError **error);
+/* SavePreset, DeletePreset and ApplyPreset for the frontends. Presets are
+ * kept in gconf under presets/<name>. */
+gboolean
+fmtx_object_preset_save(FmtxObject *obj, const char *name, guint frequency,
+                        guint power_level, guint preemphasis,
+                        const char *rds_ps, const char *rds_text,
+                        GError **error);
+gboolean
+fmtx_object_preset_delete(FmtxObject *obj, const char *name, GError **error);
+gboolean
+fmtx_object_preset_apply(FmtxObject *obj, const char *name, GError **error);
+/* Once the engine has started and knows its limits */
 void
-exit_timeout_cb(FmtxObject *obj);
-int
-fmtx_enable(FmtxObject *fmtx, gboolean enable);
-int
-fmtx_set_frequency(FmtxObject *fmtx, unsigned int frequency);
-int
-fmtx_set_rds_station_name(FmtxObject *obj, const char *rds_ps);
-int
-fmtx_set_rds_text(FmtxObject *obj, const char *rds_text);
+fmtx_object_load_presets(FmtxObject *obj);
+/* ReloadSchedule, after the presets are loaded */
+gboolean
+fmtx_object_schedule_reload(FmtxObject *obj, GError **error);
 
 void
 log_error(const char *msg, const char *reason, gboolean quit);
@@ -0,0 +1,134 @@
+# Generates the property dispatch table from the <property> elements of
+# fmtx-object.xml. Every property needs a fmtx_property_get_<name>() and,
+# if it is writable, a fmtx_property_set_<name>() in fmtx-object.c.
+#
+# Lookups use a perfect hash over the name: h = (h * seed + c) % size for
+# each byte. The smallest size and seed without collisions are searched
+# here, so a lookup is one hash plus one strcmp.
+
+BEGIN {
+  for (i = 32; i < 127; i++)
+    ord[sprintf("%c", i)] = i
+
+  n = 0
+  failed = 0
+}
+
+/<property / {
+  if (!match($0, /name="[^"]*"/))
+    next
+
+  name = substr($0, RSTART + 6, RLENGTH - 7)
+
+  match($0, /type="[^"]*"/)
+  type = substr($0, RSTART + 6, RLENGTH - 7)
+
+  match($0, /access="[^"]*"/)
+  access = substr($0, RSTART + 8, RLENGTH - 9)
+
+  if (access != "read" && access != "readwrite")
+  {
+    printf("property %s: unsupported access %s\n", name, access) > "/dev/stderr"
+    failed = 1
+    exit 1
+  }
+
+  if (type != "u" && type != "s")
+  {
+    printf("property %s: unsupported type %s\n", name, type) > "/dev/stderr"
+    failed = 1
+    exit 1
+  }
+
+  names[n] = name
+  types[n] = type
+  accesses[n] = access
+  n++
+}
+
+function hash(s, seed, size,    h, i)
+{
+  h = 0
+
+  for (i = 1; i <= length(s); i++)
+    h = (h * seed + ord[substr(s, i, 1)]) % size
+
+  return h
+}
+
+function try(seed, size,    i, h, used)
+{
+  for (i = 0; i < n; i++)
+  {
+    h = hash(names[i], seed, size)
+
+    if (h in used)
+      return 0
+
+    used[h] = i
+  }
+
+  for (i = 0; i < size; i++)
+    slots[i] = (i in used) ? used[i] : -1
+
+  return 1
+}
+
+END {
+  # exit in a rule still runs END
+  if (failed)
+    exit 1
+
+  if (!n)
+  {
+    print "no properties found" > "/dev/stderr"
+    exit 1
+  }
+
+  found = 0
+
+  for (size = n; size <= 8 * n && !found; size++)
+  {
+    for (seed = 1; seed < 256 && !found; seed++)
+    {
+      if (try(seed, size))
+        found = 1
+    }
+  }
+
+  if (!found)
+  {
+    print "no perfect hash found" > "/dev/stderr"
+    exit 1
+  }
+
+  size--
+  seed--
+
+  print "/* Generated from fmtx-object.xml by fmtx-properties.awk */"
+  print ""
+  printf("#define FMTX_PROPERTY_HASH_SEED %du\n", seed)
+  printf("#define FMTX_PROPERTY_HASH_SIZE %du\n", size)
+  print ""
+  print "static const FmtxProperty fmtx_object_properties[] ="
+  print "{"
+
+  for (i = 0; i < n; i++)
+  {
+    printf("  { \"%s\", %s, fmtx_property_get_%s,\n    %s }%s\n",
+           names[i], types[i] == "u" ? "DBUS_TYPE_UINT32" : "DBUS_TYPE_STRING",
+           names[i],
+           accesses[i] == "read" ? "NULL" : "fmtx_property_set_" names[i],
+           i < n - 1 ? "," : "")
+  }
+
+  print "};"
+  print ""
+  print "static const signed char fmtx_property_slots[FMTX_PROPERTY_HASH_SIZE] ="
+  print "{"
+
+  for (i = 0; i < size; i++)
+    printf("  %d%s\n", slots[i], i < size - 1 ? "," : "")
+
+  print "};"
+}
@@ -0,0 +1,881 @@
+#include <dbus/dbus.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FMTX_SERVICE "com.nokia.FMTx"
+#define FMTX_PATH "/com/nokia/fmtx/default"
+#define PROPERTIES_IF "org.freedesktop.DBus.Properties"
+#define SIM_PATH "/com/nokia/fmtx/sim"
+#define SIM_IF "com.nokia.FMTx.Sim"
+
+#define HAL_SERVICE "org.freedesktop.Hal"
+#define HAL_JACK_PATH \
+  "/org/freedesktop/Hal/devices/platform_soc_audio_logicaldev_input"
+#define HAL_DEVICE_IF "org.freedesktop.Hal.Device"
+
+/* Same value as MCE_SERVICE in mce/dbus-names.h */
+#define MCE_SERVICE "com.nokia.mce"
+
+#define SYSINFO_SERVICE "com.nokia.SystemInfo"
+
+#define CALL_TIMEOUT 5000
+
+struct bench
+{
+  const char *fmtxd;
+  const char *output;
+  const char *latency_us;
+  int iterations;
+  pid_t bus_pid;
+  pid_t fmtxd_pid;
+  char *address;
+  DBusConnection *client;
+  DBusConnection *service;
+  pthread_t service_thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int running;
+  int jack_connected;
+  unsigned int hal_calls;
+  unsigned char region;
+  FILE *out;
+  int first_scenario;
+};
+
+struct counters
+{
+  unsigned int write_attr;
+  unsigned int ioctl;
+};
+
+static struct bench bench;
+
+static void
+fatal(const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  fprintf(stderr, "fmtx_bench: ERROR: ");
+  vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+
+  if (bench.fmtxd_pid > 0)
+    kill(bench.fmtxd_pid, SIGTERM);
+
+  if (bench.bus_pid > 0)
+    kill(bench.bus_pid, SIGTERM);
+
+  exit(1);
+}
+
+static unsigned long long
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void
+start_bus(void)
+{
+  int fds[2];
+  char buf[256];
+  ssize_t len;
+
+  if (pipe(fds) == -1)
+    fatal("pipe: %s", strerror(errno));
+
+  bench.bus_pid = fork();
+
+  if (!bench.bus_pid)
+  {
+    char fd_arg[32];
+
+    close(fds[0]);
+    snprintf(fd_arg, sizeof(fd_arg), "--print-address=%d", fds[1]);
+    execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork", fd_arg,
+           NULL);
+    _exit(127);
+  }
+
+  close(fds[1]);
+  len = read(fds[0], buf, sizeof(buf) - 1);
+  close(fds[0]);
+
+  if (len <= 0)
+    fatal("Couldn't start a private dbus-daemon");
+
+  buf[len] = 0;
+  buf[strcspn(buf, "\n")] = 0;
+  bench.address = strdup(buf);
+}
+
+static DBusConnection *
+bus_connect(void)
+{
+  DBusConnection *conn;
+  DBusError error;
+
+  dbus_error_init(&error);
+  conn = dbus_connection_open_private(bench.address, &error);
+
+  if (!conn || !dbus_bus_register(conn, &error))
+    fatal("Couldn't connect to %s: %s", bench.address, error.message);
+
+  return conn;
+}
+
+static void
+reply_string(DBusConnection *conn, DBusMessage *msg, const char *s)
+{
+  DBusMessage *reply = dbus_message_new_method_return(msg);
+
+  dbus_message_append_args(reply, DBUS_TYPE_STRING, &s, DBUS_TYPE_INVALID);
+  dbus_connection_send(conn, reply, NULL);
+  dbus_message_unref(reply);
+}
+
+static DBusHandlerResult
+service_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+  DBusMessage *reply;
+
+  if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  if (dbus_message_has_member(msg, "GetConfigValue"))
+  {
+    const unsigned char *p = &bench.region;
+
+    reply = dbus_message_new_method_return(msg);
+    dbus_message_append_args(reply, DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE, &p, 1,
+                             DBUS_TYPE_INVALID);
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+  }
+  else if (dbus_message_has_member(msg, "GetPropertyString"))
+  {
+    const char *jack = "headphone";
+    const char **v = &jack;
+
+    reply = dbus_message_new_method_return(msg);
+
+    pthread_mutex_lock(&bench.lock);
+    dbus_message_append_args(reply, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &v,
+                             bench.jack_connected ? 1 : 0, DBUS_TYPE_INVALID);
+    bench.hal_calls++;
+    pthread_cond_broadcast(&bench.cond);
+    pthread_mutex_unlock(&bench.lock);
+
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+  }
+  else if (dbus_message_has_member(msg, "get_device_mode"))
+    reply_string(conn, msg, "normal");
+  else
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void *
+service_main(void *data)
+{
+  while (bench.running &&
+         dbus_connection_read_write_dispatch(bench.service, 100))
+    ;
+
+  return NULL;
+}
+
+static void
+start_services(void)
+{
+  static const char *const names[] =
+  {
+    HAL_SERVICE,
+    MCE_SERVICE,
+    SYSINFO_SERVICE
+  };
+  DBusError error;
+  size_t i;
+
+  dbus_error_init(&error);
+  bench.service = bus_connect();
+
+  for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+  {
+    if (dbus_bus_request_name(bench.service, names[i],
+                              DBUS_NAME_FLAG_DO_NOT_QUEUE, &error) !=
+        DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+      fatal("Couldn't own %s", names[i]);
+  }
+
+  dbus_connection_add_filter(bench.service, service_filter, NULL, NULL);
+
+  bench.running = 1;
+  pthread_create(&bench.service_thread, NULL, service_main, NULL);
+}
+
+static void
+start_fmtxd(void)
+{
+  bench.fmtxd_pid = fork();
+
+  if (!bench.fmtxd_pid)
+  {
+    setenv("FMTXD_HW", "sim", 1);
+    setenv("FMTXD_SIM_LATENCY_US", bench.latency_us, 1);
+    setenv("DBUS_SYSTEM_BUS_ADDRESS", bench.address, 1);
+    setenv("DBUS_SESSION_BUS_ADDRESS", bench.address, 1);
+    execl(bench.fmtxd, bench.fmtxd, NULL);
+    _exit(127);
+  }
+}
+
+static DBusMessage *
+call(const char *path, const char *iface, const char *method, int first_type,
+     ...)
+{
+  DBusMessage *msg;
+  DBusMessage *reply;
+  DBusError error;
+  va_list ap;
+
+  msg = dbus_message_new_method_call(FMTX_SERVICE, path, iface, method);
+
+  va_start(ap, first_type);
+  dbus_message_append_args_valist(msg, first_type, ap);
+  va_end(ap);
+
+  dbus_error_init(&error);
+  reply = dbus_connection_send_with_reply_and_block(bench.client, msg,
+                                                    CALL_TIMEOUT, &error);
+  dbus_message_unref(msg);
+  dbus_error_free(&error);
+
+  return reply;
+}
+
+static DBusMessage *
+get_property(const char *property)
+{
+  const char *iface = PROPERTIES_IF;
+
+  return call(FMTX_PATH, PROPERTIES_IF, "Get",
+              DBUS_TYPE_STRING, &iface,
+              DBUS_TYPE_STRING, &property,
+              DBUS_TYPE_INVALID);
+}
+
+static unsigned int
+get_uint(const char *property)
+{
+  DBusMessage *reply = get_property(property);
+  DBusMessageIter iter;
+  DBusMessageIter var;
+  dbus_uint32_t u = 0;
+
+  if (!reply)
+    fatal("Get %s failed", property);
+
+  dbus_message_iter_init(reply, &iter);
+  dbus_message_iter_recurse(&iter, &var);
+
+  if (dbus_message_iter_get_arg_type(&var) == DBUS_TYPE_UINT32)
+    dbus_message_iter_get_basic(&var, &u);
+
+  dbus_message_unref(reply);
+
+  return u;
+}
+
+static int
+set_property(const char *property, int type, const void *val)
+{
+  DBusMessage *msg;
+  DBusMessage *reply;
+  DBusMessageIter iter;
+  DBusMessageIter var;
+  DBusError error;
+  const char *iface = PROPERTIES_IF;
+  char sig[2] = { (char)type, 0 };
+  int rv;
+
+  msg = dbus_message_new_method_call(FMTX_SERVICE, FMTX_PATH, PROPERTIES_IF,
+                                     "Set");
+  dbus_message_iter_init_append(msg, &iter);
+  dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &iface);
+  dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &property);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_VARIANT, sig, &var);
+  dbus_message_iter_append_basic(&var, type, val);
+  dbus_message_iter_close_container(&iter, &var);
+
+  dbus_error_init(&error);
+  reply = dbus_connection_send_with_reply_and_block(bench.client, msg,
+                                                    CALL_TIMEOUT, &error);
+  dbus_message_unref(msg);
+  rv = reply ? 0 : -1;
+
+  if (reply)
+    dbus_message_unref(reply);
+
+  dbus_error_free(&error);
+
+  return rv;
+}
+
+static int
+set_state(const char *state)
+{
+  return set_property("state", DBUS_TYPE_STRING, &state);
+}
+
+static void
+sim_call(const char *method, int first_type, ...)
+{
+  DBusMessage *msg;
+  DBusMessage *reply;
+  DBusError error;
+  va_list ap;
+
+  msg = dbus_message_new_method_call(FMTX_SERVICE, SIM_PATH, SIM_IF, method);
+
+  va_start(ap, first_type);
+  dbus_message_append_args_valist(msg, first_type, ap);
+  va_end(ap);
+
+  dbus_error_init(&error);
+  reply = dbus_connection_send_with_reply_and_block(bench.client, msg,
+                                                    CALL_TIMEOUT, &error);
+  dbus_message_unref(msg);
+
+  if (!reply)
+    fatal("%s.%s failed: %s", SIM_IF, method, error.message);
+
+  dbus_message_unref(reply);
+}
+
+static void
+get_counters(struct counters *c)
+{
+  DBusMessage *msg;
+  DBusMessage *reply;
+  DBusMessageIter iter;
+  DBusMessageIter dict;
+  DBusError error;
+
+  memset(c, 0, sizeof(*c));
+  msg = dbus_message_new_method_call(FMTX_SERVICE, SIM_PATH, SIM_IF,
+                                     "GetCounters");
+  dbus_error_init(&error);
+  reply = dbus_connection_send_with_reply_and_block(bench.client, msg,
+                                                    CALL_TIMEOUT, &error);
+  dbus_message_unref(msg);
+
+  if (!reply)
+    fatal("GetCounters failed: %s", error.message);
+
+  dbus_message_iter_init(reply, &iter);
+  dbus_message_iter_recurse(&iter, &dict);
+
+  while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY)
+  {
+    DBusMessageIter entry;
+    const char *key;
+    dbus_uint32_t val;
+
+    dbus_message_iter_recurse(&dict, &entry);
+    dbus_message_iter_get_basic(&entry, &key);
+    dbus_message_iter_next(&entry);
+    dbus_message_iter_get_basic(&entry, &val);
+
+    if (!strcmp(key, "write_attr"))
+      c->write_attr = val;
+    else if (!strcmp(key, "ioctl"))
+      c->ioctl = val;
+
+    dbus_message_iter_next(&dict);
+  }
+
+  dbus_message_unref(reply);
+}
+
+static int
+cmp_ull(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *)a;
+  unsigned long long y = *(const unsigned long long *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static unsigned long long
+percentile(const unsigned long long *v, int n, double p)
+{
+  int i = (int)(p * n + 0.999999) - 1;
+
+  if (i < 0)
+    i = 0;
+
+  if (i >= n)
+    i = n - 1;
+
+  return v[i];
+}
+
+static void
+report(const char *name, unsigned long long *samples, int n,
+       unsigned long long total_us, int errors)
+{
+  struct counters c;
+
+  get_counters(&c);
+  qsort(samples, n, sizeof(*samples), cmp_ull);
+
+  fprintf(bench.out,
+          "%s    \"%s\": {\"n\": %d, \"errors\": %d, \"total_us\": %llu, "
+          "\"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, "
+          "\"max_us\": %llu, \"hw_writes\": %u, \"hw_ioctls\": %u, "
+          "\"hw_writes_per_op\": %.2f}",
+          bench.first_scenario ? "" : ",\n", name, n, errors, total_us,
+          percentile(samples, n, 0.50), percentile(samples, n, 0.90),
+          percentile(samples, n, 0.99), samples[n - 1], c.write_attr, c.ioctl,
+          n ? (double)c.write_attr / n : 0.0);
+  bench.first_scenario = 0;
+
+  printf("%-16s n=%-5d p50=%6lluus p99=%6lluus max=%6lluus writes=%u "
+         "ioctls=%u errors=%d\n", name, n, percentile(samples, n, 0.50),
+         percentile(samples, n, 0.99), samples[n - 1], c.write_attr, c.ioctl,
+         errors);
+}
+
+static void
+begin_scenario(void)
+{
+  sim_call("ResetCounters", DBUS_TYPE_INVALID);
+}
+
+static void
+bench_get(unsigned long long *s, int n)
+{
+  unsigned long long start = now_us();
+  int errors = 0;
+  int i;
+
+  begin_scenario();
+
+  for (i = 0; i < n; i++)
+  {
+    unsigned long long t = now_us();
+    DBusMessage *reply = get_property("frequency");
+
+    s[i] = now_us() - t;
+
+    if (reply)
+      dbus_message_unref(reply);
+    else
+      errors++;
+  }
+
+  report("get", s, n, now_us() - start, errors);
+}
+
+static void
+bench_getall(unsigned long long *s, int n)
+{
+  const char *iface = PROPERTIES_IF;
+  unsigned long long start = now_us();
+  int errors = 0;
+  int i;
+
+  begin_scenario();
+
+  for (i = 0; i < n; i++)
+  {
+    unsigned long long t = now_us();
+    DBusMessage *reply = call(FMTX_PATH, PROPERTIES_IF, "GetAll",
+                              DBUS_TYPE_STRING, &iface, DBUS_TYPE_INVALID);
+
+    s[i] = now_us() - t;
+
+    if (reply)
+      dbus_message_unref(reply);
+    else
+      errors++;
+  }
+
+  report("getall", s, n, now_us() - start, errors);
+}
+
+static void
+bench_set(unsigned long long *s, int n)
+{
+  static const char *const names[] = { "Nokia", "fmtxd" };
+  unsigned long long start = now_us();
+  int errors = 0;
+  int i;
+
+  begin_scenario();
+
+  for (i = 0; i < n; i++)
+  {
+    unsigned long long t = now_us();
+
+    errors += set_property("rds_ps", DBUS_TYPE_STRING, &names[i & 1]) != 0;
+    s[i] = now_us() - t;
+  }
+
+  report("set", s, n, now_us() - start, errors);
+}
+
+static void
+bench_enable_disable(unsigned long long *s, int n)
+{
+  unsigned long long start = now_us();
+  int errors = 0;
+  int i;
+
+  begin_scenario();
+
+  for (i = 0; i < n; i++)
+  {
+    unsigned long long t = now_us();
+
+    errors += set_state("enabled") != 0;
+    errors += set_state("disabled") != 0;
+    s[i] = now_us() - t;
+  }
+
+  report("enable_disable", s, n, now_us() - start, errors);
+}
+
+static void
+bench_jack_storm(unsigned long long *s, int n)
+{
+  unsigned long long start;
+  unsigned int base;
+  struct timespec ts;
+  int errors = 0;
+  int i;
+
+  set_state("enabled");
+  begin_scenario();
+
+  pthread_mutex_lock(&bench.lock);
+  base = bench.hal_calls;
+  pthread_mutex_unlock(&bench.lock);
+
+  start = now_us();
+
+  for (i = 0; i < n; i++)
+  {
+    DBusMessage *sig;
+    const char *condition = "ButtonPressed";
+    const char *details = "connection";
+    unsigned long long t = now_us();
+
+    pthread_mutex_lock(&bench.lock);
+    bench.jack_connected = !(i & 1);
+    pthread_mutex_unlock(&bench.lock);
+
+    sig = dbus_message_new_signal(HAL_JACK_PATH, HAL_DEVICE_IF, "Condition");
+    dbus_message_append_args(sig, DBUS_TYPE_STRING, &condition,
+                             DBUS_TYPE_STRING, &details, DBUS_TYPE_INVALID);
+    dbus_connection_send(bench.service, sig, NULL);
+    dbus_connection_flush(bench.service);
+    dbus_message_unref(sig);
+
+    /* wait for fmtxd to query the jack state before flipping it again */
+    pthread_mutex_lock(&bench.lock);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += CALL_TIMEOUT / 1000;
+
+    while (bench.hal_calls < base + i + 1)
+    {
+      if (pthread_cond_timedwait(&bench.cond, &bench.lock, &ts) == ETIMEDOUT)
+      {
+        errors++;
+        break;
+      }
+    }
+
+    pthread_mutex_unlock(&bench.lock);
+    s[i] = now_us() - t;
+  }
+
+  pthread_mutex_lock(&bench.lock);
+  bench.jack_connected = 0;
+  pthread_mutex_unlock(&bench.lock);
+
+  report("jack_storm", s, n, now_us() - start, errors);
+  set_state("disabled");
+}
+
+static void
+bench_pa_storm(unsigned long long *s, int n)
+{
+  unsigned long long start;
+  int i;
+
+  set_state("enabled");
+  begin_scenario();
+  start = now_us();
+
+  for (i = 0; i < n; i++)
+  {
+    dbus_bool_t running = i & 1;
+    unsigned long long t = now_us();
+
+    sim_call("SetSinkState", DBUS_TYPE_BOOLEAN, &running, DBUS_TYPE_INVALID);
+    s[i] = now_us() - t;
+  }
+
+  report("pa_storm", s, n, now_us() - start, 0);
+
+  {
+    dbus_bool_t running = 1;
+
+    sim_call("SetSinkState", DBUS_TYPE_BOOLEAN, &running, DBUS_TYPE_INVALID);
+  }
+
+  set_state("disabled");
+}
+
+static void
+bench_rds_text(unsigned long long *s, int n)
+{
+  unsigned long long start;
+  int errors = 0;
+  int i;
+
+  set_state("enabled");
+  begin_scenario();
+  start = now_us();
+
+  for (i = 0; i < n; i++)
+  {
+    char text[64];
+    const char *p = text;
+    unsigned long long t = now_us();
+
+    snprintf(text, sizeof(text), "Artist %d - Title of track number %d",
+             i % 17, i);
+    errors += set_property("rds_text", DBUS_TYPE_STRING, &p) != 0;
+    s[i] = now_us() - t;
+  }
+
+  report("rds_text_stream", s, n, now_us() - start, errors);
+  set_state("disabled");
+}
+
+static void
+bench_freq_sweep(unsigned long long *s, int n)
+{
+  unsigned int freq_min = get_uint("freq_min");
+  unsigned int freq_max = get_uint("freq_max");
+  unsigned int freq_step = get_uint("freq_step");
+  unsigned long long start;
+  dbus_uint32_t f = freq_min;
+  int errors = 0;
+  int i;
+
+  if (!freq_step || freq_max < freq_min)
+    fatal("Invalid band %u-%u/%u", freq_min, freq_max, freq_step);
+
+  set_state("enabled");
+  begin_scenario();
+  start = now_us();
+
+  for (i = 0; i < n; i++)
+  {
+    unsigned long long t = now_us();
+
+    errors += set_property("frequency", DBUS_TYPE_UINT32, &f) != 0;
+    s[i] = now_us() - t;
+
+    f += freq_step;
+
+    if (f > freq_max)
+      f = freq_min;
+  }
+
+  report("freq_sweep", s, n, now_us() - start, errors);
+  set_state("disabled");
+}
+
+static unsigned long
+fmtxd_rss_kb(void)
+{
+  char path[64];
+  char line[128];
+  unsigned long rss = 0;
+  FILE *fp;
+
+  snprintf(path, sizeof(path), "/proc/%d/status", (int)bench.fmtxd_pid);
+  fp = fopen(path, "r");
+
+  if (!fp)
+    return 0;
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (sscanf(line, "VmRSS: %lu", &rss) == 1)
+      break;
+  }
+
+  fclose(fp);
+
+  return rss;
+}
+
+static void
+show_usage(void)
+{
+  printf("Usage: fmtx_bench [-d fmtxd] [-o output] [-n iterations] "
+         "[-l i2c latency us]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned long long *samples;
+  unsigned long long start;
+  unsigned long long cold_start;
+  DBusMessage *reply = NULL;
+  int opt;
+  int status;
+
+  bench.fmtxd = "./fmtxd";
+  bench.output = "fmtx_bench.json";
+  bench.latency_us = "300";
+  bench.iterations = 500;
+  bench.region = 2;
+  bench.first_scenario = 1;
+
+  while ((opt = getopt(argc, argv, "d:o:n:l:h")) != -1)
+  {
+    if (opt == 'd')
+      bench.fmtxd = optarg;
+    else if (opt == 'o')
+      bench.output = optarg;
+    else if (opt == 'n')
+      bench.iterations = strtol(optarg, NULL, 10);
+    else if (opt == 'l')
+      bench.latency_us = optarg;
+    else
+    {
+      show_usage();
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if (bench.iterations <= 0)
+    fatal("Invalid iteration count");
+
+  samples = calloc(bench.iterations, sizeof(*samples));
+  pthread_mutex_init(&bench.lock, NULL);
+  pthread_cond_init(&bench.cond, NULL);
+  dbus_threads_init_default();
+
+  start_bus();
+  start_services();
+  bench.client = bus_connect();
+
+  start = now_us();
+  start_fmtxd();
+
+  while (!reply)
+  {
+    if (waitpid(bench.fmtxd_pid, &status, WNOHANG) == bench.fmtxd_pid)
+    {
+      bench.fmtxd_pid = 0;
+      fatal("fmtxd exited during startup");
+    }
+
+    /* freq_max is only set once the region has been applied, which is the
+     * last step of fmtxd setup */
+    reply = get_property("freq_max");
+
+    if (reply)
+    {
+      DBusMessageIter iter;
+      DBusMessageIter var;
+      dbus_uint32_t u = 0;
+
+      dbus_message_iter_init(reply, &iter);
+      dbus_message_iter_recurse(&iter, &var);
+
+      if (dbus_message_iter_get_arg_type(&var) == DBUS_TYPE_UINT32)
+        dbus_message_iter_get_basic(&var, &u);
+
+      if (!u)
+      {
+        dbus_message_unref(reply);
+        reply = NULL;
+      }
+    }
+
+    if (!reply)
+    {
+      if (now_us() - start > CALL_TIMEOUT * 1000ULL)
+        fatal("fmtxd did not come up");
+
+      usleep(1000);
+    }
+  }
+
+  cold_start = now_us() - start;
+  dbus_message_unref(reply);
+
+  bench.out = fopen(bench.output, "w");
+
+  if (!bench.out)
+    fatal("Couldn't open %s: %s", bench.output, strerror(errno));
+
+  printf("%-16s %lluus\n", "cold_start", cold_start);
+  fprintf(bench.out,
+          "{\n  \"iterations\": %d,\n  \"i2c_latency_us\": %s,\n"
+          "  \"cold_start_us\": %llu,\n  \"rss_start_kb\": %lu,\n"
+          "  \"scenarios\": {\n", bench.iterations, bench.latency_us,
+          cold_start, fmtxd_rss_kb());
+
+  bench_get(samples, bench.iterations);
+  bench_getall(samples, bench.iterations);
+  bench_set(samples, bench.iterations);
+  bench_enable_disable(samples, bench.iterations);
+  bench_jack_storm(samples, bench.iterations);
+  bench_pa_storm(samples, bench.iterations);
+  bench_rds_text(samples, bench.iterations);
+  bench_freq_sweep(samples, bench.iterations);
+
+  fprintf(bench.out, "\n  },\n  \"rss_end_kb\": %lu\n}\n", fmtxd_rss_kb());
+  fclose(bench.out);
+
+  kill(bench.fmtxd_pid, SIGTERM);
+  waitpid(bench.fmtxd_pid, &status, 0);
+
+  bench.running = 0;
+  pthread_join(bench.service_thread, NULL);
+  dbus_connection_close(bench.service);
+  dbus_connection_close(bench.client);
+
+  kill(bench.bus_pid, SIGTERM);
+  waitpid(bench.bus_pid, &status, 0);
+  free(samples);
+
+  return 0;
+}
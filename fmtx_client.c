@@ -1,8 +1,118 @@
-#include <dbus/dbus-glib.h>
-#include <glib.h>
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "fmtxd.h"
+
+/* Noise measurements are reused for an hour */
+#define SCAN_MAX_AGE 3600
+
+struct load_options
+{
+  int connections;
+  double rate;
+  int duration;
+  int mix[3];
+};
+
+struct load_worker
+{
+  GThread *thread;
+  const struct load_options *opts;
+  int index;
+  GArray *latency;
+  guint errors;
+};
+
+enum
+{
+  LOAD_GET,
+  LOAD_SET,
+  LOAD_GETALL
+};
+
+struct watch
+{
+  GHashTable *last;
+};
+
+struct pending_set
+{
+  const char *property;
+  GValue value;
+  const char *err_detail;
+};
+
+struct batch;
+
+struct batch_cmd
+{
+  struct batch *batch;
+  gchar *property;
+  gboolean is_set;
+  gchar *result;
+  gchar *error;
+  gboolean done;
+};
+
+struct batch
+{
+  FmtxClient *client;
+  GMainLoop *loop;
+  GPtrArray *cmds;
+  guint head;
+  guint pending;
+  guint errors;
+  gboolean eof;
+};
+
+static const char *const properties[] =
+{
+  "version",
+  "frequency",
+  "freq_max",
+  "freq_min",
+  "freq_step",
+  "state",
+  "startable",
+  "rds_ps",
+  "rds_text",
+  "rds_rotation",
+  "rds_rotation_dwell",
+  "rds_ps_text",
+  "rds_ps_mode",
+  "rds_ps_dwell",
+  "rds_jitter",
+  "rds_pi",
+  "rds_pty",
+  "rds_tp",
+  "rds_ta",
+  "rds_ct",
+  "mpris_rt_template",
+  "mpris_ps_template",
+  "monitor_interval",
+  "monitor_threshold",
+  "monitor_alternates",
+  "audio_level",
+  "audio_peak",
+  "silence_timeout",
+  "silence_threshold",
+  "silence_action",
+  "silence_gated",
+  "governor_level",
+  "governor_reason",
+  "governor_battery",
+  "governor_thermal",
+  "power_level",
+  "power_points",
+  "presets",
+  "schedule",
+  "schedule_active",
+  "schedule_next"
+};
+
 static void
 print_error(const char *err_msg, const char *err_detail, gboolean quit)
 {
@@ -12,27 +122,517 @@ print_error(const char *err_msg, const char *err_detail, gboolean quit)
     exit(1);
 }
 
-static void
-set_property_value(DBusGProxy *proxy,
+static gboolean
+set_property_value(FmtxClient *client,
                    const char *property,
                    GValue *value,
                    const char *err_detail)
 {
   GError *error = NULL;
 
-  dbus_g_proxy_call(proxy, "Set", &error,
-                    G_TYPE_STRING, "org.freedesktop.DBus.Properties",
-                    G_TYPE_STRING, property,
-                    G_TYPE_VALUE, value,
-                    G_TYPE_INVALID, G_TYPE_INVALID);
+  fmtx_client_set_property(client, property, value, &error);
+  g_value_unset(value);
 
   if (error)
   {
-    print_error(error->message, err_detail, FALSE);
+    if (err_detail)
+      print_error(error->message, err_detail, FALSE);
+
     g_clear_error(&error);
+    return FALSE;
   }
 
-  g_value_unset(value);
+  return TRUE;
+}
+
+static struct pending_set *
+pending_set_add(GArray *sets, const char *property, GType type,
+                const char *err_detail)
+{
+  struct pending_set *set;
+
+  g_array_set_size(sets, sets->len + 1);
+  set = &g_array_index(sets, struct pending_set, sets->len - 1);
+  set->property = property;
+  set->err_detail = err_detail;
+  g_value_init(&set->value, type);
+
+  return set;
+}
+
+static gboolean
+get_property_value(FmtxClient *client,
+                   const char *property,
+                   GValue *value,
+                   const char *err_detail)
+{
+  GError *error = NULL;
+
+  fmtx_client_get_property(client, property, value, &error);
+
+  if (error)
+  {
+    if (err_detail)
+      print_error(err_detail, error->message, FALSE);
+
+    g_clear_error(&error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gpointer
+load_worker_run(gpointer data)
+{
+  struct load_worker *w = data;
+  const struct load_options *opts = w->opts;
+  int total = opts->mix[LOAD_GET] + opts->mix[LOAD_SET] + opts->mix[LOAD_GETALL];
+  gint64 interval = (gint64)(G_USEC_PER_SEC * opts->connections / opts->rate);
+  DBusGConnection *dbus;
+  FmtxClient *client;
+  GError *error = NULL;
+  gint64 start;
+  gint64 next;
+  guint n = 0;
+
+  dbus = dbus_g_bus_get_private(DBUS_BUS_SYSTEM, NULL, &error);
+
+  if (error)
+    print_error("Couldn't connect to the System bus", error->message, TRUE);
+
+  client = fmtx_client_new(dbus, FMTX_CLIENT_NO_CACHE, NULL);
+  start = g_get_monotonic_time();
+
+  /* spread the connections over the first interval */
+  next = start + interval * w->index / opts->connections;
+
+  while (next < start + (gint64)opts->duration * G_USEC_PER_SEC)
+  {
+    GValue value = { 0, };
+    GHashTable *properties = NULL;
+    gboolean ok;
+    gint64 t;
+    guint64 us;
+    int op = n % total;
+
+    t = g_get_monotonic_time();
+
+    if (next > t)
+      g_usleep(next - t);
+
+    if (op < opts->mix[LOAD_GET])
+    {
+      ok = get_property_value(client, "frequency", &value, NULL);
+
+      if (ok)
+        g_value_unset(&value);
+    }
+    else if (op < opts->mix[LOAD_GET] + opts->mix[LOAD_SET])
+    {
+      g_value_init(&value, G_TYPE_STRING);
+      g_value_set_string(&value, n & 1 ? "fmtx_client" : "load test");
+      ok = set_property_value(client, "rds_text", &value, NULL);
+    }
+    else
+    {
+      ok = fmtx_client_get_all(client, &properties, NULL);
+
+      if (ok)
+        g_hash_table_destroy(properties);
+    }
+
+    /* latency is measured from the scheduled time, so a slow daemon
+     * cannot hide queueing delay by slowing the generator down */
+    us = g_get_monotonic_time() - next;
+    g_array_append_val(w->latency, us);
+
+    if (!ok)
+      w->errors++;
+
+    next += interval;
+    n++;
+  }
+
+  fmtx_client_free(client);
+  dbus_g_connection_unref(dbus);
+
+  return NULL;
+}
+
+static gint
+compare_latency(gconstpointer a, gconstpointer b)
+{
+  guint64 x = *(const guint64 *)a;
+  guint64 y = *(const guint64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static guint64
+latency_percentile(GArray *latency, double p)
+{
+  guint i = (guint)(p * latency->len);
+
+  if (i >= latency->len)
+    i = latency->len - 1;
+
+  return g_array_index(latency, guint64, i);
+}
+
+static void
+run_load(const struct load_options *opts)
+{
+  struct load_worker *workers;
+  GArray *latency;
+  guint errors = 0;
+  gint64 start;
+  double elapsed;
+  int i;
+
+  if (opts->connections <= 0 || opts->rate <= 0 || opts->duration <= 0 ||
+      opts->mix[LOAD_GET] + opts->mix[LOAD_SET] + opts->mix[LOAD_GETALL] <= 0)
+    print_error("Error in load parameters", "", TRUE);
+
+  workers = g_new0(struct load_worker, opts->connections);
+  latency = g_array_new(FALSE, FALSE, sizeof(guint64));
+  start = g_get_monotonic_time();
+
+  for (i = 0; i < opts->connections; i++)
+  {
+    workers[i].opts = opts;
+    workers[i].index = i;
+    workers[i].latency = g_array_new(FALSE, FALSE, sizeof(guint64));
+    workers[i].thread = g_thread_new("load", load_worker_run, &workers[i]);
+  }
+
+  for (i = 0; i < opts->connections; i++)
+  {
+    g_thread_join(workers[i].thread);
+    g_array_append_vals(latency, workers[i].latency->data,
+                        workers[i].latency->len);
+    errors += workers[i].errors;
+    g_array_free(workers[i].latency, TRUE);
+  }
+
+  elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+  g_free(workers);
+
+  if (!latency->len)
+    print_error("No requests completed", "", TRUE);
+
+  g_array_sort(latency, compare_latency);
+
+  g_print("connections=%d target=%.0f/s mix=%d:%d:%d\n"
+          "requests=%u errors=%u throughput=%.1f/s\n"
+          "latency p50=%" G_GUINT64_FORMAT "us p99=%" G_GUINT64_FORMAT
+          "us p999=%" G_GUINT64_FORMAT "us max=%" G_GUINT64_FORMAT "us\n",
+          opts->connections, opts->rate, opts->mix[LOAD_GET],
+          opts->mix[LOAD_SET], opts->mix[LOAD_GETALL],
+          latency->len, errors, latency->len / elapsed,
+          latency_percentile(latency, 0.50),
+          latency_percentile(latency, 0.99),
+          latency_percentile(latency, 0.999),
+          g_array_index(latency, guint64, latency->len - 1));
+
+  g_array_free(latency, TRUE);
+
+  if (errors)
+    exit(2);
+}
+
+static void
+watch_changed_cb(FmtxClient *client, gpointer data)
+{
+  struct watch *w = data;
+  size_t i;
+
+  for (i = 0; i < G_N_ELEMENTS(properties); i++)
+  {
+    const GValue *value = fmtx_client_get_cached(client, properties[i]);
+    gchar *s;
+
+    if (!value)
+      continue;
+
+    s = fmtx_client_value_to_string(value);
+
+    if (g_strcmp0(g_hash_table_lookup(w->last, properties[i]), s))
+    {
+      g_print("%s=%s\n", properties[i], s);
+      g_hash_table_replace(w->last, (gpointer)properties[i], s);
+    }
+    else
+      g_free(s);
+  }
+
+  fflush(stdout);
+}
+
+static void
+watch_error_cb(FmtxClient *client, const char *message, gpointer data)
+{
+  g_print("error=%s\n", message);
+  fflush(stdout);
+}
+
+static void
+run_watch(FmtxClient *client)
+{
+  struct watch w;
+
+  w.last = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+
+  fmtx_client_set_changed_callback(client, watch_changed_cb, &w);
+  fmtx_client_set_error_callback(client, watch_error_cb, &w);
+
+  watch_changed_cb(client, &w);
+  g_main_loop_run(g_main_loop_new(NULL, FALSE));
+}
+
+static void
+batch_flush(struct batch *b)
+{
+  while (b->head < b->cmds->len)
+  {
+    struct batch_cmd *cmd = g_ptr_array_index(b->cmds, b->head);
+
+    if (!cmd->done)
+      break;
+
+    if (cmd->error)
+      print_error(cmd->error, cmd->property ? cmd->property : "", FALSE);
+    else if (!cmd->is_set)
+      g_print("%s=%s\n", cmd->property, cmd->result);
+
+    g_free(cmd->property);
+    g_free(cmd->result);
+    g_free(cmd->error);
+    g_free(cmd);
+    b->head++;
+  }
+
+  fflush(stdout);
+
+  if (b->eof && !b->pending)
+    g_main_loop_quit(b->loop);
+}
+
+static void
+batch_done(struct batch_cmd *cmd, const GError *error)
+{
+  struct batch *b = cmd->batch;
+
+  if (error)
+  {
+    cmd->error = g_strdup(error->message);
+    b->errors++;
+  }
+
+  cmd->done = TRUE;
+  b->pending--;
+  batch_flush(b);
+}
+
+static void
+batch_get_cb(FmtxClient *client, const GValue *value, const GError *error,
+             gpointer data)
+{
+  struct batch_cmd *cmd = data;
+
+  if (value)
+    cmd->result = fmtx_client_value_to_string(value);
+
+  batch_done(cmd, error);
+}
+
+static void
+batch_set_cb(FmtxClient *client, const GError *error, gpointer data)
+{
+  batch_done(data, error);
+}
+
+static void
+batch_command(struct batch *b, gchar *line)
+{
+  struct batch_cmd *cmd;
+  gchar **argv;
+
+  g_strstrip(line);
+
+  if (!*line || *line == '#')
+    return;
+
+  argv = g_strsplit_set(line, " \t", 3);
+  cmd = g_new0(struct batch_cmd, 1);
+  cmd->batch = b;
+  cmd->property = g_strdup(argv[1]);
+  g_ptr_array_add(b->cmds, cmd);
+
+  if (argv[1] && g_str_equal(argv[0], "get"))
+  {
+    b->pending++;
+    fmtx_client_get_property_async(b->client, argv[1], batch_get_cb, cmd);
+  }
+  else if (argv[1] && argv[2] && g_str_equal(argv[0], "set"))
+  {
+    GValue value = { 0, };
+
+    cmd->is_set = TRUE;
+
+    if (fmtx_client_property_is_uint(argv[1]))
+    {
+      g_value_init(&value, G_TYPE_UINT);
+      g_value_set_uint(&value, strtoul(argv[2], NULL, 10));
+    }
+    else
+    {
+      g_value_init(&value, G_TYPE_STRING);
+      g_value_set_string(&value, argv[2]);
+    }
+
+    b->pending++;
+    fmtx_client_set_property_async(b->client, argv[1], &value, batch_set_cb,
+                                   cmd);
+    g_value_unset(&value);
+  }
+  else
+  {
+    cmd->error = g_strdup_printf("Invalid command '%s'", line);
+    cmd->done = TRUE;
+    b->errors++;
+  }
+
+  g_strfreev(argv);
+}
+
+static gboolean
+batch_input_cb(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+  struct batch *b = data;
+  gchar *line = NULL;
+  GIOStatus status;
+
+  status = g_io_channel_read_line(channel, &line, NULL, NULL, NULL);
+
+  if (status == G_IO_STATUS_NORMAL)
+  {
+    batch_command(b, line);
+    g_free(line);
+    batch_flush(b);
+    return TRUE;
+  }
+
+  if (status == G_IO_STATUS_AGAIN)
+    return TRUE;
+
+  b->eof = TRUE;
+  batch_flush(b);
+
+  return FALSE;
+}
+
+static int
+run_batch(FmtxClient *client)
+{
+  struct batch b = { client, NULL, NULL, 0, 0, 0, FALSE };
+  GIOChannel *channel;
+
+  b.loop = g_main_loop_new(NULL, FALSE);
+  b.cmds = g_ptr_array_new();
+
+  channel = g_io_channel_unix_new(STDIN_FILENO);
+  g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR, batch_input_cb, &b);
+
+  g_main_loop_run(b.loop);
+
+  g_io_channel_unref(channel);
+  g_ptr_array_free(b.cmds, TRUE);
+
+  return b.errors ? 1 : 0;
+}
+
+static int
+run_scan(FmtxClient *client, guint count)
+{
+  GArray *frequencies = NULL;
+  GArray *noise = NULL;
+  GError *error = NULL;
+  guint i;
+
+  if (!fmtx_client_scan_channels(client, SCAN_MAX_AGE, count, &frequencies,
+                                 &noise, &error))
+  {
+    print_error("Unable to scan channels", error->message, FALSE);
+    g_error_free(error);
+    return 1;
+  }
+
+  g_print("Quietest channels (kHz, noise in dBuV):\n");
+
+  for (i = 0; i < frequencies->len && i < noise->len; i++)
+    g_print("%u %d\n", g_array_index(frequencies, guint, i),
+            g_array_index(noise, gint, i));
+
+  g_array_free(frequencies, TRUE);
+  g_array_free(noise, TRUE);
+
+  return 0;
+}
+
+/* Saves what is on air now, at the CAL power limit and the region's
+ * preemphasis */
+static gboolean
+save_current_preset(FmtxClient *client, const char *name, GError **error)
+{
+  const GValue *frequency;
+  const GValue *rds_ps;
+  const GValue *rds_text;
+
+  if (!fmtx_client_refresh(client, error))
+    return FALSE;
+
+  frequency = fmtx_client_get_cached(client, "frequency");
+  rds_ps = fmtx_client_get_cached(client, "rds_ps");
+  rds_text = fmtx_client_get_cached(client, "rds_text");
+
+  if (!frequency || !rds_ps || !rds_text)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Settings not available");
+    return FALSE;
+  }
+
+  return fmtx_client_save_preset(client, name, g_value_get_uint(frequency),
+                                 0, 0, g_value_get_string(rds_ps),
+                                 g_value_get_string(rds_text), error);
+}
+
+/* The presets, or the schedule for R */
+static int
+run_device_call(FmtxClient *client, int opt, const char *name)
+{
+  GError *error = NULL;
+  gboolean rv;
+
+  if (opt == 'R')
+    rv = fmtx_client_reload_schedule(client, &error);
+  else if (opt == 'a')
+    rv = fmtx_client_apply_preset(client, name, &error);
+  else if (opt == 'S')
+    rv = save_current_preset(client, name, &error);
+  else
+    rv = fmtx_client_delete_preset(client, name, &error);
+
+  if (!rv)
+  {
+    print_error(opt == 'R' ? "Unable to reload the schedule" :
+                "Unable to use preset", error->message, FALSE);
+    g_error_free(error);
+    return 1;
+  }
+
+  return 0;
 }
 
 static void
@@ -43,130 +643,181 @@ show_usage()
           "-f<uint>\tSet frequency (in kHz)\n"
           "-s<string>\tSet RDS station name\n"
           "-t<string>\tSet RDS info text\n"
-          "-p<uint>\tTurn fmtx on (1) or off (0)\n\n");
+          "-p<uint>\tTurn fmtx on (1) or off (0)\n"
+          "-n<uint>\tList the quietest channels, all for 0\n"
+          "-a<name>\tApply a preset\n"
+          "-S<name>\tSave the current settings as a preset\n"
+          "-D<name>\tDelete a preset\n"
+          "-R\t\tReload the schedule\n"
+          "-L\t\tRun a load test instead, tuned with:\n"
+          "-c<uint>\t  Number of concurrent connections (default 4)\n"
+          "-r<uint>\t  Target request rate per second (default 200)\n"
+          "-d<uint>\t  Duration in seconds (default 10)\n"
+          "-m<g:s:a>\t  Get:Set:GetAll weights (default 8:1:1)\n"
+          "-w, --watch\tPrint changed settings until interrupted\n"
+          "-b, --batch\tRead 'get <name>' and 'set <name> <value>' lines "
+          "from stdin\n"
+          "-h, --help\tShow this help\n\n");
 }
 
 int
 main(int argc, char **argv)
 {
   DBusGConnection *dbus;
+  FmtxClient *client;
   int opt;
   size_t i;
-  DBusGProxy *proxy;
-
-  const char *const properties[] =
-  {
-    "version",
-    "frequency",
-    "freq_max",
-    "freq_min",
-    "freq_step",
-    "state",
-    "startable",
-    "rds_ps",
-    "rds_text"
+
+  static const struct option long_options[] =
+  {
+    { "watch", no_argument, NULL, 'w' },
+    { "batch", no_argument, NULL, 'b' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
   };
 
-  GValue value = { 0, };
+  struct load_options load = { 4, 200, 10, { 8, 1, 1 } };
+  gboolean load_test = FALSE;
+  gboolean watch = FALSE;
+  gboolean batch = FALSE;
+  gint scan = -1;
+  gint call_opt = 0;
+  const gchar *call_arg = NULL;
+  GArray *sets = g_array_new(FALSE, TRUE, sizeof(struct pending_set));
+  struct pending_set *set;
   GError *error = NULL;
 
-  show_usage();
-
-  dbus = dbus_g_bus_get(DBUS_BUS_SYSTEM, &error);
-
-  if (error)
-    print_error("Couldn't connect to the System bus", error->message, TRUE);
-
-  proxy = dbus_g_proxy_new_for_name(dbus,
-                                    "com.nokia.FMTx",
-                                    "/com/nokia/fmtx/default",
-                                    "org.freedesktop.DBus.Properties");
-
-  if (!proxy)
-    print_error("Couldn't create the proxy object",
-                "Unknown(dbus_g_proxy_new_for_name)",
-                TRUE);
-
   while (1)
   {
-    opt = getopt(argc, argv, "f:s:t:p:");
+    opt = getopt_long(argc, argv, "f:s:t:p:n:a:S:D:RLc:r:d:m:wbh", long_options,
+                      NULL);
 
     if (opt == -1)
       break;
 
     if (opt == 'p')
     {
-      g_value_init(&value, G_TYPE_STRING);
+      set = pending_set_add(sets, "state", G_TYPE_STRING,
+                            "Unable to set FmTx state");
 
       if (*optarg == '1')
-        g_value_set_string(&value, "enabled");
+        g_value_set_string(&set->value, "enabled");
       else
-        g_value_set_string(&value, "disabled");
-
-      set_property_value(proxy, "state", &value,
-                         "Unable to set FmTx state");
+        g_value_set_string(&set->value, "disabled");
     }
     else if (opt == 'f')
     {
-      g_value_init(&value, G_TYPE_UINT);
-      g_value_set_uint(&value, strtol(optarg, NULL, 10));
-      set_property_value(proxy, "frequency", &value,
-                         "Unable to set frequency");
+      set = pending_set_add(sets, "frequency", G_TYPE_UINT,
+                            "Unable to set frequency");
+      g_value_set_uint(&set->value, strtol(optarg, NULL, 10));
     }
     else if (opt == 's')
     {
-      g_value_init(&value, G_TYPE_STRING);
-      g_value_set_string(&value, optarg);
-      set_property_value(proxy, "rds_ps", &value,
-                         "Unable to set RDS station name");
+      set = pending_set_add(sets, "rds_ps", G_TYPE_STRING,
+                            "Unable to set RDS station name");
+      g_value_set_string(&set->value, optarg);
     }
     else if (opt == 't')
     {
-      g_value_init(&value, G_TYPE_STRING);
-      g_value_set_string(&value, optarg);
-      set_property_value(proxy, "rds_text", &value,
-                         "Unable to set RDS info text");
+      set = pending_set_add(sets, "rds_text", G_TYPE_STRING,
+                            "Unable to set RDS info text");
+      g_value_set_string(&set->value, optarg);
+    }
+    else if (opt == 'n')
+      scan = strtol(optarg, NULL, 10);
+    else if (opt == 'a' || opt == 'S' || opt == 'D' || opt == 'R')
+    {
+      call_opt = opt;
+      call_arg = opt == 'R' ? "" : optarg;
+    }
+    else if (opt == 'L')
+      load_test = TRUE;
+    else if (opt == 'c')
+      load.connections = strtol(optarg, NULL, 10);
+    else if (opt == 'r')
+      load.rate = strtod(optarg, NULL);
+    else if (opt == 'd')
+      load.duration = strtol(optarg, NULL, 10);
+    else if (opt == 'm')
+    {
+      if (sscanf(optarg, "%d:%d:%d", &load.mix[LOAD_GET], &load.mix[LOAD_SET],
+                 &load.mix[LOAD_GETALL]) != 3)
+        print_error("Error in commandline arguments", optarg, TRUE);
+    }
+    else if (opt == 'w')
+      watch = TRUE;
+    else if (opt == 'b')
+      batch = TRUE;
+    else if (opt == 'h')
+    {
+      show_usage();
+      return 0;
     }
     else
+    {
+      show_usage();
       print_error("Error in commandline arguments", "", TRUE);
+    }
   }
 
-  g_print(
-    "Current settings (Frequencies in kHz):\n--------------------------------------\n");
+  dbus_g_thread_init();
 
-  for (i = 0; i < sizeof(properties) / sizeof(const char *); i++)
+  if (load_test)
   {
-    gchar *s = NULL;
+    run_load(&load);
+    return 0;
+  }
 
-    dbus_g_proxy_call(proxy, "Get", &error,
-                      G_TYPE_STRING, "org.freedesktop.DBus.Properties",
-                      G_TYPE_STRING, properties[i],
-                      G_TYPE_INVALID,
-                      G_TYPE_VALUE, &value,
-                      G_TYPE_INVALID);
+  dbus = dbus_g_bus_get(DBUS_BUS_SYSTEM, &error);
 
-    if (error)
-    {
-      print_error("Unable to get property", error->message, 0);
-      g_clear_error(&error);
-      continue;
-    }
+  if (error)
+    print_error("Couldn't connect to the System bus", error->message, TRUE);
 
-    if ((G_VALUE_TYPE(&value) == G_TYPE_STRING) ||
-        G_VALUE_HOLDS(&value, G_TYPE_STRING))
-      s = g_strdup(g_value_get_string(&value));
+  client = fmtx_client_new(dbus, watch ? 0 : FMTX_CLIENT_NO_CACHE, &error);
 
-    if ((G_VALUE_TYPE(&value) == G_TYPE_UINT) ||
-        G_VALUE_HOLDS(&value, G_TYPE_UINT))
-    {
-      s = (gchar *)g_malloc(10);
-      g_snprintf(s, 10, "%i", g_value_get_uint(&value));
-    }
+  if (!client)
+    print_error("Couldn't connect to fmtxd", error->message, TRUE);
 
+  for (i = 0; i < sets->len; i++)
+  {
+    set = &g_array_index(sets, struct pending_set, i);
+    set_property_value(client, set->property, &set->value, set->err_detail);
+  }
+
+  g_array_free(sets, TRUE);
+
+  if (call_arg)
+    return run_device_call(client, call_opt, call_arg);
+
+  if (scan >= 0)
+    return run_scan(client, scan);
+
+  if (batch)
+    return run_batch(client);
+
+  if (watch)
+    run_watch(client);
+
+  g_print(
+    "Current settings (Frequencies in kHz):\n--------------------------------------\n");
+
+  if (!fmtx_client_refresh(client, &error))
+    print_error("Unable to get properties", error->message, TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS(properties); i++)
+  {
+    const GValue *v = fmtx_client_get_cached(client, properties[i]);
+    gchar *s;
+
+    if (!v)
+      continue;
+
+    s = fmtx_client_value_to_string(v);
     g_print("%s=%s\n", properties[i], s);
-    g_value_unset(&value);
     g_free(s);
   }
 
+  fmtx_client_free(client);
+
   return 0;
 }
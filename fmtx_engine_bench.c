@@ -0,0 +1,143 @@
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "engine.h"
+
+/* Microbenchmark for the engine alone, on the simulated hardware with no
+ * bus latency unless FMTXD_SIM_LATENCY_US says otherwise. Reports the cost
+ * of each input including the worker round trip and the heap growth over
+ * the measured loop, which should be zero. */
+
+#define DEFAULT_ITERATIONS 100000
+
+static int started;
+
+static void
+bench_started(void *data)
+{
+  started = 1;
+}
+
+static const FmtxEngineOps bench_ops =
+{
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  bench_started,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+static long long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+report(const char *name, long long start, int n, size_t heap_before)
+{
+  struct mallinfo2 mi = mallinfo2();
+
+  printf("%-14s %8.1f ns/op  heap %+zd bytes\n", name,
+         (double)(now_ns() - start) / n,
+         (ssize_t)(mi.uordblks - heap_before));
+}
+
+int
+main(int argc, char **argv)
+{
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  FmtxEngine *engine;
+  FmtxHw *hw;
+  long long start;
+  size_t heap;
+  int i;
+
+  setenv("FMTXD_HW", "sim", 0);
+  setenv("FMTXD_SIM_LATENCY_US", "0", 0);
+  setenv("FMTXD_SIM_BYTE_US", "0", 0);
+
+  hw = fmtx_hw_new();
+  engine = hw ? fmtx_engine_new(hw, &bench_ops, NULL) : NULL;
+
+  if (!engine || fmtx_engine_open(engine) != 2)
+  {
+    fprintf(stderr, "fmtx_engine_bench: could not start the engine\n");
+    return 1;
+  }
+
+  fmtx_engine_set_region(engine, 2, 88100);
+
+  while (!started)
+    fmtx_engine_flush(engine);
+
+  /* warm up, the first enable opens the mixer */
+  fmtx_engine_set_enabled(engine, 1);
+  fmtx_engine_set_enabled(engine, 0);
+  fmtx_engine_flush(engine);
+
+  heap = mallinfo2().uordblks;
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+    fmtx_engine_set_frequency(engine, 88100 + (i % 100) * 100);
+
+  fmtx_engine_flush(engine);
+  report("set_frequency", start, n, heap);
+
+  heap = mallinfo2().uordblks;
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+    fmtx_engine_set_enabled(engine, !(i & 1));
+
+  fmtx_engine_flush(engine);
+  report("set_enabled", start, n, heap);
+
+  heap = mallinfo2().uordblks;
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+    fmtx_engine_set_rds_text(engine, i & 1 ? "Now playing" : "Up next");
+
+  fmtx_engine_flush(engine);
+  report("set_rds_text", start, n, heap);
+
+  heap = mallinfo2().uordblks;
+  start = now_ns();
+
+  /* players resend their metadata, the text is only encoded once */
+  for (i = 0; i < n; i++)
+    fmtx_engine_set_rds_text(engine, "Motörhead – Ace of Spades");
+
+  fmtx_engine_flush(engine);
+  report("same_rds_text", start, n, heap);
+
+  heap = mallinfo2().uordblks;
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+  {
+    fmtx_engine_set_jack(engine, i & 1);
+    fmtx_engine_dispatch(engine);
+  }
+
+  fmtx_engine_flush(engine);
+  report("jack+dispatch", start, n, heap);
+
+  fmtx_engine_free(engine);
+  fmtx_hw_free(hw);
+
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "meter.h"
+
+/* Checks the vector meter against the plain C one, then measures how much
+ * CPU it takes per second of audio at the monitor stream's format, 48 kHz
+ * stereo in blocks of 20 ms. */
+
+#define RATE 48000
+#define CHANNELS 2
+#define BLOCK (RATE * CHANNELS / 50)
+#define DEFAULT_SECONDS 600
+
+static long long
+cpu_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int
+check(const int16_t *s, size_t n)
+{
+  uint64_t sum;
+  uint64_t ref_sum;
+  unsigned int peak;
+  unsigned int ref_peak;
+
+  fmtx_meter_accumulate(s, n, &sum, &peak);
+  fmtx_meter_accumulate_scalar(s, n, &ref_sum, &ref_peak);
+
+  if (sum != ref_sum || peak != ref_peak)
+  {
+    fprintf(stderr, "mismatch for %zu samples: %llu/%u, expected %llu/%u\n",
+            n, (unsigned long long)sum, peak, (unsigned long long)ref_sum,
+            ref_peak);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+validate(int16_t *buf)
+{
+  FmtxMeterLevel level;
+  size_t n;
+  size_t i;
+
+  for (i = 0; i < BLOCK; i++)
+    buf[i] = rand();
+
+  /* every length covers the vector loop, the tail and both together */
+  for (n = 0; n <= 64; n++)
+  {
+    if (check(buf, n) || check(buf + 1, n))
+      return 1;
+  }
+
+  if (check(buf, BLOCK))
+    return 1;
+
+  /* full scale either way must not overflow the pairwise sums */
+  for (i = 0; i < BLOCK; i++)
+    buf[i] = i & 1 ? INT16_MIN : INT16_MAX;
+
+  if (check(buf, BLOCK))
+    return 1;
+
+  for (i = 0; i < BLOCK; i++)
+    buf[i] = INT16_MIN;
+
+  if (check(buf, BLOCK) || check(buf, 13))
+    return 1;
+
+  fmtx_meter_block(buf, BLOCK, &level);
+
+  if (level.rms_db || level.peak_db)
+  {
+    fprintf(stderr, "full scale reads %u/%u dB\n", level.rms_db,
+            level.peak_db);
+    return 1;
+  }
+
+  memset(buf, 0, BLOCK * sizeof(buf[0]));
+  fmtx_meter_block(buf, BLOCK, &level);
+
+  if (level.rms_db != FMTX_METER_FLOOR_DB ||
+      level.peak_db != FMTX_METER_FLOOR_DB)
+  {
+    fprintf(stderr, "silence reads %u/%u dB\n", level.rms_db,
+            level.peak_db);
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+report(const char *name, long long start, int seconds)
+{
+  double ns = (double)(cpu_ns() - start) / seconds;
+
+  printf("%-10s %8.1f us CPU per second of audio  %6.3f%% of a core\n",
+         name, ns / 1e3, ns / 1e7);
+}
+
+int
+main(int argc, char **argv)
+{
+  int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+  int16_t *buf = malloc(BLOCK * sizeof(*buf));
+  FmtxMeterLevel level;
+  unsigned int sink = 0;
+  uint64_t sum;
+  unsigned int peak;
+  long long start;
+  int i;
+
+  if (!buf || validate(buf))
+    return 1;
+
+  printf("validated  vector sums match the scalar ones\n");
+
+  for (i = 0; i < BLOCK; i++)
+    buf[i] = (rand() % 2000) - 1000;
+
+  start = cpu_ns();
+
+  for (i = 0; i < seconds * 50; i++)
+  {
+    fmtx_meter_accumulate_scalar(buf, BLOCK, &sum, &peak);
+    sink ^= sum ^ peak;
+  }
+
+  report("scalar", start, seconds);
+
+  start = cpu_ns();
+
+  for (i = 0; i < seconds * 50; i++)
+  {
+    fmtx_meter_accumulate(buf, BLOCK, &sum, &peak);
+    sink ^= sum ^ peak;
+  }
+
+  report("vector", start, seconds);
+
+  start = cpu_ns();
+
+  for (i = 0; i < seconds * 50; i++)
+  {
+    fmtx_meter_block(buf, BLOCK, &level);
+    sink ^= level.rms_db;
+  }
+
+  report("block", start, seconds);
+
+  free(buf);
+
+  /* keeps the loops from being optimised away */
+  return sink == 0xffffffff;
+}
@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rds-charset.h"
+#include "rds-sched.h"
+
+/* Validates the RDS encoder against the bitwise syndrome for every
+ * information word and offset, then measures encoding throughput in groups
+ * per second. On air a group lasts 87.6 ms, about 11.4 groups/s.
+ *
+ * Text is measured on a corpus of "artist - title" lines, one per line of
+ * the file given as second argument or made up from names in many scripts:
+ * transcoding to the EBU set, the scheduler's set with RT+ tags and 11A
+ * encoding of the tags. */
+
+#define DEFAULT_GROUPS 10000000
+#define DEFAULT_TITLES 200000
+
+typedef struct
+{
+  char *text;
+  size_t len;
+  FmtxRdsTag tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_tags;
+} BenchTitle;
+
+static const char *const names[] =
+{
+  "Love", "Night", "Dancing", "Queen", "of the", "Motörhead", "Sigur Rós",
+  "Björk", "Beyoncé", "Łódź", "Dvořák", "Café", "Señorita", "Ελλάδα",
+  "Кино", "Группа крови", "Tiếng Việt", "“Quoted”", "—", "Straße",
+  "Œuvre", "€", "日本", "Part 2…", "Mañana", "Ærø", "Çà", "Žižek", "Ağır"
+};
+
+#define N_NAMES (sizeof(names) / sizeof(names[0]))
+
+static long long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+report(const char *name, long long start, int n, const char *unit)
+{
+  double s = (double)(now_ns() - start) / 1e9;
+
+  printf("%-12s %12.0f %ss/s  %6.1f ns/%s\n", name, n / s, unit,
+         s * 1e9 / n, unit);
+}
+
+static void
+add_title(BenchTitle *t, char *text)
+{
+  char *dash = strstr(text, " - ");
+
+  t->text = text;
+  t->len = strlen(text);
+  t->n_tags = 0;
+
+  if (dash && dash > text && dash[3])
+  {
+    t->tags[0].type = FMTX_RDS_RTPLUS_ARTIST;
+    t->tags[0].start = 0;
+    t->tags[0].len = dash - text;
+    t->tags[1].type = FMTX_RDS_RTPLUS_TITLE;
+    t->tags[1].start = dash + 3 - text;
+    t->tags[1].len = t->len - t->tags[1].start;
+    t->n_tags = 2;
+  }
+}
+
+/* One title per line, the lines are kept in buf */
+static int
+load_titles(const char *path, BenchTitle **titles, char **buf)
+{
+  FILE *f = fopen(path, "r");
+  long size;
+  char *p;
+  int n = 0;
+
+  if (!f || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0)
+    return -1;
+
+  rewind(f);
+  *buf = malloc(size + 1);
+  *titles = malloc(sizeof(**titles) * (size / 2 + 1));
+
+  if (fread(*buf, 1, size, f) != (size_t)size)
+    return -1;
+
+  fclose(f);
+  (*buf)[size] = 0;
+
+  for (p = strtok(*buf, "\n"); p; p = strtok(NULL, "\n"))
+    add_title(&(*titles)[n++], p);
+
+  return n;
+}
+
+/* Artists of one or two names and titles of two to five, drawn from a
+ * fixed seed so runs compare */
+static int
+make_titles(int n, BenchTitle **titles, char **buf)
+{
+  unsigned int seed = 1;
+  char *p;
+  int i;
+  int j;
+
+  *buf = malloc((size_t)n * 160);
+  *titles = malloc(sizeof(**titles) * n);
+  p = *buf;
+
+  for (i = 0; i < n; i++)
+  {
+    char *start = p;
+    int words = 2 + (seed >> 16) % 5;
+
+    for (j = 0; j <= words; j++)
+    {
+      seed = seed * 1103515245 + 12345;
+      p += sprintf(p, "%s%s", j == 0 ? "" : j == 1 + (words & 1) ? " - " : " ",
+                   names[(seed >> 16) % N_NAMES]);
+    }
+
+    *p++ = 0;
+    add_title(&(*titles)[i], start);
+  }
+
+  return n;
+}
+
+static int
+validate(void)
+{
+  FmtxRdsEncoder enc;
+  FmtxRdsGroup group;
+  uint8_t packed[FMTX_RDS_GROUP_BYTES];
+  uint32_t info;
+  int offset;
+  int i;
+
+  for (info = 0; info <= 0xffff; info++)
+  {
+    for (offset = 0; offset < FMTX_RDS_OFFSET_LAST; offset++)
+    {
+      if (fmtx_rds_syndrome(fmtx_rds_block(info, offset)) !=
+          fmtx_rds_offset_word(offset))
+      {
+        fprintf(stderr, "checkword mismatch for %04x offset %d\n", info,
+                offset);
+        return 1;
+      }
+    }
+  }
+
+  fmtx_rds_encoder_init(&enc, 0x6099);
+  fmtx_rds_set_ps(&enc, "Nokia", 5);
+  fmtx_rds_set_rt(&enc, "Now playing", 11);
+  fmtx_rds_set_ptyn(&enc, "Car", 3);
+
+  for (i = 0; i < 64; i++)
+  {
+    fmtx_rds_next_group(&enc, &group);
+
+    if (fmtx_rds_check_group(&group) != -1 || (group.block[0] >> 10) != 0x6099)
+    {
+      fprintf(stderr, "bad group %d\n", i);
+      return 1;
+    }
+  }
+
+  fmtx_rds_set_rtplus(&enc, NULL, 0);
+
+  for (i = 0; i < 64; i++)
+  {
+    if (fmtx_rds_next_group(&enc, &group) == FMTX_RDS_GROUP_3A &&
+        (group.block[3] >> 10) != FMTX_RDS_RTPLUS_AID)
+    {
+      fprintf(stderr, "bad 3A group\n");
+      return 1;
+    }
+  }
+
+  fmtx_rds_encode_4a(&enc, time(NULL), 0, &group);
+  fmtx_rds_pack(&group, packed);
+
+  /* the first 16 bits on air are the PI code */
+  if (fmtx_rds_check_group(&group) != -1 || packed[0] != 0x60 ||
+      packed[1] != 0x99)
+  {
+    fprintf(stderr, "bad 4A group\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+validate_charset(void)
+{
+  static const struct
+  {
+    const char *utf8;
+    const char *ebu;
+  } cases[] =
+  {
+    { "Motörhead – Ace of Spades…", "Mot\x97rhead - Ace of Spades..." },
+    { "Кино $5 €", "Kino \xab" "5 \xa9" },
+    { "Tiếng Việt", "Ti\x92ng Vi\x92t" },
+    { "e\xcc\x81t\xe9\t\xff", "et\x82 y" },
+    { "日本", "??" }
+  };
+  char buf[FMTX_RDS_RT_LEN];
+  unsigned int i;
+  size_t used;
+  size_t n;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    n = fmtx_rds_charset_encode(cases[i].utf8, strlen(cases[i].utf8), buf,
+                                sizeof(buf), &used);
+
+    if (n != strlen(cases[i].ebu) || memcmp(buf, cases[i].ebu, n) ||
+        used != strlen(cases[i].utf8))
+    {
+      fprintf(stderr, "bad transcoding of \"%s\"\n", cases[i].utf8);
+      return 1;
+    }
+  }
+
+  /* a transliteration is not split */
+  n = fmtx_rds_charset_encode("ab…", 5, buf, 4, &used);
+
+  if (n != 2 || used != 2)
+  {
+    fprintf(stderr, "transcoding split a transliteration\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_GROUPS;
+  FmtxRdsEncoder enc;
+  FmtxRdsGroup group;
+  FmtxRdsSched sched;
+  uint8_t packed[FMTX_RDS_GROUP_BYTES];
+  char buf[FMTX_RDS_RT_LEN];
+  BenchTitle *titles;
+  char *text;
+  unsigned int sink = 0;
+  long long start;
+  size_t bytes = 0;
+  size_t used;
+  int n_titles;
+  int i;
+
+  if (validate() || validate_charset())
+    return 1;
+
+  printf("checkwords   all 65536 words and 5 offsets verified\n");
+
+  fmtx_rds_encoder_init(&enc, 0x6099);
+  fmtx_rds_set_ps(&enc, "Nokia", 5);
+  fmtx_rds_set_rt(&enc, "Artist - A rather long title that fills the RT",
+                  47);
+
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+  {
+    fmtx_rds_next_group(&enc, &group);
+    sink ^= group.block[3];
+  }
+
+  report("next_group", start, n, "group");
+
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+  {
+    fmtx_rds_next_group(&enc, &group);
+    fmtx_rds_pack(&group, packed);
+    sink ^= packed[12];
+  }
+
+  report("+pack", start, n, "group");
+
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+  {
+    fmtx_rds_set_rt(&enc, i & 1 ? "Now playing" : "Up next", i & 1 ? 11 : 7);
+    fmtx_rds_encode_2a(&enc, 0, &group);
+    sink ^= group.block[2];
+  }
+
+  report("set_rt+2A", start, n, "group");
+
+  if (argc > 2)
+    n_titles = load_titles(argv[2], &titles, &text);
+  else
+    n_titles = make_titles(DEFAULT_TITLES, &titles, &text);
+
+  if (n_titles <= 0)
+  {
+    fprintf(stderr, "fmtx_rds_bench: no titles\n");
+    return 1;
+  }
+
+  start = now_ns();
+
+  for (i = 0; i < n_titles; i++)
+  {
+    sink ^= fmtx_rds_charset_encode(titles[i].text, titles[i].len, buf,
+                                    sizeof(buf), &used);
+    bytes += titles[i].len;
+  }
+
+  report("transcode", start, n_titles, "title");
+  printf("%-12s %12d titles, %.1f bytes of UTF-8 each\n", "", n_titles,
+         (double)bytes / n_titles);
+
+  fmtx_rds_sched_init(&sched);
+  start = now_ns();
+
+  for (i = 0; i < n_titles; i++)
+    sink ^= fmtx_rds_sched_set_static_rt(&sched, titles[i].text,
+                                         titles[i].tags, titles[i].n_tags);
+
+  report("set_rt+tags", start, n_titles, "title");
+
+  start = now_ns();
+
+  for (i = 0; i < n; i++)
+  {
+    sink ^= fmtx_rds_set_rtplus(&enc, i & 1 ? sched.rt_tags : NULL,
+                                i & 1 ? sched.n_rt_tags : 0);
+    fmtx_rds_encode_11a(&enc, &group);
+    sink ^= group.block[2];
+  }
+
+  report("rtplus+11A", start, n, "group");
+
+  free(titles);
+  free(text);
+
+  /* keeps the loops from being optimised away */
+  return sink == 0xffffffff;
+}
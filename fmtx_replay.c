@@ -0,0 +1,566 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine.h"
+
+/* Feeds logs written with FMTXD_INPUT_LOG into an engine on the simulated
+ * hardware and reports what reached the hardware and what each input cost.
+ * By default the inputs go in as fast as the engine takes them, waiting for
+ * the worker after each one, so the hardware traffic is the same on every
+ * run. With -r they keep their recorded spacing and timers, pilot toggling
+ * and silence gating play out as they did in the field. A corpus of field
+ * logs replayed this way is a regression test for the hardware traffic.
+ *
+ *   fmtx_replay [-r] LOG...
+ *   fmtx_replay -d LOG...      prints the inputs instead
+ *
+ * The sim latencies apply as usual, see hw-sim.c. Schedules replay against
+ * today's clock, so only a log of a whole week of slots replays exactly. */
+
+typedef struct
+{
+  unsigned int count;
+  long long total_ns;
+  long long max_ns;
+} InputCost;
+
+/* what a known input needs at least */
+static const struct
+{
+  unsigned char n_u;
+  unsigned char n_s;
+} input_shape[FMTX_INPUT_LAST] =
+{
+  [FMTX_INPUT_REGION] = { 2, 0 },
+  [FMTX_INPUT_ENABLED] = { 1, 0 },
+  [FMTX_INPUT_FREQUENCY] = { 1, 0 },
+  [FMTX_INPUT_RDS_PS] = { 0, 1 },
+  [FMTX_INPUT_RDS_TEXT] = { 0, 1 },
+  [FMTX_INPUT_RDS_ROTATION] = { 0, 1 },
+  [FMTX_INPUT_RDS_ROTATION_DWELL] = { 1, 0 },
+  [FMTX_INPUT_RDS_PS_TEXT] = { 0, 1 },
+  [FMTX_INPUT_RDS_PS_MODE] = { 0, 1 },
+  [FMTX_INPUT_RDS_PS_DWELL] = { 1, 0 },
+  [FMTX_INPUT_RDS_PI] = { 0, 1 },
+  [FMTX_INPUT_RDS_PTY] = { 1, 0 },
+  [FMTX_INPUT_RDS_TP] = { 1, 0 },
+  [FMTX_INPUT_RDS_TA] = { 1, 0 },
+  [FMTX_INPUT_RDS_CT] = { 1, 0 },
+  [FMTX_INPUT_SCAN] = { 2, 0 },
+  [FMTX_INPUT_MONITOR_INTERVAL] = { 1, 0 },
+  [FMTX_INPUT_MONITOR_THRESHOLD] = { 1, 0 },
+  [FMTX_INPUT_MONITOR_ALTERNATES] = { 1, 0 },
+  [FMTX_INPUT_SILENCE_TIMEOUT] = { 1, 0 },
+  [FMTX_INPUT_SILENCE_THRESHOLD] = { 1, 0 },
+  [FMTX_INPUT_SILENCE_ACTION] = { 0, 1 },
+  [FMTX_INPUT_AUDIO_LEVEL] = { 2, 0 },
+  [FMTX_INPUT_POWER_POINTS] = { 0, 1 },
+  [FMTX_INPUT_SAVE_PRESET] = { 3, 3 },
+  [FMTX_INPUT_DELETE_PRESET] = { 0, 1 },
+  [FMTX_INPUT_APPLY_PRESET] = { 0, 1 },
+  [FMTX_INPUT_LOAD_SCHEDULE] = { 0, 1 },
+  [FMTX_INPUT_GOVERNOR_BATTERY] = { 0, 1 },
+  [FMTX_INPUT_GOVERNOR_THERMAL] = { 0, 1 },
+  [FMTX_INPUT_OFFLINE] = { 1, 0 },
+  [FMTX_INPUT_CALL_ACTIVE] = { 1, 0 },
+  [FMTX_INPUT_JACK] = { 1, 0 },
+  [FMTX_INPUT_SINK_RUNNING] = { 1, 0 },
+  [FMTX_INPUT_MIXER] = { 1, 0 },
+  [FMTX_INPUT_CALL_BEGIN] = { 0, 0 },
+  [FMTX_INPUT_CALL_END] = { 0, 0 }
+};
+
+static const char *const op_names[FMTX_HW_OP_LAST] =
+{
+  "write_attr",
+  "ioctl",
+  "mixer",
+  "cal"
+};
+
+static const FmtxEngineOps replay_ops =
+{
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL
+};
+
+static char schedule_path[] = "/tmp/fmtx_replay.XXXXXX";
+static int schedule_fd = -1;
+
+static long long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static char *
+read_file(const char *path, size_t *len)
+{
+  struct stat st;
+  char *data;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+    return NULL;
+
+  if (fstat(fd, &st) || !(data = malloc(st.st_size + 1)))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  for (*len = 0; *len < (size_t)st.st_size; *len += n)
+  {
+    n = read(fd, data + *len, st.st_size - *len);
+
+    if (n < 0 && errno == EINTR)
+      n = 0;
+    else if (n <= 0)
+      break;
+  }
+
+  close(fd);
+
+  return data;
+}
+
+static void
+scan_done(void *data, const FmtxScanResult *results, unsigned int n)
+{
+}
+
+/* The engine reads schedules from a file only */
+static void
+load_schedule(FmtxEngine *engine, const char *text)
+{
+  size_t len = strlen(text);
+  unsigned int line;
+
+  if (schedule_fd == -1 && (schedule_fd = mkstemp(schedule_path)) == -1)
+    return;
+
+  if (ftruncate(schedule_fd, 0) ||
+      pwrite(schedule_fd, text, len, 0) != (ssize_t)len)
+    return;
+
+  fmtx_engine_set_schedule_path(engine, schedule_path);
+  fmtx_engine_load_schedule(engine, &line);
+}
+
+static void
+replay_input(FmtxEngine *engine, const FmtxInputEvent *ev)
+{
+  const unsigned int *u = ev->u;
+  const char *const *s = ev->s;
+  FmtxRdsTag tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  FmtxMeterLevel level;
+  FmtxPreset preset;
+  unsigned int i;
+
+  switch (ev->input)
+  {
+    case FMTX_INPUT_REGION:
+      fmtx_engine_set_region(engine, (int)u[0], u[1]);
+      break;
+    case FMTX_INPUT_ENABLED:
+      fmtx_engine_set_enabled(engine, u[0]);
+      break;
+    case FMTX_INPUT_FREQUENCY:
+      fmtx_engine_set_frequency(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_PS:
+      fmtx_engine_set_rds_ps(engine, s[0]);
+      break;
+    case FMTX_INPUT_RDS_TEXT:
+      for (i = 0; i < ev->n_u / 3 && i < FMTX_RDS_RTPLUS_MAX_TAGS; i++)
+      {
+        tags[i].type = u[3 * i];
+        tags[i].start = u[3 * i + 1];
+        tags[i].len = u[3 * i + 2];
+      }
+
+      fmtx_engine_set_rds_text_tagged(engine, s[0], tags, i);
+      break;
+    case FMTX_INPUT_RDS_ROTATION:
+      fmtx_engine_set_rds_rotation(engine, s[0]);
+      break;
+    case FMTX_INPUT_RDS_ROTATION_DWELL:
+      fmtx_engine_set_rds_rotation_dwell(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_PS_TEXT:
+      fmtx_engine_set_rds_ps_text(engine, s[0]);
+      break;
+    case FMTX_INPUT_RDS_PS_MODE:
+      fmtx_engine_set_rds_ps_mode(engine, s[0]);
+      break;
+    case FMTX_INPUT_RDS_PS_DWELL:
+      fmtx_engine_set_rds_ps_dwell(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_PI:
+      fmtx_engine_set_rds_pi(engine, s[0]);
+      break;
+    case FMTX_INPUT_RDS_PTY:
+      fmtx_engine_set_rds_pty(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_TP:
+      fmtx_engine_set_rds_tp(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_TA:
+      fmtx_engine_set_rds_ta(engine, u[0]);
+      break;
+    case FMTX_INPUT_RDS_CT:
+      fmtx_engine_set_rds_ct(engine, u[0]);
+      break;
+    case FMTX_INPUT_SCAN:
+      fmtx_engine_scan(engine, u[0], u[1], scan_done, NULL);
+      break;
+    case FMTX_INPUT_MONITOR_INTERVAL:
+      fmtx_engine_set_monitor_interval(engine, u[0]);
+      break;
+    case FMTX_INPUT_MONITOR_THRESHOLD:
+      fmtx_engine_set_monitor_threshold(engine, u[0]);
+      break;
+    case FMTX_INPUT_MONITOR_ALTERNATES:
+      fmtx_engine_set_monitor_alternates(engine, u[0]);
+      break;
+    case FMTX_INPUT_SILENCE_TIMEOUT:
+      fmtx_engine_set_silence_timeout(engine, u[0]);
+      break;
+    case FMTX_INPUT_SILENCE_THRESHOLD:
+      fmtx_engine_set_silence_threshold(engine, u[0]);
+      break;
+    case FMTX_INPUT_SILENCE_ACTION:
+      fmtx_engine_set_silence_action(engine, s[0]);
+      break;
+    case FMTX_INPUT_AUDIO_LEVEL:
+      level.rms_db = u[0];
+      level.peak_db = u[1];
+      fmtx_engine_set_audio_level(engine, &level);
+      break;
+    case FMTX_INPUT_POWER_POINTS:
+      fmtx_engine_set_power_points(engine, s[0]);
+      break;
+    case FMTX_INPUT_SAVE_PRESET:
+      memset(&preset, 0, sizeof(preset));
+      snprintf(preset.name, sizeof(preset.name), "%s", s[0]);
+      snprintf(preset.rds_ps, sizeof(preset.rds_ps), "%s", s[1]);
+      snprintf(preset.rds_text, sizeof(preset.rds_text), "%s", s[2]);
+      preset.frequency = u[0];
+      preset.power_level = u[1];
+      preset.preemphasis = u[2];
+      fmtx_engine_save_preset(engine, &preset);
+      break;
+    case FMTX_INPUT_DELETE_PRESET:
+      fmtx_engine_delete_preset(engine, s[0]);
+      break;
+    case FMTX_INPUT_APPLY_PRESET:
+      fmtx_engine_apply_preset(engine, s[0]);
+      break;
+    case FMTX_INPUT_LOAD_SCHEDULE:
+      load_schedule(engine, s[0]);
+      break;
+    case FMTX_INPUT_GOVERNOR_BATTERY:
+      fmtx_engine_set_governor_battery(engine, s[0]);
+      break;
+    case FMTX_INPUT_GOVERNOR_THERMAL:
+      fmtx_engine_set_governor_thermal(engine, s[0]);
+      break;
+    case FMTX_INPUT_OFFLINE:
+      fmtx_engine_set_offline(engine, u[0]);
+      break;
+    case FMTX_INPUT_CALL_ACTIVE:
+      fmtx_engine_set_call_active(engine, u[0]);
+      break;
+    case FMTX_INPUT_JACK:
+      fmtx_engine_set_jack(engine, u[0]);
+      break;
+    case FMTX_INPUT_SINK_RUNNING:
+      fmtx_engine_set_sink_running(engine, u[0]);
+      break;
+    case FMTX_INPUT_MIXER:
+      fmtx_hw_sim_set_mixer_function(engine->hw, u[0]);
+      fmtx_engine_check_mixer(engine);
+      break;
+    case FMTX_INPUT_CALL_BEGIN:
+      fmtx_engine_call_begin(engine);
+      break;
+    case FMTX_INPUT_CALL_END:
+      fmtx_engine_call_end(engine);
+      break;
+    default:
+      break;
+  }
+}
+
+static int
+known_input(const FmtxInputEvent *ev)
+{
+  return ev->input < FMTX_INPUT_LAST &&
+         ev->n_u >= input_shape[ev->input].n_u &&
+         ev->n_s >= input_shape[ev->input].n_s;
+}
+
+/* Keeps the engine's timers and the worker going until the deadline */
+static void
+wait_until(FmtxEngine *engine, long long deadline)
+{
+  struct pollfd pfd;
+  long long left;
+
+  pfd.fd = fmtx_engine_get_fd(engine);
+  pfd.events = POLLIN;
+
+  while ((left = deadline - now_ns()) > 0)
+  {
+    if (poll(&pfd, 1, (left + 999999) / 1000000) > 0)
+      fmtx_engine_dispatch(engine);
+  }
+
+  fmtx_engine_dispatch(engine);
+}
+
+static void
+print_string(const char *s)
+{
+  fputs(" \"", stdout);
+
+  for (; *s; s++)
+  {
+    if (*s == '\n')
+      fputs("\\n", stdout);
+    else if (*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else
+      putchar(*s);
+  }
+
+  putchar('"');
+}
+
+static void
+dump(const char *data, size_t len, size_t off)
+{
+  FmtxInputEvent ev;
+  unsigned int i;
+  int rv;
+
+  memset(&ev, 0, sizeof(ev));
+
+  while ((rv = fmtx_input_log_next(data, len, &off, &ev)) > 0)
+  {
+    printf("%12.6f %s", ev.time_us / 1e6, fmtx_input_name(ev.input));
+
+    for (i = 0; i < ev.n_u; i++)
+      printf(" %u", ev.u[i]);
+
+    for (i = 0; i < ev.n_s; i++)
+      print_string(ev.s[i]);
+
+    printf("\n");
+  }
+
+  if (rv < 0)
+    printf("corrupt at byte %zu\n", off);
+}
+
+static void
+report(const char *name, FmtxHw *hw, const InputCost *cost,
+       unsigned int n, unsigned int skipped, long long log_us,
+       long long wall_ns, long long worker_ns)
+{
+  char key[64];
+  unsigned int i;
+
+  printf("%s: %u inputs over %.1f s, replayed in %.3f s", name, n,
+         log_us / 1e6, wall_ns / 1e9);
+
+  if (worker_ns)
+    printf(", %.3f s of it waiting for the worker", worker_ns / 1e9);
+
+  printf("\n");
+
+  if (skipped)
+    printf("  %u unknown inputs skipped\n", skipped);
+
+  printf("  %-24s %8s %10s %10s\n", "input", "count", "mean us", "max us");
+
+  for (i = 0; i < FMTX_INPUT_LAST; i++)
+  {
+    if (cost[i].count)
+      printf("  %-24s %8u %10.1f %10.1f\n", fmtx_input_name(i),
+             cost[i].count, cost[i].total_ns / 1e3 / cost[i].count,
+             cost[i].max_ns / 1e3);
+  }
+
+  /* named like the sim's GetCounters */
+  for (i = 0; i < FMTX_HW_OP_LAST; i++)
+    printf("  %-24s %8u\n", op_names[i], hw->op_count[i]);
+
+  for (i = 0; i < FMTX_HW_ATTR_LAST; i++)
+  {
+    snprintf(key, sizeof(key), "attr:%s", fmtx_hw_attr_name(i));
+
+    if (hw->attr_writes[i])
+      printf("  %-24s %8u\n", key, hw->attr_writes[i]);
+  }
+}
+
+static int
+replay(const char *name, const char *data, size_t len, size_t off,
+       int realtime)
+{
+  const char *sysfs = getenv("FMTXD_SYSFS_CLASS");
+  InputCost cost[FMTX_INPUT_LAST];
+  unsigned int skipped = 0;
+  unsigned int n = 0;
+  long long worker_ns = 0;
+  long long start;
+  long long t;
+  FmtxInputEvent ev;
+  FmtxEngine *engine;
+  FmtxHw *hw;
+  int rv;
+
+  memset(cost, 0, sizeof(cost));
+  memset(&ev, 0, sizeof(ev));
+
+  hw = fmtx_hw_new();
+  engine = hw ? fmtx_engine_new(hw, &replay_ops, NULL) : NULL;
+
+  if (!engine || fmtx_engine_open(engine) != 2)
+  {
+    fprintf(stderr, "fmtx_replay: could not start the engine\n");
+    return 1;
+  }
+
+  /* the host's battery and temperature have nothing to do with the log */
+  fmtx_engine_set_sysfs_class(engine, sysfs ? sysfs : "/nonexistent");
+  start = now_ns();
+
+  while ((rv = fmtx_input_log_next(data, len, &off, &ev)) > 0)
+  {
+    if (!known_input(&ev))
+    {
+      skipped++;
+      continue;
+    }
+
+    if (realtime)
+      wait_until(engine, start + ev.time_us * 1000);
+    else
+      fmtx_engine_dispatch(engine);
+
+    t = now_ns();
+    replay_input(engine, &ev);
+    t = now_ns() - t;
+
+    cost[ev.input].count++;
+    cost[ev.input].total_ns += t;
+
+    if (t > cost[ev.input].max_ns)
+      cost[ev.input].max_ns = t;
+
+    n++;
+
+    if (!realtime)
+    {
+      t = now_ns();
+      fmtx_engine_flush(engine);
+      worker_ns += now_ns() - t;
+    }
+  }
+
+  if (rv < 0)
+    fprintf(stderr, "fmtx_replay: %s is corrupt at byte %zu\n", name, off);
+
+  fmtx_engine_flush(engine);
+  report(name, hw, cost, n, skipped, ev.time_us, now_ns() - start,
+         worker_ns);
+
+  fmtx_engine_free(engine);
+  fmtx_hw_free(hw);
+
+  return rv < 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  int realtime = 0;
+  int print = 0;
+  int failed = 0;
+  size_t len;
+  size_t off;
+  char *data;
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; i++)
+  {
+    if (!strcmp(argv[i], "-r"))
+      realtime = 1;
+    else if (!strcmp(argv[i], "-d"))
+      print = 1;
+    else
+      break;
+  }
+
+  if (i == argc)
+  {
+    fprintf(stderr, "usage: fmtx_replay [-r | -d] LOG...\n");
+    return 2;
+  }
+
+  setenv("FMTXD_HW", "sim", 0);
+  /* the mixer is as the log says, not up from the start */
+  setenv("FMTXD_SIM_MIXER_FUNCTION", "0", 1);
+
+  for (; i < argc; i++)
+  {
+    if (!(data = read_file(argv[i], &len)))
+    {
+      fprintf(stderr, "fmtx_replay: %s: %s\n", argv[i], strerror(errno));
+      failed = 1;
+      continue;
+    }
+
+    if (!(off = fmtx_input_log_start(data, len)))
+    {
+      fprintf(stderr, "fmtx_replay: %s is not an input log\n", argv[i]);
+      failed = 1;
+    }
+    else if (print)
+      dump(data, len, off);
+    else
+      failed |= replay(argv[i], data, len, off, realtime);
+
+    free(data);
+  }
+
+  if (schedule_fd != -1)
+  {
+    close(schedule_fd);
+    unlink(schedule_path);
+  }
+
+  return failed;
+}
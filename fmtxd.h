@@ -0,0 +1,213 @@
+#ifndef __FMTXD_CLIENT_H_INCLUDED__
+#define __FMTXD_CLIENT_H_INCLUDED__
+
+#include <dbus/dbus-glib.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define FMTX_SERVICE "com.nokia.FMTx"
+/* The first transmitter. Any further ones are FMTX_OBJECT_PATH_PREFIX
+ * followed by their device name, e.g. /com/nokia/fmtx/radio1. */
+#define FMTX_OBJECT_PATH "/com/nokia/fmtx/default"
+#define FMTX_OBJECT_PATH_PREFIX "/com/nokia/fmtx/"
+#define FMTX_DEVICE_INTERFACE "com.nokia.FMTx.Device"
+
+#define FMTX_STATUS_PATH "/run/fmtxd/status"
+#define FMTX_STATUS_MAGIC 0x53544d46u
+#define FMTX_STATUS_VERSION 1
+
+/* Layout of the status page fmtxd keeps mapped at FMTX_STATUS_PATH
+ * (overridable with FMTXD_STATUS_PATH), with ".radioN" appended for
+ * transmitters other than the first. seq is odd while the daemon is
+ * writing, so read it through fmtx_status_read() rather than directly. */
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 seq;
+  guint32 pid;
+  guint32 frequency;
+  guint32 freq_min;
+  guint32 freq_max;
+  guint32 freq_step;
+  char state[16];
+  char startable[32];
+  char rds_ps[16];
+  char rds_text[72];
+} FmtxStatusPage;
+
+typedef struct _FmtxClient FmtxClient;
+typedef struct _FmtxClientBatch FmtxClientBatch;
+typedef struct _FmtxStatus FmtxStatus;
+
+typedef enum
+{
+  /* Don't subscribe to Changed or fill the property cache, for clients
+   * that only issue calls and never run a main loop */
+  FMTX_CLIENT_NO_CACHE = 1 << 0
+} FmtxClientFlags;
+
+typedef void (*FmtxClientCallback)(FmtxClient *client,
+                                   const GError *error,
+                                   gpointer user_data);
+typedef void (*FmtxClientValueCallback)(FmtxClient *client,
+                                        const GValue *value,
+                                        const GError *error,
+                                        gpointer user_data);
+typedef void (*FmtxClientChangedCallback)(FmtxClient *client,
+                                          gpointer user_data);
+typedef void (*FmtxClientErrorCallback)(FmtxClient *client,
+                                        const char *message,
+                                        gpointer user_data);
+typedef void (*FmtxStatusCallback)(FmtxStatus *status, gpointer user_data);
+
+FmtxClient *
+fmtx_client_new(DBusGConnection *dbus, FmtxClientFlags flags, GError **error);
+void
+fmtx_client_free(FmtxClient *client);
+DBusGProxy *
+fmtx_client_get_proxy(FmtxClient *client);
+
+void
+fmtx_client_set_changed_callback(FmtxClient *client,
+                                 FmtxClientChangedCallback cb,
+                                 gpointer user_data);
+void
+fmtx_client_set_error_callback(FmtxClient *client,
+                               FmtxClientErrorCallback cb,
+                               gpointer user_data);
+
+/* Cached, never block. Kept fresh from the Changed signal. */
+guint
+fmtx_client_get_version(FmtxClient *client);
+guint
+fmtx_client_get_frequency(FmtxClient *client);
+guint
+fmtx_client_get_freq_min(FmtxClient *client);
+guint
+fmtx_client_get_freq_max(FmtxClient *client);
+guint
+fmtx_client_get_freq_step(FmtxClient *client);
+const char *
+fmtx_client_get_state(FmtxClient *client);
+const char *
+fmtx_client_get_startable(FmtxClient *client);
+const char *
+fmtx_client_get_rds_ps(FmtxClient *client);
+const char *
+fmtx_client_get_rds_text(FmtxClient *client);
+const GValue *
+fmtx_client_get_cached(FmtxClient *client, const char *property);
+
+/* Round trips to the daemon */
+gboolean
+fmtx_client_refresh(FmtxClient *client, GError **error);
+gboolean
+fmtx_client_get_property(FmtxClient *client, const char *property,
+                         GValue *value, GError **error);
+gboolean
+fmtx_client_get_all(FmtxClient *client, GHashTable **properties,
+                    GError **error);
+gboolean
+fmtx_client_set_property(FmtxClient *client, const char *property,
+                         const GValue *value, GError **error);
+/* Quietest channels first, with their noise in dBuV. Up to count of them,
+ * all if 0. Measurements younger than max_age seconds are reused, anything
+ * else takes a few seconds. */
+gboolean
+fmtx_client_scan_channels(FmtxClient *client, guint max_age, guint count,
+                          GArray **frequencies, GArray **noise,
+                          GError **error);
+/* power_level 0 is the CAL limit, preemphasis 0 the region's. The
+ * "presets" property lists the names. */
+gboolean
+fmtx_client_save_preset(FmtxClient *client, const char *name,
+                        guint frequency, guint power_level, guint preemphasis,
+                        const char *rds_ps, const char *rds_text,
+                        GError **error);
+gboolean
+fmtx_client_delete_preset(FmtxClient *client, const char *name,
+                          GError **error);
+/* Retunes and sets everything the preset has in one go */
+gboolean
+fmtx_client_apply_preset(FmtxClient *client, const char *name,
+                         GError **error);
+/* Reads the schedule file again, see the "schedule" property */
+gboolean
+fmtx_client_reload_schedule(FmtxClient *client, GError **error);
+void
+fmtx_client_get_property_async(FmtxClient *client, const char *property,
+                               FmtxClientValueCallback cb,
+                               gpointer user_data);
+void
+fmtx_client_set_property_async(FmtxClient *client, const char *property,
+                               const GValue *value, FmtxClientCallback cb,
+                               gpointer user_data);
+
+gboolean
+fmtx_client_set_frequency(FmtxClient *client, guint frequency,
+                          GError **error);
+gboolean
+fmtx_client_set_state(FmtxClient *client, const char *state, GError **error);
+gboolean
+fmtx_client_set_rds_ps(FmtxClient *client, const char *rds_ps,
+                       GError **error);
+gboolean
+fmtx_client_set_rds_text(FmtxClient *client, const char *rds_text,
+                         GError **error);
+
+void
+fmtx_client_set_frequency_async(FmtxClient *client, guint frequency,
+                                FmtxClientCallback cb, gpointer user_data);
+void
+fmtx_client_set_state_async(FmtxClient *client, const char *state,
+                            FmtxClientCallback cb, gpointer user_data);
+void
+fmtx_client_set_rds_ps_async(FmtxClient *client, const char *rds_ps,
+                             FmtxClientCallback cb, gpointer user_data);
+void
+fmtx_client_set_rds_text_async(FmtxClient *client, const char *rds_text,
+                               FmtxClientCallback cb, gpointer user_data);
+
+/* Queue several settings and send them pipelined. The callback runs once,
+ * after every Set has been answered, with the first error if any. */
+FmtxClientBatch *
+fmtx_client_batch_new(FmtxClient *client);
+void
+fmtx_client_batch_set_uint(FmtxClientBatch *batch, const char *property,
+                           guint value);
+void
+fmtx_client_batch_set_string(FmtxClientBatch *batch, const char *property,
+                             const char *value);
+void
+fmtx_client_batch_apply(FmtxClientBatch *batch, FmtxClientCallback cb,
+                        gpointer user_data);
+
+gboolean
+fmtx_client_property_is_uint(const char *property);
+gchar *
+fmtx_client_value_to_string(const GValue *value);
+
+/* Read-only view of the daemon state without any D-Bus traffic. read
+ * returns FALSE when fmtxd is not running or the page can't be trusted, in
+ * which case fall back to the D-Bus interface (which also starts fmtxd). */
+FmtxStatus *
+fmtx_status_open(const char *path, GError **error);
+void
+fmtx_status_close(FmtxStatus *status);
+gboolean
+fmtx_status_read(FmtxStatus *status, FmtxStatusPage *snapshot);
+
+/* The fd becomes readable whenever the page was updated and is drained by
+ * the next fmtx_status_read(). The callback variant watches it from the
+ * default main context. */
+int
+fmtx_status_get_fd(FmtxStatus *status);
+void
+fmtx_status_set_changed_callback(FmtxStatus *status, FmtxStatusCallback cb,
+                                 gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __FMTXD_CLIENT_H_INCLUDED__ */
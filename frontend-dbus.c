@@ -0,0 +1,687 @@
+#include <dbus/dbus-glib-lowlevel.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+#include <string.h>
+
+#include "events.h"
+#include "fmtx-object.h"
+#include "frontend.h"
+#include "sim-control.h"
+
+/* Plain libdbus frontend. Properties are read straight from the dispatch
+ * table into the message, and MCE, HAL and SystemInfo are only ever called
+ * asynchronously. dbus-glib is still used to hook the connection into the
+ * GLib main loop. */
+
+#define HAL_DEVICE_IF "org.freedesktop.Hal.Device"
+#define OHM_SERVICE "org.freedesktop.ohm"
+#define POLICY_IF "com.nokia.policy"
+
+static const char introspect_xml[] =
+#include "fmtx-object-introspect.h"
+;
+
+struct region_call
+{
+  FmtxObject *obj;
+  FrontendRegionCallback cb;
+};
+
+struct scan_call
+{
+  FmtxObject *obj;
+  DBusMessage *msg;
+};
+
+static const char *
+error_name(const GError *error)
+{
+  if (error->domain == DBUS_GERROR)
+  {
+    switch (error->code)
+    {
+      case DBUS_GERROR_INVALID_ARGS:
+        return DBUS_ERROR_INVALID_ARGS;
+      case DBUS_GERROR_ACCESS_DENIED:
+        return DBUS_ERROR_ACCESS_DENIED;
+      case DBUS_GERROR_UNKNOWN_METHOD:
+        return DBUS_ERROR_UNKNOWN_METHOD;
+      default:
+        break;
+    }
+  }
+
+  return DBUS_ERROR_FAILED;
+}
+
+static gboolean
+call_async(FmtxObject *obj, DBusMessage *msg,
+           DBusPendingCallNotifyFunction notify, void *data,
+           DBusFreeFunction free_data)
+{
+  DBusPendingCall *pending = NULL;
+  gboolean rv = FALSE;
+
+  if (dbus_connection_send_with_reply(obj->dbus, msg, &pending, -1) &&
+      pending)
+  {
+    dbus_pending_call_set_notify(pending, notify, data, free_data);
+    dbus_pending_call_unref(pending);
+    rv = TRUE;
+  }
+  else
+    log_error("Couldn't send D-Bus call", dbus_message_get_member(msg), 0);
+
+  dbus_message_unref(msg);
+
+  return rv;
+}
+
+static DBusMessage *
+steal_reply(DBusPendingCall *pending, const char *what)
+{
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+  if (reply && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+  {
+    log_error(what, dbus_message_get_error_name(reply), 0);
+    dbus_message_unref(reply);
+    reply = NULL;
+  }
+
+  return reply;
+}
+
+static void
+jack_state_cb(DBusPendingCall *pending, void *user_data)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter;
+  DBusMessageIter array;
+
+  reply = steal_reply(pending, "Unable to get headphone connector state");
+
+  if (!reply)
+    return;
+
+  if (dbus_message_iter_init(reply, &iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+  {
+    dbus_message_iter_recurse(&iter, &array);
+    fmtx_jack_changed(user_data, dbus_message_iter_get_arg_type(&array) !=
+                      DBUS_TYPE_INVALID);
+  }
+
+  dbus_message_unref(reply);
+}
+
+static void
+query_jack_state(FmtxObject *obj)
+{
+  const char *key = "input.jack.type";
+  DBusMessage *msg;
+
+  msg = dbus_message_new_method_call("org.freedesktop.Hal", FMTX_HAL_JACK_UDI,
+                                     HAL_DEVICE_IF, "GetPropertyString");
+  dbus_message_append_args(msg, DBUS_TYPE_STRING, &key, DBUS_TYPE_INVALID);
+  call_async(obj, msg, jack_state_cb, obj, NULL);
+}
+
+static void
+device_mode_cb(DBusPendingCall *pending, void *user_data)
+{
+  DBusMessage *reply = steal_reply(pending, "Unable to get device state");
+  const char *mode;
+
+  if (!reply)
+    return;
+
+  if (dbus_message_get_args(reply, NULL, DBUS_TYPE_STRING, &mode,
+                            DBUS_TYPE_INVALID))
+    fmtx_device_mode_changed(user_data, mode);
+
+  dbus_message_unref(reply);
+}
+
+static void
+query_device_mode(FmtxObject *obj)
+{
+  call_async(obj, dbus_message_new_method_call(MCE_SERVICE,
+                                               MCE_REQUEST_PATH,
+                                               MCE_REQUEST_IF,
+                                               MCE_DEVICE_MODE_GET),
+             device_mode_cb, obj, NULL);
+}
+
+static DBusHandlerResult
+bus_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+  FmtxObject *obj = user_data;
+  const char *s1;
+  const char *s2;
+
+  if (dbus_message_is_signal(msg, MCE_SIGNAL_IF, MCE_DEVICE_MODE_SIG))
+  {
+    if (dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &s1,
+                              DBUS_TYPE_INVALID))
+      fmtx_device_mode_changed(obj, s1);
+  }
+  else if (dbus_message_is_signal(msg, MCE_SIGNAL_IF, MCE_CALL_STATE_SIG))
+  {
+    if (dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &s1,
+                              DBUS_TYPE_STRING, &s2, DBUS_TYPE_INVALID))
+      fmtx_call_state_changed(obj, s1);
+  }
+  else if (dbus_message_is_signal(msg, HAL_DEVICE_IF, "Condition") &&
+           dbus_message_has_path(msg, FMTX_HAL_JACK_UDI))
+    query_jack_state(obj);
+  else if (dbus_message_is_signal(msg, DBUS_INTERFACE_DBUS,
+                                  "NameOwnerChanged"))
+  {
+    if (dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &s1,
+                              DBUS_TYPE_INVALID) &&
+        g_str_equal(s1, OHM_SERVICE))
+      emit_info(obj);
+  }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+append_value(DBusMessageIter *iter, const FmtxValue *value)
+{
+  char sig[2] = { value->type, 0 };
+  DBusMessageIter var;
+
+  dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, sig, &var);
+
+  if (value->type == DBUS_TYPE_UINT32)
+    dbus_message_iter_append_basic(&var, DBUS_TYPE_UINT32, &value->u);
+  else
+    dbus_message_iter_append_basic(&var, DBUS_TYPE_STRING, &value->s);
+
+  dbus_message_iter_close_container(iter, &var);
+}
+
+static DBusMessage *
+property_get(FmtxObject *obj, DBusMessage *msg, GError **error)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter;
+  const char *iname;
+  const char *pname;
+  FmtxValue value;
+
+  if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &iname,
+                             DBUS_TYPE_STRING, &pname, DBUS_TYPE_INVALID))
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Expected interface and property name");
+    return NULL;
+  }
+
+  if (!fmtx_object_get_property(obj, pname, &value, error))
+    return NULL;
+
+  reply = dbus_message_new_method_return(msg);
+  dbus_message_iter_init_append(reply, &iter);
+  append_value(&iter, &value);
+
+  return reply;
+}
+
+static DBusMessage *
+property_set(FmtxObject *obj, DBusMessage *msg, GError **error)
+{
+  DBusMessageIter iter;
+  DBusMessageIter var;
+  const char *pname;
+  FmtxValue value = { 0, };
+
+  if (!dbus_message_has_signature(msg, "ssv"))
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Expected interface, property name and value");
+    return NULL;
+  }
+
+  dbus_message_iter_init(msg, &iter);
+  dbus_message_iter_next(&iter);
+  dbus_message_iter_get_basic(&iter, &pname);
+  dbus_message_iter_next(&iter);
+  dbus_message_iter_recurse(&iter, &var);
+
+  value.type = dbus_message_iter_get_arg_type(&var);
+
+  if (value.type == DBUS_TYPE_UINT32)
+    dbus_message_iter_get_basic(&var, &value.u);
+  else if (value.type == DBUS_TYPE_STRING)
+    dbus_message_iter_get_basic(&var, &value.s);
+
+  if (!fmtx_object_set_property(obj, pname, &value, error))
+    return NULL;
+
+  return dbus_message_new_method_return(msg);
+}
+
+static void
+append_property(const char *name, const FmtxValue *value, gpointer user_data)
+{
+  DBusMessageIter entry;
+
+  dbus_message_iter_open_container(user_data, DBUS_TYPE_DICT_ENTRY, NULL,
+                                   &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+  append_value(&entry, value);
+  dbus_message_iter_close_container(user_data, &entry);
+}
+
+static DBusMessage *
+property_get_all(FmtxObject *obj, DBusMessage *msg)
+{
+  DBusMessage *reply = dbus_message_new_method_return(msg);
+  DBusMessageIter iter;
+  DBusMessageIter dict;
+
+  dbus_message_iter_init_append(reply, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+  fmtx_object_foreach_property(obj, append_property, &dict);
+  dbus_message_iter_close_container(&iter, &dict);
+
+  return reply;
+}
+
+static void
+scan_reply(void *data, const FmtxScanResult *results, unsigned int n)
+{
+  struct scan_call *call = data;
+  DBusMessage *reply = dbus_message_new_method_return(call->msg);
+  DBusMessageIter iter;
+  DBusMessageIter array;
+  dbus_uint32_t u;
+  dbus_int32_t i32;
+  unsigned int i;
+
+  dbus_message_iter_init_append(reply, &iter);
+
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+                                   DBUS_TYPE_UINT32_AS_STRING, &array);
+
+  for (i = 0; i < n; i++)
+  {
+    u = results[i].frequency;
+    dbus_message_iter_append_basic(&array, DBUS_TYPE_UINT32, &u);
+  }
+
+  dbus_message_iter_close_container(&iter, &array);
+
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+                                   DBUS_TYPE_INT32_AS_STRING, &array);
+
+  for (i = 0; i < n; i++)
+  {
+    i32 = results[i].noise;
+    dbus_message_iter_append_basic(&array, DBUS_TYPE_INT32, &i32);
+  }
+
+  dbus_message_iter_close_container(&iter, &array);
+
+  if (!dbus_message_get_no_reply(call->msg))
+    dbus_connection_send(call->obj->dbus, reply, NULL);
+
+  dbus_message_unref(reply);
+  dbus_message_unref(call->msg);
+  g_free(call);
+}
+
+/* The reply is sent from scan_reply() once the engine is done */
+static gboolean
+scan_channels(FmtxObject *obj, DBusMessage *msg, GError **error)
+{
+  struct scan_call *call;
+  dbus_uint32_t max_age;
+  dbus_uint32_t count;
+
+  if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_UINT32, &max_age,
+                             DBUS_TYPE_UINT32, &count, DBUS_TYPE_INVALID))
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Expected a maximum age and a count");
+    return FALSE;
+  }
+
+  call = g_new(struct scan_call, 1);
+  call->obj = obj;
+  call->msg = dbus_message_ref(msg);
+
+  if (fmtx_object_scan(obj, max_age, count, scan_reply, call, error))
+    return TRUE;
+
+  dbus_message_unref(call->msg);
+  g_free(call);
+
+  return FALSE;
+}
+
+static DBusMessage *
+save_preset(FmtxObject *obj, DBusMessage *msg, GError **error)
+{
+  const char *name;
+  dbus_uint32_t frequency;
+  dbus_uint32_t power_level;
+  dbus_uint32_t preemphasis;
+  const char *rds_ps;
+  const char *rds_text;
+
+  if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &name,
+                             DBUS_TYPE_UINT32, &frequency,
+                             DBUS_TYPE_UINT32, &power_level,
+                             DBUS_TYPE_UINT32, &preemphasis,
+                             DBUS_TYPE_STRING, &rds_ps,
+                             DBUS_TYPE_STRING, &rds_text, DBUS_TYPE_INVALID))
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Expected a name, frequency, power level, preemphasis, "
+                "PS and radio text");
+    return NULL;
+  }
+
+  if (!fmtx_object_preset_save(obj, name, frequency, power_level, preemphasis,
+                               rds_ps, rds_text, error))
+    return NULL;
+
+  return dbus_message_new_method_return(msg);
+}
+
+/* DeletePreset and ApplyPreset */
+static DBusMessage *
+preset_call(FmtxObject *obj, DBusMessage *msg,
+            gboolean (*call)(FmtxObject *, const char *, GError **),
+            GError **error)
+{
+  const char *name;
+
+  if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &name,
+                             DBUS_TYPE_INVALID))
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+                "Expected a preset name");
+    return NULL;
+  }
+
+  if (!call(obj, name, error))
+    return NULL;
+
+  return dbus_message_new_method_return(msg);
+}
+
+static DBusHandlerResult
+object_message(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+  FmtxObject *obj = user_data;
+  DBusMessage *reply = NULL;
+  GError *error = NULL;
+  const char *xml = introspect_xml;
+
+  if (dbus_message_is_method_call(msg, DBUS_INTERFACE_INTROSPECTABLE,
+                                  "Introspect"))
+  {
+    reply = dbus_message_new_method_return(msg);
+    dbus_message_append_args(reply, DBUS_TYPE_STRING, &xml,
+                             DBUS_TYPE_INVALID);
+  }
+  else if (dbus_message_has_interface(msg, DBUS_INTERFACE_PROPERTIES))
+  {
+    fmtx_object_call_begin(obj);
+
+    if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES, "Get"))
+      reply = property_get(obj, msg, &error);
+    else if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES,
+                                         "Set"))
+      reply = property_set(obj, msg, &error);
+    else if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES,
+                                         "GetAll"))
+      reply = property_get_all(obj, msg);
+    else
+      g_set_error(&error, DBUS_GERROR, DBUS_GERROR_UNKNOWN_METHOD,
+                  "Unknown method");
+
+    fmtx_object_call_end(obj);
+  }
+  else if (dbus_message_is_method_call(msg, FMTX_DEVICE_INTERFACE,
+                                       "ScanChannels"))
+  {
+    gboolean started;
+
+    fmtx_object_call_begin(obj);
+    started = scan_channels(obj, msg, &error);
+    fmtx_object_call_end(obj);
+
+    if (started)
+      return DBUS_HANDLER_RESULT_HANDLED;
+  }
+  else if (dbus_message_has_interface(msg, FMTX_DEVICE_INTERFACE) &&
+           dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_METHOD_CALL &&
+           (dbus_message_has_member(msg, "SavePreset") ||
+            dbus_message_has_member(msg, "DeletePreset") ||
+            dbus_message_has_member(msg, "ApplyPreset")))
+  {
+    fmtx_object_call_begin(obj);
+
+    if (dbus_message_has_member(msg, "SavePreset"))
+      reply = save_preset(obj, msg, &error);
+    else if (dbus_message_has_member(msg, "DeletePreset"))
+      reply = preset_call(obj, msg, fmtx_object_preset_delete, &error);
+    else
+      reply = preset_call(obj, msg, fmtx_object_preset_apply, &error);
+
+    fmtx_object_call_end(obj);
+  }
+  else if (dbus_message_is_method_call(msg, FMTX_DEVICE_INTERFACE,
+                                       "ReloadSchedule"))
+  {
+    fmtx_object_call_begin(obj);
+
+    if (fmtx_object_schedule_reload(obj, &error))
+      reply = dbus_message_new_method_return(msg);
+
+    fmtx_object_call_end(obj);
+  }
+  else
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  if (error)
+  {
+    reply = dbus_message_new_error(msg, error_name(error), error->message);
+    g_error_free(error);
+  }
+
+  if (!dbus_message_get_no_reply(msg))
+    dbus_connection_send(conn, reply, NULL);
+
+  dbus_message_unref(reply);
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static const DBusObjectPathVTable object_vtable =
+{
+  NULL,
+  object_message
+};
+
+static void
+send_signal(FmtxObject *obj, DBusMessage *msg)
+{
+  dbus_connection_send(obj->dbus, msg, NULL);
+  dbus_message_unref(msg);
+}
+
+static void
+changed_signal_cb(FmtxObject *obj, gpointer user_data)
+{
+  send_signal(obj, dbus_message_new_signal(obj->path,
+                                           FMTX_DEVICE_INTERFACE,
+                                           "Changed"));
+}
+
+static void
+error_signal_cb(FmtxObject *obj, const char *message, gpointer user_data)
+{
+  DBusMessage *msg = dbus_message_new_signal(obj->path,
+                                             FMTX_DEVICE_INTERFACE,
+                                             "Error");
+
+  dbus_message_append_args(msg, DBUS_TYPE_STRING, &message,
+                           DBUS_TYPE_INVALID);
+  send_signal(obj, msg);
+}
+
+static void
+migrated_signal_cb(FmtxObject *obj, guint from, guint to, gpointer user_data)
+{
+  DBusMessage *msg = dbus_message_new_signal(obj->path,
+                                             FMTX_DEVICE_INTERFACE,
+                                             "ChannelMigrated");
+  dbus_uint32_t f = from;
+  dbus_uint32_t t = to;
+
+  dbus_message_append_args(msg, DBUS_TYPE_UINT32, &f, DBUS_TYPE_UINT32, &t,
+                           DBUS_TYPE_INVALID);
+  send_signal(obj, msg);
+}
+
+static void
+info_signal_cb(FmtxObject *obj, const char *key, const char *value,
+               char **strv, gpointer user_data)
+{
+  DBusMessage *msg = dbus_message_new_signal(obj->path, POLICY_IF,
+                                             "info");
+
+  dbus_message_append_args(msg,
+                           DBUS_TYPE_STRING, &key,
+                           DBUS_TYPE_STRING, &value,
+                           DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &strv,
+                           (int)g_strv_length(strv),
+                           DBUS_TYPE_INVALID);
+  send_signal(obj, msg);
+}
+
+/* Called once per transmitter. The name and the match rules are shared,
+ * every object gets its own filter for the MCE and HAL signals. */
+void
+frontend_init(FmtxObject *fmtx)
+{
+  static gboolean name_owned = FALSE;
+  DBusConnection *conn;
+  DBusError error;
+  int ret;
+
+  dbus_error_init(&error);
+  conn = dbus_bus_get(DBUS_BUS_SYSTEM, &error);
+
+  if (!conn)
+    log_error("Couldn't connect to the System bus", error.message, TRUE);
+
+  fmtx->dbus = conn;
+
+  if (!name_owned)
+  {
+    dbus_connection_setup_with_g_main(conn, NULL);
+
+    ret = dbus_bus_request_name(conn, FMTX_SERVICE,
+                                DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+
+    if (ret == -1)
+      log_error("D-Bus.RequestName RPC failed", error.message, TRUE);
+
+    if (ret != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+      log_error("Failed to get the primary well-known name.",
+                "RequestName result != 1", TRUE);
+
+    dbus_bus_add_match(conn,
+                       "type='signal',interface='" HAL_DEVICE_IF "',"
+                       "member='Condition',path='" FMTX_HAL_JACK_UDI "'",
+                       NULL);
+    dbus_bus_add_match(conn,
+                       "type='signal',interface='" MCE_SIGNAL_IF "',"
+                       "path='" MCE_SIGNAL_PATH "'",
+                       NULL);
+    dbus_bus_add_match(conn,
+                       "type='signal',sender='" DBUS_SERVICE_DBUS "',"
+                       "interface='" DBUS_INTERFACE_DBUS "',"
+                       "member='NameOwnerChanged',arg0='" OHM_SERVICE "'",
+                       NULL);
+    name_owned = TRUE;
+  }
+
+  if (!dbus_connection_register_object_path(conn, fmtx->path,
+                                            &object_vtable, fmtx))
+    log_error("Couldn't register the FMTx object", "OOM", TRUE);
+
+  g_signal_connect(fmtx, "changed", G_CALLBACK(changed_signal_cb), NULL);
+  g_signal_connect(fmtx, "error", G_CALLBACK(error_signal_cb), NULL);
+  g_signal_connect(fmtx, "info", G_CALLBACK(info_signal_cb), NULL);
+  g_signal_connect(fmtx, "channel-migrated", G_CALLBACK(migrated_signal_cb),
+                   NULL);
+
+  if (fmtx_hw_is_sim(fmtx->engine->hw))
+    sim_control_register(conn, fmtx);
+
+  dbus_connection_add_filter(conn, bus_filter, fmtx, NULL);
+
+  query_jack_state(fmtx);
+  query_device_mode(fmtx);
+}
+
+void
+frontend_close(FmtxObject *obj)
+{
+  dbus_connection_unref(obj->dbus);
+}
+
+static void
+region_cb(DBusPendingCall *pending, void *user_data)
+{
+  struct region_call *call = user_data;
+  DBusMessage *reply;
+  unsigned char *data;
+  int len = 0;
+  int region = -1;
+
+  reply = steal_reply(pending, "Unable to get stored fmtx settings");
+
+  if (reply)
+  {
+    if (dbus_message_get_args(reply, NULL, DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE,
+                              &data, &len, DBUS_TYPE_INVALID) && len)
+      region = data[0];
+
+    dbus_message_unref(reply);
+  }
+
+  call->cb(call->obj, region);
+}
+
+void
+frontend_get_region(FmtxObject *obj, FrontendRegionCallback cb)
+{
+  const char *key = "/certs/ccc/pp/fmtx-raw";
+  struct region_call *call = g_new(struct region_call, 1);
+  DBusMessage *msg;
+
+  call->obj = obj;
+  call->cb = cb;
+
+  msg = dbus_message_new_method_call("com.nokia.SystemInfo",
+                                     "/com/nokia/SystemInfo",
+                                     "com.nokia.SystemInfo",
+                                     "GetConfigValue");
+  dbus_message_append_args(msg, DBUS_TYPE_STRING, &key, DBUS_TYPE_INVALID);
+
+  if (!call_async(obj, msg, region_cb, call, g_free))
+  {
+    g_free(call);
+    cb(obj, -1);
+  }
+}
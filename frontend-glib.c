@@ -0,0 +1,491 @@
+#include <dbus/dbus-glib-lowlevel.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+#include <string.h>
+
+#include "events.h"
+#include "fmtx-object.h"
+#include "frontend.h"
+#include "sim-control.h"
+
+static void
+sig_device_mode_ind_cb(DBusGProxy *proxy, const char *valueName,
+                       FmtxObject *obj)
+{
+  fmtx_device_mode_changed(obj, valueName);
+}
+
+static void
+platform_soc_audio_logicaldev_input_cb(DBusGProxy *proxy,
+                                       const gchar *condition,
+                                       const gchar *details,
+                                       FmtxObject *obj)
+{
+  DBusGProxy *hal_proxy;
+  GError *error = NULL;
+  GPtrArray *array = NULL;
+
+  hal_proxy =
+    dbus_g_proxy_new_for_name(
+      dbus_connection_get_g_connection(obj->dbus),
+      "org.freedesktop.Hal",
+      FMTX_HAL_JACK_UDI,
+      "org.freedesktop.Hal.Device");
+
+  if (!hal_proxy)
+  {
+    log_error("Couldn't create the proxy object",
+              "Unknown(dbus_g_proxy_new_for_name)", 0);
+    return;
+  }
+
+  dbus_g_proxy_call(hal_proxy, "GetPropertyString", &error,
+                    G_TYPE_STRING, "input.jack.type", 0,
+                    dbus_g_type_get_collection("GPtrArray", G_TYPE_STRING),
+                    &array, 0);
+
+  g_object_unref(hal_proxy);
+
+  if (error)
+  {
+    log_error("Unable to get headphone connector state", "", 0);
+    g_clear_error(&error);
+    return;
+  }
+
+  fmtx_jack_changed(obj, array->len != 0);
+
+  g_ptr_array_free(array, 1);
+}
+
+static void
+g_cclosure_user_marshal_VOID__STRING_STRING (GClosure *closure,
+                                             GValue *return_value,
+                                             guint n_param_values,
+                                             const GValue *param_values,
+                                             gpointer invocation_hint,
+                                             gpointer marshal_data) {
+  typedef void (*GMarshalFunc_VOID__STRING_STRING)(gpointer data1,
+                                                   const char *arg_1,
+                                                   const char *arg_2,
+                                                   gpointer data2);
+  register GMarshalFunc_VOID__STRING_STRING callback;
+  register GCClosure *cc;
+  register gpointer data1;
+  register gpointer data2;
+  cc = (GCClosure *)closure;
+  g_return_if_fail(n_param_values == 3);
+
+  if (G_CCLOSURE_SWAP_DATA(closure))
+  {
+    data1 = closure->data;
+    data2 = param_values->data[0].v_pointer;
+  }
+  else
+  {
+    data1 = param_values->data[0].v_pointer;
+    data2 = closure->data;
+  }
+
+  callback = (GMarshalFunc_VOID__STRING_STRING)
+    (marshal_data ? marshal_data : cc->callback);
+  callback(data1, g_value_get_string(param_values + 1),
+           g_value_get_string(param_values + 2), data2);
+}
+
+static void
+sig_call_state_ind_cb(DBusGProxy *proxy, const gchar *call_state,
+                      const gchar *call_e_state, FmtxObject *obj)
+{
+  fmtx_call_state_changed(obj, call_state);
+}
+
+static void
+nameownerchanged_cb(DBusGProxy *proxy, const char *name,
+                    const char *old_owner, const char *new_owner,
+                    FmtxObject *obj)
+{
+  if (g_str_equal(name, "org.freedesktop.ohm"))
+    emit_info(obj);
+}
+
+static void
+fmtx_value_to_gvalue(const FmtxValue *v, GValue *value)
+{
+  if (v->type == DBUS_TYPE_UINT32)
+  {
+    g_value_init(value, G_TYPE_UINT);
+    g_value_set_uint(value, v->u);
+  }
+  else
+  {
+    g_value_init(value, G_TYPE_STRING);
+    g_value_set_string(value, v->s);
+  }
+}
+
+static gboolean
+dbus_glib_marshal_fmtx_object_get(FmtxObject *obj,
+                                  gconstpointer iname,
+                                  gconstpointer pname,
+                                  GValue *value,
+                                  GError **error)
+{
+  FmtxValue v;
+  gboolean rv;
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_get_property(obj, pname, &v, error);
+
+  if (rv)
+    fmtx_value_to_gvalue(&v, value);
+
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+static gboolean
+dbus_glib_marshal_fmtx_object_set(FmtxObject *obj,
+                                  gconstpointer iname,
+                                  gconstpointer pname,
+                                  GValue *value,
+                                  GError **error)
+{
+  FmtxValue v = { 0, };
+  gboolean rv;
+
+  if (G_VALUE_HOLDS(value, G_TYPE_UINT))
+  {
+    v.type = DBUS_TYPE_UINT32;
+    v.u = g_value_get_uint(value);
+  }
+  else if (G_VALUE_HOLDS(value, G_TYPE_STRING))
+  {
+    v.type = DBUS_TYPE_STRING;
+    v.s = g_value_get_string(value);
+  }
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_set_property(obj, pname, &v, error);
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+static void
+free_gvalue(gpointer value)
+{
+  g_value_unset(value);
+  g_free(value);
+}
+
+static void
+insert_property(const char *name, const FmtxValue *v, gpointer user_data)
+{
+  GValue *value = g_new0(GValue, 1);
+
+  fmtx_value_to_gvalue(v, value);
+  g_hash_table_insert(user_data, (gpointer)name, value);
+}
+
+static gboolean
+dbus_glib_marshal_fmtx_object_get_all(FmtxObject *obj,
+                                      gconstpointer iname,
+                                      GHashTable **properties,
+                                      GError **error)
+{
+  fmtx_object_call_begin(obj);
+
+  *properties = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                      free_gvalue);
+  fmtx_object_foreach_property(obj, insert_property, *properties);
+
+  fmtx_object_call_end(obj);
+
+  return TRUE;
+}
+
+static void
+scan_reply(void *data, const FmtxScanResult *results, unsigned int n)
+{
+  GArray *frequencies = g_array_sized_new(FALSE, FALSE, sizeof(guint), n);
+  GArray *noise = g_array_sized_new(FALSE, FALSE, sizeof(gint), n);
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+  {
+    guint f = results[i].frequency;
+    gint rnl = results[i].noise;
+
+    g_array_append_val(frequencies, f);
+    g_array_append_val(noise, rnl);
+  }
+
+  dbus_g_method_return(data, frequencies, noise);
+
+  g_array_free(frequencies, TRUE);
+  g_array_free(noise, TRUE);
+}
+
+static gboolean
+fmtx_object_scan_channels(FmtxObject *obj, guint max_age, guint count,
+                          DBusGMethodInvocation *context)
+{
+  GError *error = NULL;
+
+  fmtx_object_call_begin(obj);
+
+  if (!fmtx_object_scan(obj, max_age, count, scan_reply, context, &error))
+  {
+    dbus_g_method_return_error(context, error);
+    g_error_free(error);
+  }
+
+  fmtx_object_call_end(obj);
+
+  return TRUE;
+}
+
+static gboolean
+fmtx_object_save_preset(FmtxObject *obj, const char *name, guint frequency,
+                        guint power_level, guint preemphasis,
+                        const char *rds_ps, const char *rds_text,
+                        GError **error)
+{
+  gboolean rv;
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_preset_save(obj, name, frequency, power_level, preemphasis,
+                               rds_ps, rds_text, error);
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+static gboolean
+fmtx_object_delete_preset(FmtxObject *obj, const char *name, GError **error)
+{
+  gboolean rv;
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_preset_delete(obj, name, error);
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+static gboolean
+fmtx_object_apply_preset(FmtxObject *obj, const char *name, GError **error)
+{
+  gboolean rv;
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_preset_apply(obj, name, error);
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+static gboolean
+fmtx_object_reload_schedule(FmtxObject *obj, GError **error)
+{
+  gboolean rv;
+
+  fmtx_object_call_begin(obj);
+  rv = fmtx_object_schedule_reload(obj, error);
+  fmtx_object_call_end(obj);
+
+  return rv;
+}
+
+#include "fmtx-object-bindings.h"
+
+static void
+connect_dbus_signals(DBusGConnection *dbus, FmtxObject *obj)
+{
+  DBusGProxy *proxy;
+  gchar *s;
+  GError *err = NULL;
+
+  err = 0;
+  proxy = dbus_g_proxy_new_for_name(
+      dbus,
+      "org.freedesktop.Hal",
+      FMTX_HAL_JACK_UDI,
+      "org.freedesktop.Hal.Device");
+
+  if (!proxy)
+    goto err;
+
+  dbus_g_proxy_add_signal(proxy, "Condition",
+                          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INVALID);
+  dbus_g_proxy_connect_signal(proxy, "Condition",
+                              (GCallback)platform_soc_audio_logicaldev_input_cb,
+                              obj, NULL);
+  platform_soc_audio_logicaldev_input_cb(0, 0, 0, obj);
+
+  proxy = dbus_g_proxy_new_for_name(dbus,
+                                    MCE_SERVICE,
+                                    MCE_SIGNAL_PATH,
+                                    MCE_SIGNAL_IF);
+
+  if (!proxy)
+    goto err;
+
+  dbus_g_proxy_add_signal(proxy, MCE_DEVICE_MODE_SIG,
+                          G_TYPE_STRING, G_TYPE_INVALID);
+  dbus_g_proxy_connect_signal(proxy, MCE_DEVICE_MODE_SIG,
+                              (GCallback)sig_device_mode_ind_cb,
+                              obj, NULL);
+  dbus_g_object_register_marshaller(
+    (GClosureMarshal)g_cclosure_user_marshal_VOID__STRING_STRING,
+    G_TYPE_NONE, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INVALID);
+  dbus_g_proxy_add_signal(proxy, MCE_CALL_STATE_SIG,
+                          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INVALID);
+  dbus_g_proxy_connect_signal(proxy, MCE_CALL_STATE_SIG,
+                              (GCallback)sig_call_state_ind_cb, obj, NULL);
+
+  proxy = dbus_g_proxy_new_for_name(dbus,
+                                    MCE_SERVICE,
+                                    MCE_REQUEST_PATH,
+                                    MCE_REQUEST_IF);
+
+  if (!proxy)
+    goto err;
+
+  dbus_g_proxy_call(proxy, MCE_DEVICE_MODE_GET, &err,
+                    G_TYPE_STRING, MCE_REQUEST_IF, G_TYPE_INVALID,
+                    G_TYPE_STRING, &s, G_TYPE_INVALID);
+
+  if (err)
+  {
+    log_error("Unable to get device state", "", 0);
+    g_clear_error(&err);
+    return;
+  }
+
+  fmtx_device_mode_changed(obj, s);
+
+  g_free(s);
+
+  return;
+
+err:
+  log_error("Couldn't create the proxy object",
+            "Unknown(dbus_g_proxy_new_for_name)", FALSE);
+
+  obj->engine->state = FMTX_STATE_ERROR;
+}
+
+void
+frontend_init(FmtxObject *fmtx)
+{
+  static gboolean name_owned = FALSE;
+  DBusGConnection *dbus;
+  DBusGProxy *proxy;
+  GError *error = NULL;
+  unsigned int ret;
+
+  dbus = dbus_g_bus_get(DBUS_BUS_SYSTEM, &error);
+
+  if (error)
+    log_error("Couldn't connect to the System bus", error->message, TRUE);
+
+  proxy = dbus_g_proxy_new_for_name(dbus,
+                                    "org.freedesktop.DBus",
+                                    "/org/freedesktop/DBus",
+                                    "org.freedesktop.DBus");
+
+  if (!proxy)
+    log_error("Failed to get a proxy for D-Bus",
+              "Unknown(dbus_g_proxy_new_for_name)", TRUE);
+
+  /* the name and the introspection data are shared by all transmitters */
+  if (!name_owned)
+  {
+    if (!dbus_g_proxy_call(proxy, "RequestName",
+                           &error,
+                           G_TYPE_STRING, "com.nokia.FMTx",
+                           G_TYPE_UINT, DBUS_NAME_FLAG_DO_NOT_QUEUE,
+                           G_TYPE_INVALID,
+                           G_TYPE_UINT, &ret,
+                           G_TYPE_INVALID ))
+      log_error("D-Bus.RequestName RPC failed", error->message, TRUE);
+
+    if (ret != 1)
+      log_error("Failed to get the primary well-known name.",
+                "RequestName result != 1", TRUE);
+
+    dbus_g_object_type_install_info(FMTX_OBJECT_TYPE,
+                                    &dbus_glib_fmtx_object_object_info);
+    name_owned = TRUE;
+  }
+
+  fmtx->dbus = dbus_g_connection_get_connection(dbus);
+
+  dbus_g_connection_register_g_object(dbus, fmtx->path, G_OBJECT(fmtx));
+
+  if (fmtx_hw_is_sim(fmtx->engine->hw))
+    sim_control_register(fmtx->dbus, fmtx);
+
+  connect_dbus_signals(dbus, fmtx);
+
+  dbus_g_proxy_add_signal(proxy, "NameOwnerChanged",
+                          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                          G_TYPE_INVALID);
+
+  dbus_g_proxy_connect_signal(proxy,
+                              "NameOwnerChanged",
+                              (GCallback)nameownerchanged_cb,
+                              fmtx,
+                              G_TYPE_INVALID);
+  g_object_unref(proxy);
+}
+
+void
+frontend_close(FmtxObject *obj)
+{
+  dbus_g_connection_unref(dbus_connection_get_g_connection(obj->dbus));
+}
+
+void
+frontend_get_region(FmtxObject *obj, FrontendRegionCallback cb)
+{
+  DBusGProxy *proxy;
+  GError *error = NULL;
+  GArray *array = NULL;
+  int region = -1;
+
+  proxy = dbus_g_proxy_new_for_name(
+      dbus_connection_get_g_connection(obj->dbus),
+      "com.nokia.SystemInfo",
+      "/com/nokia/SystemInfo",
+      "com.nokia.SystemInfo");
+
+  if (proxy)
+  {
+    if (dbus_g_proxy_call(proxy, "GetConfigValue", &error, G_TYPE_STRING,
+                          "/certs/ccc/pp/fmtx-raw",
+                          G_TYPE_INVALID,
+                          DBUS_TYPE_G_UCHAR_ARRAY, &array,
+                          G_TYPE_INVALID) && !error)
+    {
+      if (array->len)
+        region = *array->data;
+
+      g_array_free(array, TRUE);
+    }
+    else
+    {
+      g_log(0, G_LOG_LEVEL_WARNING, "Unable to get stored fmtx settings");
+      g_clear_error(&error);
+    }
+
+    g_object_unref(proxy);
+  }
+  else
+    g_log(0, G_LOG_LEVEL_WARNING, "Couldn't create the proxy object");
+
+  cb(obj, region);
+}
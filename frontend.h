@@ -0,0 +1,25 @@
+#ifndef __FMTXD_FRONTEND_H_INCLUDED__
+#define __FMTXD_FRONTEND_H_INCLUDED__
+
+#include "fmtx-object.h"
+
+/* The D-Bus side of fmtxd. frontend-dbus.c talks libdbus directly and is
+ * the default, frontend-glib.c is the dbus-glib one (make FRONTEND=glib). */
+
+#define FMTX_HAL_JACK_UDI \
+  "/org/freedesktop/Hal/devices/platform_soc_audio_logicaldev_input"
+
+typedef void (*FrontendRegionCallback)(FmtxObject *obj, int region);
+
+/* Takes com.nokia.FMTx, exports the object and follows MCE, HAL and ohm.
+ * Exits on failure. */
+void
+frontend_init(FmtxObject *obj);
+void
+frontend_close(FmtxObject *obj);
+
+/* Region byte from SystemInfo fmtx-raw, or -1 if it can't be read */
+void
+frontend_get_region(FmtxObject *obj, FrontendRegionCallback cb);
+
+#endif /* __FMTXD_FRONTEND_H_INCLUDED__ */
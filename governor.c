@@ -0,0 +1,299 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "governor.h"
+
+void
+fmtx_governor_init(FmtxGovernor *gov)
+{
+  memset(gov, 0, sizeof(*gov));
+  gov->capacity_fd = -1;
+  gov->status_fd = -1;
+  gov->capacity = -1;
+  gov->discharging = -1;
+  gov->temperature = FMTX_GOVERNOR_NO_TEMPERATURE;
+  fmtx_governor_curve_parse(&gov->battery, FMTX_GOVERNOR_BATTERY_CURVE,
+                            FMTX_GOVERNOR_BATTERY_MIN,
+                            FMTX_GOVERNOR_BATTERY_MAX);
+  fmtx_governor_curve_parse(&gov->thermal, FMTX_GOVERNOR_THERMAL_CURVE,
+                            FMTX_GOVERNOR_THERMAL_MIN,
+                            FMTX_GOVERNOR_THERMAL_MAX);
+}
+
+static int
+open_attr(const char *dir, const char *name, const char *attr)
+{
+  char path[256];
+
+  if (snprintf(path, sizeof(path), "%s/%s/%s", dir, name, attr) >=
+      (int)sizeof(path))
+    return -1;
+
+  return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* sysfs answers a read at offset 0 with the current value, so the fds can
+ * be kept and re-read */
+static int
+read_attr(int fd, char *buf, size_t len)
+{
+  ssize_t n;
+
+  do
+    n = pread(fd, buf, len - 1, 0);
+  while (n < 0 && errno == EINTR);
+
+  if (n <= 0)
+    return -1;
+
+  buf[n] = 0;
+
+  if (buf[n - 1] == '\n')
+    buf[n - 1] = 0;
+
+  return 0;
+}
+
+static int
+read_int(int fd, int *value)
+{
+  char buf[32];
+  char *end;
+  long v;
+
+  if (fd == -1 || read_attr(fd, buf, sizeof(buf)))
+    return -1;
+
+  v = strtol(buf, &end, 10);
+
+  if (end == buf)
+    return -1;
+
+  *value = v;
+
+  return 0;
+}
+
+static void
+open_battery(FmtxGovernor *gov, const char *class_dir)
+{
+  char dir[256];
+  char type[16];
+  struct dirent *de;
+  DIR *d;
+  int fd;
+
+  snprintf(dir, sizeof(dir), "%s/power_supply", class_dir);
+
+  if (!(d = opendir(dir)))
+    return;
+
+  while (gov->capacity_fd == -1 && (de = readdir(d)))
+  {
+    if (de->d_name[0] == '.')
+      continue;
+
+    fd = open_attr(dir, de->d_name, "type");
+
+    if (fd == -1)
+      continue;
+
+    if (!read_attr(fd, type, sizeof(type)) && !strcmp(type, "Battery"))
+    {
+      gov->capacity_fd = open_attr(dir, de->d_name, "capacity");
+      gov->status_fd = open_attr(dir, de->d_name, "status");
+    }
+
+    close(fd);
+  }
+
+  closedir(d);
+}
+
+static void
+open_zones(FmtxGovernor *gov, const char *class_dir)
+{
+  char dir[256];
+  struct dirent *de;
+  DIR *d;
+  int fd;
+
+  snprintf(dir, sizeof(dir), "%s/thermal", class_dir);
+
+  if (!(d = opendir(dir)))
+    return;
+
+  while (gov->n_zones < FMTX_GOVERNOR_MAX_ZONES && (de = readdir(d)))
+  {
+    if (strncmp(de->d_name, "thermal_zone", 12))
+      continue;
+
+    if ((fd = open_attr(dir, de->d_name, "temp")) != -1)
+      gov->zone_fd[gov->n_zones++] = fd;
+  }
+
+  closedir(d);
+}
+
+int
+fmtx_governor_open(FmtxGovernor *gov, const char *class_dir)
+{
+  fmtx_governor_close(gov);
+  open_battery(gov, class_dir);
+  open_zones(gov, class_dir);
+  gov->opened = 1;
+
+  return (gov->capacity_fd != -1) + (gov->status_fd != -1) + gov->n_zones;
+}
+
+void
+fmtx_governor_close(FmtxGovernor *gov)
+{
+  unsigned int i;
+
+  if (gov->capacity_fd != -1)
+    close(gov->capacity_fd);
+
+  if (gov->status_fd != -1)
+    close(gov->status_fd);
+
+  for (i = 0; i < gov->n_zones; i++)
+    close(gov->zone_fd[i]);
+
+  gov->capacity_fd = -1;
+  gov->status_fd = -1;
+  gov->n_zones = 0;
+  gov->opened = 0;
+  gov->capacity = -1;
+  gov->discharging = -1;
+  gov->temperature = FMTX_GOVERNOR_NO_TEMPERATURE;
+}
+
+int
+fmtx_governor_read(FmtxGovernor *gov)
+{
+  int capacity = -1;
+  int discharging = -1;
+  int temperature = FMTX_GOVERNOR_NO_TEMPERATURE;
+  char status[32];
+  unsigned int i;
+  int changed;
+  int t;
+
+  read_int(gov->capacity_fd, &capacity);
+
+  if (gov->status_fd != -1 &&
+      !read_attr(gov->status_fd, status, sizeof(status)))
+    discharging = !strcmp(status, "Discharging");
+
+  /* millidegrees */
+  for (i = 0; i < gov->n_zones; i++)
+  {
+    if (!read_int(gov->zone_fd[i], &t) && t / 1000 > temperature)
+      temperature = t / 1000;
+  }
+
+  changed = capacity != gov->capacity || discharging != gov->discharging ||
+            temperature != gov->temperature;
+
+  gov->capacity = capacity;
+  gov->discharging = discharging;
+  gov->temperature = temperature;
+
+  return changed;
+}
+
+int
+fmtx_governor_update(FmtxGovernor *gov, long long now_ns)
+{
+  FmtxGovernorReason reason = FMTX_GOVERNOR_NONE;
+  int target = FMTX_MAX_POWER_LEVEL;
+  int limit;
+
+  /* without a status file the battery is assumed to be in use */
+  if (gov->capacity >= 0 && gov->discharging &&
+      (limit = fmtx_governor_curve_eval(&gov->battery, gov->capacity)) >= 0 &&
+      limit < target)
+  {
+    target = limit;
+    reason = FMTX_GOVERNOR_BATTERY;
+  }
+
+  if (gov->temperature != FMTX_GOVERNOR_NO_TEMPERATURE &&
+      (limit = fmtx_governor_curve_eval(&gov->thermal,
+                                        gov->temperature)) >= 0 &&
+      limit < target)
+  {
+    target = limit;
+    reason = FMTX_GOVERNOR_THERMAL;
+  }
+
+  if (target < FMTX_MIN_POWER_LEVEL)
+    target = FMTX_MIN_POWER_LEVEL;
+
+  if (gov->level && target > gov->level &&
+      ((target < gov->level + FMTX_GOVERNOR_HYSTERESIS &&
+        target != FMTX_MAX_POWER_LEVEL) ||
+       now_ns - gov->changed_ns < FMTX_GOVERNOR_RAISE_HOLD * 1000000000LL))
+    return 0;
+
+  if (target == gov->level && reason == gov->reason)
+    return 0;
+
+  if (target != gov->level)
+    gov->changed_ns = now_ns;
+
+  gov->level = target;
+  gov->reason = reason;
+
+  return 1;
+}
+
+int
+fmtx_governor_curve_parse(FmtxGovernorCurve *curve, const char *text,
+                          int min_x, int max_x)
+{
+  FmtxGovernorCurve c;
+  int n = fmtx_points_parse(c.point, FMTX_GOVERNOR_MAX_POINTS, text, min_x,
+                            max_x);
+
+  if (n < 0)
+    return 0;
+
+  c.n = n;
+  *curve = c;
+
+  return 1;
+}
+
+void
+fmtx_governor_curve_format(const FmtxGovernorCurve *curve, char *buf,
+                           unsigned int len)
+{
+  fmtx_points_format(curve->point, curve->n, buf, len);
+}
+
+int
+fmtx_governor_curve_eval(const FmtxGovernorCurve *curve, int x)
+{
+  return fmtx_points_eval(curve->point, curve->n, x);
+}
+
+const char *
+fmtx_governor_reason_name(FmtxGovernorReason reason)
+{
+  switch (reason)
+  {
+    case FMTX_GOVERNOR_BATTERY:
+      return "battery";
+    case FMTX_GOVERNOR_THERMAL:
+      return "thermal";
+    default:
+      return "none";
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef __FMTXD_GOVERNOR_H_INCLUDED__
+#define __FMTXD_GOVERNOR_H_INCLUDED__
+
+/* Transmit power from the battery charge and the temperature. Each input
+ * has a curve of points x:dBuV, percent for the battery and degrees
+ * Celsius for the hottest thermal zone, and the lowest answer wins. The
+ * sysfs files stay open and are re-read with pread(). */
+
+#include <limits.h>
+
+#include "points.h"
+
+#define FMTX_GOVERNOR_MAX_POINTS 8
+#define FMTX_GOVERNOR_MAX_ZONES 8
+/* x in percent and in degrees */
+#define FMTX_GOVERNOR_BATTERY_MIN 0
+#define FMTX_GOVERNOR_BATTERY_MAX 100
+#define FMTX_GOVERNOR_THERMAL_MIN (-40)
+#define FMTX_GOVERNOR_THERMAL_MAX 150
+/* below any reading, as curves go below 0 degrees */
+#define FMTX_GOVERNOR_NO_TEMPERATURE INT_MIN
+/* "-40:120," per point at most, the last comma leaves room for the NUL */
+#define FMTX_GOVERNOR_MAX_CURVE (FMTX_GOVERNOR_MAX_POINTS * 8)
+
+#define FMTX_GOVERNOR_BATTERY_CURVE "15:96,50:112,80:120"
+#define FMTX_GOVERNOR_THERMAL_CURVE "55:120,65:104,75:88"
+
+/* Power only goes up again once it can rise by this many dB and has not
+ * changed for FMTX_GOVERNOR_RAISE_HOLD seconds. Drops apply at once. */
+#define FMTX_GOVERNOR_HYSTERESIS 3
+#define FMTX_GOVERNOR_RAISE_HOLD 60
+
+/* seconds between reads of files that don't notify changes */
+#define FMTX_GOVERNOR_POLL_INTERVAL 30
+
+typedef enum
+{
+  FMTX_GOVERNOR_NONE,
+  FMTX_GOVERNOR_BATTERY,
+  FMTX_GOVERNOR_THERMAL
+} FmtxGovernorReason;
+
+/* An empty curve never limits */
+typedef struct
+{
+  unsigned int n;
+  FmtxPoint point[FMTX_GOVERNOR_MAX_POINTS];
+} FmtxGovernorCurve;
+
+typedef struct
+{
+  int capacity_fd;
+  int status_fd;
+  int zone_fd[FMTX_GOVERNOR_MAX_ZONES];
+  unsigned int n_zones;
+  int opened;
+  /* percent, -1 if unknown */
+  int capacity;
+  int discharging;
+  /* degrees, FMTX_GOVERNOR_NO_TEMPERATURE if unknown */
+  int temperature;
+  FmtxGovernorCurve battery;
+  FmtxGovernorCurve thermal;
+  /* the decision, 0 before the first one */
+  int level;
+  FmtxGovernorReason reason;
+  long long changed_ns;
+} FmtxGovernor;
+
+void
+fmtx_governor_init(FmtxGovernor *gov);
+/* Opens the first battery under class_dir/power_supply and the zones under
+ * class_dir/thermal. Returns how many files are open. */
+int
+fmtx_governor_open(FmtxGovernor *gov, const char *class_dir);
+void
+fmtx_governor_close(FmtxGovernor *gov);
+/* Returns 1 if a reading changed */
+int
+fmtx_governor_read(FmtxGovernor *gov);
+/* Decides the limit at CLOCK_MONOTONIC now, FMTX_MAX_POWER_LEVEL when
+ * nothing limits. Returns 1 if the level or the reason changed. */
+int
+fmtx_governor_update(FmtxGovernor *gov, long long now_ns);
+
+/* "x:level,..." with x ascending from min_x to max_x, "" clears. Returns 0
+ * if invalid. */
+int
+fmtx_governor_curve_parse(FmtxGovernorCurve *curve, const char *text,
+                          int min_x, int max_x);
+void
+fmtx_governor_curve_format(const FmtxGovernorCurve *curve, char *buf,
+                           unsigned int len);
+/* Linear between the points and flat past the ends, -1 if empty */
+int
+fmtx_governor_curve_eval(const FmtxGovernorCurve *curve, int x);
+
+const char *
+fmtx_governor_reason_name(FmtxGovernorReason reason);
+
+#endif /* __FMTXD_GOVERNOR_H_INCLUDED__ */
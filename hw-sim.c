@@ -0,0 +1,475 @@
+#include <errno.h>
+#include <linux/videodev2.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hw.h"
+#include "rds.h"
+
+/* Modelled on a 400 kHz i2c bus: fixed transaction cost plus ~25us/byte */
+#define SIM_DEFAULT_LATENCY_US 300
+#define SIM_DEFAULT_BYTE_US 25
+#define SIM_DEFAULT_POWER_LEVEL 120
+#define SIM_ATTR_MAX 72
+/* si4713 tune plus RNL measurement, mostly waiting for the receiver */
+#define SIM_DEFAULT_MEASURE_US 20000
+#define SIM_MAX_STATIONS 16
+
+/* A station others can hear, it also raises the two channels either side */
+struct sim_station
+{
+  unsigned int khz;
+  int dbuv;
+};
+
+struct fmtx_hw_sim
+{
+  unsigned int latency_us;
+  unsigned int byte_us;
+  int power_level;
+  unsigned int mixer_function;
+  unsigned int frequency;
+  int muted;
+  const char *name;
+  FILE *trace;
+  unsigned int measure_us;
+  struct sim_station station[SIM_MAX_STATIONS];
+  unsigned int n_stations;
+  char attr[FMTX_HW_ATTR_LAST][SIM_ATTR_MAX];
+  /* what a si4713 would put on air for the RDS attributes */
+  FmtxRdsEncoder rds;
+};
+
+static unsigned int
+sim_env_uint(const char *name, unsigned int def)
+{
+  const char *s = getenv(name);
+
+  return s ? strtoul(s, NULL, 10) : def;
+}
+
+/* FMTXD_SIM_NOISE="98500:62,101100:55" puts stations on the band */
+static void
+sim_parse_stations(struct fmtx_hw_sim *sim, const char *s)
+{
+  char *end;
+
+  while (s && *s && sim->n_stations < SIM_MAX_STATIONS)
+  {
+    struct sim_station *st = &sim->station[sim->n_stations];
+
+    st->khz = strtoul(s, &end, 10);
+
+    if (*end != ':')
+      break;
+
+    st->dbuv = strtol(end + 1, &end, 10);
+    sim->n_stations++;
+    s = *end == ',' ? end + 1 : NULL;
+  }
+}
+
+static struct fmtx_hw_sim *
+sim_priv(FmtxHw *hw)
+{
+  struct fmtx_hw_sim *sim = hw->priv;
+
+  if (!sim)
+  {
+    const char *trace = getenv("FMTXD_SIM_TRACE");
+
+    sim = calloc(1, sizeof(*sim));
+    sim->latency_us = sim_env_uint("FMTXD_SIM_LATENCY_US",
+                                   SIM_DEFAULT_LATENCY_US);
+    sim->byte_us = sim_env_uint("FMTXD_SIM_BYTE_US", SIM_DEFAULT_BYTE_US);
+    sim->power_level = sim_env_uint("FMTXD_SIM_POWER_LEVEL",
+                                    SIM_DEFAULT_POWER_LEVEL);
+    sim->mixer_function = sim_env_uint("FMTXD_SIM_MIXER_FUNCTION", 1);
+    sim->measure_us = sim_env_uint("FMTXD_SIM_MEASURE_US",
+                                   SIM_DEFAULT_MEASURE_US);
+    sim_parse_stations(sim, getenv("FMTXD_SIM_NOISE"));
+    sim->muted = 1;
+    sim->name = hw->name;
+    fmtx_rds_encoder_init(&sim->rds, 0);
+
+    if (trace)
+    {
+      sim->trace = fopen(trace, "a");
+
+      if (sim->trace)
+        setvbuf(sim->trace, NULL, _IOLBF, 0);
+    }
+
+    hw->priv = sim;
+  }
+
+  return sim;
+}
+
+static void
+sim_sleep_us(unsigned long us)
+{
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+    ;
+}
+
+static void
+sim_delay(struct fmtx_hw_sim *sim, size_t len)
+{
+  unsigned long us = sim->latency_us + sim->byte_us * len;
+
+  if (us)
+    sim_sleep_us(us);
+}
+
+static void
+sim_trace(struct fmtx_hw_sim *sim, const char *op, const char *fmt, ...)
+  __attribute__((format(printf, 3, 4)));
+
+static void
+sim_trace(struct fmtx_hw_sim *sim, const char *op, const char *fmt, ...)
+{
+  struct timespec ts;
+  va_list ap;
+
+  if (!sim->trace)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  fprintf(sim->trace, "%ld.%06ld %s %s ", (long)ts.tv_sec, ts.tv_nsec / 1000,
+          sim->name, op);
+
+  va_start(ap, fmt);
+  vfprintf(sim->trace, fmt, ap);
+  va_end(ap);
+
+  fputc('\n', sim->trace);
+}
+
+static void
+sim_trace_group(struct fmtx_hw_sim *sim, FmtxRdsGroupType type,
+                const FmtxRdsGroup *group)
+{
+  sim_trace(sim, "rds", "%s %07x %07x %07x %07x",
+            fmtx_rds_group_name(type), group->block[0], group->block[1],
+            group->block[2], group->block[3]);
+}
+
+/* Traces the groups that carry the attribute, blocks with checkwords */
+static void
+sim_rds_write(struct fmtx_hw_sim *sim, FmtxHwAttr attr, const char *val,
+              size_t len)
+{
+  FmtxRdsGroup group;
+  unsigned int i;
+
+  switch (attr)
+  {
+    case FMTX_HW_ATTR_RDS_PI:
+      sim->rds.pi = strtoul(val, NULL, 16);
+      break;
+    case FMTX_HW_ATTR_RDS_PTY:
+      sim->rds.pty = strtoul(val, NULL, 10) & 0x1f;
+      break;
+    case FMTX_HW_ATTR_RDS_TP:
+      sim->rds.tp = val[0] == '1';
+      break;
+    case FMTX_HW_ATTR_RDS_TA:
+      sim->rds.ta = val[0] == '1';
+      break;
+    case FMTX_HW_ATTR_RDS_CT:
+    {
+      char *end;
+      time_t utc = strtoll(val, &end, 10);
+
+      if (utc)
+      {
+        fmtx_rds_encode_4a(&sim->rds, utc, strtol(end, NULL, 10), &group);
+        sim_trace_group(sim, FMTX_RDS_GROUP_4A, &group);
+      }
+
+      return;
+    }
+    case FMTX_HW_ATTR_RDS_RT_PLUS:
+    {
+      FmtxRdsTag tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+      const char *p = val;
+      unsigned long type;
+      unsigned int n = 0;
+      char *end;
+
+      /* "0" has no tags */
+      while (n < FMTX_RDS_RTPLUS_MAX_TAGS &&
+             (type = strtoul(p, &end, 10)) > 0)
+      {
+        tags[n].type = type;
+        tags[n].start = strtoul(end, &end, 10);
+        tags[n++].len = strtoul(end, &end, 10);
+        p = end;
+      }
+
+      if (!fmtx_rds_set_rtplus(&sim->rds, tags, n))
+      {
+        sim_trace(sim, "rds", "invalid RT+");
+        return;
+      }
+
+      fmtx_rds_encode_3a(&sim->rds, &group);
+      sim_trace_group(sim, FMTX_RDS_GROUP_3A, &group);
+      fmtx_rds_encode_11a(&sim->rds, &group);
+      sim_trace_group(sim, FMTX_RDS_GROUP_11A, &group);
+
+      return;
+    }
+    case FMTX_HW_ATTR_RDS_PS_NAME:
+      if (!fmtx_rds_set_ps(&sim->rds, val, strnlen(val, len)))
+      {
+        sim_trace(sim, "rds", "invalid PS");
+        return;
+      }
+
+      break;
+    case FMTX_HW_ATTR_RDS_RADIO_TEXT:
+      if (!fmtx_rds_set_rt(&sim->rds, val, strnlen(val, len)))
+      {
+        sim_trace(sim, "rds", "invalid RT");
+        return;
+      }
+
+      for (i = 0; i < sim->rds.rt_segments; i++)
+      {
+        fmtx_rds_encode_2a(&sim->rds, i, &group);
+        sim_trace_group(sim, FMTX_RDS_GROUP_2A, &group);
+      }
+
+      return;
+    default:
+      return;
+  }
+
+  for (i = 0; i < 4; i++)
+  {
+    fmtx_rds_encode_0a(&sim->rds, i, &group);
+    sim_trace_group(sim, FMTX_RDS_GROUP_0A, &group);
+  }
+}
+
+/* A floor between 20 and 31 dBuV that only depends on the channel, so
+ * repeated scans agree, plus whatever the stations spill over */
+static int
+sim_noise(struct fmtx_hw_sim *sim, unsigned int khz)
+{
+  unsigned int h = khz * 2654435761u;
+  int noise = 20 + (int)((h >> 16) % 12);
+  unsigned int i;
+
+  for (i = 0; i < sim->n_stations; i++)
+  {
+    unsigned int d = khz > sim->station[i].khz ? khz - sim->station[i].khz :
+                     sim->station[i].khz - khz;
+    int level;
+
+    if (d == 0)
+      level = sim->station[i].dbuv;
+    else if (d <= 100)
+      level = sim->station[i].dbuv - 20;
+    else if (d <= 200)
+      level = sim->station[i].dbuv - 35;
+    else
+      continue;
+
+    if (level > noise)
+      noise = level;
+  }
+
+  return noise;
+}
+
+static int
+sim_open_modulator(FmtxHw *hw)
+{
+  struct fmtx_hw_sim *sim = sim_priv(hw);
+
+  sim_trace(sim, "open", "%s", hw->device);
+  hw->attrs = (1u << FMTX_HW_ATTR_LAST) - 1;
+
+  /* Any positive number will do, it is only ever handed back to us */
+  return 1000;
+}
+
+static void
+sim_close(FmtxHw *hw)
+{
+  struct fmtx_hw_sim *sim = hw->priv;
+
+  if (sim && sim->trace)
+    fclose(sim->trace);
+}
+
+static int
+sim_write_attr(FmtxHw *hw, FmtxHwAttr attr, const void *val, size_t len)
+{
+  struct fmtx_hw_sim *sim = sim_priv(hw);
+  size_t n = len < SIM_ATTR_MAX - 1 ? len : SIM_ATTR_MAX - 1;
+
+  sim_delay(sim, len);
+
+  memcpy(sim->attr[attr], val, n);
+  sim->attr[attr][n] = 0;
+  sim_trace(sim, "write", "%s \"%s\"", fmtx_hw_attr_name(attr),
+            sim->attr[attr]);
+
+  if (sim->trace)
+    sim_rds_write(sim, attr, sim->attr[attr], n);
+
+  return 0;
+}
+
+static int
+sim_ioctl(FmtxHw *hw, unsigned long request, void *arg)
+{
+  struct fmtx_hw_sim *sim = sim_priv(hw);
+
+  sim_delay(sim, 8);
+
+  switch (request)
+  {
+    case VIDIOC_S_TUNER:
+    {
+      sim_trace(sim, "ioctl", "VIDIOC_S_TUNER");
+      return 0;
+    }
+    case VIDIOC_G_TUNER:
+    {
+      struct v4l2_tuner *tun = arg;
+
+      tun->type = V4L2_TUNER_RADIO;
+      tun->capability = V4L2_TUNER_CAP_LOW | V4L2_TUNER_CAP_STEREO;
+      tun->rangelow = 76000 * 16;
+      tun->rangehigh = 108000 * 16;
+      sim_trace(sim, "ioctl", "VIDIOC_G_TUNER");
+      return 0;
+    }
+    case VIDIOC_S_FREQUENCY:
+    {
+      struct v4l2_frequency *freq = arg;
+
+      sim->frequency = freq->frequency;
+      sim_trace(sim, "ioctl", "VIDIOC_S_FREQUENCY %u", freq->frequency);
+      return 0;
+    }
+    case VIDIOC_S_CTRL:
+    {
+      struct v4l2_control *ctl = arg;
+
+      if (ctl->id == V4L2_CID_AUDIO_MUTE)
+        sim->muted = ctl->value;
+
+      sim_trace(sim, "ioctl", "VIDIOC_S_CTRL 0x%x %d", ctl->id, ctl->value);
+      return 0;
+    }
+    case SI4713_IOC_MEASURE_RNL:
+    {
+      struct si4713_rnl *rnl = arg;
+
+      /* like the chip, this leaves the transmitter on the measured channel */
+      if (sim->measure_us)
+        sim_sleep_us(sim->measure_us);
+
+      sim->frequency = rnl->frequency;
+      rnl->rnl = sim_noise(sim, rnl->frequency / 16);
+      sim_trace(sim, "ioctl", "SI4713_IOC_MEASURE_RNL %u %d", rnl->frequency,
+                rnl->rnl);
+      return 0;
+    }
+  }
+
+  sim_trace(sim, "ioctl", "unsupported 0x%lx", request);
+  errno = EINVAL;
+
+  return -1;
+}
+
+static int
+sim_mixer_open(FmtxHw *hw)
+{
+  sim_trace(sim_priv(hw), "mixer", "open");
+
+  return 0;
+}
+
+static int
+sim_mixer_get_function(FmtxHw *hw, unsigned int *idx)
+{
+  *idx = sim_priv(hw)->mixer_function;
+
+  return 0;
+}
+
+static void
+sim_mixer_close(FmtxHw *hw)
+{
+}
+
+static int
+sim_cal_power_level(FmtxHw *hw, const char *standard)
+{
+  struct fmtx_hw_sim *sim = sim_priv(hw);
+
+  sim_trace(sim, "cal", "fmtx_pwl %s", standard);
+
+  return sim->power_level;
+}
+
+const FmtxHwOps fmtx_hw_sim_ops =
+{
+  "sim",
+  sim_open_modulator,
+  sim_close,
+  sim_write_attr,
+  sim_ioctl,
+  sim_mixer_open,
+  sim_mixer_get_function,
+  sim_mixer_close,
+  sim_cal_power_level
+};
+
+void
+fmtx_hw_sim_set_mixer_function(FmtxHw *hw, unsigned int idx)
+{
+  sim_trace(sim_priv(hw), "inject", "mixer %u", idx);
+  sim_priv(hw)->mixer_function = idx;
+}
+
+/* Adds a station or changes its level, as if the car had moved */
+void
+fmtx_hw_sim_set_noise(FmtxHw *hw, unsigned int khz, int dbuv)
+{
+  struct fmtx_hw_sim *sim = sim_priv(hw);
+  unsigned int i;
+
+  sim_trace(sim, "inject", "noise %u %d", khz, dbuv);
+
+  for (i = 0; i < sim->n_stations; i++)
+  {
+    if (sim->station[i].khz == khz)
+      break;
+  }
+
+  if (i == SIM_MAX_STATIONS)
+    return;
+
+  if (i == sim->n_stations)
+    sim->n_stations++;
+
+  sim->station[i].khz = khz;
+  sim->station[i].dbuv = dbuv;
+}
@@ -0,0 +1,288 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "hw-worker.h"
+
+/* One thread owns the hardware. Commands go to it and completions come back
+ * through two single-producer single-consumer rings, each paired with an
+ * eventfd for wakeups. Every command carries a sequence number for its
+ * collapse key, and the worker skips commands that a newer one for the same
+ * key has superseded. Because the ring is FIFO, per-key order is kept. */
+
+#define RING_SIZE 128
+
+struct command
+{
+  FmtxHwJobFunc run;
+  FmtxHwDoneFunc done;
+  void *data;
+  int key;
+  unsigned int seq;
+  int write;
+  size_t len;
+  char val[FMTX_HW_WORKER_MAX_VALUE];
+  int result;
+  int err;
+};
+
+struct ring
+{
+  unsigned int head;
+  unsigned int tail;
+  struct command cmds[RING_SIZE];
+};
+
+struct _FmtxHwWorker
+{
+  FmtxHw *hw;
+  pthread_t thread;
+  int kick_fd;
+  int done_fd;
+  int stop;
+  unsigned int submitted;
+  unsigned int completed;
+  unsigned int latest[FMTX_HW_WORKER_KEY_LAST];
+  struct ring commands;
+  struct ring completions;
+};
+
+static int
+ring_push(struct ring *ring, const struct command *cmd)
+{
+  unsigned int head = ring->head;
+
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+    return 0;
+
+  ring->cmds[head % RING_SIZE] = *cmd;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+static int
+ring_pop(struct ring *ring, struct command *cmd)
+{
+  unsigned int tail = ring->tail;
+
+  if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+    return 0;
+
+  *cmd = ring->cmds[tail % RING_SIZE];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+static void
+kick(int fd)
+{
+  uint64_t one = 1;
+
+  while (write(fd, &one, sizeof(one)) == -1 && errno == EINTR)
+    ;
+}
+
+static void
+run_command(FmtxHwWorker *worker, struct command *cmd)
+{
+  cmd->result = 0;
+  cmd->err = 0;
+
+  if (cmd->key != FMTX_HW_WORKER_KEY_NONE &&
+      __atomic_load_n(&worker->latest[cmd->key], __ATOMIC_ACQUIRE) != cmd->seq)
+    return;
+
+  if (cmd->write)
+    cmd->result = fmtx_hw_write_attr(worker->hw, cmd->key, cmd->val, cmd->len);
+  else
+    cmd->result = cmd->run(worker->hw, cmd->data);
+
+  if (cmd->result < 0)
+    cmd->err = errno;
+}
+
+static void *
+worker_main(void *data)
+{
+  FmtxHwWorker *worker = data;
+  struct command cmd;
+  uint64_t count;
+  int stop;
+
+  for (;;)
+  {
+    /* read before draining, so nothing queued ahead of the stop is lost */
+    stop = __atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE);
+
+    while (ring_pop(&worker->commands, &cmd))
+    {
+      run_command(worker, &cmd);
+
+      if (cmd.done || cmd.result < 0)
+      {
+        /* the main loop drains completions even while it waits for room
+         * in the command ring, so this can't deadlock */
+        while (!ring_push(&worker->completions, &cmd))
+          usleep(100);
+
+        kick(worker->done_fd);
+      }
+
+      __atomic_add_fetch(&worker->completed, 1, __ATOMIC_RELEASE);
+    }
+
+    if (stop)
+      break;
+
+    if (read(worker->kick_fd, &count, sizeof(count)) == -1 &&
+        errno != EINTR)
+      break;
+  }
+
+  return NULL;
+}
+
+FmtxHwWorker *
+fmtx_hw_worker_new(FmtxHw *hw)
+{
+  FmtxHwWorker *worker = calloc(1, sizeof(*worker));
+
+  if (!worker)
+    return NULL;
+
+  worker->hw = hw;
+  worker->kick_fd = eventfd(0, EFD_CLOEXEC);
+  worker->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+  if (worker->kick_fd == -1 || worker->done_fd == -1 ||
+      pthread_create(&worker->thread, NULL, worker_main, worker))
+  {
+    if (worker->kick_fd != -1)
+      close(worker->kick_fd);
+
+    if (worker->done_fd != -1)
+      close(worker->done_fd);
+
+    free(worker);
+    return NULL;
+  }
+
+  return worker;
+}
+
+void
+fmtx_hw_worker_free(FmtxHwWorker *worker)
+{
+  if (!worker)
+    return;
+
+  fmtx_hw_worker_flush(worker);
+  __atomic_store_n(&worker->stop, 1, __ATOMIC_RELEASE);
+  kick(worker->kick_fd);
+  pthread_join(worker->thread, NULL);
+
+  close(worker->kick_fd);
+  close(worker->done_fd);
+  free(worker);
+}
+
+int
+fmtx_hw_worker_get_fd(FmtxHwWorker *worker)
+{
+  return worker->done_fd;
+}
+
+void
+fmtx_hw_worker_dispatch(FmtxHwWorker *worker)
+{
+  struct command cmd;
+  uint64_t count;
+
+  if (read(worker->done_fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+    return;
+
+  while (ring_pop(&worker->completions, &cmd))
+  {
+    if (cmd.done)
+      cmd.done(cmd.data, cmd.result, cmd.err);
+    else if (cmd.write)
+      fprintf(stderr, "fmtxd Could not write %s: %s\n",
+              fmtx_hw_attr_name(cmd.key), strerror(cmd.err));
+  }
+}
+
+void
+fmtx_hw_worker_flush(FmtxHwWorker *worker)
+{
+  while (__atomic_load_n(&worker->completed, __ATOMIC_ACQUIRE) !=
+         worker->submitted)
+  {
+    fmtx_hw_worker_dispatch(worker);
+    usleep(100);
+  }
+
+  fmtx_hw_worker_dispatch(worker);
+}
+
+static void
+submit(FmtxHwWorker *worker, struct command *cmd)
+{
+  if (cmd->key != FMTX_HW_WORKER_KEY_NONE)
+  {
+    cmd->seq = worker->latest[cmd->key] + 1;
+    __atomic_store_n(&worker->latest[cmd->key], cmd->seq, __ATOMIC_RELEASE);
+  }
+
+  /* only reached with RING_SIZE commands outstanding */
+  while (!ring_push(&worker->commands, cmd))
+  {
+    fmtx_hw_worker_dispatch(worker);
+    usleep(100);
+  }
+
+  worker->submitted++;
+  kick(worker->kick_fd);
+}
+
+void
+fmtx_hw_worker_write(FmtxHwWorker *worker, FmtxHwAttr attr, const void *val,
+                     size_t len, FmtxHwDoneFunc done, void *data)
+{
+  struct command cmd;
+
+  memset(&cmd, 0, sizeof(cmd));
+
+  if (len > sizeof(cmd.val))
+    len = sizeof(cmd.val);
+
+  cmd.write = 1;
+  cmd.key = attr;
+  cmd.len = len;
+  cmd.done = done;
+  cmd.data = data;
+  memcpy(cmd.val, val, len);
+
+  submit(worker, &cmd);
+}
+
+void
+fmtx_hw_worker_job(FmtxHwWorker *worker, int key, FmtxHwJobFunc run,
+                   FmtxHwDoneFunc done, void *data)
+{
+  struct command cmd;
+
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.key = key;
+  cmd.run = run;
+  cmd.done = done;
+  cmd.data = data;
+
+  submit(worker, &cmd);
+}
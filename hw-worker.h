@@ -0,0 +1,51 @@
+#ifndef __FMTXD_HW_WORKER_H_INCLUDED__
+#define __FMTXD_HW_WORKER_H_INCLUDED__
+
+#include "hw.h"
+
+/* Large enough for the RDS radio text and its terminator */
+#define FMTX_HW_WORKER_MAX_VALUE 72
+
+/* Collapse keys. Attribute writes use their FmtxHwAttr, jobs may use one of
+ * these or FMTX_HW_WORKER_KEY_NONE. Only the newest pending command for a
+ * key is run. */
+enum
+{
+  FMTX_HW_WORKER_KEY_FREQUENCY = FMTX_HW_ATTR_LAST,
+  FMTX_HW_WORKER_KEY_LAST,
+  FMTX_HW_WORKER_KEY_NONE = -1
+};
+
+typedef struct _FmtxHwWorker FmtxHwWorker;
+
+/* Runs on the worker thread, returns < 0 and sets errno on failure */
+typedef int (*FmtxHwJobFunc)(FmtxHw *hw, void *data);
+/* Runs from fmtx_hw_worker_dispatch(). err is the errno of a failed job,
+ * superseded commands complete with result and err 0. */
+typedef void (*FmtxHwDoneFunc)(void *data, int result, int err);
+
+FmtxHwWorker *
+fmtx_hw_worker_new(FmtxHw *hw);
+/* Flushes first, so queued writes still reach the hardware */
+void
+fmtx_hw_worker_free(FmtxHwWorker *worker);
+
+/* Readable when completions are waiting for fmtx_hw_worker_dispatch() */
+int
+fmtx_hw_worker_get_fd(FmtxHwWorker *worker);
+void
+fmtx_hw_worker_dispatch(FmtxHwWorker *worker);
+/* Waits until everything queued so far has run. Only for shutdown and the
+ * simulator control interface. */
+void
+fmtx_hw_worker_flush(FmtxHwWorker *worker);
+
+/* Failed writes without a done callback are logged to stderr */
+void
+fmtx_hw_worker_write(FmtxHwWorker *worker, FmtxHwAttr attr, const void *val,
+                     size_t len, FmtxHwDoneFunc done, void *data);
+void
+fmtx_hw_worker_job(FmtxHwWorker *worker, int key, FmtxHwJobFunc run,
+                   FmtxHwDoneFunc done, void *data);
+
+#endif /* __FMTXD_HW_WORKER_H_INCLUDED__ */
@@ -0,0 +1,438 @@
+#include <alsa/asoundlib.h>
+#include <cal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "hw.h"
+
+struct cal_fmtx_power_level
+{
+  char standard[8];
+  unsigned int level;
+};
+
+struct fmtx_hw_real
+{
+  snd_mixer_t *snd_mixer;
+  snd_mixer_elem_t *mixer_elem;
+};
+
+static const char *const fmtx_hw_attr_names[FMTX_HW_ATTR_LAST] =
+{
+  "pilot_frequency",
+  "pilot_enabled",
+  "rds_pi",
+  "rds_ps_name",
+  "rds_radio_text",
+  "rds_pty",
+  "rds_tp",
+  "rds_ta",
+  "rds_ct",
+  "rds_rt_plus",
+  "region_preemphasis",
+  "power_level",
+  "tone_frequency",
+  "tone_deviation",
+  "tone_off_time",
+  "tone_on_time"
+};
+
+const char *
+fmtx_hw_attr_name(FmtxHwAttr attr)
+{
+  if (attr >= FMTX_HW_ATTR_LAST)
+    return NULL;
+
+  return fmtx_hw_attr_names[attr];
+}
+
+/* Not every si4713 driver has the RDS fields or clock time, none has RT+
+ * yet, and a write to a missing file would fail every time */
+static int
+real_open_modulator(FmtxHw *hw)
+{
+  char file[128];
+  int i;
+
+  hw->attrs = 0;
+
+  for (i = 0; i < FMTX_HW_ATTR_LAST; i++)
+  {
+    snprintf(file, sizeof(file), "%s%s", hw->sysfs_node,
+             fmtx_hw_attr_name(i));
+
+    if (!access(file, W_OK))
+      hw->attrs |= 1u << i;
+  }
+
+  return open(hw->device, O_RDONLY | O_CLOEXEC);
+}
+
+static void
+real_close(FmtxHw *hw)
+{
+  if (hw->dev_radio >= 0)
+    close(hw->dev_radio);
+}
+
+static int
+real_write_attr(FmtxHw *hw, FmtxHwAttr attr, const void *val, size_t len)
+{
+  char file[128];
+  int fd;
+  int rv;
+
+  snprintf(file, sizeof(file), "%s%s", hw->sysfs_node,
+           fmtx_hw_attr_name(attr));
+
+  fd = open(file, O_WRONLY);
+
+  if (fd == -1)
+    return -1;
+
+  rv = write(fd, val, len);
+
+  if (rv == -1)
+  {
+    int e = errno;
+
+    close(fd);
+    errno = e;
+    return -1;
+  }
+
+  close(fd);
+
+  return 0;
+}
+
+static int
+real_ioctl(FmtxHw *hw, unsigned long request, void *arg)
+{
+  return ioctl(hw->dev_radio, request, arg);
+}
+
+static int
+real_mixer_open(FmtxHw *hw)
+{
+  struct fmtx_hw_real *real = hw->priv;
+  snd_mixer_selem_id_t *sid;
+  snd_mixer_elem_t *elem;
+  char name[16];
+
+  snd_mixer_selem_id_alloca(&sid);
+  memset(sid, 0, snd_mixer_selem_id_sizeof());
+
+  sprintf(name, "hw:%i", snd_card_get_index("0"));
+
+  if (snd_mixer_open(&real->snd_mixer, 0) < 0)
+  {
+    fprintf(stderr, "fmtxd snd_mixer_open failed\n");
+    return -1;
+  }
+
+  if (snd_mixer_attach(real->snd_mixer, name) < 0)
+  {
+    fprintf(stderr, "fmtxd snd_mixer_attach failed\n");
+    return -1;
+  }
+
+  if (snd_mixer_selem_register(real->snd_mixer, 0, 0) < 0)
+  {
+    fprintf(stderr, "fmtxd snd_mixer_selem_register failed\n");
+    return -1;
+  }
+
+  if (snd_mixer_load(real->snd_mixer) < 0)
+  {
+    fprintf(stderr, "fmtxd snd_mixer_load failed\n");
+    return -1;
+  }
+
+  for (elem = snd_mixer_first_elem(real->snd_mixer); elem;
+       elem = snd_mixer_elem_next(elem))
+  {
+    snd_mixer_selem_get_id(elem, sid);
+
+    if (!strcmp(snd_mixer_selem_id_get_name(sid), "FMTX Function"))
+    {
+      real->mixer_elem = elem;
+      break;
+    }
+  }
+
+  return 0;
+}
+
+static int
+real_mixer_get_function(FmtxHw *hw, unsigned int *idx)
+{
+  struct fmtx_hw_real *real = hw->priv;
+
+  if (!real->mixer_elem)
+  {
+    errno = ENODEV;
+    return -1;
+  }
+
+  return snd_mixer_selem_get_enum_item(real->mixer_elem,
+                                       SND_MIXER_SCHN_FRONT_LEFT, idx);
+}
+
+static void
+real_mixer_close(FmtxHw *hw)
+{
+  struct fmtx_hw_real *real = hw->priv;
+
+  if (real->snd_mixer)
+    snd_mixer_close(real->snd_mixer);
+
+  real->snd_mixer = NULL;
+  real->mixer_elem = NULL;
+}
+
+static int
+real_cal_power_level(FmtxHw *hw, const char *standard)
+{
+  void *fmtx_pwl;
+  struct cal *cal;
+  unsigned long len;
+  struct cal_fmtx_power_level pl[3];
+
+  if (cal_init(&cal) < 0)
+    return -1;
+
+  if (cal_read_block(cal, "fmtx_pwl", &fmtx_pwl, &len, 0) < 0)
+  {
+    fprintf(stderr, "CAL: failed to read fmtx_pwl from cal\n");
+    cal_finish(cal);
+    return 0;
+  }
+
+  memcpy(pl, fmtx_pwl, len > sizeof(pl) ? sizeof(pl) : len);
+  free(fmtx_pwl);
+  cal_finish(cal);
+
+  /* WTF did Nokia developer do here, why is CAL std ignored? */
+  if (!memcmp(standard, "fcc", 3))
+    return pl[0].level;
+
+  if (!memcmp(standard, "etsi", 4))
+    return pl[1].level;
+
+  if (!memcmp(standard, "anfr", 4))
+    return pl[2].level;
+
+  fprintf(stderr, "FMTX: Invalid standard\n");
+
+  return 0;
+}
+
+const FmtxHwOps fmtx_hw_real_ops =
+{
+  "real",
+  real_open_modulator,
+  real_close,
+  real_write_attr,
+  real_ioctl,
+  real_mixer_open,
+  real_mixer_get_function,
+  real_mixer_close,
+  real_cal_power_level
+};
+
+static FmtxHw *
+hw_new(const FmtxHwOps *ops, int index)
+{
+  FmtxHw *hw = calloc(1, sizeof(*hw));
+
+  if (!hw)
+    return NULL;
+
+  hw->ops = ops;
+
+  if (ops == &fmtx_hw_real_ops)
+    hw->priv = calloc(1, sizeof(struct fmtx_hw_real));
+
+  snprintf(hw->name, sizeof(hw->name), "radio%d", index);
+  snprintf(hw->device, sizeof(hw->device), "/dev/%s", hw->name);
+  strcpy(hw->sysfs_node, FMTX_SYSFS_NODE);
+  hw->dev_radio = -1;
+
+  return hw;
+}
+
+static int
+use_sim(void)
+{
+  const char *backend = getenv("FMTXD_HW");
+
+  return backend && !strcmp(backend, "sim");
+}
+
+FmtxHw *
+fmtx_hw_new(void)
+{
+  return hw_new(use_sim() ? &fmtx_hw_sim_ops : &fmtx_hw_real_ops, 0);
+}
+
+/* The si4713 attributes hang off the device behind the V4L2 node. Older
+ * kernels only have them on the i2c client, which is the default. */
+static void
+real_find_sysfs_node(FmtxHw *hw)
+{
+  char node[sizeof(hw->sysfs_node)];
+  char attr[sizeof(node) + 32];
+
+  snprintf(node, sizeof(node), FMTX_V4L_CLASS "%s/device/", hw->name);
+  snprintf(attr, sizeof(attr), "%s%s", node,
+           fmtx_hw_attr_name(FMTX_HW_ATTR_PILOT_FREQUENCY));
+
+  if (!access(attr, W_OK))
+    strcpy(hw->sysfs_node, node);
+}
+
+static int
+real_is_modulator(const char *device)
+{
+  struct v4l2_capability cap;
+  int fd = open(device, O_RDONLY | O_CLOEXEC);
+  int rv;
+
+  if (fd == -1)
+    return 0;
+
+  rv = ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0 &&
+       (cap.capabilities & V4L2_CAP_MODULATOR);
+  close(fd);
+
+  return rv;
+}
+
+int
+fmtx_hw_discover(FmtxHw **hw, int max)
+{
+  char device[32];
+  int n = 0;
+  int i;
+
+  if (use_sim())
+  {
+    const char *s = getenv("FMTXD_SIM_DEVICES");
+    int count = s ? atoi(s) : 1;
+
+    for (i = 0; i < count && n < max; i++)
+    {
+      if ((hw[n] = hw_new(&fmtx_hw_sim_ops, i)))
+        n++;
+    }
+
+    return n;
+  }
+
+  for (i = 0; i < FMTX_HW_MAX_DEVICES && n < max; i++)
+  {
+    snprintf(device, sizeof(device), "/dev/radio%d", i);
+
+    if (!real_is_modulator(device) ||
+        !(hw[n] = hw_new(&fmtx_hw_real_ops, i)))
+      continue;
+
+    real_find_sysfs_node(hw[n]);
+    n++;
+  }
+
+  return n;
+}
+
+void
+fmtx_hw_free(FmtxHw *hw)
+{
+  if (!hw)
+    return;
+
+  fmtx_hw_mixer_close(hw);
+  hw->ops->close(hw);
+  free(hw->priv);
+  free(hw);
+}
+
+int
+fmtx_hw_is_sim(FmtxHw *hw)
+{
+  return hw->ops == &fmtx_hw_sim_ops;
+}
+
+int
+fmtx_hw_has_attr(FmtxHw *hw, FmtxHwAttr attr)
+{
+  return attr < FMTX_HW_ATTR_LAST && (hw->attrs & 1u << attr);
+}
+
+int
+fmtx_hw_open_modulator(FmtxHw *hw)
+{
+  hw->dev_radio = hw->ops->open_modulator(hw);
+
+  return hw->dev_radio;
+}
+
+int
+fmtx_hw_write_attr(FmtxHw *hw, FmtxHwAttr attr, const void *val, size_t len)
+{
+  hw->op_count[FMTX_HW_OP_WRITE_ATTR]++;
+  hw->attr_writes[attr]++;
+
+  return hw->ops->write_attr(hw, attr, val, len);
+}
+
+int
+fmtx_hw_ioctl(FmtxHw *hw, unsigned long request, void *arg)
+{
+  hw->op_count[FMTX_HW_OP_IOCTL]++;
+
+  return hw->ops->ioctl(hw, request, arg);
+}
+
+int
+fmtx_hw_mixer_open(FmtxHw *hw)
+{
+  hw->op_count[FMTX_HW_OP_MIXER]++;
+
+  return hw->ops->mixer_open(hw);
+}
+
+int
+fmtx_hw_mixer_get_function(FmtxHw *hw, unsigned int *idx)
+{
+  hw->op_count[FMTX_HW_OP_MIXER]++;
+
+  return hw->ops->mixer_get_function(hw, idx);
+}
+
+void
+fmtx_hw_mixer_close(FmtxHw *hw)
+{
+  hw->ops->mixer_close(hw);
+}
+
+int
+fmtx_hw_cal_power_level(FmtxHw *hw, const char *standard)
+{
+  hw->op_count[FMTX_HW_OP_CAL]++;
+
+  return hw->ops->cal_power_level(hw, standard);
+}
+
+void
+fmtx_hw_reset_counters(FmtxHw *hw)
+{
+  memset(hw->op_count, 0, sizeof(hw->op_count));
+  memset(hw->attr_writes, 0, sizeof(hw->attr_writes));
+}
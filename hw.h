@@ -0,0 +1,135 @@
+#ifndef __FMTXD_HW_H_INCLUDED__
+#define __FMTXD_HW_H_INCLUDED__
+
+#include <linux/videodev2.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FMTX_SYSFS_NODE "/sys/bus/i2c/devices/2-0063/"
+#define FMTX_V4L_CLASS "/sys/class/video4linux/"
+
+/* /dev/radio0 up to /dev/radio7 are probed */
+#define FMTX_HW_MAX_DEVICES 8
+
+/* Received noise level measurement of the si4713 driver. The chip tunes
+ * its receiver to frequency (in 62.5 Hz units), lets it settle and returns
+ * the noise in dBuV. */
+#ifndef SI4713_IOC_MEASURE_RNL
+struct si4713_rnl
+{
+  uint32_t index;
+  uint32_t frequency;
+  int32_t rnl;
+  uint32_t reserved[4];
+};
+
+#define SI4713_IOC_MEASURE_RNL \
+  _IOWR('V', BASE_VIDIOC_PRIVATE + 0, struct si4713_rnl)
+#endif
+
+typedef enum
+{
+  FMTX_HW_ATTR_PILOT_FREQUENCY,
+  FMTX_HW_ATTR_PILOT_ENABLED,
+  FMTX_HW_ATTR_RDS_PI,
+  FMTX_HW_ATTR_RDS_PS_NAME,
+  FMTX_HW_ATTR_RDS_RADIO_TEXT,
+  FMTX_HW_ATTR_RDS_PTY,
+  FMTX_HW_ATTR_RDS_TP,
+  FMTX_HW_ATTR_RDS_TA,
+  /* "<utc> <half hours>" of the minute to send in 4A groups, "0" for none */
+  FMTX_HW_ATTR_RDS_CT,
+  /* "<type> <start> <length>" of up to two RT+ tags, in characters of the
+   * radio text, "0" for none. Only the simulator has it so far. */
+  FMTX_HW_ATTR_RDS_RT_PLUS,
+  FMTX_HW_ATTR_REGION_PREEMPHASIS,
+  FMTX_HW_ATTR_POWER_LEVEL,
+  FMTX_HW_ATTR_TONE_FREQUENCY,
+  FMTX_HW_ATTR_TONE_DEVIATION,
+  FMTX_HW_ATTR_TONE_OFF_TIME,
+  FMTX_HW_ATTR_TONE_ON_TIME,
+  FMTX_HW_ATTR_LAST
+} FmtxHwAttr;
+
+typedef enum
+{
+  FMTX_HW_OP_WRITE_ATTR,
+  FMTX_HW_OP_IOCTL,
+  FMTX_HW_OP_MIXER,
+  FMTX_HW_OP_CAL,
+  FMTX_HW_OP_LAST
+} FmtxHwOp;
+
+typedef struct _FmtxHw FmtxHw;
+typedef struct _FmtxHwOps FmtxHwOps;
+
+/* All callbacks return < 0 and set errno on failure */
+struct _FmtxHwOps
+{
+  const char *name;
+  int (*open_modulator)(FmtxHw *hw);
+  void (*close)(FmtxHw *hw);
+  int (*write_attr)(FmtxHw *hw, FmtxHwAttr attr, const void *val, size_t len);
+  int (*ioctl)(FmtxHw *hw, unsigned long request, void *arg);
+  int (*mixer_open)(FmtxHw *hw);
+  int (*mixer_get_function)(FmtxHw *hw, unsigned int *idx);
+  void (*mixer_close)(FmtxHw *hw);
+  int (*cal_power_level)(FmtxHw *hw, const char *standard);
+};
+
+struct _FmtxHw
+{
+  const FmtxHwOps *ops;
+  /* radioN, also names the D-Bus object and the settings */
+  char name[16];
+  char device[32];
+  char sysfs_node[128];
+  int dev_radio;
+  /* a bit per FmtxHwAttr the driver has, known once the modulator is open */
+  uint32_t attrs;
+  void *priv;
+  unsigned int op_count[FMTX_HW_OP_LAST];
+  unsigned int attr_writes[FMTX_HW_ATTR_LAST];
+};
+
+extern const FmtxHwOps fmtx_hw_real_ops;
+extern const FmtxHwOps fmtx_hw_sim_ops;
+
+/* The first modulator, without probing */
+FmtxHw *
+fmtx_hw_new(void);
+/* Fills hw with every V4L2 modulator found, or with FMTXD_SIM_DEVICES
+ * simulated ones when FMTXD_HW=sim. Returns how many. */
+int
+fmtx_hw_discover(FmtxHw **hw, int max);
+void
+fmtx_hw_free(FmtxHw *hw);
+const char *
+fmtx_hw_attr_name(FmtxHwAttr attr);
+int
+fmtx_hw_has_attr(FmtxHw *hw, FmtxHwAttr attr);
+int
+fmtx_hw_is_sim(FmtxHw *hw);
+void
+fmtx_hw_reset_counters(FmtxHw *hw);
+void
+fmtx_hw_sim_set_mixer_function(FmtxHw *hw, unsigned int idx);
+void
+fmtx_hw_sim_set_noise(FmtxHw *hw, unsigned int khz, int dbuv);
+
+int
+fmtx_hw_open_modulator(FmtxHw *hw);
+int
+fmtx_hw_write_attr(FmtxHw *hw, FmtxHwAttr attr, const void *val, size_t len);
+int
+fmtx_hw_ioctl(FmtxHw *hw, unsigned long request, void *arg);
+int
+fmtx_hw_mixer_open(FmtxHw *hw);
+int
+fmtx_hw_mixer_get_function(FmtxHw *hw, unsigned int *idx);
+void
+fmtx_hw_mixer_close(FmtxHw *hw);
+int
+fmtx_hw_cal_power_level(FmtxHw *hw, const char *standard);
+
+#endif /* __FMTXD_HW_H_INCLUDED__ */
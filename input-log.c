@@ -0,0 +1,311 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input-log.h"
+
+/* a varint of a 64 bit value */
+#define VARINT_MAX 10
+
+static const char *const input_names[FMTX_INPUT_LAST] =
+{
+  "region",
+  "enabled",
+  "frequency",
+  "rds_ps",
+  "rds_text",
+  "rds_rotation",
+  "rds_rotation_dwell",
+  "rds_ps_text",
+  "rds_ps_mode",
+  "rds_ps_dwell",
+  "rds_pi",
+  "rds_pty",
+  "rds_tp",
+  "rds_ta",
+  "rds_ct",
+  "scan",
+  "monitor_interval",
+  "monitor_threshold",
+  "monitor_alternates",
+  "silence_timeout",
+  "silence_threshold",
+  "silence_action",
+  "audio_level",
+  "power_points",
+  "save_preset",
+  "delete_preset",
+  "apply_preset",
+  "load_schedule",
+  "governor_battery",
+  "governor_thermal",
+  "offline",
+  "call_active",
+  "jack",
+  "sink_running",
+  "mixer",
+  "call_begin",
+  "call_end"
+};
+
+static long long
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+  const char *p = buf;
+  ssize_t n;
+
+  while (len)
+  {
+    n = write(fd, p, len);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    if (n <= 0)
+      return -1;
+
+    p += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+void
+fmtx_input_log_init(FmtxInputLog *log)
+{
+  log->fd = -1;
+  log->len = 0;
+}
+
+int
+fmtx_input_log_open(FmtxInputLog *log, const char *path)
+{
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd == -1)
+    return -1;
+
+  if (write_full(fd, FMTX_INPUT_LOG_MAGIC, FMTX_INPUT_LOG_MAGIC_LEN))
+  {
+    close(fd);
+    return -1;
+  }
+
+  fmtx_input_log_close(log);
+  log->fd = fd;
+  log->len = 0;
+  log->last_ns = now_ns();
+  log->flushed_ns = log->last_ns;
+
+  return 0;
+}
+
+void
+fmtx_input_log_close(FmtxInputLog *log)
+{
+  if (log->fd == -1)
+    return;
+
+  fmtx_input_log_flush(log);
+
+  if (log->fd != -1)
+    close(log->fd);
+
+  log->fd = -1;
+}
+
+/* A log with a hole would replay wrong, so it ends at the first failure */
+void
+fmtx_input_log_flush(FmtxInputLog *log)
+{
+  if (log->fd == -1 || !log->len)
+    return;
+
+  if (write_full(log->fd, log->buf, log->len))
+  {
+    fprintf(stderr, "fmtxd Could not write the input log: %s\n",
+            strerror(errno));
+    close(log->fd);
+    log->fd = -1;
+  }
+
+  log->len = 0;
+  log->flushed_ns = log->last_ns;
+}
+
+static size_t
+put_varint(unsigned char *p, unsigned long long v)
+{
+  size_t n = 0;
+
+  while (v >= 0x80)
+  {
+    p[n++] = v | 0x80;
+    v >>= 7;
+  }
+
+  p[n++] = v;
+
+  return n;
+}
+
+void
+fmtx_input_log_write(FmtxInputLog *log, FmtxInput input,
+                     const unsigned int *u, unsigned int n_u,
+                     const char *const *s, unsigned int n_s)
+{
+  size_t size = VARINT_MAX + 2 + n_u * VARINT_MAX;
+  long long now;
+  unsigned char *p;
+  unsigned int i;
+  size_t len;
+
+  if (log->fd == -1 || n_u > FMTX_INPUT_MAX_UINTS ||
+      n_s > FMTX_INPUT_MAX_STRINGS)
+    return;
+
+  for (i = 0; i < n_s; i++)
+  {
+    if (!s[i])
+      return;
+
+    size += strlen(s[i]) + 1;
+  }
+
+  if (size > sizeof(log->buf))
+    return;
+
+  if (log->len + size > sizeof(log->buf))
+    fmtx_input_log_flush(log);
+
+  now = now_ns();
+  p = log->buf + log->len;
+  p += put_varint(p, (now - log->last_ns) / 1000);
+  *p++ = input;
+  *p++ = n_u | n_s << 4;
+
+  for (i = 0; i < n_u; i++)
+    p += put_varint(p, u[i]);
+
+  for (i = 0; i < n_s; i++)
+  {
+    len = strlen(s[i]) + 1;
+    memcpy(p, s[i], len);
+    p += len;
+  }
+
+  /* the remainder carries over, so rounding never adds up */
+  log->last_ns = now - (now - log->last_ns) % 1000;
+  log->len = p - log->buf;
+
+  if (now - log->flushed_ns >= 1000000000LL)
+    fmtx_input_log_flush(log);
+}
+
+void
+fmtx_input_log_uint(FmtxInputLog *log, FmtxInput input, unsigned int u)
+{
+  fmtx_input_log_write(log, input, &u, 1, NULL, 0);
+}
+
+void
+fmtx_input_log_string(FmtxInputLog *log, FmtxInput input, const char *s)
+{
+  fmtx_input_log_write(log, input, NULL, 0, &s, 1);
+}
+
+size_t
+fmtx_input_log_start(const char *data, size_t len)
+{
+  if (len < FMTX_INPUT_LOG_MAGIC_LEN ||
+      memcmp(data, FMTX_INPUT_LOG_MAGIC, FMTX_INPUT_LOG_MAGIC_LEN))
+    return 0;
+
+  return FMTX_INPUT_LOG_MAGIC_LEN;
+}
+
+static int
+get_varint(const char *data, size_t len, size_t *off,
+           unsigned long long *v)
+{
+  unsigned int shift = 0;
+  unsigned char c;
+
+  *v = 0;
+
+  do
+  {
+    if (*off == len || shift >= 64)
+      return -1;
+
+    c = data[(*off)++];
+    *v |= (unsigned long long)(c & 0x7f) << shift;
+    shift += 7;
+  }
+  while (c & 0x80);
+
+  return 0;
+}
+
+int
+fmtx_input_log_next(const char *data, size_t len, size_t *off,
+                    FmtxInputEvent *ev)
+{
+  unsigned long long v;
+  unsigned int i;
+  const char *end;
+
+  if (*off == len)
+    return 0;
+
+  if (get_varint(data, len, off, &v) || len - *off < 2)
+    return -1;
+
+  ev->time_us += v;
+  ev->input = (unsigned char)data[(*off)++];
+  ev->n_u = data[*off] & 0x0f;
+  ev->n_s = (unsigned char)data[(*off)++] >> 4;
+
+  /* inputs from a newer fmtxd are still well formed, just unknown */
+  if (ev->n_s > FMTX_INPUT_MAX_STRINGS)
+    return -1;
+
+  for (i = 0; i < ev->n_u; i++)
+  {
+    if (get_varint(data, len, off, &v) || v > 0xffffffffULL)
+      return -1;
+
+    ev->u[i] = v;
+  }
+
+  for (i = 0; i < ev->n_s; i++)
+  {
+    if (!(end = memchr(data + *off, 0, len - *off)))
+      return -1;
+
+    ev->s[i] = data + *off;
+    *off = end - data + 1;
+  }
+
+  return 1;
+}
+
+const char *
+fmtx_input_name(FmtxInput input)
+{
+  return input < FMTX_INPUT_LAST ? input_names[input] : "unknown";
+}
@@ -0,0 +1,133 @@
+#ifndef __FMTXD_INPUT_LOG_H_INCLUDED__
+#define __FMTXD_INPUT_LOG_H_INCLUDED__
+
+#include <stddef.h>
+
+/* Every input of an engine with the time it arrived, for replaying against
+ * the simulated hardware with fmtx_replay. The file starts with
+ * FMTX_INPUT_LOG_MAGIC, then one record per input:
+ *
+ *   varint   microseconds since the previous record
+ *   byte     FmtxInput
+ *   byte     number of integers, number of strings << 4
+ *   varint   each integer
+ *   bytes    each string, NUL terminated
+ *
+ * Varints are LEB128, so a meter block 20 ms after the last one takes seven
+ * bytes. Records are buffered and written at most a second late. */
+
+#define FMTX_INPUT_LOG_MAGIC "FMTXIN1\n"
+#define FMTX_INPUT_LOG_MAGIC_LEN 8
+/* the largest bounded input is a schedule or a rotation, about 4 KiB */
+#define FMTX_INPUT_LOG_BUFFER 16384
+#define FMTX_INPUT_MAX_UINTS 15
+#define FMTX_INPUT_MAX_STRINGS 3
+
+/* Stored in the log, so only ever appended to */
+typedef enum
+{
+  /* region as unsigned, frequency */
+  FMTX_INPUT_REGION,
+  FMTX_INPUT_ENABLED,
+  FMTX_INPUT_FREQUENCY,
+  FMTX_INPUT_RDS_PS,
+  /* the text, then type, start and length of each RT+ tag */
+  FMTX_INPUT_RDS_TEXT,
+  FMTX_INPUT_RDS_ROTATION,
+  FMTX_INPUT_RDS_ROTATION_DWELL,
+  FMTX_INPUT_RDS_PS_TEXT,
+  FMTX_INPUT_RDS_PS_MODE,
+  FMTX_INPUT_RDS_PS_DWELL,
+  FMTX_INPUT_RDS_PI,
+  FMTX_INPUT_RDS_PTY,
+  FMTX_INPUT_RDS_TP,
+  FMTX_INPUT_RDS_TA,
+  FMTX_INPUT_RDS_CT,
+  /* max_age, count */
+  FMTX_INPUT_SCAN,
+  FMTX_INPUT_MONITOR_INTERVAL,
+  FMTX_INPUT_MONITOR_THRESHOLD,
+  FMTX_INPUT_MONITOR_ALTERNATES,
+  FMTX_INPUT_SILENCE_TIMEOUT,
+  FMTX_INPUT_SILENCE_THRESHOLD,
+  FMTX_INPUT_SILENCE_ACTION,
+  /* rms_db, peak_db */
+  FMTX_INPUT_AUDIO_LEVEL,
+  FMTX_INPUT_POWER_POINTS,
+  /* name, rds_ps, rds_text; frequency, power_level, preemphasis */
+  FMTX_INPUT_SAVE_PRESET,
+  FMTX_INPUT_DELETE_PRESET,
+  FMTX_INPUT_APPLY_PRESET,
+  /* the schedule that was loaded, in the file's syntax */
+  FMTX_INPUT_LOAD_SCHEDULE,
+  FMTX_INPUT_GOVERNOR_BATTERY,
+  FMTX_INPUT_GOVERNOR_THERMAL,
+  FMTX_INPUT_OFFLINE,
+  FMTX_INPUT_CALL_ACTIVE,
+  FMTX_INPUT_JACK,
+  FMTX_INPUT_SINK_RUNNING,
+  /* a new mixer function from the poll, which the simulation can't know */
+  FMTX_INPUT_MIXER,
+  FMTX_INPUT_CALL_BEGIN,
+  FMTX_INPUT_CALL_END,
+  FMTX_INPUT_LAST
+} FmtxInput;
+
+typedef struct
+{
+  int fd;
+  /* CLOCK_MONOTONIC ns of the last record and the last write */
+  long long last_ns;
+  long long flushed_ns;
+  size_t len;
+  unsigned char buf[FMTX_INPUT_LOG_BUFFER];
+} FmtxInputLog;
+
+/* One record as read back, the strings point into the log */
+typedef struct
+{
+  FmtxInput input;
+  /* since the first record */
+  long long time_us;
+  unsigned int n_u;
+  unsigned int u[FMTX_INPUT_MAX_UINTS];
+  unsigned int n_s;
+  const char *s[FMTX_INPUT_MAX_STRINGS];
+} FmtxInputEvent;
+
+/* Closed, writing does nothing */
+void
+fmtx_input_log_init(FmtxInputLog *log);
+/* Truncates path. Returns -1 with errno set on failure. */
+int
+fmtx_input_log_open(FmtxInputLog *log, const char *path);
+void
+fmtx_input_log_close(FmtxInputLog *log);
+void
+fmtx_input_log_flush(FmtxInputLog *log);
+
+/* A record too large for the buffer is dropped, it can only be an input
+ * the engine refuses anyway */
+void
+fmtx_input_log_write(FmtxInputLog *log, FmtxInput input,
+                     const unsigned int *u, unsigned int n_u,
+                     const char *const *s, unsigned int n_s);
+void
+fmtx_input_log_uint(FmtxInputLog *log, FmtxInput input, unsigned int u);
+void
+fmtx_input_log_string(FmtxInputLog *log, FmtxInput input, const char *s);
+
+/* Returns the offset of the first record, 0 if data isn't a log */
+size_t
+fmtx_input_log_start(const char *data, size_t len);
+/* Decodes the record at *off and moves past it, ev->input may be past
+ * FMTX_INPUT_LAST. Returns 1 for a record, 0 at the end and -1 if the log
+ * is corrupt or cut short. ev->time_us has to start at 0. */
+int
+fmtx_input_log_next(const char *data, size_t len, size_t *off,
+                    FmtxInputEvent *ev);
+
+const char *
+fmtx_input_name(FmtxInput input);
+
+#endif /* __FMTXD_INPUT_LOG_H_INCLUDED__ */
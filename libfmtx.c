@@ -0,0 +1,954 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmtxd.h"
+
+#define PROPERTIES_IF "org.freedesktop.DBus.Properties"
+/* a full scan of the band measures a couple of hundred channels */
+#define SCAN_TIMEOUT 120000
+
+enum
+{
+  PROP_VERSION,
+  PROP_FREQUENCY,
+  PROP_FREQ_MAX,
+  PROP_FREQ_MIN,
+  PROP_FREQ_STEP,
+  PROP_STATE,
+  PROP_STARTABLE,
+  PROP_RDS_PS,
+  PROP_RDS_TEXT,
+  PROP_LAST
+};
+
+static const char *const properties[PROP_LAST] =
+{
+  "version",
+  "frequency",
+  "freq_max",
+  "freq_min",
+  "freq_step",
+  "state",
+  "startable",
+  "rds_ps",
+  "rds_text"
+};
+
+struct _FmtxClient
+{
+  DBusGConnection *dbus;
+  DBusGProxy *proxy;
+  DBusGProxy *device;
+  GValue cache[PROP_LAST];
+  DBusGProxyCall *refresh_call;
+  gboolean refresh_pending;
+  gboolean refresh_dirty;
+  FmtxClientChangedCallback changed_cb;
+  gpointer changed_data;
+  FmtxClientErrorCallback error_cb;
+  gpointer error_data;
+};
+
+struct _FmtxClientBatch
+{
+  FmtxClient *client;
+  GPtrArray *names;
+  GArray *values;
+  guint pending;
+  GError *error;
+  FmtxClientCallback cb;
+  gpointer user_data;
+};
+
+struct async_call
+{
+  FmtxClient *client;
+  FmtxClientCallback cb;
+  FmtxClientValueCallback value_cb;
+  gpointer user_data;
+};
+
+static GType
+properties_map_type(void)
+{
+  return dbus_g_type_get_map("GHashTable", G_TYPE_STRING, G_TYPE_VALUE);
+}
+
+static int
+property_index(const char *property)
+{
+  int i;
+
+  for (i = 0; i < PROP_LAST; i++)
+  {
+    if (g_str_equal(properties[i], property))
+      return i;
+  }
+
+  return -1;
+}
+
+gboolean
+fmtx_client_property_is_uint(const char *property)
+{
+  return g_str_equal(property, "version") ||
+         g_str_has_prefix(property, "freq") ||
+         g_str_has_suffix(property, "_dwell") ||
+         g_str_equal(property, "rds_jitter") ||
+         g_str_equal(property, "rds_pty") ||
+         g_str_equal(property, "rds_tp") ||
+         g_str_equal(property, "rds_ta") ||
+         g_str_equal(property, "rds_ct") ||
+         g_str_has_prefix(property, "monitor_") ||
+         g_str_has_prefix(property, "audio_") ||
+         (g_str_has_prefix(property, "silence_") &&
+          !g_str_equal(property, "silence_action")) ||
+         g_str_equal(property, "governor_level") ||
+         g_str_equal(property, "power_level") ||
+         g_str_equal(property, "schedule_next");
+}
+
+gchar *
+fmtx_client_value_to_string(const GValue *value)
+{
+  if (G_VALUE_HOLDS(value, G_TYPE_STRING))
+    return g_value_dup_string(value);
+
+  if (G_VALUE_HOLDS(value, G_TYPE_UINT))
+    return g_strdup_printf("%u", g_value_get_uint(value));
+
+  return g_strdup_value_contents(value);
+}
+
+static void
+update_cache(FmtxClient *client, GHashTable *props)
+{
+  int i;
+
+  for (i = 0; i < PROP_LAST; i++)
+  {
+    GValue *v = g_hash_table_lookup(props, properties[i]);
+
+    if (!v)
+      continue;
+
+    if (G_IS_VALUE(&client->cache[i]))
+      g_value_unset(&client->cache[i]);
+
+    g_value_init(&client->cache[i], G_VALUE_TYPE(v));
+    g_value_copy(v, &client->cache[i]);
+  }
+}
+
+static void
+refresh(FmtxClient *client);
+
+static void
+refresh_cb(DBusGProxy *proxy, DBusGProxyCall *call, gpointer data)
+{
+  FmtxClient *client = data;
+  GHashTable *props = NULL;
+
+  client->refresh_pending = FALSE;
+  client->refresh_call = NULL;
+
+  if (dbus_g_proxy_end_call(proxy, call, NULL,
+                            properties_map_type(), &props, G_TYPE_INVALID))
+  {
+    update_cache(client, props);
+    g_hash_table_destroy(props);
+
+    if (client->changed_cb)
+      client->changed_cb(client, client->changed_data);
+  }
+
+  if (client->refresh_dirty)
+  {
+    client->refresh_dirty = FALSE;
+    refresh(client);
+  }
+}
+
+static void
+refresh(FmtxClient *client)
+{
+  /* Changed carries no payload, so collapse bursts into one GetAll */
+  if (client->refresh_pending)
+  {
+    client->refresh_dirty = TRUE;
+    return;
+  }
+
+  client->refresh_pending = TRUE;
+  client->refresh_call = dbus_g_proxy_begin_call(client->proxy, "GetAll",
+                                                 refresh_cb, client, NULL,
+                                                 G_TYPE_STRING, PROPERTIES_IF,
+                                                 G_TYPE_INVALID);
+}
+
+static void
+changed_cb(DBusGProxy *proxy, gpointer data)
+{
+  refresh(data);
+}
+
+static void
+error_cb(DBusGProxy *proxy, const char *message, gpointer data)
+{
+  FmtxClient *client = data;
+
+  if (client->error_cb)
+    client->error_cb(client, message, client->error_data);
+}
+
+FmtxClient *
+fmtx_client_new(DBusGConnection *dbus, FmtxClientFlags flags, GError **error)
+{
+  FmtxClient *client = g_new0(FmtxClient, 1);
+
+  client->dbus = dbus_g_connection_ref(dbus);
+  client->proxy = dbus_g_proxy_new_for_name(dbus,
+                                            FMTX_SERVICE,
+                                            FMTX_OBJECT_PATH,
+                                            PROPERTIES_IF);
+
+  if (flags & FMTX_CLIENT_NO_CACHE)
+    return client;
+
+  client->device = dbus_g_proxy_new_for_name(dbus,
+                                             FMTX_SERVICE,
+                                             FMTX_OBJECT_PATH,
+                                             FMTX_DEVICE_INTERFACE);
+
+  dbus_g_proxy_add_signal(client->device, "Changed", G_TYPE_INVALID);
+  dbus_g_proxy_connect_signal(client->device, "Changed",
+                              G_CALLBACK(changed_cb), client, NULL);
+  dbus_g_proxy_add_signal(client->device, "Error", G_TYPE_STRING,
+                          G_TYPE_INVALID);
+  dbus_g_proxy_connect_signal(client->device, "Error",
+                              G_CALLBACK(error_cb), client, NULL);
+
+  if (!fmtx_client_refresh(client, error))
+  {
+    fmtx_client_free(client);
+    return NULL;
+  }
+
+  return client;
+}
+
+void
+fmtx_client_free(FmtxClient *client)
+{
+  int i;
+
+  if (!client)
+    return;
+
+  if (client->refresh_call)
+    dbus_g_proxy_cancel_call(client->proxy, client->refresh_call);
+
+  if (client->device)
+    g_object_unref(client->device);
+
+  g_object_unref(client->proxy);
+  dbus_g_connection_unref(client->dbus);
+
+  for (i = 0; i < PROP_LAST; i++)
+  {
+    if (G_IS_VALUE(&client->cache[i]))
+      g_value_unset(&client->cache[i]);
+  }
+
+  g_free(client);
+}
+
+DBusGProxy *
+fmtx_client_get_proxy(FmtxClient *client)
+{
+  return client->proxy;
+}
+
+void
+fmtx_client_set_changed_callback(FmtxClient *client,
+                                 FmtxClientChangedCallback cb,
+                                 gpointer user_data)
+{
+  client->changed_cb = cb;
+  client->changed_data = user_data;
+}
+
+void
+fmtx_client_set_error_callback(FmtxClient *client,
+                               FmtxClientErrorCallback cb,
+                               gpointer user_data)
+{
+  client->error_cb = cb;
+  client->error_data = user_data;
+}
+
+const GValue *
+fmtx_client_get_cached(FmtxClient *client, const char *property)
+{
+  int i = property_index(property);
+
+  if (i < 0 || !G_IS_VALUE(&client->cache[i]))
+    return NULL;
+
+  return &client->cache[i];
+}
+
+static guint
+cached_uint(FmtxClient *client, int i)
+{
+  if (!G_VALUE_HOLDS(&client->cache[i], G_TYPE_UINT))
+    return 0;
+
+  return g_value_get_uint(&client->cache[i]);
+}
+
+static const char *
+cached_string(FmtxClient *client, int i)
+{
+  if (!G_VALUE_HOLDS(&client->cache[i], G_TYPE_STRING))
+    return NULL;
+
+  return g_value_get_string(&client->cache[i]);
+}
+
+guint
+fmtx_client_get_version(FmtxClient *client)
+{
+  return cached_uint(client, PROP_VERSION);
+}
+
+guint
+fmtx_client_get_frequency(FmtxClient *client)
+{
+  return cached_uint(client, PROP_FREQUENCY);
+}
+
+guint
+fmtx_client_get_freq_min(FmtxClient *client)
+{
+  return cached_uint(client, PROP_FREQ_MIN);
+}
+
+guint
+fmtx_client_get_freq_max(FmtxClient *client)
+{
+  return cached_uint(client, PROP_FREQ_MAX);
+}
+
+guint
+fmtx_client_get_freq_step(FmtxClient *client)
+{
+  return cached_uint(client, PROP_FREQ_STEP);
+}
+
+const char *
+fmtx_client_get_state(FmtxClient *client)
+{
+  return cached_string(client, PROP_STATE);
+}
+
+const char *
+fmtx_client_get_startable(FmtxClient *client)
+{
+  return cached_string(client, PROP_STARTABLE);
+}
+
+const char *
+fmtx_client_get_rds_ps(FmtxClient *client)
+{
+  return cached_string(client, PROP_RDS_PS);
+}
+
+const char *
+fmtx_client_get_rds_text(FmtxClient *client)
+{
+  return cached_string(client, PROP_RDS_TEXT);
+}
+
+gboolean
+fmtx_client_get_all(FmtxClient *client, GHashTable **props, GError **error)
+{
+  return dbus_g_proxy_call(client->proxy, "GetAll", error,
+                           G_TYPE_STRING, PROPERTIES_IF,
+                           G_TYPE_INVALID,
+                           properties_map_type(), props,
+                           G_TYPE_INVALID);
+}
+
+gboolean
+fmtx_client_refresh(FmtxClient *client, GError **error)
+{
+  GHashTable *props = NULL;
+
+  if (!fmtx_client_get_all(client, &props, error))
+    return FALSE;
+
+  update_cache(client, props);
+  g_hash_table_destroy(props);
+
+  return TRUE;
+}
+
+gboolean
+fmtx_client_get_property(FmtxClient *client, const char *property,
+                         GValue *value, GError **error)
+{
+  return dbus_g_proxy_call(client->proxy, "Get", error,
+                           G_TYPE_STRING, PROPERTIES_IF,
+                           G_TYPE_STRING, property,
+                           G_TYPE_INVALID,
+                           G_TYPE_VALUE, value,
+                           G_TYPE_INVALID);
+}
+
+gboolean
+fmtx_client_set_property(FmtxClient *client, const char *property,
+                         const GValue *value, GError **error)
+{
+  return dbus_g_proxy_call(client->proxy, "Set", error,
+                           G_TYPE_STRING, PROPERTIES_IF,
+                           G_TYPE_STRING, property,
+                           G_TYPE_VALUE, value,
+                           G_TYPE_INVALID,
+                           G_TYPE_INVALID);
+}
+
+gboolean
+fmtx_client_scan_channels(FmtxClient *client, guint max_age, guint count,
+                          GArray **frequencies, GArray **noise,
+                          GError **error)
+{
+  DBusGProxy *device = dbus_g_proxy_new_from_proxy(client->proxy,
+                                                   FMTX_DEVICE_INTERFACE,
+                                                   NULL);
+  gboolean rv;
+
+  rv = dbus_g_proxy_call_with_timeout(device, "ScanChannels", SCAN_TIMEOUT,
+                                      error,
+                                      G_TYPE_UINT, max_age,
+                                      G_TYPE_UINT, count,
+                                      G_TYPE_INVALID,
+                                      DBUS_TYPE_G_UINT_ARRAY, frequencies,
+                                      DBUS_TYPE_G_INT_ARRAY, noise,
+                                      G_TYPE_INVALID);
+  g_object_unref(device);
+
+  return rv;
+}
+
+gboolean
+fmtx_client_save_preset(FmtxClient *client, const char *name,
+                        guint frequency, guint power_level, guint preemphasis,
+                        const char *rds_ps, const char *rds_text,
+                        GError **error)
+{
+  DBusGProxy *device = dbus_g_proxy_new_from_proxy(client->proxy,
+                                                   FMTX_DEVICE_INTERFACE,
+                                                   NULL);
+  gboolean rv;
+
+  rv = dbus_g_proxy_call(device, "SavePreset", error,
+                         G_TYPE_STRING, name,
+                         G_TYPE_UINT, frequency,
+                         G_TYPE_UINT, power_level,
+                         G_TYPE_UINT, preemphasis,
+                         G_TYPE_STRING, rds_ps,
+                         G_TYPE_STRING, rds_text,
+                         G_TYPE_INVALID,
+                         G_TYPE_INVALID);
+  g_object_unref(device);
+
+  return rv;
+}
+
+static gboolean
+preset_call(FmtxClient *client, const char *method, const char *name,
+            GError **error)
+{
+  DBusGProxy *device = dbus_g_proxy_new_from_proxy(client->proxy,
+                                                   FMTX_DEVICE_INTERFACE,
+                                                   NULL);
+  gboolean rv;
+
+  rv = dbus_g_proxy_call(device, method, error,
+                         G_TYPE_STRING, name,
+                         G_TYPE_INVALID,
+                         G_TYPE_INVALID);
+  g_object_unref(device);
+
+  return rv;
+}
+
+gboolean
+fmtx_client_delete_preset(FmtxClient *client, const char *name,
+                          GError **error)
+{
+  return preset_call(client, "DeletePreset", name, error);
+}
+
+gboolean
+fmtx_client_apply_preset(FmtxClient *client, const char *name,
+                         GError **error)
+{
+  return preset_call(client, "ApplyPreset", name, error);
+}
+
+gboolean
+fmtx_client_reload_schedule(FmtxClient *client, GError **error)
+{
+  DBusGProxy *device = dbus_g_proxy_new_from_proxy(client->proxy,
+                                                   FMTX_DEVICE_INTERFACE,
+                                                   NULL);
+  gboolean rv;
+
+  rv = dbus_g_proxy_call(device, "ReloadSchedule", error,
+                         G_TYPE_INVALID,
+                         G_TYPE_INVALID);
+  g_object_unref(device);
+
+  return rv;
+}
+
+static void
+get_property_cb(DBusGProxy *proxy, DBusGProxyCall *call, gpointer data)
+{
+  struct async_call *c = data;
+  GValue value = { 0, };
+  GError *error = NULL;
+
+  if (dbus_g_proxy_end_call(proxy, call, &error,
+                            G_TYPE_VALUE, &value, G_TYPE_INVALID))
+  {
+    c->value_cb(c->client, &value, NULL, c->user_data);
+    g_value_unset(&value);
+  }
+  else
+  {
+    c->value_cb(c->client, NULL, error, c->user_data);
+    g_clear_error(&error);
+  }
+}
+
+void
+fmtx_client_get_property_async(FmtxClient *client, const char *property,
+                               FmtxClientValueCallback cb,
+                               gpointer user_data)
+{
+  struct async_call *c = g_new0(struct async_call, 1);
+
+  c->client = client;
+  c->value_cb = cb;
+  c->user_data = user_data;
+
+  dbus_g_proxy_begin_call(client->proxy, "Get", get_property_cb, c, g_free,
+                          G_TYPE_STRING, PROPERTIES_IF,
+                          G_TYPE_STRING, property,
+                          G_TYPE_INVALID);
+}
+
+static void
+set_property_cb(DBusGProxy *proxy, DBusGProxyCall *call, gpointer data)
+{
+  struct async_call *c = data;
+  GError *error = NULL;
+
+  dbus_g_proxy_end_call(proxy, call, &error, G_TYPE_INVALID);
+
+  if (c->cb)
+    c->cb(c->client, error, c->user_data);
+
+  g_clear_error(&error);
+}
+
+void
+fmtx_client_set_property_async(FmtxClient *client, const char *property,
+                               const GValue *value, FmtxClientCallback cb,
+                               gpointer user_data)
+{
+  struct async_call *c = g_new0(struct async_call, 1);
+
+  c->client = client;
+  c->cb = cb;
+  c->user_data = user_data;
+
+  dbus_g_proxy_begin_call(client->proxy, "Set", set_property_cb, c, g_free,
+                          G_TYPE_STRING, PROPERTIES_IF,
+                          G_TYPE_STRING, property,
+                          G_TYPE_VALUE, value,
+                          G_TYPE_INVALID);
+}
+
+static gboolean
+set_uint(FmtxClient *client, const char *property, guint u, GError **error)
+{
+  GValue value = { 0, };
+  gboolean rv;
+
+  g_value_init(&value, G_TYPE_UINT);
+  g_value_set_uint(&value, u);
+  rv = fmtx_client_set_property(client, property, &value, error);
+  g_value_unset(&value);
+
+  return rv;
+}
+
+static gboolean
+set_string(FmtxClient *client, const char *property, const char *s,
+           GError **error)
+{
+  GValue value = { 0, };
+  gboolean rv;
+
+  g_value_init(&value, G_TYPE_STRING);
+  g_value_set_string(&value, s);
+  rv = fmtx_client_set_property(client, property, &value, error);
+  g_value_unset(&value);
+
+  return rv;
+}
+
+static void
+set_uint_async(FmtxClient *client, const char *property, guint u,
+               FmtxClientCallback cb, gpointer user_data)
+{
+  GValue value = { 0, };
+
+  g_value_init(&value, G_TYPE_UINT);
+  g_value_set_uint(&value, u);
+  fmtx_client_set_property_async(client, property, &value, cb, user_data);
+  g_value_unset(&value);
+}
+
+static void
+set_string_async(FmtxClient *client, const char *property, const char *s,
+                 FmtxClientCallback cb, gpointer user_data)
+{
+  GValue value = { 0, };
+
+  g_value_init(&value, G_TYPE_STRING);
+  g_value_set_string(&value, s);
+  fmtx_client_set_property_async(client, property, &value, cb, user_data);
+  g_value_unset(&value);
+}
+
+gboolean
+fmtx_client_set_frequency(FmtxClient *client, guint frequency, GError **error)
+{
+  return set_uint(client, "frequency", frequency, error);
+}
+
+gboolean
+fmtx_client_set_state(FmtxClient *client, const char *state, GError **error)
+{
+  return set_string(client, "state", state, error);
+}
+
+gboolean
+fmtx_client_set_rds_ps(FmtxClient *client, const char *rds_ps, GError **error)
+{
+  return set_string(client, "rds_ps", rds_ps, error);
+}
+
+gboolean
+fmtx_client_set_rds_text(FmtxClient *client, const char *rds_text,
+                         GError **error)
+{
+  return set_string(client, "rds_text", rds_text, error);
+}
+
+void
+fmtx_client_set_frequency_async(FmtxClient *client, guint frequency,
+                                FmtxClientCallback cb, gpointer user_data)
+{
+  set_uint_async(client, "frequency", frequency, cb, user_data);
+}
+
+void
+fmtx_client_set_state_async(FmtxClient *client, const char *state,
+                            FmtxClientCallback cb, gpointer user_data)
+{
+  set_string_async(client, "state", state, cb, user_data);
+}
+
+void
+fmtx_client_set_rds_ps_async(FmtxClient *client, const char *rds_ps,
+                             FmtxClientCallback cb, gpointer user_data)
+{
+  set_string_async(client, "rds_ps", rds_ps, cb, user_data);
+}
+
+void
+fmtx_client_set_rds_text_async(FmtxClient *client, const char *rds_text,
+                               FmtxClientCallback cb, gpointer user_data)
+{
+  set_string_async(client, "rds_text", rds_text, cb, user_data);
+}
+
+FmtxClientBatch *
+fmtx_client_batch_new(FmtxClient *client)
+{
+  FmtxClientBatch *batch = g_new0(FmtxClientBatch, 1);
+
+  batch->client = client;
+  batch->names = g_ptr_array_new_with_free_func(g_free);
+  batch->values = g_array_new(FALSE, TRUE, sizeof(GValue));
+
+  return batch;
+}
+
+static GValue *
+batch_add(FmtxClientBatch *batch, const char *property, GType type)
+{
+  GValue *value;
+
+  g_ptr_array_add(batch->names, g_strdup(property));
+  g_array_set_size(batch->values, batch->values->len + 1);
+  value = &g_array_index(batch->values, GValue, batch->values->len - 1);
+
+  return g_value_init(value, type);
+}
+
+void
+fmtx_client_batch_set_uint(FmtxClientBatch *batch, const char *property,
+                           guint value)
+{
+  g_value_set_uint(batch_add(batch, property, G_TYPE_UINT), value);
+}
+
+void
+fmtx_client_batch_set_string(FmtxClientBatch *batch, const char *property,
+                             const char *value)
+{
+  g_value_set_string(batch_add(batch, property, G_TYPE_STRING), value);
+}
+
+static void
+batch_free(FmtxClientBatch *batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->values->len; i++)
+    g_value_unset(&g_array_index(batch->values, GValue, i));
+
+  g_array_free(batch->values, TRUE);
+  g_ptr_array_free(batch->names, TRUE);
+  g_clear_error(&batch->error);
+  g_free(batch);
+}
+
+static void
+batch_set_cb(FmtxClient *client, const GError *error, gpointer data)
+{
+  FmtxClientBatch *batch = data;
+
+  if (error && !batch->error)
+    batch->error = g_error_copy(error);
+
+  if (--batch->pending)
+    return;
+
+  if (batch->cb)
+    batch->cb(client, batch->error, batch->user_data);
+
+  batch_free(batch);
+}
+
+void
+fmtx_client_batch_apply(FmtxClientBatch *batch, FmtxClientCallback cb,
+                        gpointer user_data)
+{
+  guint i;
+
+  batch->cb = cb;
+  batch->user_data = user_data;
+
+  if (!batch->values->len)
+  {
+    if (cb)
+      cb(batch->client, NULL, user_data);
+
+    batch_free(batch);
+    return;
+  }
+
+  /* all calls are queued before any reply can be dispatched */
+  batch->pending = batch->values->len;
+
+  for (i = 0; i < batch->values->len; i++)
+    fmtx_client_set_property_async(batch->client,
+                                   g_ptr_array_index(batch->names, i),
+                                   &g_array_index(batch->values, GValue, i),
+                                   batch_set_cb, batch);
+}
+
+struct _FmtxStatus
+{
+  int fd;
+  int inotify_fd;
+  FmtxStatusPage *page;
+  guint watch;
+  FmtxStatusCallback cb;
+  gpointer user_data;
+};
+
+FmtxStatus *
+fmtx_status_open(const char *path, GError **error)
+{
+  FmtxStatus *status;
+  struct stat st;
+  int fd;
+
+  if (!path)
+    path = g_getenv("FMTXD_STATUS_PATH");
+
+  if (!path)
+    path = FMTX_STATUS_PATH;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+  {
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                "Can't open status page %s: %s", path, g_strerror(errno));
+    return NULL;
+  }
+
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(FmtxStatusPage))
+  {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "Status page %s is truncated", path);
+    close(fd);
+    return NULL;
+  }
+
+  status = g_new0(FmtxStatus, 1);
+  status->fd = fd;
+  status->page = mmap(NULL, sizeof(FmtxStatusPage), PROT_READ, MAP_SHARED,
+                      fd, 0);
+
+  if (status->page == MAP_FAILED)
+  {
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                "Can't map status page %s: %s", path, g_strerror(errno));
+    close(fd);
+    g_free(status);
+    return NULL;
+  }
+
+  /* fmtxd touches the page after every update */
+  status->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if (status->inotify_fd != -1)
+    inotify_add_watch(status->inotify_fd, path, IN_ATTRIB);
+
+  return status;
+}
+
+void
+fmtx_status_close(FmtxStatus *status)
+{
+  if (!status)
+    return;
+
+  if (status->watch)
+    g_source_remove(status->watch);
+
+  if (status->inotify_fd != -1)
+    close(status->inotify_fd);
+
+  munmap(status->page, sizeof(FmtxStatusPage));
+  close(status->fd);
+  g_free(status);
+}
+
+gboolean
+fmtx_status_read(FmtxStatus *status, FmtxStatusPage *snapshot)
+{
+  char buf[256];
+  guint32 seq;
+  int tries;
+
+  if (status->inotify_fd != -1)
+  {
+    while (read(status->inotify_fd, buf, sizeof(buf)) > 0)
+      ;
+  }
+
+  for (tries = 0; tries < 1000; tries++)
+  {
+    seq = __atomic_load_n(&status->page->seq, __ATOMIC_ACQUIRE);
+
+    if (seq & 1)
+    {
+      sched_yield();
+      continue;
+    }
+
+    memcpy(snapshot, status->page, sizeof(*snapshot));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&status->page->seq, __ATOMIC_RELAXED) == seq)
+      break;
+  }
+
+  /* a writer that died halfway leaves seq odd for good */
+  if (tries == 1000)
+    return FALSE;
+
+  snapshot->state[sizeof(snapshot->state) - 1] = 0;
+  snapshot->startable[sizeof(snapshot->startable) - 1] = 0;
+  snapshot->rds_ps[sizeof(snapshot->rds_ps) - 1] = 0;
+  snapshot->rds_text[sizeof(snapshot->rds_text) - 1] = 0;
+
+  return snapshot->magic == FMTX_STATUS_MAGIC &&
+         snapshot->version == FMTX_STATUS_VERSION && snapshot->pid;
+}
+
+int
+fmtx_status_get_fd(FmtxStatus *status)
+{
+  return status->inotify_fd;
+}
+
+static gboolean
+status_changed_cb(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  FmtxStatus *status = data;
+  char buf[256];
+
+  while (read(status->inotify_fd, buf, sizeof(buf)) > 0)
+    ;
+
+  if (status->cb)
+    status->cb(status, status->user_data);
+
+  return TRUE;
+}
+
+void
+fmtx_status_set_changed_callback(FmtxStatus *status, FmtxStatusCallback cb,
+                                 gpointer user_data)
+{
+  GIOChannel *channel;
+
+  status->cb = cb;
+  status->user_data = user_data;
+
+  if (status->watch || status->inotify_fd == -1)
+    return;
+
+  channel = g_io_channel_unix_new(status->inotify_fd);
+  status->watch = g_io_add_watch(channel, G_IO_IN, status_changed_cb, status);
+  g_io_channel_unref(channel);
+}
@@ -1,414 +1,432 @@
-#include <cal.h>
 #include <errno.h>
 #include <glib/gprintf.h>
 #include <libintl.h>
-#include <linux/videodev2.h>
 #include <locale.h>
 #include <string.h>
-#include <sys/ioctl.h>
 
 #include "audio.h"
-#include "dbus.h"
 #include "fmtx-object.h"
+#include "frontend.h"
+#include "mpris.h"
+#include "profile.h"
+#include "status.h"
 
-struct cal_fmtx_power_level
+void
+log_error(const char *msg, const char *reason, gboolean quit)
 {
-  char standard[8];
-  unsigned int level;
-};
+  g_printerr("fmtxd: ERROR: %s (%s)\n", msg, reason);
 
-static int
-fmtx_set_preemphasis_level(FmtxObject *fmtx, int level)
-{
-  int fd;
-  int rv;
-  char buf[10];
+  if (quit)
+    exit(1);
+}
 
-  g_snprintf(buf, sizeof(buf), "%u", level);
-  fd = open(FMTX_SYSFS_NODE "region_preemphasis", O_WRONLY);
+/* From g_object_new() until the region has been applied */
+static FmtxProfileMark init_mark;
 
-  if (fd == -1)
-  {
-    perror("fmtxd Could not open pre-emphasis file");
-    rv = 1;
-  }
-  else
-  {
-    if (write(fd, buf, strlen(buf) + 1) == -1)
-    {
-      perror("fmtxd Could not set FM tx pre-emphasis level");
-      close(fd);
-      rv = 1;
-    }
-    else
-    {
-      close(fd);
-      rv = 2;
-    }
-  }
+/* One per transmitter, each with its own engine and hardware worker */
+static FmtxObject *objects[FMTX_HW_MAX_DEVICES];
+static int n_objects;
 
-  return rv;
+static void
+engine_changed(void *data)
+{
+  g_idle_add(emit_changed, data);
 }
 
-static int
-fmtx_get_cal_power_level(const char *standard)
+static void
+engine_info(void *data)
 {
-  void *fmtx_pwl;
-  struct cal *cal;
-  unsigned long len;
-  struct cal_fmtx_power_level pl[3];
-
-  if (cal_init(&cal) < 0)
-    return -1;
+  g_idle_add(emit_info, data);
+}
 
-  if (cal_read_block(cal, "fmtx_pwl", &fmtx_pwl, &len, 0) < 0)
-  {
-    g_log(0, G_LOG_LEVEL_WARNING, "CAL: failed to read fmtx_pwl from cal\n");
-    cal_finish(cal);
-    return 0;
-  }
+static void
+engine_error(void *data, const char *error)
+{
+  g_signal_emit(data, FMTX_OBJECT_GET_CLASS(data)->error, 0, error);
+}
 
-  memcpy(pl, fmtx_pwl, len > sizeof(pl) ? sizeof(pl) : len);
-  free(fmtx_pwl);
-  cal_finish(cal);
+/* Indexed by FmtxEngineKey */
+static const char *const store_keys[] =
+{
+  "/frequency",
+  "/enabled",
+  "/monitor_interval",
+  "/monitor_threshold",
+  "/monitor_alternates",
+  "/silence_timeout",
+  "/silence_threshold",
+  "/silence_action",
+  "/rds_pi",
+  "/rds_pty",
+  "/rds_tp",
+  "/rds_ta",
+  "/rds_ct"
+};
 
-  /* WTF did Nokia developer do here, why is CAL std ignored? */
-  if (!memcmp(standard, "fcc", 3))
-    return pl[0].level;
+static void
+engine_store(void *data, FmtxEngineKey key, unsigned int value)
+{
+  FmtxObject *obj = data;
+  GError *err = NULL;
+  gchar *k = g_strconcat(obj->gconf_dir, store_keys[key], NULL);
 
-  if (!memcmp(standard, "etsi", 4))
-    return pl[1].level;
+  if (key == FMTX_ENGINE_KEY_ENABLED)
+    gconf_client_set_bool(obj->gcclient, k, value, &err);
+  else
+    gconf_client_set_int(obj->gcclient, k, value, &err);
 
-  if (!memcmp(standard, "anfr", 4))
-    return pl[2].level;
+  g_free(k);
 
-  g_log(0, G_LOG_LEVEL_WARNING, "FMTX: Invalid standard\n");
+  if (err)
+  {
+    g_fprintf(stderr, "Could not save fmtx settings: %s\n", err->message);
+    g_clear_error(&err);
+  }
+}
 
-  return 0;
+static void
+engine_audio_start(void *data)
+{
+  fmtx_audio_start(data);
 }
 
-static int
-fmtx_set_power_level(FmtxObject *obj, int level)
+static void
+engine_started(void *data)
 {
-  char buf[10];
-  int fd;
+  GError *err = NULL;
 
-  if (obj->max_power_level < level)
-    return 0;
+  status_page_init(data);
+  fmtx_object_load_presets(data);
 
-  if (level < 88)
-    level = 88;
+  if (!fmtx_object_schedule_reload(data, &err))
+  {
+    log_error("Could not load the schedule", err->message, FALSE);
+    g_error_free(err);
+  }
 
-  g_snprintf(buf, sizeof(buf), "%u", level);
+  fmtx_profile_end(&init_mark, "startup");
+  emit_info(data);
+}
 
-  fd = open(FMTX_SYSFS_NODE "power_level", O_WRONLY);
+/* fmtxd exits once every transmitter is idle */
+static void
+engine_idle(void *data)
+{
+  int i;
 
-  if (fd == -1)
+  for (i = 0; i < n_objects; i++)
   {
-    g_log(0, G_LOG_LEVEL_WARNING,
-          "fmtxd Could not open fmtx power level file: %s", strerror(errno));
-    return 1;
+    if (objects[i] != data && !fmtx_engine_is_idle(objects[i]->engine))
+      return;
   }
 
-  if (write(fd, buf, strlen(buf) + 1) == -1)
-  {
-    g_log(0, G_LOG_LEVEL_WARNING,
-          "fmtxd Could not set FM tx power level: %s", strerror(errno));
-    close(fd);
-    return 1;
-  }
+  for (i = 0; i < n_objects; i++)
+    fmtx_object_close(objects[i]);
 
-  close(fd);
-  obj->power_level = level;
-  return 2;
+  exit(0);
 }
 
-void
-log_error(const char *msg, const char *reason, gboolean quit)
+static void
+engine_fatal(void *data, const char *msg, const char *reason)
 {
-  g_printerr("fmtxd: ERROR: %s (%s)\n", msg, reason);
+  log_error(msg, reason, TRUE);
+}
 
-  if (quit)
-    exit(1);
+static void
+engine_migrated(void *data, unsigned int from, unsigned int to)
+{
+  g_signal_emit(data, FMTX_OBJECT_GET_CLASS(data)->channel_migrated, 0,
+                from, to);
 }
 
-static gboolean
-nameownerchanged_cb(FmtxObject *obj, gconstpointer pname)
+static void
+engine_meter(void *data, int on)
+{
+  fmtx_audio_meter(data, on);
+}
+
+static const FmtxEngineOps engine_ops =
 {
-  gboolean rv = g_str_equal(pname, "org.freedesktop.ohm");
+  engine_changed,
+  engine_info,
+  engine_error,
+  engine_store,
+  engine_audio_start,
+  engine_started,
+  engine_idle,
+  engine_fatal,
+  engine_migrated,
+  engine_meter
+};
 
-  if (rv)
-    rv = emit_info(obj);
+static gboolean
+engine_cb(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+  fmtx_engine_dispatch(data);
 
-  return rv;
+  return TRUE;
 }
 
-static int
-fmtx_init(FmtxObject *obj)
+static unsigned int
+load_uint(FmtxObject *obj, FmtxEngineKey key)
 {
-  int fd;
-  int i;
-  unsigned int f;
-  DBusGProxy *proxy;
-  const char *err_msg;
-  char file[50];
-  GError *error = NULL;
-  GArray *array = NULL;
-  GError *err = NULL;
+  gchar *k = g_strconcat(obj->gconf_dir, store_keys[key], NULL);
+  int value = gconf_client_get_int(obj->gcclient, k, NULL);
 
-  fd = open(FMTX_SYSFS_NODE "pilot_frequency", O_WRONLY);
+  g_free(k);
 
-  if (fd == -1)
-  {
-    perror("fmtxd Could not open pilot tone frequency file");
-    return 1;
-  }
+  return value > 0 ? value : 0;
+}
 
-  if (write(fd, "19000", 6) == -1)
-  {
-    err_msg = "fmtxd Could not set pilot tone frequency";
-    goto err_out;
-  }
+/* Unset keys read as 0 and keep the engine defaults */
+static void
+fmtx_init_monitor(FmtxObject *obj)
+{
+  unsigned int v;
 
-  close(fd);
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_MONITOR_THRESHOLD)))
+    fmtx_engine_set_monitor_threshold(obj->engine, v);
 
-  fd = open(FMTX_SYSFS_NODE "pilot_enabled", O_WRONLY);
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_MONITOR_ALTERNATES)))
+    fmtx_engine_set_monitor_alternates(obj->engine, v);
 
-  if (fd == -1)
-  {
-    perror("fmtxd Could not open pilot enable file");
-    return 1;
-  }
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_MONITOR_INTERVAL)))
+    fmtx_engine_set_monitor_interval(obj->engine, v);
+}
 
-  /* FIXME Why 1, but not 2??? */
-  if (write(fd, "1", 1) == -1)
-  {
-    err_msg = "fmtxd Could not set pilot tone";
-    goto err_out;
-  }
+static void
+fmtx_init_silence(FmtxObject *obj)
+{
+  unsigned int v;
 
-  close(fd);
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_SILENCE_THRESHOLD)))
+    fmtx_engine_set_silence_threshold(obj->engine, v);
 
-  fd = open(FMTX_SYSFS_NODE "rds_pi", O_WRONLY);
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_SILENCE_ACTION)))
+    fmtx_engine_set_silence_action(obj->engine, fmtx_silence_action_name(v));
 
-  if (fd == -1)
-  {
-    perror("fmtxd Could not open RDS Program Information file");
-    return 1;
-  }
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_SILENCE_TIMEOUT)))
+    fmtx_engine_set_silence_timeout(obj->engine, v);
+}
 
-  /* FIXME - same here, no term zero written */
-  if (write(fd, "6099", 4) == -1)
+static void
+fmtx_init_rds(FmtxObject *obj)
+{
+  gchar pi[5];
+  unsigned int v;
+
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_RDS_PI)))
   {
-    err_msg = "fmtxd Could not set RDS PI";
-    goto err_out;
+    g_snprintf(pi, sizeof(pi), "%04X", v);
+    fmtx_engine_set_rds_pi(obj->engine, pi);
   }
 
-  close(fd);
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_RDS_PTY)))
+    fmtx_engine_set_rds_pty(obj->engine, v);
 
-  i = 0;
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_RDS_TP)))
+    fmtx_engine_set_rds_tp(obj->engine, v);
 
-  while (1)
-  {
-    snprintf(file, sizeof(file), "%s%i", "/dev/radio", i);
-    fd = open(file, 0);
-    obj->dev_radio = fd;
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_RDS_TA)))
+    fmtx_engine_set_rds_ta(obj->engine, v);
 
-    if (fd > 0)
-      break;
+  if ((v = load_uint(obj, FMTX_ENGINE_KEY_RDS_CT)))
+    fmtx_engine_set_rds_ct(obj->engine, v);
+}
 
-    i++;
+static void
+fmtx_init_power(FmtxObject *obj)
+{
+  const char *sysfs = g_getenv("FMTXD_SYSFS_CLASS");
+  gchar *k;
+  gchar *curve;
+  gchar *points;
 
-    if (i == 2)
-    {
-      perror("fmtxd Could not open fmtx device");
-      g_free(obj->state);
-      obj->state = g_strdup("error");
-      return 1;
-    }
-  }
+  if (sysfs)
+    fmtx_engine_set_sysfs_class(obj->engine, sysfs);
 
-  f = gconf_client_get_int(obj->gcclient, "/system/fmtx/frequency", &err);
+  k = g_strconcat(obj->gconf_dir, "/governor_battery", NULL);
+  curve = gconf_client_get_string(obj->gcclient, k, NULL);
+  g_free(k);
 
-  if (err)
-  {
-    g_fprintf(stderr, "Could not load fmtx settings: %s\n", err->message);
-    return 1;
-  }
+  if (curve)
+    fmtx_engine_set_governor_battery(obj->engine, curve);
 
-  proxy = dbus_g_proxy_new_for_name(obj->dbus,
-                                    "com.nokia.SystemInfo",
-                                    "/com/nokia/SystemInfo",
-                                    "com.nokia.SystemInfo");
+  g_free(curve);
 
-  if (proxy)
-  {
-    if (dbus_g_proxy_call(proxy, "GetConfigValue", &error, G_TYPE_STRING,
-                          "/certs/ccc/pp/fmtx-raw",
-                          G_TYPE_INVALID,
-                          DBUS_TYPE_G_UCHAR_ARRAY, &array,
-                          G_TYPE_INVALID) && !error)
-    {
-      int std = *array->data;
+  k = g_strconcat(obj->gconf_dir, "/governor_thermal", NULL);
+  curve = gconf_client_get_string(obj->gcclient, k, NULL);
+  g_free(k);
 
-      g_array_free(array, TRUE);
-      g_object_unref(proxy);
+  if (curve)
+    fmtx_engine_set_governor_thermal(obj->engine, curve);
 
-      if (std == 2)
-      {
-        obj->max_power_level = fmtx_get_cal_power_level("etsi");
-        fmtx_set_preemphasis_level(obj, 50);
-        obj->freq_step = 100;
-      }
-      else if (std == 3)
-      {
-        obj->max_power_level = fmtx_get_cal_power_level("etsi");
-        fmtx_set_preemphasis_level(obj, 75);
-        obj->freq_step = 100;
-      }
-      else if (std == 4)
-      {
-        obj->max_power_level = fmtx_get_cal_power_level("fcc");
-        fmtx_set_preemphasis_level(obj, 50);
-        obj->freq_step = 200;
-      }
-      else if (std == 5)
-      {
-        obj->max_power_level = fmtx_get_cal_power_level("fcc");
-        fmtx_set_preemphasis_level(obj, 75);
-        obj->freq_step = 200;
-      }
-      else
-        goto bad_std;
+  g_free(curve);
 
-      obj->freq_min = 88100;
-      obj->freq_max = 107900;
-      goto set_power;
-    }
-    else
-    {
-      g_log(0, G_LOG_LEVEL_WARNING, "Unable to get stored fmtx settings");
-      g_clear_error(&error);
-    }
-  }
-  else
-    g_log(0, G_LOG_LEVEL_WARNING, "Couldn't create the proxy object");
-
-bad_std:
-  obj->state = g_strdup("n/a");
+  /* the table is built from these once CAL has been read */
+  k = g_strconcat(obj->gconf_dir, "/power_points", NULL);
+  points = gconf_client_get_string(obj->gcclient, k, NULL);
+  g_free(k);
 
-set_power:
-  fmtx_set_power_level(obj, obj->max_power_level);
+  if (points)
+    fmtx_engine_set_power_points(obj->engine, points);
 
-  fmtx_set_rds_station_name(obj, "Nokia   ");
+  g_free(points);
+}
 
-  fmtx_set_rds_text(obj, " ");
+static void
+fmtx_init_region(FmtxObject *obj, int region)
+{
+  unsigned int f;
+  GError *err = NULL;
+  gchar *key = g_strconcat(obj->gconf_dir, "/frequency", NULL);
 
-  fd = fmtx_set_frequency(obj, f);
+  f = gconf_client_get_int(obj->gcclient, key, &err);
+  g_free(key);
 
-  if (fd == 1)
-    return 1;
+  if (err)
+    log_error("Could not load fmtx settings", err->message, TRUE);
 
-  if (!fd)
-    fmtx_set_frequency(obj, obj->freq_min);
+  fmtx_engine_set_region(obj->engine, region, f);
+  fmtx_init_monitor(obj);
+  fmtx_init_silence(obj);
+  fmtx_init_rds(obj);
+  fmtx_init_power(obj);
+}
 
-  if (fmtx_enable(obj, 0) == 1)
+/* The region from SystemInfo decides the rest of the setup, which continues
+ * in the engine once it is known. */
+static int
+fmtx_init(FmtxObject *obj)
+{
+  if (fmtx_engine_open(obj->engine) == 1)
     return 1;
 
-  return 2;
+  frontend_get_region(obj, fmtx_init_region);
 
-err_out:
-  perror(err_msg);
-  close(fd);
-  return 1;
+  return 2;
 }
 
-static gboolean
-check_mixer(FmtxObject *obj)
+/* Like the status page, every transmitter past the first gets a suffix */
+static void
+fmtx_init_noise_map(FmtxObject *obj, gboolean primary)
 {
-  gboolean old;
-  unsigned int idxp;
+  const char *base = g_getenv("FMTXD_NOISE_MAP_PATH");
+  gchar *path;
 
-  old = obj->mixer_inited;
+  if (!base)
+    base = FMTX_NOISE_MAP_PATH;
 
-  if (obj->mixer_elem)
-  {
-    snd_mixer_selem_get_enum_item(obj->mixer_elem,
-                                  SND_MIXER_SCHN_FRONT_LEFT,
-                                  &idxp);
+  if (primary)
+    path = g_strdup(base);
+  else
+    path = g_strdup_printf("%s.%s", base, obj->engine->hw->name);
+
+  fmtx_engine_set_noise_map_path(obj->engine, path);
+  g_free(path);
+}
 
-    obj->mixer_inited = (idxp != 0);
+static void
+fmtx_init_schedule_path(FmtxObject *obj, gboolean primary)
+{
+  const char *base = g_getenv("FMTXD_SCHEDULE_PATH");
+  gchar *path;
 
-    if (obj->mixer_inited != old)
-      fmtx_toggle_pilot(obj);
-  }
+  if (!base)
+    base = FMTX_SCHEDULE_PATH;
 
-  return TRUE;
+  if (primary)
+    path = g_strdup(base);
+  else
+    path = g_strdup_printf("%s.%s", base, obj->engine->hw->name);
+
+  fmtx_engine_set_schedule_path(obj->engine, path);
+  g_free(path);
 }
 
+/* Off unless FMTXD_INPUT_LOG names a file, which is replaced. Opened before
+ * the settings are loaded so a replay starts from the same ones. */
 static void
-mixer_init(FmtxObject *obj)
+fmtx_init_input_log(FmtxObject *obj, gboolean primary)
 {
-  snd_mixer_selem_id_t *sid;
+  const char *base = g_getenv("FMTXD_INPUT_LOG");
+  gchar *path;
 
-  snd_mixer_elem_t *elem;
+  if (!base)
+    return;
 
-  char name[16];
+  if (primary)
+    path = g_strdup(base);
+  else
+    path = g_strdup_printf("%s.%s", base, obj->engine->hw->name);
 
-  snd_mixer_selem_id_alloca(&sid);
-  memset(sid, 0, snd_mixer_selem_id_sizeof());
+  if (fmtx_engine_log_inputs(obj->engine, path))
+    g_log(NULL, G_LOG_LEVEL_WARNING, "Could not create the input log %s: %s",
+          path, g_strerror(errno));
 
-  sprintf(name, "hw:%i", snd_card_get_index("0"));
+  g_free(path);
+}
 
-  if (snd_mixer_open(&obj->snd_mixer, 0) < 0)
-    log_error("snd_mixer_open", 0, 1);
+static FmtxObject *
+fmtx_object_setup(FmtxHw *hw, gboolean primary)
+{
+  FmtxObject *fmtx;
+  GIOChannel *channel;
+  FmtxProfileMark mark;
 
-  if (snd_mixer_attach(obj->snd_mixer, name) < 0)
-    log_error("snd_mixer_attach", 0, 1);
+  fmtx = (FmtxObject *)g_object_new(FMTX_OBJECT_TYPE, NULL);
 
-  if (snd_mixer_selem_register(obj->snd_mixer, 0, 0) < 0)
-    log_error("snd_mixer_selem_register", 0, 1);
+  if (!fmtx)
+    log_error("Failed to create one Value instance.", "Unknown(OOM?)", TRUE);
 
-  if (snd_mixer_load(obj->snd_mixer) < 0)
-    log_error("snd_mixer_load", 0, 1);
+  if (primary)
+  {
+    fmtx->path = g_strdup(FMTX_OBJECT_PATH);
+    fmtx->gconf_dir = g_strdup("/system/fmtx");
+  }
+  else
+  {
+    fmtx->path = g_strconcat(FMTX_OBJECT_PATH_PREFIX, hw->name, NULL);
+    fmtx->gconf_dir = g_strconcat("/system/fmtx/", hw->name, NULL);
+  }
 
-  elem = snd_mixer_first_elem(obj->snd_mixer);
+  fmtx->engine = fmtx_engine_new(hw, &engine_ops, fmtx);
 
-  if (elem)
-  {
-    while (1)
-    {
-      const char *s;
-      snd_mixer_selem_get_id(elem, sid);
-      s = snd_mixer_selem_id_get_name(sid);
+  if (!fmtx->engine)
+    log_error("Failed to create the engine", g_strerror(errno), TRUE);
 
-      if (g_str_equal(s, "FMTX Function"))
-        break;
+  fmtx_init_noise_map(fmtx, primary);
+  fmtx_init_schedule_path(fmtx, primary);
+  fmtx_init_input_log(fmtx, primary);
 
-      elem = snd_mixer_elem_next(elem);
+  channel = g_io_channel_unix_new(fmtx_engine_get_fd(fmtx->engine));
+  g_io_add_watch(channel, G_IO_IN, engine_cb, fmtx->engine);
+  g_io_channel_unref(channel);
 
-      if (!elem)
-        break;
-    }
+  fmtx_profile_begin(&mark);
+  fmtx->gcclient = gconf_client_get_default();
+  fmtx_profile_end(&mark, "gconf");
 
-    if (elem)
-      obj->mixer_elem = elem;
-  }
+  fmtx_mpris_init(fmtx);
+
+  fmtx_profile_begin(&mark);
+  frontend_init(fmtx);
+  fmtx_profile_end(&mark, "dbus");
 
-  g_timeout_add(1000u, (GSourceFunc)check_mixer, obj);
+  return fmtx;
 }
 
 int
 main(int argc, char **argv)
 {
   FILE *fp;
-  FmtxObject *fmtx;
-  DBusGConnection *dbus;
-  DBusGProxy *proxy;
+  FmtxHw *hw[FMTX_HW_MAX_DEVICES];
   GMainLoop *loop;
   char buf[100];
-  GError *error = NULL;
-  unsigned int ret;
+  FmtxProfileMark mark;
+  int running = 0;
+  int n;
+  int i;
 
   if ((argc > 1) && g_str_equal("-d", argv[1]) && (daemon(0, 0) == -1))
     log_error("Failed to daemonize", "Unknown(OOM?)", 1);
@@ -469,76 +487,35 @@ deflocale:
     fclose(fp);
   }
 
-  fmtx = (FmtxObject *)g_object_new(FMTX_OBJECT_TYPE, NULL);
+  fmtx_profile_begin(&init_mark);
 
-  if (!fmtx)
-    log_error("Failed to create one Value instance.", "Unknown(OOM?)", TRUE);
+  fmtx_profile_begin(&mark);
+  n = fmtx_hw_discover(hw, FMTX_HW_MAX_DEVICES);
+
+  if (!n)
+    log_error("No FM transmitter found", "fmtx_hw_discover", TRUE);
+
+  fmtx_profile_end(&mark, "hw");
 
   loop = g_main_loop_new(NULL, FALSE);
 
   if (!loop)
     log_error("Couldn't create GMainLoop", "Unknown(OOM?)", TRUE);
 
-  dbus = dbus_g_bus_get(DBUS_BUS_SYSTEM, &error);
-
-  if (error)
-    log_error("Couldn't connect to the System bus", error->message, TRUE);
-
-  proxy = dbus_g_proxy_new_for_name(dbus,
-                                    "org.freedesktop.DBus",
-                                    "/org/freedesktop/DBus",
-                                    "org.freedesktop.DBus");
-
-  if (!proxy)
-    log_error("Failed to get a proxy for D-Bus",
-              "Unknown(dbus_g_proxy_new_for_name)", TRUE);
-
-  if (!dbus_g_proxy_call(proxy, "RequestName",
-                         &error,
-                         G_TYPE_STRING, "com.nokia.FMTx",
-                         G_TYPE_UINT, DBUS_NAME_FLAG_DO_NOT_QUEUE,
-                         G_TYPE_INVALID,
-                         G_TYPE_UINT, &ret,
-                         G_TYPE_INVALID ))
-    log_error("D-Bus.RequestName RPC failed", error->message, TRUE);
-
-  if (ret != 1)
-    log_error("Failed to get the primary well-known name.",
-              "RequestName result != 1", TRUE);
-
-  fmtx->dbus = dbus;
-  fmtx->gcclient = gconf_client_get_default();
-
-  dbus_g_connection_register_g_object(dbus,
-                                      "/com/nokia/fmtx/default",
-                                      G_OBJECT(fmtx));
-
-  connect_dbus_signals(dbus, fmtx);
-  mixer_init(fmtx);
-  register_pa(fmtx);
-
-  dbus_g_proxy_add_signal(proxy, "NameOwnerChanged",
-                          G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-                          G_TYPE_INVALID);
-
-  dbus_g_proxy_connect_signal(proxy,
-                              "NameOwnerChanged",
-                              (GCallback)nameownerchanged_cb,
-                              fmtx,
-                              G_TYPE_INVALID);
-  g_object_unref(proxy);
-
-  if (!g_str_equal(fmtx->state, "error") && (fmtx_init(fmtx) != 1))
+  /* Each engine starts its own hardware worker, so the transmitters are
+   * set up in parallel */
+  for (i = 0; i < n; i++)
   {
-    emit_info(fmtx);
+    FmtxObject *fmtx = fmtx_object_setup(hw[i], i == 0);
 
-    if (!g_str_equal(fmtx->state, "enabled"))
-      fmtx->exit_timeout = g_timeout_add(60000,
-                                         (GSourceFunc)exit_timeout_cb,
-                                         fmtx);
+    objects[n_objects++] = fmtx;
 
-    g_main_loop_run(loop);
+    if (fmtx->engine->state != FMTX_STATE_ERROR && (fmtx_init(fmtx) != 1))
+      running++;
   }
 
+  if (running)
+    g_main_loop_run(loop);
+
   return 1;
 }
@@ -0,0 +1,178 @@
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "meter.h"
+
+void
+fmtx_meter_accumulate_scalar(const int16_t *s, size_t n, uint64_t *sum_sq,
+                             unsigned int *peak)
+{
+  uint64_t sum = 0;
+  int max = 0;
+  int min = 0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+  {
+    sum += (int32_t)s[i] * s[i];
+
+    if (s[i] > max)
+      max = s[i];
+    else if (s[i] < min)
+      min = s[i];
+  }
+
+  *sum_sq = sum;
+  *peak = max > -min ? max : -min;
+}
+
+#if defined(__SSE2__)
+
+/* pmaddwd squares eight samples and adds neighbouring pairs, which fits 32
+ * bits unsigned even for two -32768s, then the pairs go into 64 bit lanes */
+void
+fmtx_meter_accumulate(const int16_t *s, size_t n, uint64_t *sum_sq,
+                      unsigned int *peak)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+  __m128i vmax = _mm_set1_epi16(INT16_MIN);
+  __m128i vmin = _mm_set1_epi16(INT16_MAX);
+  uint64_t lanes[2];
+  int16_t maxs[8];
+  int16_t mins[8];
+  uint64_t tail_sum;
+  unsigned int tail_peak;
+  int p = 0;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i sq = _mm_madd_epi16(v, v);
+
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+    vmax = _mm_max_epi16(vmax, v);
+    vmin = _mm_min_epi16(vmin, v);
+  }
+
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  _mm_storeu_si128((__m128i *)maxs, vmax);
+  _mm_storeu_si128((__m128i *)mins, vmin);
+
+  fmtx_meter_accumulate_scalar(s + i, n - i, &tail_sum, &tail_peak);
+
+  /* untouched lanes still hold INT16_MIN and INT16_MAX and never win */
+  for (i = 0; i < 8; i++)
+  {
+    if (maxs[i] > p)
+      p = maxs[i];
+
+    if (-mins[i] > p)
+      p = -mins[i];
+  }
+
+  *sum_sq = lanes[0] + lanes[1] + tail_sum;
+  *peak = (unsigned int)p > tail_peak ? (unsigned int)p : tail_peak;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+/* vmull widens the squares to 32 bits, vpadal adds pairs of them into the
+ * 64 bit accumulators */
+void
+fmtx_meter_accumulate(const int16_t *s, size_t n, uint64_t *sum_sq,
+                      unsigned int *peak)
+{
+  uint64x2_t acc = vdupq_n_u64(0);
+  int16x8_t vmax = vdupq_n_s16(INT16_MIN);
+  int16x8_t vmin = vdupq_n_s16(INT16_MAX);
+  int16_t maxs[8];
+  int16_t mins[8];
+  uint64_t tail_sum;
+  unsigned int tail_peak;
+  int p = 0;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+  {
+    int16x8_t v = vld1q_s16(s + i);
+    int32x4_t lo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+    int32x4_t hi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+
+    acc = vpadalq_u32(acc, vreinterpretq_u32_s32(lo));
+    acc = vpadalq_u32(acc, vreinterpretq_u32_s32(hi));
+    vmax = vmaxq_s16(vmax, v);
+    vmin = vminq_s16(vmin, v);
+  }
+
+  vst1q_s16(maxs, vmax);
+  vst1q_s16(mins, vmin);
+
+  fmtx_meter_accumulate_scalar(s + i, n - i, &tail_sum, &tail_peak);
+
+  /* untouched lanes still hold INT16_MIN and INT16_MAX and never win */
+  for (i = 0; i < 8; i++)
+  {
+    if (maxs[i] > p)
+      p = maxs[i];
+
+    if (-mins[i] > p)
+      p = -mins[i];
+  }
+
+  *sum_sq = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1) + tail_sum;
+  *peak = (unsigned int)p > tail_peak ? (unsigned int)p : tail_peak;
+}
+
+#else
+
+void
+fmtx_meter_accumulate(const int16_t *s, size_t n, uint64_t *sum_sq,
+                      unsigned int *peak)
+{
+  fmtx_meter_accumulate_scalar(s, n, sum_sq, peak);
+}
+
+#endif
+
+static unsigned int
+to_db(double value)
+{
+  double db;
+
+  if (value <= 0.0)
+    return FMTX_METER_FLOOR_DB;
+
+  db = 20.0 * log10(32768.0 / value);
+
+  if (db < 0.0)
+    return 0;
+
+  return db > FMTX_METER_FLOOR_DB ? FMTX_METER_FLOOR_DB : (unsigned int)db;
+}
+
+void
+fmtx_meter_block(const int16_t *s, size_t n, FmtxMeterLevel *level)
+{
+  uint64_t sum_sq;
+  unsigned int peak;
+
+  if (!n)
+  {
+    level->rms_db = FMTX_METER_FLOOR_DB;
+    level->peak_db = FMTX_METER_FLOOR_DB;
+    return;
+  }
+
+  fmtx_meter_accumulate(s, n, &sum_sq, &peak);
+
+  level->rms_db = to_db(sqrt((double)sum_sq / n));
+  level->peak_db = to_db(peak);
+}
@@ -0,0 +1,31 @@
+#ifndef __FMTXD_METER_H_INCLUDED__
+#define __FMTXD_METER_H_INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* RMS and peak of interleaved S16 audio blocks from the PulseAudio monitor
+ * source. The sums use SSE2 or NEON where available. Levels are dB below
+ * full scale, so 0 is the loudest a block can be. */
+
+/* 16 bit samples can't get any quieter, digital silence reads as this */
+#define FMTX_METER_FLOOR_DB 96
+
+typedef struct
+{
+  unsigned int rms_db;
+  unsigned int peak_db;
+} FmtxMeterLevel;
+
+/* Sum of squares and largest magnitude of n samples */
+void
+fmtx_meter_accumulate(const int16_t *s, size_t n, uint64_t *sum_sq,
+                      unsigned int *peak);
+/* Plain C version of the above, for checking the vector code */
+void
+fmtx_meter_accumulate_scalar(const int16_t *s, size_t n, uint64_t *sum_sq,
+                             unsigned int *peak);
+void
+fmtx_meter_block(const int16_t *s, size_t n, FmtxMeterLevel *level);
+
+#endif /* __FMTXD_METER_H_INCLUDED__ */
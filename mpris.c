@@ -0,0 +1,593 @@
+#include <dbus/dbus-glib-lowlevel.h>
+#include <string.h>
+
+#include "mpris.h"
+
+#define MPRIS_PATH "/org/mpris/MediaPlayer2"
+#define MPRIS_PLAYER_IF "org.mpris.MediaPlayer2.Player"
+#define MPRIS_NAME_PREFIX "org.mpris.MediaPlayer2."
+
+#define MPRIS_MATCH \
+  "type='signal',interface='" DBUS_INTERFACE_PROPERTIES "'," \
+  "member='PropertiesChanged',path='" MPRIS_PATH "'," \
+  "arg0='" MPRIS_PLAYER_IF "'"
+
+struct _FmtxMpris
+{
+  FmtxObject *obj;
+  DBusConnection *session;
+  gchar *tmpl[FMTX_MPRIS_LAST];
+  /* rendered text last handed to the engine */
+  gchar *last[FMTX_MPRIS_LAST];
+  FmtxRdsTag last_tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_last_tags;
+  gchar *artist;
+  gchar *title;
+  gchar *album;
+  gint64 last_apply;
+  guint timeout_id;
+};
+
+static const char *const template_keys[FMTX_MPRIS_LAST] =
+{
+  "mpris_rt_template",
+  "mpris_ps_template"
+};
+
+/* Appends value, tagged for RT+ when tags is set. A tag past what fits on
+ * air is dropped once the text is cut. */
+static void
+append_tagged(GString *s, const char *value, FmtxRdsRtPlusType type,
+              FmtxRdsTag *tags, unsigned int *n_tags)
+{
+  if (!value)
+    return;
+
+  if (tags && *value && *n_tags < FMTX_RDS_RTPLUS_MAX_TAGS &&
+      s->len <= G_MAXUINT16)
+  {
+    tags[*n_tags].type = type;
+    tags[*n_tags].start = s->len;
+    tags[(*n_tags)++].len = MIN(strlen(value), G_MAXUINT16);
+  }
+
+  g_string_append(s, value);
+}
+
+/* At most max characters on air. The artist, title and album are tagged
+ * for RT+ when tags is set. */
+static gchar *
+render(FmtxMpris *mpris, const char *tmpl, size_t max, FmtxRdsTag *tags,
+       unsigned int *n_tags)
+{
+  GString *s = g_string_new(NULL);
+  const char *p;
+  gsize used;
+  gsize len;
+  gsize i;
+
+  if (n_tags)
+    *n_tags = 0;
+
+  for (p = tmpl; *p; p++)
+  {
+    if (*p != '%' || !p[1])
+    {
+      g_string_append_c(s, *p);
+      continue;
+    }
+
+    switch (*++p)
+    {
+      case 'a':
+        append_tagged(s, mpris->artist, FMTX_RDS_RTPLUS_ARTIST, tags, n_tags);
+        break;
+      case 't':
+        append_tagged(s, mpris->title, FMTX_RDS_RTPLUS_TITLE, tags, n_tags);
+        break;
+      case 'l':
+        append_tagged(s, mpris->album, FMTX_RDS_RTPLUS_ALBUM, tags, n_tags);
+        break;
+      case '%':
+        g_string_append_c(s, '%');
+        break;
+      default:
+        g_string_append_c(s, '%');
+        g_string_append_c(s, *p);
+        break;
+    }
+  }
+
+  /* tabs and newlines in tags would go on air as spaces anyway */
+  for (i = 0; i < s->len; i++)
+  {
+    if ((guchar)s->str[i] < 0x20 || s->str[i] == 0x7f)
+      s->str[i] = ' ';
+  }
+
+  /* cut on a character boundary, limiting the bytes as well since
+   * combining accents take no room on air */
+  len = MIN(s->len, FMTX_RDS_CHARSET_MAX_BYTES(max));
+
+  while (len < s->len && len && ((guchar)s->str[len] & 0xc0) == 0x80)
+    len--;
+
+  fmtx_rds_charset_encode(s->str, len, NULL, max, &used);
+  g_string_truncate(s, used);
+
+  for (i = 0; tags && i < *n_tags; i++)
+  {
+    if (tags[i].start >= used)
+      *n_tags = i;
+    else if (tags[i].start + tags[i].len > used)
+      tags[i].len = used - tags[i].start;
+  }
+
+  return g_string_free(s, FALSE);
+}
+
+static void
+apply(FmtxMpris *mpris)
+{
+  FmtxEngine *engine = mpris->obj->engine;
+  int ps_static = engine->rds.ps_mode == FMTX_RDS_PS_STATIC;
+  FmtxRdsTag tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_tags = 0;
+  gboolean written = FALSE;
+  gchar *text;
+  int field;
+
+  if (!mpris->artist && !mpris->title)
+    return;
+
+  for (field = 0; field < FMTX_MPRIS_LAST; field++)
+  {
+    if (!mpris->tmpl[field] || !*mpris->tmpl[field])
+      continue;
+
+    if (field == FMTX_MPRIS_RT)
+      text = render(mpris, mpris->tmpl[field], FMTX_MAX_RDS_TEXT, tags,
+                    &n_tags);
+    else
+      text = render(mpris, mpris->tmpl[field],
+                    ps_static ? FMTX_MAX_RDS_PS : FMTX_RDS_SCHED_MAX_PS_TEXT,
+                    NULL, NULL);
+
+    /* most PropertiesChanged carry nothing that shows up in the text */
+    if (!g_strcmp0(text, mpris->last[field]) &&
+        (field != FMTX_MPRIS_RT ||
+         (n_tags == mpris->n_last_tags &&
+          fmtx_rds_tags_equal(tags, mpris->last_tags, n_tags))))
+    {
+      g_free(text);
+      continue;
+    }
+
+    if (field == FMTX_MPRIS_RT)
+    {
+      fmtx_engine_set_rds_text_tagged(engine, text, tags, n_tags);
+      memcpy(mpris->last_tags, tags, n_tags * sizeof(*tags));
+      mpris->n_last_tags = n_tags;
+    }
+    else if (ps_static)
+      fmtx_engine_set_rds_ps(engine, text);
+    else
+      fmtx_engine_set_rds_ps_text(engine, text);
+
+    g_free(mpris->last[field]);
+    mpris->last[field] = text;
+    written = TRUE;
+  }
+
+  if (written)
+    mpris->last_apply = g_get_monotonic_time();
+}
+
+static gboolean
+apply_timeout(gpointer data)
+{
+  FmtxMpris *mpris = data;
+
+  mpris->timeout_id = 0;
+  apply(mpris);
+
+  return FALSE;
+}
+
+/* At most one update per FMTX_MPRIS_MIN_INTERVAL_MS, a burst of changes
+ * ends with the newest metadata on air */
+static void
+update(FmtxMpris *mpris)
+{
+  gint64 wait;
+
+  if (mpris->timeout_id)
+    return;
+
+  wait = mpris->last_apply + FMTX_MPRIS_MIN_INTERVAL_MS * 1000 -
+         g_get_monotonic_time();
+
+  if (wait <= 0)
+    apply(mpris);
+  else
+    mpris->timeout_id = g_timeout_add(wait / 1000 + 1, apply_timeout, mpris);
+}
+
+static gchar *
+dup_string(DBusMessageIter *iter)
+{
+  const char *s;
+
+  if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_STRING)
+    return NULL;
+
+  dbus_message_iter_get_basic(iter, &s);
+
+  return g_strdup(s);
+}
+
+/* xesam:artist is a list, shown comma separated */
+static gchar *
+dup_strings(DBusMessageIter *iter)
+{
+  DBusMessageIter array;
+  GString *s;
+  const char *item;
+
+  if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+    return dup_string(iter);
+
+  s = g_string_new(NULL);
+  dbus_message_iter_recurse(iter, &array);
+
+  while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING)
+  {
+    dbus_message_iter_get_basic(&array, &item);
+
+    if (s->len)
+      g_string_append(s, ", ");
+
+    g_string_append(s, item);
+    dbus_message_iter_next(&array);
+  }
+
+  return g_string_free(s, FALSE);
+}
+
+/* iter is on the a{sv} variant */
+static void
+parse_metadata(FmtxMpris *mpris, DBusMessageIter *variant)
+{
+  DBusMessageIter dict;
+  DBusMessageIter entry;
+  DBusMessageIter value;
+  const char *key;
+  char *sig;
+  int ok;
+
+  /* any client on the session bus can send this, the entries are only
+   * walked once the types are known */
+  sig = dbus_message_iter_get_signature(variant);
+  ok = sig && !strcmp(sig, "a{sv}");
+  dbus_free(sig);
+
+  if (!ok)
+    return;
+
+  g_free(mpris->artist);
+  g_free(mpris->title);
+  g_free(mpris->album);
+  mpris->artist = NULL;
+  mpris->title = NULL;
+  mpris->album = NULL;
+
+  dbus_message_iter_recurse(variant, &dict);
+
+  while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY)
+  {
+    dbus_message_iter_recurse(&dict, &entry);
+    dbus_message_iter_get_basic(&entry, &key);
+    dbus_message_iter_next(&entry);
+    dbus_message_iter_recurse(&entry, &value);
+
+    if (!strcmp(key, "xesam:title"))
+      mpris->title = dup_string(&value);
+    else if (!strcmp(key, "xesam:artist"))
+      mpris->artist = dup_strings(&value);
+    else if (!strcmp(key, "xesam:album"))
+      mpris->album = dup_string(&value);
+
+    dbus_message_iter_next(&dict);
+  }
+
+  update(mpris);
+}
+
+static DBusHandlerResult
+session_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+  DBusMessageIter iter;
+  DBusMessageIter dict;
+  DBusMessageIter entry;
+  DBusMessageIter value;
+  const char *s;
+
+  if (!dbus_message_is_signal(msg, DBUS_INTERFACE_PROPERTIES,
+                              "PropertiesChanged") ||
+      !dbus_message_has_path(msg, MPRIS_PATH) ||
+      !dbus_message_has_signature(msg, "sa{sv}as"))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  dbus_message_iter_init(msg, &iter);
+  dbus_message_iter_get_basic(&iter, &s);
+
+  if (strcmp(s, MPRIS_PLAYER_IF))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  dbus_message_iter_next(&iter);
+  dbus_message_iter_recurse(&iter, &dict);
+
+  while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY)
+  {
+    dbus_message_iter_recurse(&dict, &entry);
+    dbus_message_iter_get_basic(&entry, &s);
+
+    if (!strcmp(s, "Metadata"))
+    {
+      dbus_message_iter_next(&entry);
+      dbus_message_iter_recurse(&entry, &value);
+      parse_metadata(user_data, &value);
+    }
+
+    dbus_message_iter_next(&dict);
+  }
+
+  /* other transmitters follow the same players */
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+call_async(FmtxMpris *mpris, DBusMessage *msg,
+           DBusPendingCallNotifyFunction notify)
+{
+  DBusPendingCall *pending = NULL;
+
+  if (dbus_connection_send_with_reply(mpris->session, msg, &pending, -1) &&
+      pending)
+  {
+    dbus_pending_call_set_notify(pending, notify, mpris, NULL);
+    dbus_pending_call_unref(pending);
+  }
+
+  dbus_message_unref(msg);
+}
+
+static void
+metadata_cb(DBusPendingCall *pending, void *user_data)
+{
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  DBusMessageIter iter;
+  DBusMessageIter value;
+
+  if (!reply)
+    return;
+
+  if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN &&
+      dbus_message_iter_init(reply, &iter) &&
+      dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_VARIANT)
+  {
+    dbus_message_iter_recurse(&iter, &value);
+    parse_metadata(user_data, &value);
+  }
+
+  dbus_message_unref(reply);
+}
+
+/* Players that were already running when the bridge started */
+static void
+list_names_cb(DBusPendingCall *pending, void *user_data)
+{
+  FmtxMpris *mpris = user_data;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  const char *iface = MPRIS_PLAYER_IF;
+  const char *prop = "Metadata";
+  DBusMessage *msg;
+  char **names;
+  int n;
+  int i;
+
+  if (!reply)
+    return;
+
+  if (mpris->session &&
+      dbus_message_get_args(reply, NULL, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                            &names, &n, DBUS_TYPE_INVALID))
+  {
+    for (i = 0; i < n; i++)
+    {
+      if (!g_str_has_prefix(names[i], MPRIS_NAME_PREFIX))
+        continue;
+
+      msg = dbus_message_new_method_call(names[i], MPRIS_PATH,
+                                         DBUS_INTERFACE_PROPERTIES, "Get");
+      dbus_message_append_args(msg, DBUS_TYPE_STRING, &iface,
+                               DBUS_TYPE_STRING, &prop, DBUS_TYPE_INVALID);
+      call_async(mpris, msg, metadata_cb);
+      break;
+    }
+
+    dbus_free_string_array(names);
+  }
+
+  dbus_message_unref(reply);
+}
+
+static gboolean
+start(FmtxMpris *mpris, GError **error)
+{
+  DBusConnection *conn;
+  DBusError err;
+
+  if (mpris->session)
+    return TRUE;
+
+  dbus_error_init(&err);
+  conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
+
+  if (!conn)
+  {
+    g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+                "Couldn't connect to the session bus: %s", err.message);
+    dbus_error_free(&err);
+    return FALSE;
+  }
+
+  /* the session may end, fmtxd goes on */
+  dbus_connection_set_exit_on_disconnect(conn, FALSE);
+  dbus_connection_setup_with_g_main(conn, NULL);
+  dbus_connection_add_filter(conn, session_filter, mpris, NULL);
+  dbus_bus_add_match(conn, MPRIS_MATCH, NULL);
+  mpris->session = conn;
+
+  call_async(mpris, dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+                                                 DBUS_PATH_DBUS,
+                                                 DBUS_INTERFACE_DBUS,
+                                                 "ListNames"),
+             list_names_cb);
+
+  return TRUE;
+}
+
+static void
+stop(FmtxMpris *mpris)
+{
+  if (mpris->timeout_id)
+  {
+    g_source_remove(mpris->timeout_id);
+    mpris->timeout_id = 0;
+  }
+
+  if (!mpris->session)
+    return;
+
+  dbus_bus_remove_match(mpris->session, MPRIS_MATCH, NULL);
+  dbus_connection_remove_filter(mpris->session, session_filter, mpris);
+  dbus_connection_unref(mpris->session);
+  mpris->session = NULL;
+}
+
+static gboolean
+active(FmtxMpris *mpris)
+{
+  int field;
+
+  for (field = 0; field < FMTX_MPRIS_LAST; field++)
+  {
+    if (mpris->tmpl[field] && *mpris->tmpl[field])
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gchar *
+template_key(FmtxObject *obj, FmtxMprisField field)
+{
+  return g_strconcat(obj->gconf_dir, "/", template_keys[field], NULL);
+}
+
+void
+fmtx_mpris_init(FmtxObject *obj)
+{
+  FmtxMpris *mpris = g_new0(FmtxMpris, 1);
+  GError *error = NULL;
+  gchar *key;
+  int field;
+
+  mpris->obj = obj;
+  obj->mpris = mpris;
+
+  for (field = 0; field < FMTX_MPRIS_LAST; field++)
+  {
+    key = template_key(obj, field);
+    mpris->tmpl[field] = gconf_client_get_string(obj->gcclient, key, NULL);
+    g_free(key);
+  }
+
+  if (active(mpris) && !start(mpris, &error))
+  {
+    log_error("MPRIS bridge not started", error->message, FALSE);
+    g_error_free(error);
+  }
+}
+
+void
+fmtx_mpris_close(FmtxObject *obj)
+{
+  FmtxMpris *mpris = obj->mpris;
+  int field;
+
+  if (!mpris)
+    return;
+
+  stop(mpris);
+
+  for (field = 0; field < FMTX_MPRIS_LAST; field++)
+  {
+    g_free(mpris->tmpl[field]);
+    g_free(mpris->last[field]);
+  }
+
+  g_free(mpris->artist);
+  g_free(mpris->title);
+  g_free(mpris->album);
+  g_free(mpris);
+  obj->mpris = NULL;
+}
+
+const char *
+fmtx_mpris_get_template(FmtxObject *obj, FmtxMprisField field)
+{
+  const char *tmpl = obj->mpris ? obj->mpris->tmpl[field] : NULL;
+
+  return tmpl ? tmpl : "";
+}
+
+gboolean
+fmtx_mpris_set_template(FmtxObject *obj, FmtxMprisField field,
+                        const char *tmpl, GError **error)
+{
+  FmtxMpris *mpris = obj->mpris;
+  gchar *old = mpris->tmpl[field];
+  gchar *key;
+
+  mpris->tmpl[field] = g_strdup(tmpl);
+
+  if (active(mpris))
+  {
+    if (!start(mpris, error))
+    {
+      g_free(mpris->tmpl[field]);
+      mpris->tmpl[field] = old;
+      return FALSE;
+    }
+  }
+  else
+    stop(mpris);
+
+  g_free(old);
+
+  key = template_key(obj, field);
+  gconf_client_set_string(obj->gcclient, key, tmpl, NULL);
+  g_free(key);
+
+  /* render the current track with the new template right away */
+  g_free(mpris->last[field]);
+  mpris->last[field] = NULL;
+  mpris->last_apply = 0;
+  update(mpris);
+
+  g_idle_add(emit_changed, obj);
+
+  return TRUE;
+}
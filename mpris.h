@@ -0,0 +1,35 @@
+#ifndef __FMTXD_MPRIS_H_INCLUDED__
+#define __FMTXD_MPRIS_H_INCLUDED__
+
+#include "fmtx-object.h"
+
+/* Follows MPRIS players on the session bus and renders their now playing
+ * metadata into rds_text and the station name. Templates use %a for the
+ * artist, %t for the title, %l for the album and %% for a percent sign; an
+ * empty template leaves that field alone. Where they end up in the RT the
+ * artist, title and album are tagged for RT+. The bridge only runs while
+ * one of the templates is set. */
+
+/* RT needs about three seconds to reach a receiver in full */
+#define FMTX_MPRIS_MIN_INTERVAL_MS 3000
+
+typedef enum
+{
+  FMTX_MPRIS_RT,
+  FMTX_MPRIS_PS,
+  FMTX_MPRIS_LAST
+} FmtxMprisField;
+
+/* Loads the templates from gconf_dir */
+void
+fmtx_mpris_init(FmtxObject *obj);
+void
+fmtx_mpris_close(FmtxObject *obj);
+
+const char *
+fmtx_mpris_get_template(FmtxObject *obj, FmtxMprisField field);
+gboolean
+fmtx_mpris_set_template(FmtxObject *obj, FmtxMprisField field,
+                        const char *tmpl, GError **error);
+
+#endif /* __FMTXD_MPRIS_H_INCLUDED__ */
@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "noise-map.h"
+
+/* The file is a cache for this machine only, so it is in host byte order */
+#define NOISE_MAP_MAGIC 0x4d4e5846
+#define NOISE_MAP_VERSION 1
+
+struct noise_map_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t freq_min;
+  uint32_t freq_step;
+  uint32_t n;
+};
+
+int
+fmtx_noise_map_reset(FmtxNoiseMap *map, unsigned int freq_min,
+                     unsigned int freq_max, unsigned int freq_step)
+{
+  unsigned int n;
+
+  if (!freq_step || freq_max < freq_min)
+    return 0;
+
+  n = (freq_max - freq_min) / freq_step + 1;
+
+  if (n > FMTX_NOISE_MAP_MAX)
+    return 0;
+
+  if (map->freq_min != freq_min || map->freq_step != freq_step ||
+      map->n != n)
+  {
+    memset(map->entry, 0, sizeof(map->entry));
+    map->freq_min = freq_min;
+    map->freq_step = freq_step;
+    map->n = n;
+  }
+
+  return 1;
+}
+
+static int
+read_full(int fd, void *buf, size_t len)
+{
+  char *p = buf;
+
+  while (len)
+  {
+    ssize_t n = read(fd, p, len);
+
+    if (n <= 0)
+    {
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      return -1;
+    }
+
+    p += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+int
+fmtx_noise_map_load(FmtxNoiseMap *map, const char *path)
+{
+  struct noise_map_header hdr;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  int rv = 0;
+
+  if (fd == -1)
+    return 0;
+
+  if (!read_full(fd, &hdr, sizeof(hdr)) && hdr.magic == NOISE_MAP_MAGIC &&
+      hdr.version == NOISE_MAP_VERSION && hdr.freq_min == map->freq_min &&
+      hdr.freq_step == map->freq_step && hdr.n == map->n)
+  {
+    if (!read_full(fd, map->entry, sizeof(map->entry[0]) * map->n))
+      rv = 1;
+    else
+      memset(map->entry, 0, sizeof(map->entry));
+  }
+
+  close(fd);
+
+  return rv;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+  const char *p = buf;
+
+  while (len)
+  {
+    ssize_t n = write(fd, p, len);
+
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      return -1;
+    }
+
+    p += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+int
+fmtx_noise_map_save(const FmtxNoiseMap *map, const char *path)
+{
+  struct noise_map_header hdr;
+  char tmp[PATH_MAX];
+  char *slash;
+  int fd;
+  int rv;
+
+  if (snprintf(tmp, sizeof(tmp), "%s", path) >= (int)sizeof(tmp))
+  {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  slash = strrchr(tmp, '/');
+
+  if (slash && slash != tmp)
+  {
+    *slash = 0;
+
+    if (mkdir(tmp, 0755) == -1 && errno != EEXIST)
+      return -1;
+  }
+
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+  {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd == -1)
+    return -1;
+
+  hdr.magic = NOISE_MAP_MAGIC;
+  hdr.version = NOISE_MAP_VERSION;
+  hdr.freq_min = map->freq_min;
+  hdr.freq_step = map->freq_step;
+  hdr.n = map->n;
+
+  rv = write_full(fd, &hdr, sizeof(hdr));
+
+  if (!rv)
+    rv = write_full(fd, map->entry, sizeof(map->entry[0]) * map->n);
+
+  if (close(fd) == -1)
+    rv = -1;
+
+  /* readers see either the old map or the new one, never half of it */
+  if (!rv)
+    rv = rename(tmp, path);
+
+  if (rv)
+    unlink(tmp);
+
+  return rv;
+}
+
+unsigned int
+fmtx_noise_map_frequency(const FmtxNoiseMap *map, unsigned int i)
+{
+  return map->freq_min + i * map->freq_step;
+}
+
+void
+fmtx_noise_map_set(FmtxNoiseMap *map, unsigned int i, int rnl, uint32_t now)
+{
+  if (rnl < INT8_MIN)
+    rnl = INT8_MIN;
+  else if (rnl > INT8_MAX)
+    rnl = INT8_MAX;
+
+  map->entry[i].rnl = rnl;
+  map->entry[i].measured = now ? now : 1;
+}
+
+int
+fmtx_noise_map_is_fresh(const FmtxNoiseMap *map, unsigned int i,
+                        uint32_t now, unsigned int max_age)
+{
+  uint32_t measured = map->entry[i].measured;
+
+  return measured && max_age && measured <= now &&
+         now - measured <= max_age;
+}
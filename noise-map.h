@@ -0,0 +1,53 @@
+#ifndef __FMTXD_NOISE_MAP_H_INCLUDED__
+#define __FMTXD_NOISE_MAP_H_INCLUDED__
+
+#include <stdint.h>
+
+/* Last measured noise on every channel of the frequency plan, kept across
+ * restarts so scans only need to revisit channels that went stale. Times
+ * are CLOCK_REALTIME seconds, 0 is never measured. */
+
+#define FMTX_NOISE_MAP_PATH "/var/cache/fmtxd/noise"
+
+/* 76 to 108 MHz in 50 kHz steps */
+#define FMTX_NOISE_MAP_MAX 641
+
+typedef struct
+{
+  uint32_t measured;
+  /* dBuV */
+  int8_t rnl;
+  uint8_t reserved[3];
+} FmtxNoiseEntry;
+
+typedef struct
+{
+  unsigned int freq_min;
+  unsigned int freq_step;
+  unsigned int n;
+  FmtxNoiseEntry entry[FMTX_NOISE_MAP_MAX];
+} FmtxNoiseMap;
+
+/* Keeps the entries if the plan is unchanged, else starts over. Returns 0
+ * when the plan has too many channels. */
+int
+fmtx_noise_map_reset(FmtxNoiseMap *map, unsigned int freq_min,
+                     unsigned int freq_max, unsigned int freq_step);
+/* Only takes entries saved for the same plan. Returns 1 if any were. */
+int
+fmtx_noise_map_load(FmtxNoiseMap *map, const char *path);
+/* Replaces path atomically, returns < 0 and sets errno on failure */
+int
+fmtx_noise_map_save(const FmtxNoiseMap *map, const char *path);
+
+unsigned int
+fmtx_noise_map_frequency(const FmtxNoiseMap *map, unsigned int i);
+void
+fmtx_noise_map_set(FmtxNoiseMap *map, unsigned int i, int rnl,
+                   uint32_t now);
+/* max_age 0 makes every entry stale */
+int
+fmtx_noise_map_is_fresh(const FmtxNoiseMap *map, unsigned int i,
+                        uint32_t now, unsigned int max_age);
+
+#endif /* __FMTXD_NOISE_MAP_H_INCLUDED__ */
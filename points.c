@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "points.h"
+
+int
+fmtx_points_parse(FmtxPoint *point, unsigned int max, const char *text,
+                  int min_x, int max_x)
+{
+  unsigned int n = 0;
+  const char *p = text;
+  char *end;
+  long x;
+  long level;
+
+  while (*p)
+  {
+    x = strtol(p, &end, 10);
+
+    /* the bounds also bound the length of the formatted list */
+    if (end == p || *end != ':' || x < min_x || x > max_x)
+      return -1;
+
+    p = end + 1;
+    level = strtol(p, &end, 10);
+
+    if (end == p || (*end && (*end != ',' || !end[1])))
+      return -1;
+
+    if (n == max || (n && x <= point[n - 1].x) ||
+        level < FMTX_MIN_POWER_LEVEL || level > FMTX_MAX_POWER_LEVEL)
+      return -1;
+
+    point[n].x = x;
+    point[n].level = level;
+    n++;
+
+    p = *end ? end + 1 : end;
+  }
+
+  return n;
+}
+
+void
+fmtx_points_format(const FmtxPoint *point, unsigned int n, char *buf,
+                   unsigned int len)
+{
+  unsigned int off = 0;
+  unsigned int i;
+
+  buf[0] = 0;
+
+  for (i = 0; i < n && off < len; i++)
+    off += snprintf(buf + off, len - off, "%s%d:%d", i ? "," : "",
+                    point[i].x, point[i].level);
+}
+
+int
+fmtx_points_eval(const FmtxPoint *point, unsigned int n, int x)
+{
+  const FmtxPoint *a;
+  const FmtxPoint *b;
+  unsigned int i;
+  long long d;
+  long long w;
+
+  if (!n)
+    return -1;
+
+  if (x <= point[0].x)
+    return point[0].level;
+
+  for (i = 1; i < n; i++)
+  {
+    a = &point[i - 1];
+    b = &point[i];
+
+    if (x < b->x)
+    {
+      d = (long long)(b->level - a->level) * (x - a->x);
+      w = b->x - a->x;
+
+      return a->level + (d >= 0 ? d / w : -((-d + w - 1) / w));
+    }
+  }
+
+  return point[n - 1].level;
+}
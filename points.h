@@ -0,0 +1,30 @@
+#ifndef __FMTXD_POINTS_H_INCLUDED__
+#define __FMTXD_POINTS_H_INCLUDED__
+
+/* Point lists "x:dBuV,..." with x ascending, as used by the governor
+ * curves and the power table. Between the points the level is linear,
+ * past the first and the last it is flat. */
+
+#define FMTX_MIN_POWER_LEVEL 88
+#define FMTX_MAX_POWER_LEVEL 120
+
+typedef struct
+{
+  int x;
+  int level;
+} FmtxPoint;
+
+/* Parses at most max points with x from min_x to max_x, "" is none.
+ * Returns the number of points, -1 if invalid with point partly
+ * written. */
+int
+fmtx_points_parse(FmtxPoint *point, unsigned int max, const char *text,
+                  int min_x, int max_x);
+void
+fmtx_points_format(const FmtxPoint *point, unsigned int n, char *buf,
+                   unsigned int len);
+/* Rounded towards the lower level, -1 without points */
+int
+fmtx_points_eval(const FmtxPoint *point, unsigned int n, int x);
+
+#endif /* __FMTXD_POINTS_H_INCLUDED__ */
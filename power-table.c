@@ -0,0 +1,84 @@
+#include "power-table.h"
+
+int
+fmtx_power_table_set_points(FmtxPowerTable *table, const char *text)
+{
+  FmtxPoint point[FMTX_POWER_TABLE_MAX_POINTS];
+  int n = fmtx_points_parse(point, FMTX_POWER_TABLE_MAX_POINTS, text,
+                            FMTX_POWER_TABLE_MIN_KHZ,
+                            FMTX_POWER_TABLE_MAX_KHZ);
+
+  if (n < 0)
+    return 0;
+
+  table->n_points = n;
+
+  while (n--)
+    table->point[n] = point[n];
+
+  return 1;
+}
+
+void
+fmtx_power_table_format_points(const FmtxPowerTable *table, char *buf,
+                               unsigned int len)
+{
+  fmtx_points_format(table->point, table->n_points, buf, len);
+}
+
+/* Rounded down so a channel never gets more than was measured to be safe,
+ * CAL's level where no points are given */
+static int
+interpolate(const FmtxPowerTable *table, unsigned int khz, int cal_level)
+{
+  if (!table->n_points)
+    return cal_level;
+
+  return fmtx_points_eval(table->point, table->n_points, khz);
+}
+
+int
+fmtx_power_table_build(FmtxPowerTable *table, unsigned int freq_min,
+                       unsigned int freq_max, unsigned int freq_step,
+                       int cal_level)
+{
+  unsigned int n;
+  unsigned int i;
+  int level;
+
+  if (!freq_step || freq_max < freq_min)
+    return 0;
+
+  n = (freq_max - freq_min) / freq_step + 1;
+
+  if (n > FMTX_POWER_TABLE_MAX)
+    return 0;
+
+  if (cal_level < FMTX_MIN_POWER_LEVEL)
+    cal_level = FMTX_MIN_POWER_LEVEL;
+
+  for (i = 0; i < n; i++)
+  {
+    level = interpolate(table, freq_min + i * freq_step, cal_level);
+    table->level[i] = level > cal_level ? cal_level : level;
+  }
+
+  table->freq_min = freq_min;
+  table->freq_step = freq_step;
+  table->n = n;
+
+  return 1;
+}
+
+int
+fmtx_power_table_lookup(const FmtxPowerTable *table, unsigned int khz)
+{
+  unsigned int i;
+
+  if (!table->n || khz < table->freq_min)
+    return 0;
+
+  i = (khz - table->freq_min) / table->freq_step;
+
+  return i < table->n ? table->level[i] : 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __FMTXD_POWER_TABLE_H_INCLUDED__
+#define __FMTXD_POWER_TABLE_H_INCLUDED__
+
+#include <stdint.h>
+
+#include "points.h"
+
+/* Transmit power for every channel of the frequency plan, so a retune
+ * only has to index it. The levels are interpolated from measured points
+ * and capped by the CAL limit, which is also used where no points are
+ * given since CAL has a single level per standard. */
+
+/* 76 to 108 MHz in 50 kHz steps */
+#define FMTX_POWER_TABLE_MAX 641
+#define FMTX_POWER_TABLE_MAX_POINTS 32
+#define FMTX_POWER_TABLE_MIN_KHZ 76000
+#define FMTX_POWER_TABLE_MAX_KHZ 108000
+/* "108000:120," per point at most, the last comma leaves room for the NUL */
+#define FMTX_POWER_TABLE_MAX_TEXT (FMTX_POWER_TABLE_MAX_POINTS * 11)
+
+typedef struct
+{
+  unsigned int n_points;
+  /* x in kHz */
+  FmtxPoint point[FMTX_POWER_TABLE_MAX_POINTS];
+  unsigned int freq_min;
+  unsigned int freq_step;
+  unsigned int n;
+  uint8_t level[FMTX_POWER_TABLE_MAX];
+} FmtxPowerTable;
+
+/* "kHz:dBuV,..." with kHz ascending within FMTX_POWER_TABLE_MIN_KHZ and
+ * FMTX_POWER_TABLE_MAX_KHZ, "" clears. Returns 0 if invalid and leaves the
+ * points alone. */
+int
+fmtx_power_table_set_points(FmtxPowerTable *table, const char *text);
+void
+fmtx_power_table_format_points(const FmtxPowerTable *table, char *buf,
+                               unsigned int len);
+/* Fills the levels for a plan, none above cal_level. Returns 0 when the
+ * plan has too many channels. */
+int
+fmtx_power_table_build(FmtxPowerTable *table, unsigned int freq_min,
+                       unsigned int freq_max, unsigned int freq_step,
+                       int cal_level);
+
+/* 0 before the table is built or off the plan */
+int
+fmtx_power_table_lookup(const FmtxPowerTable *table, unsigned int khz);
+
+#endif /* __FMTXD_POWER_TABLE_H_INCLUDED__ */
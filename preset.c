@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "preset.h"
+
+int
+fmtx_preset_name_valid(const char *name)
+{
+  size_t len = strlen(name);
+  size_t i;
+
+  if (!len || len > FMTX_PRESET_NAME_LEN)
+    return 0;
+
+  for (i = 0; i < len; i++)
+  {
+    char c = name[i];
+
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '-' || c == '_'))
+      return 0;
+  }
+
+  return 1;
+}
+
+FmtxPreset *
+fmtx_preset_find(FmtxPresetList *list, const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < list->n; i++)
+  {
+    if (!strcmp(list->preset[i].name, name))
+      return &list->preset[i];
+  }
+
+  return NULL;
+}
+
+static void
+update_names(FmtxPresetList *list)
+{
+  char *p = list->names;
+  unsigned int i;
+
+  *p = 0;
+
+  for (i = 0; i < list->n; i++)
+  {
+    if (i)
+      *p++ = ',';
+
+    strcpy(p, list->preset[i].name);
+    p += strlen(p);
+  }
+}
+
+int
+fmtx_preset_store(FmtxPresetList *list, const FmtxPreset *preset)
+{
+  FmtxPreset *p = fmtx_preset_find(list, preset->name);
+
+  if (!p)
+  {
+    if (list->n == FMTX_MAX_PRESETS)
+      return 0;
+
+    p = &list->preset[list->n++];
+  }
+
+  *p = *preset;
+  update_names(list);
+
+  return 1;
+}
+
+int
+fmtx_preset_remove(FmtxPresetList *list, const char *name)
+{
+  FmtxPreset *p = fmtx_preset_find(list, name);
+
+  if (!p)
+    return 0;
+
+  memmove(p, p + 1, (list->preset + list->n - (p + 1)) * sizeof(*p));
+  list->n--;
+  update_names(list);
+
+  return 1;
+}
@@ -0,0 +1,50 @@
+#ifndef __FMTXD_PRESET_H_INCLUDED__
+#define __FMTXD_PRESET_H_INCLUDED__
+
+#include "rds-charset.h"
+#include "rds.h"
+
+/* Named transmitter setups. The engine checks a preset against the plan
+ * and the CAL limit when it is saved, so applying it can't fail half way.
+ * Names double as gconf directory names. */
+
+#define FMTX_MAX_PRESETS 16
+#define FMTX_PRESET_NAME_LEN 24
+/* comma separated names */
+#define FMTX_PRESET_NAMES_LEN (FMTX_MAX_PRESETS * (FMTX_PRESET_NAME_LEN + 1))
+
+typedef struct
+{
+  char name[FMTX_PRESET_NAME_LEN + 1];
+  /* kHz */
+  unsigned int frequency;
+  /* dBuV, 0 for the CAL limit */
+  unsigned int power_level;
+  /* us, 0 for the region's */
+  unsigned int preemphasis;
+  /* UTF-8 */
+  char rds_ps[FMTX_RDS_CHARSET_MAX_BYTES(FMTX_RDS_PS_LEN) + 1];
+  char rds_text[FMTX_RDS_CHARSET_MAX_BYTES(FMTX_RDS_RT_LEN) + 1];
+} FmtxPreset;
+
+typedef struct
+{
+  unsigned int n;
+  FmtxPreset preset[FMTX_MAX_PRESETS];
+  char names[FMTX_PRESET_NAMES_LEN];
+} FmtxPresetList;
+
+/* Letters, digits, '-' and '_' */
+int
+fmtx_preset_name_valid(const char *name);
+/* NULL if there is none of that name */
+FmtxPreset *
+fmtx_preset_find(FmtxPresetList *list, const char *name);
+/* Replaces a preset of the same name. Returns 0 when the list is full. */
+int
+fmtx_preset_store(FmtxPresetList *list, const FmtxPreset *preset);
+/* Returns 0 if there was none of that name */
+int
+fmtx_preset_remove(FmtxPresetList *list, const char *name);
+
+#endif /* __FMTXD_PRESET_H_INCLUDED__ */
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "profile.h"
+
+static int
+profile_enabled(void)
+{
+  static int enabled = -1;
+
+  if (enabled == -1)
+    enabled = g_getenv("FMTXD_PROFILE") != NULL;
+
+  return enabled;
+}
+
+static long
+rss_kb(void)
+{
+  long size;
+  long resident = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+
+  if (!fp)
+    return 0;
+
+  if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+    resident = 0;
+
+  fclose(fp);
+
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void
+fmtx_profile_begin(FmtxProfileMark *mark)
+{
+  if (!profile_enabled())
+    return;
+
+  mark->start = g_get_monotonic_time();
+  mark->rss_kb = rss_kb();
+}
+
+void
+fmtx_profile_end(FmtxProfileMark *mark, const char *subsystem)
+{
+  long rss;
+
+  if (!profile_enabled())
+    return;
+
+  rss = rss_kb();
+  g_printerr("fmtxd: profile: %-12s %8lld us %+6ld kB (rss %ld kB)\n",
+             subsystem, (long long)(g_get_monotonic_time() - mark->start),
+             rss - mark->rss_kb, rss);
+}
@@ -0,0 +1,18 @@
+#ifndef __FMTXD_PROFILE_H_INCLUDED__
+#define __FMTXD_PROFILE_H_INCLUDED__
+
+#include <glib.h>
+
+/* Startup profile, printed to stderr when FMTXD_PROFILE is set */
+typedef struct
+{
+  gint64 start;
+  long rss_kb;
+} FmtxProfileMark;
+
+void
+fmtx_profile_begin(FmtxProfileMark *mark);
+void
+fmtx_profile_end(FmtxProfileMark *mark, const char *subsystem);
+
+#endif /* __FMTXD_PROFILE_H_INCLUDED__ */
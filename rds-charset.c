@@ -0,0 +1,402 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "rds-charset.h"
+
+/* EBU code of U+0000 to U+017F, 0 where the set has none. Controls,
+ * including the C1 range, are spaces. */
+static const uint8_t latin_to_ebu[0x180] =
+{
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x21, 0x22, 0x23, 0xab, 0x25, 0x26, 0x27,
+  0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+  0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f,
+  0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+  0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57,
+  0x58, 0x59, 0x5a, 0x5b, 0x5c, 0x5d, 0x00, 0x5f,
+  0x00, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+  0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f,
+  0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+  0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x00, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x00, 0x8e, 0x00, 0xaa, 0x24, 0x00, 0x00, 0xbf,
+  0x00, 0xa2, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x7e,
+  0xbb, 0xb4, 0xb2, 0xb3, 0x00, 0xb8, 0x00, 0x00,
+  0x00, 0xb1, 0xb0, 0x00, 0xbc, 0xbd, 0xbe, 0xb9,
+  0xc1, 0xc0, 0xd0, 0xe0, 0xd1, 0xe1, 0xe2, 0x8b,
+  0xc3, 0xc2, 0xd2, 0xd3, 0xc5, 0xc4, 0xd4, 0xd5,
+  0x00, 0x8a, 0xc7, 0xc6, 0xd6, 0xe6, 0xd7, 0x00,
+  0xe7, 0xc9, 0xc8, 0xd8, 0xd9, 0xe5, 0xe8, 0x8d,
+  0x81, 0x80, 0x90, 0xf0, 0x91, 0xf1, 0xf2, 0x9b,
+  0x83, 0x82, 0x92, 0x93, 0x85, 0x84, 0x94, 0x95,
+  0xef, 0x9a, 0x87, 0x86, 0x96, 0xf6, 0x97, 0xba,
+  0xf7, 0x89, 0x88, 0x98, 0x99, 0xf5, 0xf8, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xeb, 0xfb,
+  0x00, 0x00, 0x00, 0x00, 0xcb, 0xdb, 0x00, 0x00,
+  0xce, 0xde, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0xa5, 0x00, 0x00, 0xa4, 0x9d,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xb5, 0x9e, 0x8f, 0x9f, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xcf,
+  0xdf, 0x00, 0x00, 0x00, 0xb6, 0x00, 0x00, 0x00,
+  0xa6, 0x00, 0xe9, 0xf9, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0xa7, 0xe3, 0xf3, 0xea, 0xfa, 0x00, 0x00,
+  0xca, 0xda, 0xec, 0xfc, 0x00, 0x00, 0x8c, 0x9c,
+  0xcc, 0xdc, 0x00, 0x00, 0x00, 0x00, 0xee, 0xfe,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0xb7, 0x00, 0x00, 0x00, 0xf4, 0x00, 0xe4,
+  0x00, 0xed, 0xfd, 0x00, 0x00, 0xcd, 0xdd, 0x00
+};
+
+/* Sorted by code point: transliterations of what latin_to_ebu lacks and
+ * the EBU characters above it. Generated from the Unicode decompositions,
+ * keeping as much of an accent as the set has, plus Greek and Cyrillic
+ * romanisations and typographic punctuation. */
+static const struct
+{
+  uint16_t cp;
+  char text[5];
+} translit[] =
+{
+  { 0x005e, "'" }, { 0x0060, "'" }, { 0x007e, "-" },
+  { 0x00a0, " " }, { 0x00a2, "c" }, { 0x00a5, "Y" },
+  { 0x00a6, "|" }, { 0x00a8, "\"" }, { 0x00ab, "\"" },
+  { 0x00ac, "-" }, { 0x00ad, "" }, { 0x00ae, "(R)" },
+  { 0x00b4, "'" }, { 0x00b6, "P" }, { 0x00b7, "." },
+  { 0x00b8, "," }, { 0x00bb, "\"" }, { 0x00d0, "\316" },
+  { 0x00d7, "x" }, { 0x00ff, "y" }, { 0x0100, "A" },
+  { 0x0101, "a" }, { 0x0102, "A" }, { 0x0103, "a" },
+  { 0x0104, "A" }, { 0x0105, "a" }, { 0x0108, "C" },
+  { 0x0109, "c" }, { 0x010a, "C" }, { 0x010b, "c" },
+  { 0x010e, "D" }, { 0x010f, "d" }, { 0x0112, "E" },
+  { 0x0113, "e" }, { 0x0114, "E" }, { 0x0115, "e" },
+  { 0x0116, "E" }, { 0x0117, "e" }, { 0x0118, "E" },
+  { 0x0119, "e" }, { 0x011a, "E" }, { 0x011c, "G" },
+  { 0x011d, "g" }, { 0x0120, "G" }, { 0x0121, "g" },
+  { 0x0122, "G" }, { 0x0123, "g" }, { 0x0124, "H" },
+  { 0x0125, "h" }, { 0x0126, "H" }, { 0x0127, "h" },
+  { 0x0128, "I" }, { 0x0129, "i" }, { 0x012a, "I" },
+  { 0x012b, "i" }, { 0x012c, "I" }, { 0x012d, "i" },
+  { 0x012e, "I" }, { 0x012f, "i" }, { 0x0134, "J" },
+  { 0x0135, "j" }, { 0x0136, "K" }, { 0x0137, "k" },
+  { 0x0138, "k" }, { 0x0139, "L" }, { 0x013a, "l" },
+  { 0x013b, "L" }, { 0x013c, "l" }, { 0x013d, "L" },
+  { 0x013e, "l" }, { 0x0141, "L" }, { 0x0142, "l" },
+  { 0x0143, "N" }, { 0x0145, "N" }, { 0x0146, "n" },
+  { 0x0147, "N" }, { 0x0149, "'n" }, { 0x014c, "O" },
+  { 0x014d, "o" }, { 0x014e, "O" }, { 0x014f, "o" },
+  { 0x0150, "O" }, { 0x0156, "R" }, { 0x0157, "r" },
+  { 0x015c, "S" }, { 0x015d, "s" }, { 0x0162, "T" },
+  { 0x0163, "t" }, { 0x0164, "T" }, { 0x0165, "t" },
+  { 0x0168, "U" }, { 0x0169, "u" }, { 0x016a, "U" },
+  { 0x016b, "u" }, { 0x016c, "U" }, { 0x016d, "u" },
+  { 0x016e, "U" }, { 0x016f, "u" }, { 0x0170, "U" },
+  { 0x0172, "U" }, { 0x0173, "u" }, { 0x0174, "W" },
+  { 0x0176, "Y" }, { 0x0178, "Y" }, { 0x017b, "Z" },
+  { 0x017c, "z" }, { 0x017f, "s" }, { 0x0192, "f" },
+  { 0x01a0, "O" }, { 0x01a1, "o" }, { 0x01af, "U" },
+  { 0x01b0, "u" }, { 0x01cd, "A" }, { 0x01ce, "a" },
+  { 0x01cf, "I" }, { 0x01d0, "i" }, { 0x01d1, "O" },
+  { 0x01d2, "o" }, { 0x01d3, "U" }, { 0x01d4, "u" },
+  { 0x01d5, "\331" }, { 0x01d6, "\231" }, { 0x01d7, "\331" },
+  { 0x01d8, "\231" }, { 0x01d9, "\331" }, { 0x01da, "\231" },
+  { 0x01db, "\331" }, { 0x01dc, "\231" }, { 0x01de, "\321" },
+  { 0x01df, "\221" }, { 0x01e0, "A" }, { 0x01e1, "a" },
+  { 0x01e2, "\342" }, { 0x01e3, "\362" }, { 0x01e6, "G" },
+  { 0x01e7, "g" }, { 0x01e8, "K" }, { 0x01e9, "k" },
+  { 0x01ea, "O" }, { 0x01eb, "o" }, { 0x01ec, "O" },
+  { 0x01ed, "o" }, { 0x01f0, "j" }, { 0x01f4, "G" },
+  { 0x01f5, "g" }, { 0x01f8, "N" }, { 0x01f9, "n" },
+  { 0x01fa, "\341" }, { 0x01fb, "\361" }, { 0x01fc, "\342" },
+  { 0x01fd, "\362" }, { 0x01fe, "\347" }, { 0x01ff, "\367" },
+  { 0x0200, "A" }, { 0x0201, "a" }, { 0x0202, "A" },
+  { 0x0203, "a" }, { 0x0204, "E" }, { 0x0205, "e" },
+  { 0x0206, "E" }, { 0x0207, "e" }, { 0x0208, "I" },
+  { 0x0209, "i" }, { 0x020a, "I" }, { 0x020b, "i" },
+  { 0x020c, "O" }, { 0x020d, "o" }, { 0x020e, "O" },
+  { 0x020f, "o" }, { 0x0210, "R" }, { 0x0211, "r" },
+  { 0x0212, "R" }, { 0x0213, "r" }, { 0x0214, "U" },
+  { 0x0215, "u" }, { 0x0216, "U" }, { 0x0217, "u" },
+  { 0x0218, "S" }, { 0x0219, "s" }, { 0x021a, "T" },
+  { 0x021b, "t" }, { 0x021e, "H" }, { 0x021f, "h" },
+  { 0x0226, "A" }, { 0x0227, "a" }, { 0x0228, "E" },
+  { 0x0229, "e" }, { 0x022a, "\327" }, { 0x022b, "\227" },
+  { 0x022c, "\346" }, { 0x022d, "\366" }, { 0x022e, "O" },
+  { 0x022f, "o" }, { 0x0230, "O" }, { 0x0231, "o" },
+  { 0x0232, "Y" }, { 0x0233, "y" }, { 0x0386, "A" },
+  { 0x0388, "E" }, { 0x0389, "I" }, { 0x038a, "I" },
+  { 0x038c, "O" }, { 0x038e, "Y" }, { 0x038f, "O" },
+  { 0x0390, "i" }, { 0x0391, "A" }, { 0x0392, "V" },
+  { 0x0393, "G" }, { 0x0394, "D" }, { 0x0395, "E" },
+  { 0x0396, "Z" }, { 0x0397, "I" }, { 0x0398, "Th" },
+  { 0x0399, "I" }, { 0x039a, "K" }, { 0x039b, "L" },
+  { 0x039c, "M" }, { 0x039d, "N" }, { 0x039e, "X" },
+  { 0x039f, "O" }, { 0x03a0, "P" }, { 0x03a1, "R" },
+  { 0x03a3, "S" }, { 0x03a4, "T" }, { 0x03a5, "Y" },
+  { 0x03a6, "F" }, { 0x03a7, "Ch" }, { 0x03a8, "Ps" },
+  { 0x03a9, "O" }, { 0x03aa, "I" }, { 0x03ab, "Y" },
+  { 0x03ac, "\241" }, { 0x03ad, "e" }, { 0x03ae, "i" },
+  { 0x03af, "i" }, { 0x03b0, "y" }, { 0x03b1, "\241" },
+  { 0x03b2, "v" }, { 0x03b3, "g" }, { 0x03b4, "d" },
+  { 0x03b5, "e" }, { 0x03b6, "z" }, { 0x03b7, "i" },
+  { 0x03b8, "th" }, { 0x03b9, "i" }, { 0x03ba, "k" },
+  { 0x03bb, "l" }, { 0x03bc, "\270" }, { 0x03bd, "n" },
+  { 0x03be, "x" }, { 0x03bf, "o" }, { 0x03c0, "\250" },
+  { 0x03c1, "r" }, { 0x03c2, "s" }, { 0x03c3, "s" },
+  { 0x03c4, "t" }, { 0x03c5, "y" }, { 0x03c6, "f" },
+  { 0x03c7, "ch" }, { 0x03c8, "ps" }, { 0x03c9, "o" },
+  { 0x03ca, "i" }, { 0x03cb, "y" }, { 0x03cc, "o" },
+  { 0x03cd, "y" }, { 0x03ce, "o" }, { 0x0401, "Yo" },
+  { 0x0404, "Ye" }, { 0x0406, "I" }, { 0x0407, "Yi" },
+  { 0x040e, "U" }, { 0x0410, "A" }, { 0x0411, "B" },
+  { 0x0412, "V" }, { 0x0413, "G" }, { 0x0414, "D" },
+  { 0x0415, "E" }, { 0x0416, "Zh" }, { 0x0417, "Z" },
+  { 0x0418, "I" }, { 0x0419, "J" }, { 0x041a, "K" },
+  { 0x041b, "L" }, { 0x041c, "M" }, { 0x041d, "N" },
+  { 0x041e, "O" }, { 0x041f, "P" }, { 0x0420, "R" },
+  { 0x0421, "S" }, { 0x0422, "T" }, { 0x0423, "U" },
+  { 0x0424, "F" }, { 0x0425, "Kh" }, { 0x0426, "Ts" },
+  { 0x0427, "Ch" }, { 0x0428, "Sh" }, { 0x0429, "Shch" },
+  { 0x042a, "" }, { 0x042b, "Y" }, { 0x042c, "" },
+  { 0x042d, "E" }, { 0x042e, "Yu" }, { 0x042f, "Ya" },
+  { 0x0430, "a" }, { 0x0431, "b" }, { 0x0432, "v" },
+  { 0x0433, "g" }, { 0x0434, "d" }, { 0x0435, "e" },
+  { 0x0436, "zh" }, { 0x0437, "z" }, { 0x0438, "i" },
+  { 0x0439, "j" }, { 0x043a, "k" }, { 0x043b, "l" },
+  { 0x043c, "m" }, { 0x043d, "n" }, { 0x043e, "o" },
+  { 0x043f, "p" }, { 0x0440, "r" }, { 0x0441, "s" },
+  { 0x0442, "t" }, { 0x0443, "u" }, { 0x0444, "f" },
+  { 0x0445, "kh" }, { 0x0446, "ts" }, { 0x0447, "ch" },
+  { 0x0448, "sh" }, { 0x0449, "shch" }, { 0x044a, "" },
+  { 0x044b, "y" }, { 0x044c, "" }, { 0x044d, "e" },
+  { 0x044e, "yu" }, { 0x044f, "ya" }, { 0x0451, "yo" },
+  { 0x0454, "ye" }, { 0x0456, "i" }, { 0x0457, "yi" },
+  { 0x045e, "u" }, { 0x0490, "G" }, { 0x0491, "g" },
+  { 0x1e00, "A" }, { 0x1e01, "a" }, { 0x1e02, "B" },
+  { 0x1e03, "b" }, { 0x1e04, "B" }, { 0x1e05, "b" },
+  { 0x1e06, "B" }, { 0x1e07, "b" }, { 0x1e08, "\213" },
+  { 0x1e09, "\233" }, { 0x1e0a, "D" }, { 0x1e0b, "d" },
+  { 0x1e0c, "D" }, { 0x1e0d, "d" }, { 0x1e0e, "D" },
+  { 0x1e0f, "d" }, { 0x1e10, "D" }, { 0x1e11, "d" },
+  { 0x1e12, "D" }, { 0x1e13, "d" }, { 0x1e14, "\303" },
+  { 0x1e15, "\203" }, { 0x1e16, "\302" }, { 0x1e17, "\202" },
+  { 0x1e18, "E" }, { 0x1e19, "e" }, { 0x1e1a, "E" },
+  { 0x1e1b, "e" }, { 0x1e1c, "E" }, { 0x1e1d, "e" },
+  { 0x1e1e, "F" }, { 0x1e1f, "f" }, { 0x1e20, "G" },
+  { 0x1e21, "g" }, { 0x1e22, "H" }, { 0x1e23, "h" },
+  { 0x1e24, "H" }, { 0x1e25, "h" }, { 0x1e26, "H" },
+  { 0x1e27, "h" }, { 0x1e28, "H" }, { 0x1e29, "h" },
+  { 0x1e2a, "H" }, { 0x1e2b, "h" }, { 0x1e2c, "I" },
+  { 0x1e2d, "i" }, { 0x1e2e, "\325" }, { 0x1e2f, "\225" },
+  { 0x1e30, "K" }, { 0x1e31, "k" }, { 0x1e32, "K" },
+  { 0x1e33, "k" }, { 0x1e34, "K" }, { 0x1e35, "k" },
+  { 0x1e36, "L" }, { 0x1e37, "l" }, { 0x1e38, "L" },
+  { 0x1e39, "l" }, { 0x1e3a, "L" }, { 0x1e3b, "l" },
+  { 0x1e3c, "L" }, { 0x1e3d, "l" }, { 0x1e3e, "M" },
+  { 0x1e3f, "m" }, { 0x1e40, "M" }, { 0x1e41, "m" },
+  { 0x1e42, "M" }, { 0x1e43, "m" }, { 0x1e44, "N" },
+  { 0x1e45, "n" }, { 0x1e46, "N" }, { 0x1e47, "n" },
+  { 0x1e48, "N" }, { 0x1e49, "n" }, { 0x1e4a, "N" },
+  { 0x1e4b, "n" }, { 0x1e4c, "\346" }, { 0x1e4d, "\366" },
+  { 0x1e4e, "\346" }, { 0x1e4f, "\366" }, { 0x1e50, "\307" },
+  { 0x1e51, "\207" }, { 0x1e52, "\306" }, { 0x1e53, "\206" },
+  { 0x1e54, "P" }, { 0x1e55, "p" }, { 0x1e56, "P" },
+  { 0x1e57, "p" }, { 0x1e58, "R" }, { 0x1e59, "r" },
+  { 0x1e5a, "R" }, { 0x1e5b, "r" }, { 0x1e5c, "R" },
+  { 0x1e5d, "r" }, { 0x1e5e, "R" }, { 0x1e5f, "r" },
+  { 0x1e60, "S" }, { 0x1e61, "s" }, { 0x1e62, "S" },
+  { 0x1e63, "s" }, { 0x1e64, "\354" }, { 0x1e65, "\374" },
+  { 0x1e66, "\314" }, { 0x1e67, "\334" }, { 0x1e68, "S" },
+  { 0x1e69, "s" }, { 0x1e6a, "T" }, { 0x1e6b, "t" },
+  { 0x1e6c, "T" }, { 0x1e6d, "t" }, { 0x1e6e, "T" },
+  { 0x1e6f, "t" }, { 0x1e70, "T" }, { 0x1e71, "t" },
+  { 0x1e72, "U" }, { 0x1e73, "u" }, { 0x1e74, "U" },
+  { 0x1e75, "u" }, { 0x1e76, "U" }, { 0x1e77, "u" },
+  { 0x1e78, "\310" }, { 0x1e79, "\210" }, { 0x1e7a, "\331" },
+  { 0x1e7b, "\231" }, { 0x1e7c, "V" }, { 0x1e7d, "v" },
+  { 0x1e7e, "V" }, { 0x1e7f, "v" }, { 0x1e80, "W" },
+  { 0x1e81, "w" }, { 0x1e82, "W" }, { 0x1e83, "w" },
+  { 0x1e84, "W" }, { 0x1e85, "w" }, { 0x1e86, "W" },
+  { 0x1e87, "w" }, { 0x1e88, "W" }, { 0x1e89, "w" },
+  { 0x1e8a, "X" }, { 0x1e8b, "x" }, { 0x1e8c, "X" },
+  { 0x1e8d, "x" }, { 0x1e8e, "Y" }, { 0x1e8f, "y" },
+  { 0x1e90, "Z" }, { 0x1e91, "z" }, { 0x1e92, "Z" },
+  { 0x1e93, "z" }, { 0x1e94, "Z" }, { 0x1e95, "z" },
+  { 0x1e96, "h" }, { 0x1e97, "t" }, { 0x1e98, "w" },
+  { 0x1e99, "y" }, { 0x1ea0, "A" }, { 0x1ea1, "a" },
+  { 0x1ea2, "A" }, { 0x1ea3, "a" }, { 0x1ea4, "\320" },
+  { 0x1ea5, "\220" }, { 0x1ea6, "\320" }, { 0x1ea7, "\220" },
+  { 0x1ea8, "\320" }, { 0x1ea9, "\220" }, { 0x1eaa, "\320" },
+  { 0x1eab, "\220" }, { 0x1eac, "\320" }, { 0x1ead, "\220" },
+  { 0x1eae, "\300" }, { 0x1eaf, "\200" }, { 0x1eb0, "\301" },
+  { 0x1eb1, "\201" }, { 0x1eb2, "A" }, { 0x1eb3, "a" },
+  { 0x1eb4, "\340" }, { 0x1eb5, "\360" }, { 0x1eb6, "A" },
+  { 0x1eb7, "a" }, { 0x1eb8, "E" }, { 0x1eb9, "e" },
+  { 0x1eba, "E" }, { 0x1ebb, "e" }, { 0x1ebc, "E" },
+  { 0x1ebd, "e" }, { 0x1ebe, "\322" }, { 0x1ebf, "\222" },
+  { 0x1ec0, "\322" }, { 0x1ec1, "\222" }, { 0x1ec2, "\322" },
+  { 0x1ec3, "\222" }, { 0x1ec4, "\322" }, { 0x1ec5, "\222" },
+  { 0x1ec6, "\322" }, { 0x1ec7, "\222" }, { 0x1ec8, "I" },
+  { 0x1ec9, "i" }, { 0x1eca, "I" }, { 0x1ecb, "i" },
+  { 0x1ecc, "O" }, { 0x1ecd, "o" }, { 0x1ece, "O" },
+  { 0x1ecf, "o" }, { 0x1ed0, "\326" }, { 0x1ed1, "\226" },
+  { 0x1ed2, "\326" }, { 0x1ed3, "\226" }, { 0x1ed4, "\326" },
+  { 0x1ed5, "\226" }, { 0x1ed6, "\326" }, { 0x1ed7, "\226" },
+  { 0x1ed8, "\326" }, { 0x1ed9, "\226" }, { 0x1eda, "\306" },
+  { 0x1edb, "\206" }, { 0x1edc, "\307" }, { 0x1edd, "\207" },
+  { 0x1ede, "O" }, { 0x1edf, "o" }, { 0x1ee0, "\346" },
+  { 0x1ee1, "\366" }, { 0x1ee2, "O" }, { 0x1ee3, "o" },
+  { 0x1ee4, "U" }, { 0x1ee5, "u" }, { 0x1ee6, "U" },
+  { 0x1ee7, "u" }, { 0x1ee8, "\310" }, { 0x1ee9, "\210" },
+  { 0x1eea, "\311" }, { 0x1eeb, "\211" }, { 0x1eec, "U" },
+  { 0x1eed, "u" }, { 0x1eee, "U" }, { 0x1eef, "u" },
+  { 0x1ef0, "U" }, { 0x1ef1, "u" }, { 0x1ef2, "Y" },
+  { 0x1ef3, "y" }, { 0x1ef4, "Y" }, { 0x1ef5, "y" },
+  { 0x1ef6, "Y" }, { 0x1ef7, "y" }, { 0x1ef8, "Y" },
+  { 0x1ef9, "y" }, { 0x200b, "" }, { 0x200c, "" },
+  { 0x200d, "" }, { 0x2010, "-" }, { 0x2011, "-" },
+  { 0x2012, "-" }, { 0x2013, "-" }, { 0x2014, "-" },
+  { 0x2015, "^" }, { 0x2016, "`" }, { 0x2018, "'" },
+  { 0x2019, "'" }, { 0x201a, "," }, { 0x201b, "'" },
+  { 0x201c, "\"" }, { 0x201d, "\"" }, { 0x201e, "\"" },
+  { 0x201f, "\"" }, { 0x2020, "+" }, { 0x2022, "*" },
+  { 0x2026, "..." }, { 0x2030, "\243" }, { 0x2032, "'" },
+  { 0x2033, "\"" }, { 0x2039, "<" }, { 0x203a, ">" },
+  { 0x203e, "~" }, { 0x2060, "" }, { 0x20ac, "\251" },
+  { 0x2122, "TM" }, { 0x2190, "\254" }, { 0x2191, "\255" },
+  { 0x2192, "\256" }, { 0x2193, "\257" }, { 0x2212, "-" },
+  { 0xfeff, "" }
+};
+
+#define N_TRANSLIT (sizeof(translit) / sizeof(translit[0]))
+
+static const char *
+find_translit(uint32_t cp)
+{
+  size_t lo = 0;
+  size_t hi = N_TRANSLIT;
+
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+
+    if (translit[mid].cp < cp)
+      lo = mid + 1;
+    else if (translit[mid].cp > cp)
+      hi = mid;
+    else
+      return translit[mid].text;
+  }
+
+  return NULL;
+}
+
+/* Returns the length of the sequence at p and its code point in *cp, for
+ * p[0] >= 0x80 */
+static size_t
+decode(const unsigned char *p, size_t avail, uint32_t *cp)
+{
+  uint32_t c = p[0];
+  size_t n = 0;
+  size_t i;
+
+  if (c >= 0xc2 && c <= 0xdf)
+  {
+    n = 2;
+    c &= 0x1f;
+  }
+  else if (c >= 0xe0 && c <= 0xef)
+  {
+    n = 3;
+    c &= 0x0f;
+  }
+  else if (c >= 0xf0 && c <= 0xf4)
+  {
+    n = 4;
+    c &= 0x07;
+  }
+
+  if (n && n <= avail)
+  {
+    for (i = 1; i < n && (p[i] & 0xc0) == 0x80; i++)
+      c = (c << 6) | (p[i] & 0x3f);
+
+    /* no overlong forms, surrogates or code points past U+10FFFF */
+    if (i == n &&
+        !(n == 3 && (c < 0x800 || (c >= 0xd800 && c <= 0xdfff))) &&
+        !(n == 4 && (c < 0x10000 || c > 0x10ffff)))
+    {
+      *cp = c;
+      return n;
+    }
+  }
+
+  /* ASCII, or a stray byte taken as Latin-1 */
+  *cp = p[0];
+
+  return 1;
+}
+
+size_t
+fmtx_rds_charset_encode(const char *utf8, size_t len, char *out, size_t max,
+                        size_t *used)
+{
+  const unsigned char *p = (const unsigned char *)utf8;
+  size_t pos = 0;
+  size_t n = 0;
+
+  while (pos < len)
+  {
+    uint32_t cp = p[pos];
+    size_t k = 1;
+    const char *s;
+    size_t m;
+
+    if (cp >= 0x80)
+      k = decode(p + pos, len - pos, &cp);
+
+    /* most text maps one to one */
+    if (cp < 0x180 && latin_to_ebu[cp])
+    {
+      if (n == max)
+        break;
+
+      if (out)
+        out[n] = latin_to_ebu[cp];
+
+      n++;
+      pos += k;
+      continue;
+    }
+
+    /* combining accents are dropped */
+    if (cp >= 0x300 && cp < 0x370)
+      s = "";
+    else if (!(s = find_translit(cp)))
+      s = "?";
+
+    m = strlen(s);
+
+    if (n + m > max)
+      break;
+
+    if (out)
+      memcpy(out + n, s, m);
+
+    n += m;
+    pos += k;
+  }
+
+  *used = pos;
+
+  return n;
+}
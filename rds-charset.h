@@ -0,0 +1,26 @@
+#ifndef __FMTXD_RDS_CHARSET_H_INCLUDED__
+#define __FMTXD_RDS_CHARSET_H_INCLUDED__
+
+#include <stddef.h>
+
+/* UTF-8 to the EBU Latin character set of IEC 62106 Annex E, the one
+ * receivers display PS and RT in. ASCII mostly maps to itself, most of
+ * Western and Central European Latin, α, π, € and a few symbols have codes
+ * above 0x7f. Everything else is transliterated: "—" to "-", "ł" to "l",
+ * "ế" to "ê", "Ж" to "Zh"; what is left becomes '?'. Control characters
+ * turn into spaces and combining accents are dropped. Bytes that aren't
+ * UTF-8 are taken as Latin-1. */
+
+/* UTF-8 accepted for a field of n characters */
+#define FMTX_RDS_CHARSET_MAX_BYTES(n) ((n) * 4)
+
+/* Encodes len bytes of utf8 into at most max characters of out, which is
+ * not terminated; out may be NULL to only measure. Returns the characters
+ * written and the bytes of utf8 they came from in *used, all of it unless
+ * the text was cut. A transliteration is never split, the output stops
+ * before it. */
+size_t
+fmtx_rds_charset_encode(const char *utf8, size_t len, char *out, size_t max,
+                        size_t *used);
+
+#endif /* __FMTXD_RDS_CHARSET_H_INCLUDED__ */
@@ -0,0 +1,376 @@
+#include <string.h>
+
+#include "rds-charset.h"
+#include "rds-sched.h"
+
+static void
+copy_padded(char *dst, const char *src, size_t len)
+{
+  memset(dst, ' ', FMTX_RDS_PS_LEN);
+  memcpy(dst, src, len < FMTX_RDS_PS_LEN ? len : FMTX_RDS_PS_LEN);
+  dst[FMTX_RDS_PS_LEN] = 0;
+}
+
+void
+fmtx_rds_sched_init(FmtxRdsSched *sched)
+{
+  memset(sched, 0, sizeof(*sched));
+  /* what the N900 always sent */
+  sched->fields.pi = 0x6099;
+  sched->rt_deadline = -1;
+  sched->ps_deadline = -1;
+}
+
+int
+fmtx_rds_sched_set_static_ps(FmtxRdsSched *sched, const char *ps)
+{
+  size_t used;
+  size_t len = fmtx_rds_charset_encode(ps, strlen(ps), sched->ps_static,
+                                       FMTX_RDS_PS_LEN, &used);
+
+  sched->ps_static[len] = 0;
+
+  return 1;
+}
+
+/* From bytes of the UTF-8 rt to characters on air. Only the second tag
+ * is limited to 32, so a longer one goes first. */
+static unsigned int
+encode_tags(const char *rt, size_t rt_len, const FmtxRdsTag *tags,
+            unsigned int n_tags, FmtxRdsTag *out)
+{
+  unsigned int n = 0;
+  unsigned int i;
+  size_t used;
+  FmtxRdsTag t;
+
+  for (i = 0; i < n_tags && n < FMTX_RDS_RTPLUS_MAX_TAGS; i++)
+  {
+    if (tags[i].start + tags[i].len > rt_len)
+      continue;
+
+    t.type = tags[i].type;
+    t.start = fmtx_rds_charset_encode(rt, tags[i].start, NULL,
+                                      FMTX_RDS_RT_LEN, &used);
+    t.len = fmtx_rds_charset_encode(rt + tags[i].start, tags[i].len, NULL,
+                                    FMTX_RDS_RT_LEN, &used);
+
+    if (t.len)
+      out[n++] = t;
+  }
+
+  if (n == 2 && out[1].len > out[0].len)
+  {
+    t = out[0];
+    out[0] = out[1];
+    out[1] = t;
+  }
+
+  if (n == 2 && out[1].len > 32)
+    n = 1;
+
+  return n;
+}
+
+int
+fmtx_rds_sched_set_static_rt(FmtxRdsSched *sched, const char *rt,
+                             const FmtxRdsTag *tags, unsigned int n_tags)
+{
+  char buf[FMTX_RDS_RT_LEN + 1];
+  size_t len = strlen(rt);
+  size_t used;
+  size_t n = fmtx_rds_charset_encode(rt, len, buf, FMTX_RDS_RT_LEN, &used);
+
+  if (used < len)
+    return 0;
+
+  memcpy(sched->rt_static, buf, n);
+  sched->rt_static[n] = 0;
+  sched->n_rt_tags = encode_tags(rt, len, tags, n_tags, sched->rt_tags);
+
+  return 1;
+}
+
+int
+fmtx_rds_sched_set_rotation(FmtxRdsSched *sched, const char *messages,
+                            unsigned int dwell_ms, long long now)
+{
+  char rt[FMTX_RDS_SCHED_MAX_RT][FMTX_RDS_RT_LEN + 1];
+  unsigned int n = 0;
+  const char *p = messages;
+
+  while (*p)
+  {
+    const char *end = strchr(p, '\n');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    size_t used;
+    size_t m;
+
+    /* blank lines, e.g. a trailing newline, are skipped */
+    if (len)
+    {
+      if (n == FMTX_RDS_SCHED_MAX_RT)
+        return 0;
+
+      m = fmtx_rds_charset_encode(p, len, rt[n], FMTX_RDS_RT_LEN, &used);
+
+      if (used < len)
+        return 0;
+
+      rt[n++][m] = 0;
+    }
+
+    p += len + (end != NULL);
+  }
+
+  memcpy(sched->rt, rt, sizeof(rt[0]) * n);
+  sched->n_rt = n;
+  sched->rt_index = 0;
+  sched->rt_dwell_ms = dwell_ms;
+  sched->rt_deadline = n > 1 ? now + dwell_ms * 1000000LL : -1;
+
+  return 1;
+}
+
+int
+fmtx_rds_sched_set_ps_text(FmtxRdsSched *sched, const char *text,
+                           FmtxRdsPsMode mode, unsigned int dwell_ms,
+                           long long now)
+{
+  char buf[FMTX_RDS_SCHED_MAX_PS_TEXT + 1];
+  size_t used;
+  size_t len = fmtx_rds_charset_encode(text, strlen(text), buf,
+                                       FMTX_RDS_SCHED_MAX_PS_TEXT, &used);
+
+  if (text[used])
+    return 0;
+
+  memcpy(sched->ps_text, buf, len);
+  sched->ps_text[len] = 0;
+  sched->ps_len = len;
+  sched->ps_mode = mode;
+  sched->ps_pos = 0;
+  sched->ps_dwell_ms = dwell_ms;
+
+  /* nothing moves when it fits into one PS */
+  if (mode != FMTX_RDS_PS_STATIC && len > FMTX_RDS_PS_LEN)
+    sched->ps_deadline = now + dwell_ms * 1000000LL;
+  else
+    sched->ps_deadline = -1;
+
+  return 1;
+}
+
+long long
+fmtx_rds_sched_deadline(const FmtxRdsSched *sched)
+{
+  if (sched->rt_deadline < 0)
+    return sched->ps_deadline;
+
+  if (sched->ps_deadline < 0 || sched->rt_deadline < sched->ps_deadline)
+    return sched->rt_deadline;
+
+  return sched->ps_deadline;
+}
+
+static int
+ps_active(const FmtxRdsSched *sched)
+{
+  return sched->ps_mode != FMTX_RDS_PS_STATIC && sched->ps_len;
+}
+
+/* Fills out with the PS at pos and returns where the next one starts */
+static size_t
+ps_page(const FmtxRdsSched *sched, size_t pos, char *out)
+{
+  const char *text = sched->ps_text;
+  size_t len = sched->ps_len;
+  size_t n;
+
+  if (sched->ps_mode == FMTX_RDS_PS_SCROLL)
+  {
+    copy_padded(out, text + pos, len - pos);
+
+    return pos + FMTX_RDS_PS_LEN < len ? pos + 1 : 0;
+  }
+
+  while (pos < len && text[pos] == ' ')
+    pos++;
+
+  if (pos >= len)
+    pos = 0;
+
+  n = len - pos < FMTX_RDS_PS_LEN ? len - pos : FMTX_RDS_PS_LEN;
+
+  /* break pages between words where possible */
+  if (pos + n < len && text[pos + n] != ' ')
+  {
+    size_t i = n;
+
+    while (i > 1 && text[pos + i - 1] != ' ')
+      i--;
+
+    if (i > 1)
+      n = i - 1;
+  }
+
+  copy_padded(out, text + pos, n);
+
+  return pos + n < len ? pos + n : 0;
+}
+
+static long long
+advance(long long deadline, unsigned int dwell_ms, long long now)
+{
+  deadline += dwell_ms * 1000000LL;
+
+  /* after a stall, skip ahead rather than catching up in a burst */
+  return deadline > now ? deadline : now + dwell_ms * 1000000LL;
+}
+
+static unsigned int
+run_fields(FmtxRdsSched *sched)
+{
+  const FmtxRdsFields *f = &sched->fields;
+  FmtxRdsFields *out = &sched->fields_out;
+  unsigned int changed = 0;
+
+  if (f->pi != out->pi)
+    changed |= FMTX_RDS_SCHED_PI;
+
+  if (f->pty != out->pty)
+    changed |= FMTX_RDS_SCHED_PTY;
+
+  if (f->tp != out->tp)
+    changed |= FMTX_RDS_SCHED_TP;
+
+  if (f->ta != out->ta)
+    changed |= FMTX_RDS_SCHED_TA;
+
+  if (f->ct != out->ct || f->ct_offset != out->ct_offset)
+    changed |= FMTX_RDS_SCHED_CT;
+
+  /* no clock time is the hardware default */
+  changed |= ~sched->fields_known &
+             (FMTX_RDS_SCHED_PI | FMTX_RDS_SCHED_PTY | FMTX_RDS_SCHED_TP |
+              FMTX_RDS_SCHED_TA | (f->ct ? FMTX_RDS_SCHED_CT : 0));
+
+  *out = *f;
+  sched->fields_known |= changed;
+
+  return changed;
+}
+
+unsigned int
+fmtx_rds_sched_run(FmtxRdsSched *sched, long long now, const char **ps,
+                   const char **rt)
+{
+  long long deadline = fmtx_rds_sched_deadline(sched);
+  unsigned int changed = 0;
+  char buf[FMTX_RDS_PS_LEN + 1];
+  const char *want;
+  unsigned int n_tags;
+  size_t next;
+
+  if (deadline >= 0 && deadline <= now)
+  {
+    sched->jitter_us = (now - deadline) / 1000;
+
+    if (sched->jitter_us > sched->jitter_max_us)
+      sched->jitter_max_us = sched->jitter_us;
+  }
+
+  if (sched->rt_deadline >= 0 && sched->rt_deadline <= now)
+  {
+    sched->rt_index = (sched->rt_index + 1) % sched->n_rt;
+    sched->rt_deadline = advance(sched->rt_deadline, sched->rt_dwell_ms, now);
+  }
+
+  want = sched->n_rt ? sched->rt[sched->rt_index] : sched->rt_static;
+
+  if (!sched->rt_known || strcmp(want, sched->rt_out))
+  {
+    strcpy(sched->rt_out, want);
+    sched->rt_known = 1;
+    changed |= FMTX_RDS_SCHED_RT;
+  }
+
+  /* the tags belong to the static text, no RT+ is the hardware default */
+  n_tags = sched->n_rt ? 0 : sched->n_rt_tags;
+
+  if ((!sched->tags_known && n_tags) ||
+      (sched->tags_known &&
+       (n_tags != sched->n_tags_out ||
+        !fmtx_rds_tags_equal(sched->rt_tags, sched->tags_out, n_tags))))
+  {
+    memcpy(sched->tags_out, sched->rt_tags, n_tags * sizeof(FmtxRdsTag));
+    sched->n_tags_out = n_tags;
+    sched->tags_known = 1;
+    changed |= FMTX_RDS_SCHED_RTPLUS;
+  }
+
+  if (ps_active(sched))
+  {
+    next = ps_page(sched, sched->ps_pos, buf);
+
+    if (sched->ps_deadline >= 0 && sched->ps_deadline <= now)
+    {
+      sched->ps_pos = next;
+      ps_page(sched, sched->ps_pos, buf);
+      sched->ps_deadline = advance(sched->ps_deadline, sched->ps_dwell_ms,
+                                   now);
+    }
+  }
+  else
+    copy_padded(buf, sched->ps_static, strlen(sched->ps_static));
+
+  if (!sched->ps_known || strcmp(buf, sched->ps_out))
+  {
+    strcpy(sched->ps_out, buf);
+    sched->ps_known = 1;
+    changed |= FMTX_RDS_SCHED_PS;
+  }
+
+  *ps = sched->ps_out;
+  *rt = sched->rt_out;
+
+  return changed | run_fields(sched);
+}
+
+void
+fmtx_rds_sched_invalidate(FmtxRdsSched *sched)
+{
+  sched->ps_known = 0;
+  sched->rt_known = 0;
+  sched->tags_known = 0;
+  sched->fields_known = 0;
+}
+
+const char *
+fmtx_rds_ps_mode_name(FmtxRdsPsMode mode)
+{
+  switch (mode)
+  {
+    case FMTX_RDS_PS_PAGED:
+      return "paged";
+    case FMTX_RDS_PS_SCROLL:
+      return "scroll";
+    default:
+      return "static";
+  }
+}
+
+int
+fmtx_rds_ps_mode_from_name(const char *name)
+{
+  if (!strcmp(name, "static"))
+    return FMTX_RDS_PS_STATIC;
+
+  if (!strcmp(name, "paged"))
+    return FMTX_RDS_PS_PAGED;
+
+  if (!strcmp(name, "scroll"))
+    return FMTX_RDS_PS_SCROLL;
+
+  return -1;
+}
@@ -0,0 +1,130 @@
+#ifndef __FMTXD_RDS_SCHED_H_INCLUDED__
+#define __FMTXD_RDS_SCHED_H_INCLUDED__
+
+#include "rds.h"
+
+/* Decides what PS and RT should be on air at a given time: the static
+ * station name and text, a rotation of RT messages and a paged or
+ * scrolling PS. The caller keeps one timer for fmtx_rds_sched_deadline()
+ * and writes whatever fmtx_rds_sched_run() reports as changed. Times are
+ * CLOCK_MONOTONIC nanoseconds. */
+
+#define FMTX_RDS_SCHED_MAX_RT 16
+#define FMTX_RDS_SCHED_MAX_PS_TEXT 64
+
+/* fmtx_rds_sched_run() result bits */
+#define FMTX_RDS_SCHED_PS (1 << 0)
+#define FMTX_RDS_SCHED_RT (1 << 1)
+#define FMTX_RDS_SCHED_PI (1 << 2)
+#define FMTX_RDS_SCHED_PTY (1 << 3)
+#define FMTX_RDS_SCHED_TP (1 << 4)
+#define FMTX_RDS_SCHED_TA (1 << 5)
+#define FMTX_RDS_SCHED_CT (1 << 6)
+#define FMTX_RDS_SCHED_RTPLUS (1 << 7)
+
+typedef enum
+{
+  FMTX_RDS_PS_STATIC,
+  /* word wrapped pages of 8 characters */
+  FMTX_RDS_PS_PAGED,
+  /* one character per step */
+  FMTX_RDS_PS_SCROLL
+} FmtxRdsPsMode;
+
+/* Everything but the text, set directly by the caller */
+typedef struct
+{
+  uint16_t pi;
+  uint8_t pty;
+  uint8_t tp;
+  uint8_t ta;
+  /* the minute on air in CLOCK_REALTIME seconds, 0 sends no clock time */
+  time_t ct;
+  /* local offset from UTC in half hours */
+  int ct_offset;
+} FmtxRdsFields;
+
+typedef struct
+{
+  FmtxRdsFields fields;
+
+  char ps_static[FMTX_RDS_PS_LEN + 1];
+  char rt_static[FMTX_RDS_RT_LEN + 1];
+  /* RT+ of rt_static, in characters */
+  FmtxRdsTag rt_tags[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_rt_tags;
+
+  char rt[FMTX_RDS_SCHED_MAX_RT][FMTX_RDS_RT_LEN + 1];
+  unsigned int n_rt;
+  unsigned int rt_index;
+  unsigned int rt_dwell_ms;
+  long long rt_deadline;
+
+  char ps_text[FMTX_RDS_SCHED_MAX_PS_TEXT + 1];
+  size_t ps_len;
+  FmtxRdsPsMode ps_mode;
+  size_t ps_pos;
+  unsigned int ps_dwell_ms;
+  long long ps_deadline;
+
+  /* what was last handed out, nothing is written twice */
+  char ps_out[FMTX_RDS_PS_LEN + 1];
+  char rt_out[FMTX_RDS_RT_LEN + 1];
+  FmtxRdsFields fields_out;
+  FmtxRdsTag tags_out[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_tags_out;
+  int ps_known;
+  int rt_known;
+  int tags_known;
+  /* FMTX_RDS_SCHED_* of the fields in fields_out */
+  unsigned int fields_known;
+
+  /* lateness of the last and the worst timed step */
+  unsigned int jitter_us;
+  unsigned int jitter_max_us;
+} FmtxRdsSched;
+
+void
+fmtx_rds_sched_init(FmtxRdsSched *sched);
+
+/* The text used when nothing is rotating. A PS is cut to fit, an RT that
+ * doesn't is refused with 0. Tags are byte ranges of rt for RT+, they are
+ * only sent with the static text and dropped where empty. */
+int
+fmtx_rds_sched_set_static_ps(FmtxRdsSched *sched, const char *ps);
+int
+fmtx_rds_sched_set_static_rt(FmtxRdsSched *sched, const char *rt,
+                             const FmtxRdsTag *tags, unsigned int n_tags);
+
+/* Newline separated messages, shown for dwell_ms each in turn. An empty
+ * string stops the rotation. Returns 0 for invalid input. */
+int
+fmtx_rds_sched_set_rotation(FmtxRdsSched *sched, const char *messages,
+                            unsigned int dwell_ms, long long now);
+/* Text longer than a PS, shown page by page or scrolled every dwell_ms.
+ * FMTX_RDS_PS_STATIC or an empty text stops it. */
+int
+fmtx_rds_sched_set_ps_text(FmtxRdsSched *sched, const char *text,
+                           FmtxRdsPsMode mode, unsigned int dwell_ms,
+                           long long now);
+
+/* Next time fmtx_rds_sched_run() has work, or -1 */
+long long
+fmtx_rds_sched_deadline(const FmtxRdsSched *sched);
+/* Advances everything that is due and returns FMTX_RDS_SCHED_* for what
+ * differs from the last run, see fields_out and tags_out for all but the
+ * text. ps is space padded. */
+unsigned int
+fmtx_rds_sched_run(FmtxRdsSched *sched, long long now, const char **ps,
+                   const char **rt);
+/* Forget the last output, e.g. after the hardware was reset */
+void
+fmtx_rds_sched_invalidate(FmtxRdsSched *sched);
+
+const char *
+fmtx_rds_ps_mode_name(FmtxRdsPsMode mode);
+/* Returns -1 for unknown names */
+int
+fmtx_rds_ps_mode_from_name(const char *name);
+
+#endif /* __FMTXD_RDS_SCHED_H_INCLUDED__ */
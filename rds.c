@@ -0,0 +1,492 @@
+#include <string.h>
+
+#include "rds.h"
+
+/* Checkword of the information word m is m * x^10 mod g(x), with
+ * g(x) = x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1. The code is linear, so it
+ * is the sum of the remainders for the high and the low byte. */
+#define RDS_POLY 0x5b9
+
+static const uint16_t crc_hi[256] =
+{
+  0x000, 0x0dc, 0x1b8, 0x164, 0x370, 0x3ac, 0x2c8, 0x214,
+  0x359, 0x385, 0x2e1, 0x23d, 0x029, 0x0f5, 0x191, 0x14d,
+  0x30b, 0x3d7, 0x2b3, 0x26f, 0x07b, 0x0a7, 0x1c3, 0x11f,
+  0x052, 0x08e, 0x1ea, 0x136, 0x322, 0x3fe, 0x29a, 0x246,
+  0x3af, 0x373, 0x217, 0x2cb, 0x0df, 0x003, 0x167, 0x1bb,
+  0x0f6, 0x02a, 0x14e, 0x192, 0x386, 0x35a, 0x23e, 0x2e2,
+  0x0a4, 0x078, 0x11c, 0x1c0, 0x3d4, 0x308, 0x26c, 0x2b0,
+  0x3fd, 0x321, 0x245, 0x299, 0x08d, 0x051, 0x135, 0x1e9,
+  0x2e7, 0x23b, 0x35f, 0x383, 0x197, 0x14b, 0x02f, 0x0f3,
+  0x1be, 0x162, 0x006, 0x0da, 0x2ce, 0x212, 0x376, 0x3aa,
+  0x1ec, 0x130, 0x054, 0x088, 0x29c, 0x240, 0x324, 0x3f8,
+  0x2b5, 0x269, 0x30d, 0x3d1, 0x1c5, 0x119, 0x07d, 0x0a1,
+  0x148, 0x194, 0x0f0, 0x02c, 0x238, 0x2e4, 0x380, 0x35c,
+  0x211, 0x2cd, 0x3a9, 0x375, 0x161, 0x1bd, 0x0d9, 0x005,
+  0x243, 0x29f, 0x3fb, 0x327, 0x133, 0x1ef, 0x08b, 0x057,
+  0x11a, 0x1c6, 0x0a2, 0x07e, 0x26a, 0x2b6, 0x3d2, 0x30e,
+  0x077, 0x0ab, 0x1cf, 0x113, 0x307, 0x3db, 0x2bf, 0x263,
+  0x32e, 0x3f2, 0x296, 0x24a, 0x05e, 0x082, 0x1e6, 0x13a,
+  0x37c, 0x3a0, 0x2c4, 0x218, 0x00c, 0x0d0, 0x1b4, 0x168,
+  0x025, 0x0f9, 0x19d, 0x141, 0x355, 0x389, 0x2ed, 0x231,
+  0x3d8, 0x304, 0x260, 0x2bc, 0x0a8, 0x074, 0x110, 0x1cc,
+  0x081, 0x05d, 0x139, 0x1e5, 0x3f1, 0x32d, 0x249, 0x295,
+  0x0d3, 0x00f, 0x16b, 0x1b7, 0x3a3, 0x37f, 0x21b, 0x2c7,
+  0x38a, 0x356, 0x232, 0x2ee, 0x0fa, 0x026, 0x142, 0x19e,
+  0x290, 0x24c, 0x328, 0x3f4, 0x1e0, 0x13c, 0x058, 0x084,
+  0x1c9, 0x115, 0x071, 0x0ad, 0x2b9, 0x265, 0x301, 0x3dd,
+  0x19b, 0x147, 0x023, 0x0ff, 0x2eb, 0x237, 0x353, 0x38f,
+  0x2c2, 0x21e, 0x37a, 0x3a6, 0x1b2, 0x16e, 0x00a, 0x0d6,
+  0x13f, 0x1e3, 0x087, 0x05b, 0x24f, 0x293, 0x3f7, 0x32b,
+  0x266, 0x2ba, 0x3de, 0x302, 0x116, 0x1ca, 0x0ae, 0x072,
+  0x234, 0x2e8, 0x38c, 0x350, 0x144, 0x198, 0x0fc, 0x020,
+  0x16d, 0x1b1, 0x0d5, 0x009, 0x21d, 0x2c1, 0x3a5, 0x379
+};
+
+static const uint16_t crc_lo[256] =
+{
+  0x000, 0x1b9, 0x372, 0x2cb, 0x35d, 0x2e4, 0x02f, 0x196,
+  0x303, 0x2ba, 0x071, 0x1c8, 0x05e, 0x1e7, 0x32c, 0x295,
+  0x3bf, 0x206, 0x0cd, 0x174, 0x0e2, 0x15b, 0x390, 0x229,
+  0x0bc, 0x105, 0x3ce, 0x277, 0x3e1, 0x258, 0x093, 0x12a,
+  0x2c7, 0x37e, 0x1b5, 0x00c, 0x19a, 0x023, 0x2e8, 0x351,
+  0x1c4, 0x07d, 0x2b6, 0x30f, 0x299, 0x320, 0x1eb, 0x052,
+  0x178, 0x0c1, 0x20a, 0x3b3, 0x225, 0x39c, 0x157, 0x0ee,
+  0x27b, 0x3c2, 0x109, 0x0b0, 0x126, 0x09f, 0x254, 0x3ed,
+  0x037, 0x18e, 0x345, 0x2fc, 0x36a, 0x2d3, 0x018, 0x1a1,
+  0x334, 0x28d, 0x046, 0x1ff, 0x069, 0x1d0, 0x31b, 0x2a2,
+  0x388, 0x231, 0x0fa, 0x143, 0x0d5, 0x16c, 0x3a7, 0x21e,
+  0x08b, 0x132, 0x3f9, 0x240, 0x3d6, 0x26f, 0x0a4, 0x11d,
+  0x2f0, 0x349, 0x182, 0x03b, 0x1ad, 0x014, 0x2df, 0x366,
+  0x1f3, 0x04a, 0x281, 0x338, 0x2ae, 0x317, 0x1dc, 0x065,
+  0x14f, 0x0f6, 0x23d, 0x384, 0x212, 0x3ab, 0x160, 0x0d9,
+  0x24c, 0x3f5, 0x13e, 0x087, 0x111, 0x0a8, 0x263, 0x3da,
+  0x06e, 0x1d7, 0x31c, 0x2a5, 0x333, 0x28a, 0x041, 0x1f8,
+  0x36d, 0x2d4, 0x01f, 0x1a6, 0x030, 0x189, 0x342, 0x2fb,
+  0x3d1, 0x268, 0x0a3, 0x11a, 0x08c, 0x135, 0x3fe, 0x247,
+  0x0d2, 0x16b, 0x3a0, 0x219, 0x38f, 0x236, 0x0fd, 0x144,
+  0x2a9, 0x310, 0x1db, 0x062, 0x1f4, 0x04d, 0x286, 0x33f,
+  0x1aa, 0x013, 0x2d8, 0x361, 0x2f7, 0x34e, 0x185, 0x03c,
+  0x116, 0x0af, 0x264, 0x3dd, 0x24b, 0x3f2, 0x139, 0x080,
+  0x215, 0x3ac, 0x167, 0x0de, 0x148, 0x0f1, 0x23a, 0x383,
+  0x059, 0x1e0, 0x32b, 0x292, 0x304, 0x2bd, 0x076, 0x1cf,
+  0x35a, 0x2e3, 0x028, 0x191, 0x007, 0x1be, 0x375, 0x2cc,
+  0x3e6, 0x25f, 0x094, 0x12d, 0x0bb, 0x102, 0x3c9, 0x270,
+  0x0e5, 0x15c, 0x397, 0x22e, 0x3b8, 0x201, 0x0ca, 0x173,
+  0x29e, 0x327, 0x1ec, 0x055, 0x1c3, 0x07a, 0x2b1, 0x308,
+  0x19d, 0x024, 0x2ef, 0x356, 0x2c0, 0x379, 0x1b2, 0x00b,
+  0x121, 0x098, 0x253, 0x3ea, 0x27c, 0x3c5, 0x10e, 0x0b7,
+  0x222, 0x39b, 0x150, 0x0e9, 0x17f, 0x0c6, 0x20d, 0x3b4
+};
+
+static const uint16_t offset_words[FMTX_RDS_OFFSET_LAST] =
+{
+  0x0fc,
+  0x198,
+  0x168,
+  0x350,
+  0x1b4
+};
+
+/* Block 3 of 0A when there are no alternative frequencies: "no AF" and a
+ * filler code */
+#define RDS_NO_AF 0xe0cd
+
+#define RDS_RT_END 0x0d
+
+uint16_t
+fmtx_rds_checkword(uint16_t info)
+{
+  return crc_hi[info >> 8] ^ crc_lo[info & 0xff];
+}
+
+uint16_t
+fmtx_rds_offset_word(FmtxRdsOffset offset)
+{
+  return offset_words[offset];
+}
+
+uint32_t
+fmtx_rds_block(uint16_t info, FmtxRdsOffset offset)
+{
+  return ((uint32_t)info << 10) |
+         (fmtx_rds_checkword(info) ^ offset_words[offset]);
+}
+
+/* Bitwise on purpose, so it checks the tables rather than reusing them */
+uint16_t
+fmtx_rds_syndrome(uint32_t block)
+{
+  int i;
+
+  block &= 0x3ffffff;
+
+  for (i = 25; i >= 10; i--)
+  {
+    if (block & (1u << i))
+      block ^= (uint32_t)RDS_POLY << (i - 10);
+  }
+
+  return block;
+}
+
+int
+fmtx_rds_text_valid(const char *text, size_t len, size_t max)
+{
+  size_t i;
+
+  if (len > max)
+    return 0;
+
+  for (i = 0; i < len; i++)
+  {
+    unsigned char c = text[i];
+
+    if (c < 0x20 || c == 0x7f || c == 0xff)
+      return 0;
+  }
+
+  return 1;
+}
+
+void
+fmtx_rds_encoder_init(FmtxRdsEncoder *enc, uint16_t pi)
+{
+  memset(enc, 0, sizeof(*enc));
+  enc->pi = pi;
+  /* music, stereo */
+  enc->ms = 1;
+  enc->di = 1;
+  memset(enc->ps, ' ', sizeof(enc->ps));
+  fmtx_rds_set_rt(enc, "", 0);
+  enc->rt_ab = 0;
+}
+
+int
+fmtx_rds_set_ps(FmtxRdsEncoder *enc, const char *ps, size_t len)
+{
+  if (!fmtx_rds_text_valid(ps, len, FMTX_RDS_PS_LEN))
+    return 0;
+
+  memset(enc->ps, ' ', sizeof(enc->ps));
+  memcpy(enc->ps, ps, len);
+
+  return 1;
+}
+
+int
+fmtx_rds_set_rt(FmtxRdsEncoder *enc, const char *rt, size_t len)
+{
+  char buf[FMTX_RDS_RT_LEN];
+
+  if (!fmtx_rds_text_valid(rt, len, FMTX_RDS_RT_LEN))
+    return 0;
+
+  memset(buf, ' ', sizeof(buf));
+  memcpy(buf, rt, len);
+
+  /* a shorter text ends with a carriage return, and only the segments up
+   * to it are sent */
+  if (len < FMTX_RDS_RT_LEN)
+    buf[len++] = RDS_RT_END;
+
+  /* receivers clear their display when the A/B flag changes */
+  if (memcmp(buf, enc->rt, sizeof(buf)))
+  {
+    memcpy(enc->rt, buf, sizeof(buf));
+    enc->rt_ab ^= 1;
+  }
+
+  enc->rt_segments = (len + 3) / 4;
+
+  if (enc->rt_segment >= enc->rt_segments)
+    enc->rt_segment = 0;
+
+  return 1;
+}
+
+int
+fmtx_rds_set_ptyn(FmtxRdsEncoder *enc, const char *ptyn, size_t len)
+{
+  char buf[FMTX_RDS_PTYN_LEN];
+
+  if (!fmtx_rds_text_valid(ptyn, len, FMTX_RDS_PTYN_LEN))
+    return 0;
+
+  enc->has_ptyn = len > 0;
+  memset(buf, ' ', sizeof(buf));
+  memcpy(buf, ptyn, len);
+
+  if (memcmp(buf, enc->ptyn, sizeof(buf)))
+  {
+    memcpy(enc->ptyn, buf, sizeof(buf));
+    enc->ptyn_ab ^= 1;
+  }
+
+  return 1;
+}
+
+int
+fmtx_rds_tags_equal(const FmtxRdsTag *a, const FmtxRdsTag *b,
+                    unsigned int n)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+  {
+    if (a[i].type != b[i].type || a[i].start != b[i].start ||
+        a[i].len != b[i].len)
+      return 0;
+  }
+
+  return 1;
+}
+
+int
+fmtx_rds_set_rtplus(FmtxRdsEncoder *enc, const FmtxRdsTag *tags,
+                    unsigned int n)
+{
+  unsigned int i;
+
+  if (n > FMTX_RDS_RTPLUS_MAX_TAGS)
+    return 0;
+
+  /* types, starts and lengths minus one are 6 bits, the second length 5 */
+  for (i = 0; i < n; i++)
+  {
+    if (tags[i].type > 63 || !tags[i].len ||
+        tags[i].start + tags[i].len > FMTX_RDS_RT_LEN ||
+        (i && tags[i].len > 32))
+      return 0;
+  }
+
+  if (n != enc->n_rtplus || !fmtx_rds_tags_equal(tags, enc->rtplus, n))
+  {
+    memset(enc->rtplus, 0, sizeof(enc->rtplus));
+    memcpy(enc->rtplus, tags, n * sizeof(*tags));
+    enc->n_rtplus = n;
+
+    if (n)
+      enc->rtplus_toggle ^= 1;
+  }
+
+  enc->has_rtplus = 1;
+
+  return 1;
+}
+
+static uint16_t
+block_b(const FmtxRdsEncoder *enc, FmtxRdsGroupType type)
+{
+  return (type << 11) | (enc->tp << 10) | ((enc->pty & 0x1f) << 5);
+}
+
+static uint16_t
+chars(const char *s)
+{
+  return ((unsigned char)s[0] << 8) | (unsigned char)s[1];
+}
+
+static void
+group_set(FmtxRdsGroup *group, uint16_t a, uint16_t b, uint16_t c,
+          uint16_t d)
+{
+  group->block[0] = fmtx_rds_block(a, FMTX_RDS_OFFSET_A);
+  group->block[1] = fmtx_rds_block(b, FMTX_RDS_OFFSET_B);
+  group->block[2] = fmtx_rds_block(c, FMTX_RDS_OFFSET_C);
+  group->block[3] = fmtx_rds_block(d, FMTX_RDS_OFFSET_D);
+}
+
+void
+fmtx_rds_encode_0a(FmtxRdsEncoder *enc, unsigned int segment,
+                   FmtxRdsGroup *group)
+{
+  uint16_t b = block_b(enc, FMTX_RDS_GROUP_0A);
+
+  segment &= 3;
+  /* DI is sent most significant bit first, one bit per segment */
+  b |= (enc->ta << 4) | (enc->ms << 3) |
+       (((enc->di >> (3 - segment)) & 1) << 2) | segment;
+
+  group_set(group, enc->pi, b, RDS_NO_AF, chars(enc->ps + segment * 2));
+}
+
+void
+fmtx_rds_encode_2a(FmtxRdsEncoder *enc, unsigned int segment,
+                   FmtxRdsGroup *group)
+{
+  const char *rt = enc->rt + (segment & 15) * 4;
+
+  group_set(group, enc->pi,
+            block_b(enc, FMTX_RDS_GROUP_2A) | (enc->rt_ab << 4) |
+            (segment & 15),
+            chars(rt), chars(rt + 2));
+}
+
+/* Names the group the application uses and its AID; the message, template 0
+ * without server control bits, stays 0 */
+void
+fmtx_rds_encode_3a(FmtxRdsEncoder *enc, FmtxRdsGroup *group)
+{
+  group_set(group, enc->pi,
+            block_b(enc, FMTX_RDS_GROUP_3A) | FMTX_RDS_GROUP_11A, 0,
+            FMTX_RDS_RTPLUS_AID);
+}
+
+void
+fmtx_rds_encode_4a(FmtxRdsEncoder *enc, time_t utc, int offset,
+                   FmtxRdsGroup *group)
+{
+  /* Modified Julian Day, 1970-01-01 is 40587 */
+  uint32_t mjd = utc / 86400 + 40587;
+  unsigned int hour = (utc / 3600) % 24;
+  unsigned int minute = (utc / 60) % 60;
+  unsigned int sign = offset < 0;
+
+  if (sign)
+    offset = -offset;
+
+  group_set(group, enc->pi,
+            block_b(enc, FMTX_RDS_GROUP_4A) | ((mjd >> 15) & 3),
+            ((mjd & 0x7fff) << 1) | (hour >> 4),
+            ((hour & 0xf) << 12) | (minute << 6) | (sign << 5) |
+            (offset & 0x1f));
+}
+
+void
+fmtx_rds_encode_10a(FmtxRdsEncoder *enc, unsigned int segment,
+                    FmtxRdsGroup *group)
+{
+  const char *ptyn = enc->ptyn + (segment & 1) * 4;
+
+  group_set(group, enc->pi,
+            block_b(enc, FMTX_RDS_GROUP_10A) | (enc->ptyn_ab << 4) |
+            (segment & 1),
+            chars(ptyn), chars(ptyn + 2));
+}
+
+/* Two tags of 6 bit type, start and length minus one, the second length
+ * has 5 bits. Unused tags are all zero. */
+void
+fmtx_rds_encode_11a(FmtxRdsEncoder *enc, FmtxRdsGroup *group)
+{
+  const FmtxRdsTag *t = enc->rtplus;
+  unsigned int len0 = t[0].len ? t[0].len - 1 : 0;
+  unsigned int len1 = t[1].len ? t[1].len - 1 : 0;
+
+  group_set(group, enc->pi,
+            block_b(enc, FMTX_RDS_GROUP_11A) | (enc->rtplus_toggle << 4) |
+            ((enc->n_rtplus > 0) << 3) | (t[0].type >> 3),
+            ((t[0].type & 7) << 13) | (t[0].start << 7) | (len0 << 1) |
+            (t[1].type >> 5),
+            ((t[1].type & 0x1f) << 11) | (t[1].start << 5) | len1);
+}
+
+/* 0A and 2A alternate, every eighth slot is 10A when there is a PTYN. With
+ * RT+ every sixteenth is 11A, and every fourth of those 3A instead. */
+FmtxRdsGroupType
+fmtx_rds_next_group(FmtxRdsEncoder *enc, FmtxRdsGroup *group)
+{
+  unsigned int slot = enc->sequence++;
+
+  if (enc->has_rtplus && (slot & 15) == 5)
+  {
+    if ((slot & 63) == 5)
+    {
+      fmtx_rds_encode_3a(enc, group);
+
+      return FMTX_RDS_GROUP_3A;
+    }
+
+    fmtx_rds_encode_11a(enc, group);
+
+    return FMTX_RDS_GROUP_11A;
+  }
+
+  if (enc->has_ptyn && (slot & 7) == 7)
+  {
+    fmtx_rds_encode_10a(enc, enc->ptyn_segment, group);
+    enc->ptyn_segment ^= 1;
+
+    return FMTX_RDS_GROUP_10A;
+  }
+
+  if (slot & 1)
+  {
+    fmtx_rds_encode_2a(enc, enc->rt_segment, group);
+
+    if (++enc->rt_segment >= enc->rt_segments)
+      enc->rt_segment = 0;
+
+    return FMTX_RDS_GROUP_2A;
+  }
+
+  fmtx_rds_encode_0a(enc, enc->ps_segment, group);
+  enc->ps_segment = (enc->ps_segment + 1) & 3;
+
+  return FMTX_RDS_GROUP_0A;
+}
+
+void
+fmtx_rds_pack(const FmtxRdsGroup *group, uint8_t out[FMTX_RDS_GROUP_BYTES])
+{
+  uint64_t acc = 0;
+  int bits = 0;
+  int n = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+  {
+    acc = (acc << 26) | (group->block[i] & 0x3ffffff);
+    bits += 26;
+
+    while (bits >= 8)
+    {
+      bits -= 8;
+      out[n++] = acc >> bits;
+    }
+  }
+}
+
+int
+fmtx_rds_check_group(const FmtxRdsGroup *group)
+{
+  static const FmtxRdsOffset expected[4] =
+  {
+    FMTX_RDS_OFFSET_A,
+    FMTX_RDS_OFFSET_B,
+    FMTX_RDS_OFFSET_C,
+    FMTX_RDS_OFFSET_D
+  };
+  int i;
+
+  for (i = 0; i < 4; i++)
+  {
+    if (fmtx_rds_syndrome(group->block[i]) != offset_words[expected[i]])
+      return i;
+  }
+
+  return -1;
+}
+
+const char *
+fmtx_rds_group_name(FmtxRdsGroupType type)
+{
+  switch (type)
+  {
+    case FMTX_RDS_GROUP_0A:
+      return "0A";
+    case FMTX_RDS_GROUP_2A:
+      return "2A";
+    case FMTX_RDS_GROUP_3A:
+      return "3A";
+    case FMTX_RDS_GROUP_4A:
+      return "4A";
+    case FMTX_RDS_GROUP_10A:
+      return "10A";
+    case FMTX_RDS_GROUP_11A:
+      return "11A";
+  }
+
+  return "?";
+}
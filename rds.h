@@ -0,0 +1,168 @@
+#ifndef __FMTXD_RDS_H_INCLUDED__
+#define __FMTXD_RDS_H_INCLUDED__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* RDS baseband group encoder (IEC 62106). Builds the four 26 bit blocks of
+ * a group, information word and checkword plus offset, exactly as they go
+ * on air. Used by the simulated backend and for offline validation; the
+ * real si4713 does its own encoding from the sysfs attributes. */
+
+#define FMTX_RDS_PS_LEN 8
+#define FMTX_RDS_RT_LEN 64
+#define FMTX_RDS_PTYN_LEN 8
+
+/* RadioText Plus, an open data application in 11A groups announced by 3A */
+#define FMTX_RDS_RTPLUS_AID 0x4bd7
+#define FMTX_RDS_RTPLUS_MAX_TAGS 2
+
+/* 4 blocks of 26 bits */
+#define FMTX_RDS_GROUP_BITS 104
+#define FMTX_RDS_GROUP_BYTES 13
+
+/* Group types, the value is the type code and version: (type << 1) | B */
+typedef enum
+{
+  FMTX_RDS_GROUP_0A = 0 << 1,
+  FMTX_RDS_GROUP_2A = 2 << 1,
+  FMTX_RDS_GROUP_3A = 3 << 1,
+  FMTX_RDS_GROUP_4A = 4 << 1,
+  FMTX_RDS_GROUP_10A = 10 << 1,
+  FMTX_RDS_GROUP_11A = 11 << 1
+} FmtxRdsGroupType;
+
+/* RT+ content types, the ones fmtxd tags */
+typedef enum
+{
+  FMTX_RDS_RTPLUS_DUMMY = 0,
+  FMTX_RDS_RTPLUS_TITLE = 1,
+  FMTX_RDS_RTPLUS_ALBUM = 2,
+  FMTX_RDS_RTPLUS_ARTIST = 4
+} FmtxRdsRtPlusType;
+
+/* A stretch of the radio text. Counted in characters of the RT once it
+ * reaches the encoder. */
+typedef struct
+{
+  uint8_t type;
+  uint16_t start;
+  uint16_t len;
+} FmtxRdsTag;
+
+typedef enum
+{
+  FMTX_RDS_OFFSET_A,
+  FMTX_RDS_OFFSET_B,
+  FMTX_RDS_OFFSET_C,
+  FMTX_RDS_OFFSET_CP,
+  FMTX_RDS_OFFSET_D,
+  FMTX_RDS_OFFSET_LAST
+} FmtxRdsOffset;
+
+typedef struct
+{
+  /* information word << 10 | checkword, bit 25 is sent first */
+  uint32_t block[4];
+} FmtxRdsGroup;
+
+typedef struct
+{
+  uint16_t pi;
+  uint8_t pty;
+  uint8_t tp;
+  uint8_t ta;
+  uint8_t ms;
+  /* decoder identification, one bit per 0A segment */
+  uint8_t di;
+  char ps[FMTX_RDS_PS_LEN];
+  char rt[FMTX_RDS_RT_LEN];
+  char ptyn[FMTX_RDS_PTYN_LEN];
+  int has_ptyn;
+  /* flip whenever the radio text or PTYN changes */
+  uint8_t rt_ab;
+  uint8_t ptyn_ab;
+  /* 2A segments that carry text, the last one holds the 0x0d terminator */
+  uint8_t rt_segments;
+  /* where fmtx_rds_next_group() continues */
+  uint8_t ps_segment;
+  uint8_t rt_segment;
+  uint8_t ptyn_segment;
+  /* RT+ is announced once tags were set, running while there are some */
+  int has_rtplus;
+  FmtxRdsTag rtplus[FMTX_RDS_RTPLUS_MAX_TAGS];
+  unsigned int n_rtplus;
+  /* flips with every new set of tags, a new item to receivers */
+  uint8_t rtplus_toggle;
+  unsigned int sequence;
+} FmtxRdsEncoder;
+
+void
+fmtx_rds_encoder_init(FmtxRdsEncoder *enc, uint16_t pi);
+
+/* These return 0 for text that can't be sent: control characters, or
+ * longer than the field. PS is space padded. */
+int
+fmtx_rds_set_ps(FmtxRdsEncoder *enc, const char *ps, size_t len);
+int
+fmtx_rds_set_rt(FmtxRdsEncoder *enc, const char *rt, size_t len);
+int
+fmtx_rds_set_ptyn(FmtxRdsEncoder *enc, const char *ptyn, size_t len);
+int
+fmtx_rds_text_valid(const char *text, size_t len, size_t max);
+int
+fmtx_rds_tags_equal(const FmtxRdsTag *a, const FmtxRdsTag *b,
+                    unsigned int n);
+/* Returns 0 for tags past the RT or a second tag longer than 32. No tags
+ * mark the item as stopped. */
+int
+fmtx_rds_set_rtplus(FmtxRdsEncoder *enc, const FmtxRdsTag *tags,
+                    unsigned int n);
+
+uint16_t
+fmtx_rds_checkword(uint16_t info);
+uint32_t
+fmtx_rds_block(uint16_t info, FmtxRdsOffset offset);
+/* Syndrome of a received block, equals the offset word when it is intact */
+uint16_t
+fmtx_rds_syndrome(uint32_t block);
+uint16_t
+fmtx_rds_offset_word(FmtxRdsOffset offset);
+
+void
+fmtx_rds_encode_0a(FmtxRdsEncoder *enc, unsigned int segment,
+                   FmtxRdsGroup *group);
+void
+fmtx_rds_encode_2a(FmtxRdsEncoder *enc, unsigned int segment,
+                   FmtxRdsGroup *group);
+/* The RT+ announcement */
+void
+fmtx_rds_encode_3a(FmtxRdsEncoder *enc, FmtxRdsGroup *group);
+/* Clock time for utc, offset in half hours from UTC */
+void
+fmtx_rds_encode_4a(FmtxRdsEncoder *enc, time_t utc, int offset,
+                   FmtxRdsGroup *group);
+void
+fmtx_rds_encode_10a(FmtxRdsEncoder *enc, unsigned int segment,
+                    FmtxRdsGroup *group);
+/* The RT+ tags */
+void
+fmtx_rds_encode_11a(FmtxRdsEncoder *enc, FmtxRdsGroup *group);
+
+/* Round robin of 0A and 2A, plus 10A when a PTYN is set and 3A and 11A
+ * once there was RT+. Returns the type of the group written. */
+FmtxRdsGroupType
+fmtx_rds_next_group(FmtxRdsEncoder *enc, FmtxRdsGroup *group);
+
+/* The 104 bits of a group, first bit on air in the MSB of out[0] */
+void
+fmtx_rds_pack(const FmtxRdsGroup *group, uint8_t out[FMTX_RDS_GROUP_BYTES]);
+/* Returns the first block that fails its syndrome, or -1 */
+int
+fmtx_rds_check_group(const FmtxRdsGroup *group);
+
+const char *
+fmtx_rds_group_name(FmtxRdsGroupType type);
+
+#endif /* __FMTXD_RDS_H_INCLUDED__ */
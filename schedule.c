@@ -0,0 +1,399 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "schedule.h"
+
+#define DAY_MINUTES 1440
+#define WEEK_MINUTES (7 * DAY_MINUTES)
+#define ALL_DAYS 0x7f
+
+static const char day_names[7][4] =
+{
+  "sun", "mon", "tue", "wed", "thu", "fri", "sat"
+};
+
+static int
+parse_day(const char *p, const char **end)
+{
+  int i;
+
+  for (i = 0; i < 7; i++)
+  {
+    if (!strncmp(p, day_names[i], 3))
+    {
+      *end = p + 3;
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* "daily" or "mon", "fri-mon" and lists of those */
+static int
+parse_days(const char *p, const char *end)
+{
+  const char *e;
+  int days = 0;
+  int first;
+  int last;
+
+  if (end - p == 5 && !strncmp(p, "daily", 5))
+    return ALL_DAYS;
+
+  while (p < end)
+  {
+    if ((first = parse_day(p, &e)) < 0)
+      return 0;
+
+    last = first;
+    p = e;
+
+    if (p < end && *p == '-' && (last = parse_day(p + 1, &e)) >= 0)
+      p = e;
+    else if (p < end && *p == '-')
+      return 0;
+
+    while (1)
+    {
+      days |= 1 << first;
+
+      if (first == last)
+        break;
+
+      first = (first + 1) % 7;
+    }
+
+    if (p < end && (*p != ',' || ++p == end))
+      return 0;
+  }
+
+  return days;
+}
+
+/* HH:MM, 24:00 only as an end */
+static int
+parse_time(const char *p, const char **end)
+{
+  int h;
+  int m;
+
+  if (p[0] < '0' || p[0] > '2' || p[1] < '0' || p[1] > '9' || p[2] != ':' ||
+      p[3] < '0' || p[3] > '5' || p[4] < '0' || p[4] > '9')
+    return -1;
+
+  h = (p[0] - '0') * 10 + p[1] - '0';
+  m = (p[3] - '0') * 10 + p[4] - '0';
+
+  if (h > 24 || (h == 24 && m))
+    return -1;
+
+  *end = p + 5;
+
+  return h * 60 + m;
+}
+
+static const char *
+skip_space(const char *p)
+{
+  while (*p == ' ' || *p == '\t')
+    p++;
+
+  return p;
+}
+
+static const char *
+token_end(const char *p)
+{
+  while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '#')
+    p++;
+
+  return p;
+}
+
+static int
+parse_slot(FmtxScheduleSlot *slot, const char *p, const char **next)
+{
+  const char *end = token_end(p);
+  const char *e;
+  int start;
+  int stop;
+
+  memset(slot, 0, sizeof(*slot));
+
+  if (!(slot->days = parse_days(p, end)))
+    return 0;
+
+  p = skip_space(end);
+
+  if ((start = parse_time(p, &e)) < 0 || start == DAY_MINUTES ||
+      *e != '-' || (stop = parse_time(e + 1, &e)) < 0 || stop == start)
+    return 0;
+
+  slot->start = start;
+  slot->end = stop ? stop : DAY_MINUTES;
+
+  p = skip_space(e);
+  end = token_end(p);
+
+  if (end > p)
+  {
+    if (end - p > FMTX_PRESET_NAME_LEN)
+      return 0;
+
+    memcpy(slot->preset, p, end - p);
+
+    if (!fmtx_preset_name_valid(slot->preset))
+      return 0;
+
+    p = skip_space(end);
+  }
+
+  if (*p && *p != '\n' && *p != '#')
+    return 0;
+
+  *next = p;
+
+  return 1;
+}
+
+int
+fmtx_schedule_parse(FmtxSchedule *schedule, const char *text,
+                    unsigned int *line)
+{
+  FmtxSchedule s;
+  const char *p = text;
+
+  s.n = 0;
+  *line = 0;
+
+  while (*p)
+  {
+    ++*line;
+    p = skip_space(p);
+
+    if (*p && *p != '\n' && *p != '#')
+    {
+      if (s.n == FMTX_SCHEDULE_MAX_SLOTS || !parse_slot(&s.slot[s.n], p, &p))
+        return 0;
+
+      s.slot[s.n++].line = *line;
+    }
+
+    while (*p && *p != '\n')
+      p++;
+
+    if (*p)
+      p++;
+  }
+
+  *line = 0;
+  *schedule = s;
+
+  return 1;
+}
+
+int
+fmtx_schedule_load(FmtxSchedule *schedule, const char *path,
+                   unsigned int *line)
+{
+  char buf[FMTX_SCHEDULE_MAX_FILE + 1];
+  size_t len = 0;
+  ssize_t n;
+  int fd;
+
+  *line = 0;
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+  {
+    if (errno != ENOENT)
+      return -1;
+
+    schedule->n = 0;
+    return 1;
+  }
+
+  do
+  {
+    n = read(fd, buf + len, sizeof(buf) - len);
+
+    if (n > 0)
+      len += n;
+  }
+  while ((n > 0 && len < sizeof(buf)) || (n < 0 && errno == EINTR));
+
+  close(fd);
+
+  if (n < 0)
+    return -1;
+
+  if (len == sizeof(buf))
+  {
+    errno = EFBIG;
+    return -1;
+  }
+
+  buf[len] = 0;
+
+  return fmtx_schedule_parse(schedule, buf, line);
+}
+
+/* Runs of three days or more as ranges, which may wrap past Saturday */
+static unsigned int
+format_days(uint8_t days, char *buf, unsigned int len)
+{
+  unsigned int off = 0;
+  int origin = 0;
+  int first;
+  int last;
+
+  if (days == ALL_DAYS)
+    return snprintf(buf, len, "daily");
+
+  buf[0] = 0;
+
+  /* start after a day off so no run is split */
+  while (days & (1 << origin))
+    origin++;
+
+  for (first = origin + 1; first <= origin + 7 && off < len; first = last + 1)
+  {
+    last = first;
+
+    if (!(days & (1 << (first % 7))))
+      continue;
+
+    while (days & (1 << ((last + 1) % 7)))
+      last++;
+
+    off += snprintf(buf + off, len - off, "%s%s%s%s", off ? "," : "",
+                    day_names[first % 7],
+                    last == first ? "" : last - first == 1 ? "," : "-",
+                    last == first ? "" : day_names[last % 7]);
+  }
+
+  return off;
+}
+
+void
+fmtx_schedule_format_slot(const FmtxScheduleSlot *slot, char *buf,
+                          unsigned int len)
+{
+  unsigned int off = format_days(slot->days, buf, len);
+
+  if (off >= len)
+    return;
+
+  snprintf(buf + off, len - off, " %02u:%02u-%02u:%02u%s%s",
+           slot->start / 60, slot->start % 60, slot->end / 60,
+           slot->end % 60, slot->preset[0] ? " " : "", slot->preset);
+}
+
+void
+fmtx_schedule_format(const FmtxSchedule *schedule, char *buf,
+                     unsigned int len)
+{
+  unsigned int off = 0;
+  unsigned int i;
+
+  buf[0] = 0;
+
+  for (i = 0; i < schedule->n && off + 1 < len; i++)
+  {
+    if (i)
+      buf[off++] = '\n';
+
+    fmtx_schedule_format_slot(&schedule->slot[i], buf + off, len - off);
+    off += strlen(buf + off);
+  }
+}
+
+int
+fmtx_schedule_active(const FmtxSchedule *schedule, const struct tm *tm)
+{
+  unsigned int m = tm->tm_hour * 60 + tm->tm_min;
+  unsigned int today = 1 << tm->tm_wday;
+  unsigned int yesterday = 1 << ((tm->tm_wday + 6) % 7);
+  const FmtxScheduleSlot *slot;
+  unsigned int i;
+
+  for (i = 0; i < schedule->n; i++)
+  {
+    slot = &schedule->slot[i];
+
+    if (slot->start < slot->end)
+    {
+      if ((slot->days & today) && m >= slot->start && m < slot->end)
+        return i;
+    }
+    else if (((slot->days & today) && m >= slot->start) ||
+             ((slot->days & yesterday) && m < slot->end))
+      return i;
+  }
+
+  return -1;
+}
+
+/* Edges are found in minutes of the local week and only the winner goes
+ * through mktime(), which also sorts out DST */
+time_t
+fmtx_schedule_next(const FmtxSchedule *schedule, time_t now)
+{
+  unsigned int best = WEEK_MINUTES;
+  unsigned int pos;
+  unsigned int i;
+  unsigned int d;
+  unsigned int e;
+  struct tm tm;
+  time_t t;
+
+  if (!schedule->n)
+    return 0;
+
+  localtime_r(&now, &tm);
+  pos = tm.tm_wday * DAY_MINUTES + tm.tm_hour * 60 + tm.tm_min;
+
+  for (i = 0; i < schedule->n; i++)
+  {
+    const FmtxScheduleSlot *slot = &schedule->slot[i];
+
+    for (d = 0; d < 7; d++)
+    {
+      if (!(slot->days & (1 << d)))
+        continue;
+
+      e = (d * DAY_MINUTES + slot->start + WEEK_MINUTES - pos) % WEEK_MINUTES;
+
+      if (e && e < best)
+        best = e;
+
+      /* an end past midnight belongs to the next day */
+      e = ((d + (slot->end <= slot->start)) * DAY_MINUTES + slot->end +
+           WEEK_MINUTES - pos) % WEEK_MINUTES;
+
+      if (e && e < best)
+        best = e;
+    }
+  }
+
+  tm.tm_sec = 0;
+  tm.tm_min += best;
+  tm.tm_isdst = -1;
+  t = mktime(&tm);
+
+  /* the hour repeated when DST ends, take its second pass */
+  if (t <= now)
+  {
+    localtime_r(&now, &tm);
+    tm.tm_sec = 0;
+    tm.tm_min += best;
+    tm.tm_isdst = 0;
+    t = mktime(&tm);
+  }
+
+  return t > now ? t : now + 60 - now % 60;
+}
@@ -0,0 +1,74 @@
+#ifndef __FMTXD_SCHEDULE_H_INCLUDED__
+#define __FMTXD_SCHEDULE_H_INCLUDED__
+
+#include <stdint.h>
+#include <time.h>
+
+#include "preset.h"
+
+/* Weekly on-air slots, one per line of the schedule file:
+ *
+ *   # days   start-end    preset
+ *   mon-fri  07:00-09:30  morning
+ *   sat,sun  22:00-02:00  late
+ *   daily    12:00-13:00
+ *
+ * Days are "daily" or names and ranges separated by commas, times are local
+ * and a slot that ends before it starts runs past midnight. The preset is
+ * applied when the slot starts, without one the current settings are
+ * kept. The transmitter goes off air when a slot ends and no other one
+ * takes over. Where slots overlap the first one in the file counts. */
+
+#define FMTX_SCHEDULE_PATH "/etc/fmtxd/schedule"
+#define FMTX_SCHEDULE_MAX_SLOTS 64
+#define FMTX_SCHEDULE_MAX_FILE 8192
+/* one formatted slot, "sun,mon,tue,wed,thu,fri 00:00-24:00 name" */
+#define FMTX_SCHEDULE_SLOT_TEXT (40 + FMTX_PRESET_NAME_LEN)
+#define FMTX_SCHEDULE_MAX_TEXT \
+  (FMTX_SCHEDULE_MAX_SLOTS * FMTX_SCHEDULE_SLOT_TEXT)
+
+typedef struct
+{
+  /* bit 0 is Sunday, like tm_wday */
+  uint8_t days;
+  /* minutes into the day, end is 1 to 1440 */
+  uint16_t start;
+  uint16_t end;
+  /* "" keeps the current settings */
+  char preset[FMTX_PRESET_NAME_LEN + 1];
+  /* in the file, for errors */
+  unsigned int line;
+} FmtxScheduleSlot;
+
+typedef struct
+{
+  unsigned int n;
+  FmtxScheduleSlot slot[FMTX_SCHEDULE_MAX_SLOTS];
+} FmtxSchedule;
+
+/* Returns 0 and the offending line if text is invalid, leaving schedule
+ * alone */
+int
+fmtx_schedule_parse(FmtxSchedule *schedule, const char *text,
+                    unsigned int *line);
+/* A missing file is an empty schedule. Returns < 0 and sets errno if the
+ * file can't be read, else like fmtx_schedule_parse(). */
+int
+fmtx_schedule_load(FmtxSchedule *schedule, const char *path,
+                   unsigned int *line);
+/* Newline separated, in the file's syntax */
+void
+fmtx_schedule_format(const FmtxSchedule *schedule, char *buf,
+                     unsigned int len);
+void
+fmtx_schedule_format_slot(const FmtxScheduleSlot *slot, char *buf,
+                          unsigned int len);
+
+/* The slot in effect at local time tm, -1 for none */
+int
+fmtx_schedule_active(const FmtxSchedule *schedule, const struct tm *tm);
+/* The first start or end of a slot after now, 0 for an empty schedule */
+time_t
+fmtx_schedule_next(const FmtxSchedule *schedule, time_t now);
+
+#endif /* __FMTXD_SCHEDULE_H_INCLUDED__ */
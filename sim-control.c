@@ -0,0 +1,147 @@
+#include <dbus/dbus.h>
+#include <string.h>
+
+#include "fmtx-object.h"
+#include "sim-control.h"
+
+#define SIM_CONTROL_PATH "/com/nokia/fmtx/sim"
+#define SIM_CONTROL_IF "com.nokia.FMTx.Sim"
+
+static void
+append_counter(DBusMessageIter *dict, const char *key, dbus_uint32_t val)
+{
+  DBusMessageIter entry;
+
+  dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &val);
+  dbus_message_iter_close_container(dict, &entry);
+}
+
+static DBusMessage *
+sim_get_counters(DBusMessage *msg, FmtxObject *obj)
+{
+  static const char *const op_names[FMTX_HW_OP_LAST] =
+  {
+    "write_attr",
+    "ioctl",
+    "mixer",
+    "cal"
+  };
+  DBusMessage *reply = dbus_message_new_method_return(msg);
+  DBusMessageIter iter;
+  DBusMessageIter dict;
+  char key[64];
+  int i;
+
+  dbus_message_iter_init_append(reply, &iter);
+  dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{su}", &dict);
+
+  for (i = 0; i < FMTX_HW_OP_LAST; i++)
+    append_counter(&dict, op_names[i], obj->engine->hw->op_count[i]);
+
+  for (i = 0; i < FMTX_HW_ATTR_LAST; i++)
+  {
+    g_snprintf(key, sizeof(key), "attr:%s", fmtx_hw_attr_name(i));
+    append_counter(&dict, key, obj->engine->hw->attr_writes[i]);
+  }
+
+  dbus_message_iter_close_container(&iter, &dict);
+
+  return reply;
+}
+
+static DBusHandlerResult
+sim_control_message(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+  FmtxObject *obj = user_data;
+  DBusMessage *reply = NULL;
+  DBusError error;
+  dbus_bool_t b;
+  dbus_uint32_t u;
+  dbus_int32_t i;
+
+  dbus_error_init(&error);
+
+  /* the counters and the simulated mixer belong to the worker thread */
+  fmtx_engine_flush(obj->engine);
+
+  if (dbus_message_is_method_call(msg, SIM_CONTROL_IF, "GetCounters"))
+    reply = sim_get_counters(msg, obj);
+  else if (dbus_message_is_method_call(msg, SIM_CONTROL_IF, "ResetCounters"))
+  {
+    fmtx_hw_reset_counters(obj->engine->hw);
+    reply = dbus_message_new_method_return(msg);
+  }
+  else if (dbus_message_is_method_call(msg, SIM_CONTROL_IF, "SetSinkState"))
+  {
+    if (dbus_message_get_args(msg, &error, DBUS_TYPE_BOOLEAN, &b,
+                              DBUS_TYPE_INVALID))
+    {
+      fmtx_engine_set_sink_running(obj->engine, b);
+      reply = dbus_message_new_method_return(msg);
+    }
+  }
+  else if (dbus_message_is_method_call(msg, SIM_CONTROL_IF,
+                                       "SetMixerFunction"))
+  {
+    if (dbus_message_get_args(msg, &error, DBUS_TYPE_UINT32, &u,
+                              DBUS_TYPE_INVALID))
+    {
+      fmtx_hw_sim_set_mixer_function(obj->engine->hw, u);
+      fmtx_engine_check_mixer(obj->engine);
+      fmtx_engine_flush(obj->engine);
+      reply = dbus_message_new_method_return(msg);
+    }
+  }
+  else if (dbus_message_is_method_call(msg, SIM_CONTROL_IF, "SetNoise"))
+  {
+    if (dbus_message_get_args(msg, &error, DBUS_TYPE_UINT32, &u,
+                              DBUS_TYPE_INT32, &i, DBUS_TYPE_INVALID))
+    {
+      fmtx_hw_sim_set_noise(obj->engine->hw, u, i);
+      reply = dbus_message_new_method_return(msg);
+    }
+  }
+  else
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  if (dbus_error_is_set(&error))
+  {
+    reply = dbus_message_new_error(msg, error.name, error.message);
+    dbus_error_free(&error);
+  }
+
+  if (reply)
+  {
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+  }
+
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static const DBusObjectPathVTable sim_control_vtable =
+{
+  NULL,
+  sim_control_message
+};
+
+/* SIM_CONTROL_PATH for the first transmitter, SIM_CONTROL_PATH/radioN for
+ * the others */
+void
+sim_control_register(DBusConnection *dbus, FmtxObject *obj)
+{
+  gchar *path;
+
+  if (fmtx_object_is_primary(obj))
+    path = g_strdup(SIM_CONTROL_PATH);
+  else
+    path = g_strconcat(SIM_CONTROL_PATH "/", obj->engine->hw->name, NULL);
+
+  if (!dbus_connection_register_object_path(dbus, path, &sim_control_vtable,
+                                            obj))
+    log_error("Couldn't register the simulator control object", "OOM", FALSE);
+
+  g_free(path);
+}
@@ -0,0 +1,9 @@
+#ifndef __FMTXD_SIM_CONTROL_H_INCLUDED__
+#define __FMTXD_SIM_CONTROL_H_INCLUDED__
+
+#include "fmtx-object.h"
+
+void
+sim_control_register(DBusConnection *dbus, FmtxObject *obj);
+
+#endif /* __FMTXD_SIM_CONTROL_H_INCLUDED__ */
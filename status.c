@@ -0,0 +1,156 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fmtxd.h"
+#include "status.h"
+
+/* Readers mmap the page and retry while seq is odd or changed under them,
+ * so Get traffic from status widgets never reaches the daemon. The page is
+ * reused across restarts to keep existing mappings valid. */
+
+/* Cut on a UTF-8 character boundary */
+static void
+copy_string(char *dst, size_t size, const char *src)
+{
+  size_t len;
+
+  memset(dst, 0, size);
+
+  if (!src)
+    return;
+
+  len = strlen(src);
+
+  if (len >= size)
+  {
+    len = size - 1;
+
+    while (len && ((unsigned char)src[len] & 0xc0) == 0x80)
+      len--;
+  }
+
+  memcpy(dst, src, len);
+}
+
+static void
+status_page_begin(FmtxStatusPage *page)
+{
+  __atomic_store_n(&page->seq, page->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+status_page_end(FmtxObject *obj)
+{
+  __atomic_store_n(&obj->status->seq, obj->status->seq + 1, __ATOMIC_RELEASE);
+
+  /* bump ctime so inotify readers get IN_ATTRIB */
+  futimens(obj->status_fd, NULL);
+}
+
+void
+status_page_init(FmtxObject *obj)
+{
+  const char *base = g_getenv("FMTXD_STATUS_PATH");
+  gchar *path;
+  gchar *dir;
+  void *page;
+  int fd;
+
+  if (!base)
+    base = FMTX_STATUS_PATH;
+
+  if (fmtx_object_is_primary(obj))
+    path = g_strdup(base);
+  else
+    path = g_strdup_printf("%s.%s", base, obj->engine->hw->name);
+
+  dir = g_path_get_dirname(path);
+
+  if (mkdir(dir, 0755) == -1 && errno != EEXIST)
+    perror("fmtxd Could not create status page directory");
+
+  g_free(dir);
+
+  fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  g_free(path);
+
+  if (fd == -1)
+  {
+    perror("fmtxd Could not open status page");
+    return;
+  }
+
+  if (ftruncate(fd, sizeof(FmtxStatusPage)) == -1)
+  {
+    perror("fmtxd Could not size status page");
+    close(fd);
+    return;
+  }
+
+  page = mmap(NULL, sizeof(FmtxStatusPage), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+
+  if (page == MAP_FAILED)
+  {
+    perror("fmtxd Could not map status page");
+    close(fd);
+    return;
+  }
+
+  obj->status = page;
+  obj->status_fd = fd;
+
+  /* a daemon killed mid-update leaves seq odd */
+  if (obj->status->seq & 1)
+    obj->status->seq++;
+
+  status_page_update(obj);
+}
+
+void
+status_page_update(FmtxObject *obj)
+{
+  FmtxStatusPage *page = obj->status;
+  FmtxEngine *engine = obj->engine;
+
+  if (!page)
+    return;
+
+  status_page_begin(page);
+  page->magic = FMTX_STATUS_MAGIC;
+  page->version = FMTX_STATUS_VERSION;
+  page->pid = getpid();
+  page->frequency = engine->frequency;
+  page->freq_min = engine->freq_min;
+  page->freq_max = engine->freq_max;
+  page->freq_step = engine->freq_step;
+  copy_string(page->state, sizeof(page->state),
+              fmtx_state_name(engine->state));
+  copy_string(page->startable, sizeof(page->startable),
+              fmtx_engine_startable(engine));
+  copy_string(page->rds_ps, sizeof(page->rds_ps), engine->rds_ps);
+  copy_string(page->rds_text, sizeof(page->rds_text), engine->rds_text);
+  status_page_end(obj);
+}
+
+void
+status_page_close(FmtxObject *obj)
+{
+  if (!obj->status)
+    return;
+
+  status_page_begin(obj->status);
+  obj->status->pid = 0;
+  status_page_end(obj);
+
+  munmap(obj->status, sizeof(FmtxStatusPage));
+  close(obj->status_fd);
+  obj->status = NULL;
+}
@@ -0,0 +1,13 @@
+#ifndef __FMTXD_STATUS_H_INCLUDED__
+#define __FMTXD_STATUS_H_INCLUDED__
+
+#include "fmtx-object.h"
+
+void
+status_page_init(FmtxObject *obj);
+void
+status_page_update(FmtxObject *obj);
+void
+status_page_close(FmtxObject *obj);
+
+#endif /* __FMTXD_STATUS_H_INCLUDED__ */